@@ -17,10 +17,19 @@
 #include <stdlib.h>
 #include <string.h>
 
-#ifdef SRCFILE_CHECK_INO
+#if defined SRCFILE_CHECK_INO || defined SRCFILE_USE_MMAP
 #include <sys/stat.h>
 #endif
 
+#ifdef SRCFILE_USE_MMAP
+#include <sys/mman.h>
+#endif
+
+#ifdef SRCFILE_LIST_DIRS
+#include <dirent.h>
+#include <errno.h>
+#endif
+
 
 
 #ifndef NDEBUG
@@ -52,18 +61,93 @@ pos_t pos_including(pos_t start, pos_t end) {
     return start;
 }
 
+// Encode the start of a position as a `srcloc_t`.
+// Returns `SRCLOC_NONE` if the position has no source file or it could not be assigned locations.
+srcloc_t srcloc_from_pos(pos_t pos) {
+    if (!pos.srcfile || pos.srcfile->srcloc_base == SRCLOC_NONE) {
+        return SRCLOC_NONE;
+    }
+    return pos.srcfile->srcloc_base + (srcloc_t)pos.off;
+}
+
+// Decode a `srcloc_t` back into a position of length `len`, computing the line and column.
+// Returns a position without source file for `SRCLOC_NONE`.
+pos_t srcloc_to_pos(cctx_t const *ctx, srcloc_t loc, off_t len) {
+    if (loc == SRCLOC_NONE || loc >= ctx->srcloc_next) {
+        return (pos_t){0};
+    }
+
+    // Find the last file whose range starts at or before `loc`.
+    size_t lo = 0;
+    size_t hi = ctx->srcs_len;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (ctx->srcs[mid]->srcloc_base != SRCLOC_NONE && ctx->srcs[mid]->srcloc_base <= loc) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    srcfile_t *file = ctx->srcs[lo];
+    off_t      off  = loc - file->srcloc_base;
+    return (pos_t){
+        .srcfile = file,
+        .off     = off,
+        .line    = srcfile_line_of(file, off),
+        .col     = srcfile_col_of(file, off),
+        .len     = len,
+    };
+}
+
+// Encode a position as a `srcrange_t`.
+srcrange_t srcrange_from_pos(pos_t pos) {
+    return (srcrange_t){
+        .loc = srcloc_from_pos(pos),
+        .len = (int32_t)pos.len,
+    };
+}
+
+// Decode a `srcrange_t` back into a position, computing the line and column.
+pos_t srcrange_to_pos(cctx_t const *ctx, srcrange_t range) {
+    return srcloc_to_pos(ctx, range.loc, range.len);
+}
+
+// Get range from start to end (exclusive).
+srcrange_t srcrange_between(srcrange_t start, srcrange_t end) {
+    start.len = (int32_t)(end.loc - start.loc);
+    return start;
+}
+
+// Get range from start to end (inclusive).
+srcrange_t srcrange_including(srcrange_t start, srcrange_t end) {
+    start.len = (int32_t)(end.loc - start.loc) + end.len;
+    return start;
+}
+
 // Create new compiler context.
 cctx_t *cctx_create() {
-    return lilycc_calloc(1, sizeof(cctx_t));
+    cctx_t *ctx        = lilycc_calloc(1, sizeof(cctx_t));
+    ctx->srcs_by_path  = STR_MAP_EMPTY;
+    ctx->missing_paths = STR_SET_EMPTY;
+#ifdef SRCFILE_LIST_DIRS
+    ctx->dir_listings = STR_MAP_EMPTY;
+#endif
+    return ctx;
 }
 
 // Close a source file.
 static void srcfile_close(srcfile_t *file) {
-    if (file->is_ram_file) {
-        lilycc_free(file->content);
+#ifdef SRCFILE_USE_MMAP
+    if (file->is_mapped) {
+        munmap(file->content, file->content_len);
     } else {
-        fclose(file->fd);
+        lilycc_free(file->content);
     }
+#else
+    lilycc_free(file->content);
+#endif
+    vec_clear(&file->line_starts);
     lilycc_free(file->path);
     lilycc_free(file);
 }
@@ -74,6 +158,13 @@ void cctx_delete(cctx_t *ctx) {
         srcfile_close(ctx->srcs[i]);
     }
     lilycc_free(ctx->srcs);
+    map_clear(&ctx->srcs_by_path);
+    set_clear(&ctx->missing_paths);
+#ifdef SRCFILE_LIST_DIRS
+    srcfile_listings_clear(&ctx->dir_listings);
+#endif
+    strpool_clear(&ctx->idents);
+    arena_clear(&ctx->tkn_arena);
 
     while (ctx->diagnostics.len) {
         diagnostic_t *diag = (diagnostic_t *)dlist_pop_front(&ctx->diagnostics);
@@ -159,7 +250,7 @@ void print_diagnostic(diagnostic_t const *diag, FILE *to) {
     off_t min_chars  = diag->pos.col - pos.col + diag->pos.len;
     off_t max_chars  = min_chars + 80;
     off_t off        = pos.off;
-    int   line       = pos.line + 1;
+    int   line       = srcfile_line_of(pos.srcfile, pos.off) + 1;
     off_t line_start = off;
     bool  draw       = false;
     fprintf(to, "%5d | ", line);
@@ -226,15 +317,75 @@ void print_diagnostic(diagnostic_t const *diag, FILE *to) {
 }
 
 
+// Read the entire content of a file on disk into memory.
+// Maps the file if possible, otherwise reads it in one go.
+static bool srcfile_load(srcfile_t *file, FILE *fd) {
+#ifdef SRCFILE_USE_MMAP
+    struct stat statbuf;
+    if (!fstat(fileno(fd), &statbuf) && S_ISREG(statbuf.st_mode)) {
+        if (statbuf.st_size == 0) {
+            // Zero-length mappings are not allowed, but there's nothing to read anyway.
+            file->content     = NULL;
+            file->content_len = 0;
+            return true;
+        }
+        void *mem = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fileno(fd), 0);
+        if (mem != MAP_FAILED) {
+            file->content     = mem;
+            file->content_len = statbuf.st_size;
+            file->is_mapped   = true;
+            return true;
+        }
+    }
+#endif
+
+    // Not a regular file or cannot be mapped; read it in large chunks instead.
+    vec_uint8_t buf = {0};
+    while (1) {
+        vec_reserve(&buf, 4096);
+        size_t n  = fread(buf.arr + buf.len, 1, buf.cap - buf.len, fd);
+        buf.len  += n;
+        if (n == 0) {
+            break;
+        }
+    }
+    if (ferror(fd)) {
+        vec_clear(&buf);
+        return false;
+    }
+    file->content     = buf.arr;
+    file->content_len = buf.len;
+    return true;
+}
+
+// Add a new source file to the compiler context and assign it a range of `srcloc_t`.
+static void srcfile_register(cctx_t *ctx, srcfile_t *file) {
+    if (ctx->srcloc_next == SRCLOC_NONE) {
+        // Location 0 is reserved for `SRCLOC_NONE`.
+        ctx->srcloc_next = 1;
+    }
+    // One extra location so that the end of the file can be encoded.
+    if (ctx->srcloc_next < UINT32_MAX && file->content_len < UINT32_MAX - ctx->srcloc_next) {
+        file->srcloc_base  = ctx->srcloc_next;
+        ctx->srcloc_next  += file->content_len + 1;
+    } else {
+        file->srcloc_base = SRCLOC_NONE;
+        ctx->srcloc_next  = UINT32_MAX;
+    }
+    array_lencap_insert_strong(&ctx->srcs, sizeof(void *), &ctx->srcs_len, &ctx->srcs_cap, &file, ctx->srcs_len);
+    if (!map_get(&ctx->srcs_by_path, file->path)) {
+        map_set(&ctx->srcs_by_path, file->path, file);
+    }
+}
+
 // Open or get a source file from compiler context.
 srcfile_t *srcfile_open(cctx_t *ctx, char const *path) {
     // Check for existing source files.
-    for (size_t i = 0; i < ctx->srcs_len; i++) {
-        // Could try `realpath` on POSIX systems,
-        // decided against since a chdir during compilation shouldn't be happening anyway.
-        if (!strcmp(path, ctx->srcs[i]->path)) {
-            return ctx->srcs[i];
-        }
+    // Could try `realpath` on POSIX systems,
+    // decided against since a chdir during compilation shouldn't be happening anyway.
+    srcfile_t *existing = map_get(&ctx->srcs_by_path, path);
+    if (existing) {
+        return existing;
     }
 
     FILE *fd = fopen(path, "rb");
@@ -252,16 +403,30 @@ srcfile_t *srcfile_open(cctx_t *ctx, char const *path) {
     }
     for (size_t i = 0; i < ctx->srcs_len; i++) {
         if (ctx->srcs[i]->dev == statbuf.st_dev && ctx->srcs[i]->ino == statbuf.st_ino) {
+            // Remember this path too so the file doesn't have to be opened again.
             fclose(fd);
+            map_set(&ctx->srcs_by_path, path, ctx->srcs[i]);
             return ctx->srcs[i];
         }
     }
 #endif
 
-    srcfile_t *file   = lilycc_calloc(1, sizeof(srcfile_t));
+    srcfile_t *file = lilycc_calloc(1, sizeof(srcfile_t));
+    if (!srcfile_load(file, fd)) {
+        perror("fread");
+        fclose(fd);
+        lilycc_free(file);
+        return NULL;
+    }
+    fclose(fd);
+#ifdef SRCFILE_CHECK_INO
+    file->ino = statbuf.st_ino;
+    file->dev = statbuf.st_dev;
+#endif
+
     file->ctx         = ctx;
     file->is_ram_file = false;
-    file->fd          = fd;
+    file->ascii_only  = utf8_ascii_len((char const *)file->content, file->content_len) == file->content_len;
     file->path        = lilycc_strdup(path);
     char *sep         = strrchr(file->path, '/');
     if (sep) {
@@ -270,25 +435,105 @@ srcfile_t *srcfile_open(cctx_t *ctx, char const *path) {
         file->name = file->path;
     }
 
-    array_lencap_insert_strong(&ctx->srcs, sizeof(void *), &ctx->srcs_len, &ctx->srcs_cap, &file, ctx->srcs_len);
+    srcfile_register(ctx, file);
 
     return file;
 }
 
+#ifdef SRCFILE_LIST_DIRS
+// Read the listing of a directory into `listings`, if it isn't in there yet.
+// Returns the listing, or NULL if the directory exists but can't be read.
+set_t *srcfile_list_dir(map_t *listings, char const *dir) {
+    set_t *listing = map_get(listings, dir);
+    if (listing) {
+        return listing;
+    }
+    DIR *dirp = opendir(dir);
+    if (!dirp && errno != ENOENT && errno != ENOTDIR) {
+        // The directory might still be searchable without being readable; don't cache anything.
+        return NULL;
+    }
+    listing  = lilycc_calloc(1, sizeof(set_t));
+    *listing = STR_SET_EMPTY;
+    if (dirp) {
+        struct dirent *ent;
+        while ((ent = readdir(dirp))) {
+            set_add(listing, ent->d_name);
+        }
+        closedir(dirp);
+    }
+    map_set(listings, dir, listing);
+    return listing;
+}
+
+// Free the directory listings read by `srcfile_list_dir`.
+void srcfile_listings_clear(map_t *listings) {
+    map_foreach(ent, listings) {
+        set_clear(ent->value);
+        lilycc_free(ent->value);
+    }
+    map_clear(listings);
+}
+
+// Whether a directory listing says that `path` may exist.
+// Reads the directory `path` is in the first time it is asked about, unless it is in `ctx->shared_listings`.
+static bool srcfile_dir_has(cctx_t *ctx, char const *path) {
+    char const *sep     = strrchr(path, '/');
+    char const *name    = sep ? sep + 1 : path;
+    size_t      dir_len = sep ? (sep == path ? 1 : sep - path) : 1;
+    char       *dir     = lilycc_malloc(dir_len + 1);
+    memcpy(dir, sep ? path : ".", dir_len);
+    dir[dir_len] = 0;
+
+    set_t *listing = ctx->shared_listings ? map_get(ctx->shared_listings, dir) : NULL;
+    if (!listing) {
+        listing = srcfile_list_dir(&ctx->dir_listings, dir);
+    }
+    lilycc_free(dir);
+
+    return !listing || set_contains(listing, name);
+}
+#endif
+
 // Open or get a source file from compiler context, searching in the given paths.
-srcfile_t *srcfile_popen(cctx_t *ctx, char const *path, char const *const *search, size_t search_len) {
+srcfile_t *srcfile_popen(
+    cctx_t *ctx, char const *path, char const *const *search, size_t search_len, size_t *found_index
+) {
     if (path[0] == '/') {
         return srcfile_open(ctx, path);
     }
     size_t path_len = strlen(path);
     for (size_t i = 0; i < search_len; i++) {
-        char *pathbuf = lilycc_malloc(path_len + strlen(search[i]) + 2);
-        strcpy(pathbuf, search[i]);
-        strcat(pathbuf, "/");
-        strcpy(pathbuf, path);
-        srcfile_t *res = srcfile_open(ctx, pathbuf);
+        // The current directory is searched as `.`, but files in it are opened without a `./` prefix.
+        char *pathbuf;
+        if (!strcmp(search[i], ".")) {
+            pathbuf = lilycc_strdup(path);
+        } else {
+            pathbuf = lilycc_malloc(path_len + strlen(search[i]) + 2);
+            strcpy(pathbuf, search[i]);
+            strcat(pathbuf, "/");
+            strcat(pathbuf, path);
+        }
+
+        srcfile_t *res = map_get(&ctx->srcs_by_path, pathbuf);
+        if (!res && !set_contains(&ctx->missing_paths, pathbuf)) {
+#ifdef SRCFILE_LIST_DIRS
+            if (srcfile_dir_has(ctx, pathbuf)) {
+                res = srcfile_open(ctx, pathbuf);
+            }
+#else
+            res = srcfile_open(ctx, pathbuf);
+#endif
+            if (!res) {
+                set_add(&ctx->missing_paths, pathbuf);
+            }
+        }
         lilycc_free(pathbuf);
+
         if (res) {
+            if (found_index) {
+                *found_index = i;
+            }
             return res;
         }
     }
@@ -307,8 +552,9 @@ srcfile_t *srcfile_create(cctx_t *ctx, char const *virt_path, void const *data,
     file->content_len = len;
     file->ctx         = ctx;
     memcpy(file->content, data, len);
+    file->ascii_only = utf8_ascii_len(data, len) == len;
 
-    array_lencap_insert_strong(&ctx->srcs, sizeof(void *), &ctx->srcs_len, &ctx->srcs_cap, &file, ctx->srcs_len);
+    srcfile_register(ctx, file);
 
     return file;
 }
@@ -316,22 +562,64 @@ srcfile_t *srcfile_create(cctx_t *ctx, char const *virt_path, void const *data,
 // Read a raw byte from a source file.
 // Returns -1 on EOF.
 int srcfile_readb(srcfile_t *file, off_t off) {
-    if (file->is_ram_file) {
-        if (off >= (off_t)file->content_len) {
-            return -1;
-        }
-        return file->content[off];
-    } else {
-        if (file->fd_off != off) {
-            fseek(file->fd, off, SEEK_SET);
-            file->fd_off = off;
-        }
-        int val = fgetc(file->fd);
-        if (val != -1) {
-            file->fd_off = off + 1;
+    if (off >= (off_t)file->content_len) {
+        return -1;
+    }
+    return file->content[off];
+}
+
+// Get a span of at most `max_len` raw bytes starting at `off`, so that tokenizers can process multiple bytes at once.
+// If the byte at `off` is ASCII, the span ends before the first non-ASCII byte and `is_ascii` is set.
+// Otherwise, the span covers just the non-ASCII bytes and `is_ascii` is cleared.
+// Returns an empty span at EOF.
+srcspan_t srcfile_span(srcfile_t const *file, off_t off, size_t max_len) {
+    if (off >= (off_t)file->content_len) {
+        return (srcspan_t){.data = NULL, .len = 0, .is_ascii = true};
+    }
+    uint8_t const *data = file->content + off;
+    size_t         len  = file->content_len - off;
+    if (len > max_len) {
+        len = max_len;
+    }
+    if (file->ascii_only) {
+        return (srcspan_t){.data = data, .len = len, .is_ascii = true};
+    }
+
+    if (!(data[0] & 0x80)) {
+        return (srcspan_t){
+            .data     = data,
+            .len      = utf8_ascii_len((char const *)data, len),
+            .is_ascii = true,
+        };
+    }
+    size_t i = 1;
+    while (i < len && (data[i] & 0x80)) {
+        i++;
+    }
+    return (srcspan_t){.data = data, .len = i, .is_ascii = false};
+}
+
+// Advance a position over `n` bytes of pure ASCII, updating line and column like `srcfile_getc` would.
+// If this ends between a CR and LF, the LF is consumed as well.
+void srcfile_advance(srcfile_t const *file, pos_t *pos, size_t n) {
+    uint8_t const *data = file->content + pos->off;
+    size_t         i    = 0;
+    while (i < n) {
+        uint8_t c = data[i++];
+        if (c == '\r') {
+            if (pos->off + (off_t)i < (off_t)file->content_len && data[i] == '\n') {
+                i++;
+            }
+            pos->line++;
+            pos->col = 0;
+        } else if (c == '\n') {
+            pos->line++;
+            pos->col = 0;
+        } else {
+            pos->col++;
         }
-        return val;
     }
+    pos->off += (off_t)i;
 }
 
 // Read a character from a source file and update offset.
@@ -403,50 +691,84 @@ int srcfile_getc(srcfile_t *file, pos_t *pos) {
 
 // Try to seek to the previous character in a source file.
 static bool srcfile_seekprev_raw(srcfile_t *file, off_t *off) {
-    if (file->is_ram_file) {
-        if (*off == 0) {
-            return false;
-        }
-        (*off)--;
-        while (*off > 0 && ((unsigned char)file->content[*off] & 0xC0) == 0x80) {
-            (*off)--;
-        }
-        return true;
-    } else {
-        if (*off == 0) {
-            return false;
-        }
+    if (*off == 0) {
+        return false;
+    }
+    (*off)--;
+    while (*off > 0 && (file->content[*off] & 0xC0) == 0x80) {
         (*off)--;
-        int c;
-        do {
-            fseek(file->fd, *off, SEEK_SET);
-            c = fgetc(file->fd);
-            if (*off == 0 || ((unsigned char)c & 0xC0) != 0x80) {
-                break;
-            }
-            (*off)--;
-        } while (*off > 0);
-        return true;
     }
+    return true;
 }
 
 // Try to seek to the previous character in a source file.
 // Will stop at the beginnings of lines.
 bool srcfile_seekprev(srcfile_t *file, pos_t *pos) {
-    off_t tmp_off = pos->off;
-    if (!srcfile_seekprev_raw(file, &tmp_off)) {
+    if (pos->off <= srcfile_line_start(file, srcfile_line_of(file, pos->off))) {
         return false;
     }
+    srcfile_seekprev_raw(file, &pos->off);
+    pos->col--;
+    return true;
+}
+
+// Get the line starts table of a source file, building it if it doesn't exist yet.
+// Line endings are the same as for `srcfile_getc`; LF, CRLF or a lone CR.
+static vec_off_t const *srcfile_line_starts(srcfile_t *file) {
+    if (file->line_starts.len) {
+        return &file->line_starts;
+    }
+    vec_push(&file->line_starts, 0);
+    for (size_t i = 0; i < file->content_len; i++) {
+        uint8_t c = file->content[i];
+        if (c == '\r' && i + 1 < file->content_len && file->content[i + 1] == '\n') {
+            i++;
+        } else if (c != '\r' && c != '\n') {
+            continue;
+        }
+        vec_push(&file->line_starts, (off_t)i + 1);
+    }
+    return &file->line_starts;
+}
 
-    off_t tmp_off_2 = tmp_off;
-    int   c         = srcfile_getc_raw(file, &tmp_off_2);
-    if (c == '\n') {
-        return false;
+// Get the zero-indexed line that contains offset `off`.
+int srcfile_line_of(srcfile_t *file, off_t off) {
+    vec_off_t const *starts = srcfile_line_starts(file);
+    size_t           lo     = 0;
+    size_t           hi     = starts->len;
+    // Find the last line that starts at or before `off`.
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (starts->arr[mid] <= off) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
     }
+    return (int)lo;
+}
 
-    pos->col--;
-    pos->off = tmp_off;
-    return true;
+// Get the offset at which zero-indexed line `line` starts, or -1 if there is no such line.
+off_t srcfile_line_start(srcfile_t *file, int line) {
+    vec_off_t const *starts = srcfile_line_starts(file);
+    if (line < 0 || (size_t)line >= starts->len) {
+        return -1;
+    }
+    return starts->arr[line];
+}
+
+// Get the zero-indexed column (in characters) of offset `off`.
+int srcfile_col_of(srcfile_t *file, off_t off) {
+    off_t cur = srcfile_line_start(file, srcfile_line_of(file, off));
+    if (file->ascii_only) {
+        return (int)(off - cur);
+    }
+    int col = 0;
+    while (cur < off) {
+        srcfile_getc_raw(file, &cur);
+        col++;
+    }
+    return col;
 }
 
 
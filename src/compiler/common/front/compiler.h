@@ -5,7 +5,11 @@
 
 #pragma once
 
+#include "arena.h"
 #include "list.h"
+#include "map.h"
+#include "set.h"
+#include "strpool.h"
 #include "vec.h"
 
 #include <stdbool.h>
@@ -15,6 +19,8 @@
 
 #ifdef _POSIX_C_SOURCE
 #define SRCFILE_CHECK_INO
+#define SRCFILE_USE_MMAP
+#define SRCFILE_LIST_DIRS
 #endif
 
 #ifdef SRCFILE_CHECK_INO
@@ -62,12 +68,16 @@ extern char const *const tokentype_names[];
 #endif
 
 
+// Compact source location; an offset into a virtual address space shared by all source files in a `cctx_t`.
+typedef uint32_t          srcloc_t;
 // Source file.
 typedef struct srcfile    srcfile_t;
 // Position in a source file.
 typedef struct pos        pos_t;
-// Include file instance.
-typedef struct incfile    incfile_t;
+// Compact position in a source file; a `srcloc_t` with a length.
+typedef struct srcrange   srcrange_t;
+// Span of raw bytes in a source file.
+typedef struct srcspan    srcspan_t;
 // Compilation context.
 typedef struct cctx       cctx_t;
 // Diagnostic message.
@@ -75,6 +85,11 @@ typedef struct diagnostic diagnostic_t;
 // Token data.
 typedef struct token      token_t;
 
+// Unknown source location; no source file has this location.
+#define SRCLOC_NONE ((srcloc_t)0)
+
+
+VEC_TYPE_DEF(vec_off_t, off_t)
 
 // Source file.
 struct srcfile {
@@ -90,14 +105,20 @@ struct srcfile {
     char const *name;
     // Is this stored in RAM (as opposed to on disk)?
     bool        is_ram_file;
-    // Current offset of file descriptor (for file on disk).
-    off_t       fd_off;
-    // File descriptor (for files on disk).
-    FILE       *fd;
-    // File content size (for files in RAM).
+#ifdef SRCFILE_USE_MMAP
+    // Is `content` memory-mapped (as opposed to heap-allocated)?
+    bool is_mapped;
+#endif
+    // File content size.
     size_t      content_len;
-    // File content pointer (for files in RAM).
+    // File content pointer; files on disk are read in their entirety when opened.
     uint8_t    *content;
+    // The entire content is 7-bit ASCII; allows `srcfile_span` to skip scanning.
+    bool        ascii_only;
+    // Offsets at which each line starts; built on first use by `srcfile_line_of` and `srcfile_line_start`.
+    vec_off_t   line_starts;
+    // First `srcloc_t` assigned to this file, or `SRCLOC_NONE` if the address space was exhausted.
+    srcloc_t    srcloc_base;
 #ifdef SRCFILE_CHECK_INO
     // Inode number (used for deduplication).
     ino_t ino;
@@ -110,8 +131,6 @@ struct srcfile {
 struct pos {
     // Source file from whence this came.
     srcfile_t *srcfile;
-    // Include file from whence this came, if any.
-    incfile_t *incfile;
     // File offset in bytes.
     off_t      off;
     // Zero-indexed line.
@@ -122,12 +141,23 @@ struct pos {
     off_t      len;
 };
 
-// Include file instance.
-struct incfile {
-    // Associated source file.
-    srcfile_t *srcfile;
-    // Position of whatever directive caused the inclusion.
-    pos_t      inc_from;
+// Compact position in a source file; a quarter of the size of `pos_t`.
+// The source file, line and column are recovered by `srcrange_to_pos`.
+struct srcrange {
+    // Location of the first byte, or `SRCLOC_NONE`.
+    srcloc_t loc;
+    // Length in bytes.
+    int32_t  len;
+};
+
+// Span of raw bytes in a source file.
+struct srcspan {
+    // Pointer to the first byte.
+    uint8_t const *data;
+    // Length in bytes.
+    size_t         len;
+    // All bytes are 7-bit ASCII; each byte is exactly one character.
+    bool           is_ascii;
 };
 
 // Compilation context.
@@ -136,8 +166,28 @@ struct cctx {
     size_t      srcs_len;
     // Capacity for open source files.
     size_t      srcs_cap;
-    // Array of open source files.
+    // Array of open source files, sorted by `srcloc_base`.
     srcfile_t **srcs;
+    // Open source files by the paths they were opened with.
+    // Map of `char const *` -> `srcfile_t *`.
+    map_t       srcs_by_path;
+    // Paths that `srcfile_popen` could not open.
+    // Set of `char const *`.
+    set_t       missing_paths;
+#ifdef SRCFILE_LIST_DIRS
+    // Contents of directories searched by `srcfile_popen`, read once so it can skip files that don't exist.
+    // Map of `char const *` -> `set_t *` of `char const *` file names.
+    map_t       dir_listings;
+    // Directory listings shared with other compiler contexts, looked in before `dir_listings`; may be NULL.
+    // Not modified, so that contexts on different threads can share it. Same format as `dir_listings`.
+    map_t      *shared_listings;
+#endif
+    // Next free `srcloc_t`.
+    srcloc_t    srcloc_next;
+    // Interned identifier names.
+    strpool_t   idents;
+    // Memory for token strings that live as long as the context; see `tkn_arena_strval`.
+    arena_t     tkn_arena;
     // Linked list of diagnostics.
     dlist_t     diagnostics;
 };
@@ -162,10 +212,14 @@ struct token {
     tokentype_t type;
     // Language-specific subtype.
     int         subtype;
-    // Identifier or string constant value.
+    // Identifier or string constant value; NUL-terminated unless `strval_borrowed` is set.
     char       *strval;
     // Length of string constant value.
     size_t      strval_len;
+    // `strval` is interned in the compiler context's `idents` pool instead of owned by this token.
+    bool        strval_interned;
+    // `strval` is borrowed from memory that outlives the token, like source file content, instead of owned by this token.
+    bool        strval_borrowed;
     // Integer constant value.
     uint64_t    ival, ivalh;
     // Number of parameters for AST node.
@@ -179,9 +233,23 @@ VEC_TYPE_DEF(vec_token_t, token_t)
 
 
 // Get position from start to end (exclusive).
-pos_t pos_between(pos_t start, pos_t end);
+pos_t      pos_between(pos_t start, pos_t end);
 // Get position from start to end (inclusive).
-pos_t pos_including(pos_t start, pos_t end);
+pos_t      pos_including(pos_t start, pos_t end);
+// Encode the start of a position as a `srcloc_t`.
+// Returns `SRCLOC_NONE` if the position has no source file or it could not be assigned locations.
+srcloc_t   srcloc_from_pos(pos_t pos);
+// Decode a `srcloc_t` back into a position of length `len`, computing the line and column.
+// Returns a position without source file for `SRCLOC_NONE`.
+pos_t      srcloc_to_pos(cctx_t const *ctx, srcloc_t loc, off_t len);
+// Encode a position as a `srcrange_t`.
+srcrange_t srcrange_from_pos(pos_t pos);
+// Decode a `srcrange_t` back into a position, computing the line and column.
+pos_t      srcrange_to_pos(cctx_t const *ctx, srcrange_t range);
+// Get range from start to end (exclusive).
+srcrange_t srcrange_between(srcrange_t start, srcrange_t end);
+// Get range from start to end (inclusive).
+srcrange_t srcrange_including(srcrange_t start, srcrange_t end);
 
 // Create new compiler context.
 cctx_t       *cctx_create();
@@ -197,12 +265,31 @@ void print_diagnostic(diagnostic_t const *diag, FILE *to);
 // Open or get a source file from compiler context.
 srcfile_t *srcfile_open(cctx_t *ctx, char const *path);
 // Open or get a source file from compiler context, searching in the given paths.
-srcfile_t *srcfile_popen(cctx_t *ctx, char const *path, char const *const *search, size_t search_len);
+// If `found_index` is not NULL, the index in `search` of the path the file was found in is written to it.
+// Failed lookups and directory listings are cached, so files created after being searched for may not be found.
+srcfile_t *srcfile_popen(
+    cctx_t *ctx, char const *path, char const *const *search, size_t search_len, size_t *found_index
+);
+#ifdef SRCFILE_LIST_DIRS
+// Read the listing of a directory into `listings`, if it isn't in there yet.
+// Returns the listing, or NULL if the directory exists but can't be read.
+set_t     *srcfile_list_dir(map_t *listings, char const *dir);
+// Free the directory listings read by `srcfile_list_dir`.
+void       srcfile_listings_clear(map_t *listings);
+#endif
 // Create a source file from binary data.
 srcfile_t *srcfile_create(cctx_t *ctx, char const *virt_path, void const *data, size_t len);
 // Read a single raw byte from a source file at `off`.
 // Returns the byte (0..255) or -1 on EOF. Does not do UTF-8 decoding.
 int        srcfile_readb(srcfile_t *file, off_t off);
+// Get a span of at most `max_len` raw bytes starting at `off`, so that tokenizers can process multiple bytes at once.
+// If the byte at `off` is ASCII, the span ends before the first non-ASCII byte and `is_ascii` is set.
+// Otherwise, the span covers just the non-ASCII bytes and `is_ascii` is cleared.
+// Returns an empty span at EOF.
+srcspan_t  srcfile_span(srcfile_t const *file, off_t off, size_t max_len);
+// Advance a position over `n` bytes of pure ASCII, updating line and column like `srcfile_getc` would.
+// If this ends between a CR and LF, the LF is consumed as well.
+void       srcfile_advance(srcfile_t const *file, pos_t *pos, size_t n);
 // Read a character from a source file and update offset.
 int        srcfile_getc_raw(srcfile_t *file, off_t *offset);
 // Read a character from a source file and update position.
@@ -210,6 +297,12 @@ int        srcfile_getc(srcfile_t *file, pos_t *pos);
 // Try to seek to the previous character in a source file.
 // Will stop at the beginnings of lines.
 bool       srcfile_seekprev(srcfile_t *file, pos_t *pos);
+// Get the zero-indexed line that contains offset `off`.
+int        srcfile_line_of(srcfile_t *file, off_t off);
+// Get the offset at which zero-indexed line `line` starts, or -1 if there is no such line.
+off_t      srcfile_line_start(srcfile_t *file, int line);
+// Get the zero-indexed column (in characters) of offset `off`.
+int        srcfile_col_of(srcfile_t *file, off_t off);
 
 // Create an empty AST token with a position.
 token_t ast_empty(int subtype, pos_t pos);
@@ -228,10 +321,12 @@ void ast_append_params(token_t *ast, size_t n_param, token_t *params);
 
 // Set an AST node's strval.
 static inline token_t ast_with_strval(token_t ast, char *strval) {
-    if (ast.strval) {
+    if (ast.strval && !ast.strval_interned && !ast.strval_borrowed) {
         lilycc_free(ast.strval);
     }
-    ast.strval = strval;
+    ast.strval          = strval;
+    ast.strval_interned = false;
+    ast.strval_borrowed = false;
     return ast;
 }
 
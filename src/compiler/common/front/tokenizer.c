@@ -5,7 +5,6 @@
 
 #include "tokenizer.h"
 
-#include "arrays.h"
 #include "char_repr.h"
 #include "lilycc_malloc.h"
 #include "utf8.h"
@@ -16,11 +15,34 @@
 
 
 
+// Get the index in `tkn_buffer` of the token `depth` places from the head.
+static inline size_t tkn_buffer_index(tokenizer_t const *tkn_ctx, size_t depth) {
+    return (tkn_ctx->tkn_buffer_head + depth) & (tkn_ctx->tkn_buffer_cap - 1);
+}
+
+// Make room for at least one more token in the buffer.
+static void tkn_buffer_reserve(tokenizer_t *tkn_ctx) {
+    if (tkn_ctx->tkn_buffer_len < tkn_ctx->tkn_buffer_cap) {
+        return;
+    }
+    size_t   new_cap = tkn_ctx->tkn_buffer_cap ? tkn_ctx->tkn_buffer_cap * 2 : 4;
+    token_t *new_buf = lilycc_malloc(new_cap * sizeof(token_t));
+    // Unwrap the old contents to the start of the new buffer.
+    for (size_t i = 0; i < tkn_ctx->tkn_buffer_len; i++) {
+        new_buf[i] = tkn_ctx->tkn_buffer[tkn_buffer_index(tkn_ctx, i)];
+    }
+    lilycc_free(tkn_ctx->tkn_buffer);
+    tkn_ctx->tkn_buffer      = new_buf;
+    tkn_ctx->tkn_buffer_cap  = new_cap;
+    tkn_ctx->tkn_buffer_head = 0;
+}
+
+
 // Delete a tokenizer context.
 // Deletes the token in the buffer but not any tokens consumed.
 void tkn_ctx_delete(tokenizer_t *tkn_ctx) {
     for (size_t i = 0; i < tkn_ctx->tkn_buffer_len; i++) {
-        tkn_delete(tkn_ctx->tkn_buffer[i]);
+        tkn_delete(tkn_ctx->tkn_buffer[tkn_buffer_index(tkn_ctx, i)]);
     }
     lilycc_free(tkn_ctx->tkn_buffer);
     if (tkn_ctx->cleanup) {
@@ -33,9 +55,9 @@ void tkn_ctx_delete(tokenizer_t *tkn_ctx) {
 // Consume next token from the tokenizer.
 token_t tkn_next(tokenizer_t *tkn_ctx) {
     if (tkn_ctx->tkn_buffer_len) {
+        token_t tmp              = tkn_ctx->tkn_buffer[tkn_ctx->tkn_buffer_head];
+        tkn_ctx->tkn_buffer_head = tkn_buffer_index(tkn_ctx, 1);
         tkn_ctx->tkn_buffer_len--;
-        token_t tmp = tkn_ctx->tkn_buffer[0];
-        memmove(tkn_ctx->tkn_buffer, tkn_ctx->tkn_buffer + 1, tkn_ctx->tkn_buffer_len * sizeof(token_t));
         return tmp;
     } else {
         return tkn_ctx->next(tkn_ctx);
@@ -55,28 +77,34 @@ token_t tkn_peek_n(tokenizer_t *tkn_ctx, size_t depth) {
         if (tmp.type == TOKENTYPE_EOF) {
             return tmp;
         }
-        array_lencap_insert_strong(
-            &tkn_ctx->tkn_buffer,
-            sizeof(token_t),
-            &tkn_ctx->tkn_buffer_len,
-            &tkn_ctx->tkn_buffer_cap,
-            &tmp,
-            tkn_ctx->tkn_buffer_len
-        );
+        tkn_buffer_reserve(tkn_ctx);
+        tkn_ctx->tkn_buffer[tkn_buffer_index(tkn_ctx, tkn_ctx->tkn_buffer_len)] = tmp;
+        tkn_ctx->tkn_buffer_len++;
     }
-    return tkn_ctx->tkn_buffer[depth];
+    return tkn_ctx->tkn_buffer[tkn_buffer_index(tkn_ctx, depth)];
 }
 
 // Opposite of tkn_next; stuff a token back to the front of the buffer.
 void tkn_unget(tokenizer_t *tkn_ctx, token_t token) {
-    array_lencap_insert_strong(
-        &tkn_ctx->tkn_buffer,
-        sizeof(token_t),
-        &tkn_ctx->tkn_buffer_len,
-        &tkn_ctx->tkn_buffer_cap,
-        &token,
-        0
-    );
+    tkn_buffer_reserve(tkn_ctx);
+    tkn_ctx->tkn_buffer_head = tkn_buffer_index(tkn_ctx, tkn_ctx->tkn_buffer_cap - 1);
+    tkn_ctx->tkn_buffer[tkn_ctx->tkn_buffer_head] = token;
+    tkn_ctx->tkn_buffer_len++;
+}
+
+// Discard all buffered tokens and move the tokenizer back to where the first of them started.
+// Only valid for tokenizers whose state is fully described by `pos`, and if no foreign tokens were pushed by `tkn_unget`.
+void tkn_rewind(tokenizer_t *tkn_ctx) {
+    if (!tkn_ctx->tkn_buffer_len) {
+        return;
+    }
+    tkn_ctx->pos     = tkn_ctx->tkn_buffer[tkn_ctx->tkn_buffer_head].pos;
+    tkn_ctx->pos.len = 0;
+    for (size_t i = 0; i < tkn_ctx->tkn_buffer_len; i++) {
+        tkn_delete(tkn_ctx->tkn_buffer[tkn_buffer_index(tkn_ctx, i)]);
+    }
+    tkn_ctx->tkn_buffer_head = 0;
+    tkn_ctx->tkn_buffer_len  = 0;
 }
 
 
@@ -122,7 +150,7 @@ int tkn_getc(token_t const *tkn, tknoff_t *off) {
 
 // Delete a token's dynamic memory (`strval` and `params`).
 void tkn_delete(token_t token) {
-    if (token.strval) {
+    if (token.strval && !token.strval_interned && !token.strval_borrowed) {
         lilycc_free(token.strval);
     }
     for (size_t i = 0; i < token.params_len; i++) {
@@ -145,7 +173,11 @@ token_t tkn_clone(token_t const *token) {
         .params_len = token->params_len,
     };
 
-    if (token->strval_len) {
+    if (token->strval_interned || token->strval_borrowed) {
+        out.strval          = token->strval;
+        out.strval_interned = token->strval_interned;
+        out.strval_borrowed = token->strval_borrowed;
+    } else if (token->strval_len) {
         out.strval = lilycc_malloc(token->strval_len + 1);
         memcpy(out.strval, token->strval, token->strval_len);
         out.strval[token->strval_len] = 0;
@@ -161,6 +193,24 @@ token_t tkn_clone(token_t const *token) {
     return out;
 }
 
+// Replace a borrowed `strval` with an owned, NUL-terminated copy.
+void tkn_own_strval(token_t *token) {
+    if (!token->strval_borrowed) {
+        return;
+    }
+    char *copy = lilycc_malloc(token->strval_len + 1);
+    memcpy(copy, token->strval, token->strval_len);
+    copy[token->strval_len] = 0;
+    token->strval           = copy;
+    token->strval_borrowed  = false;
+}
+
+// Copy a token string into the compiler context's token arena.
+// The result is NUL-terminated and should be marked with `strval_borrowed`; it is freed with the context.
+char *tkn_arena_strval(cctx_t *cctx, char const *str, size_t len) {
+    return arena_strndup(&cctx->tkn_arena, str, len);
+}
+
 // Delete an array of tokens and each token within.
 void tkn_arr_delete(size_t tokens_len, token_t *tokens) {
     for (size_t i = 0; i < tokens_len; i++) {
@@ -217,10 +267,10 @@ static void tkn_debug_print_r(
         printf("keyword:    %s\n", keyw[token.subtype]);
     } else if (token.type == TOKENTYPE_SCONST) {
         pindent(indent);
-        printf("strval:     %s\n", token.strval);
+        printf("strval:     %.*s\n", (int)token.strval_len, token.strval);
     } else if (token.type == TOKENTYPE_IDENT) {
         pindent(indent);
-        printf("ident:      %s\n", token.strval);
+        printf("ident:      %.*s\n", (int)token.strval_len, token.strval);
     } else if (token.type == TOKENTYPE_ICONST) {
         pindent(indent);
         printf("ival:       %" PRId64 "\n", token.ival);
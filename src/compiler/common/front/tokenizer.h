@@ -29,11 +29,13 @@ struct tokenizer {
     srcfile_t *file;
     // Current file position.
     pos_t      pos;
+    // Index in `tkn_buffer` of the next token returned.
+    size_t     tkn_buffer_head;
     // Number of buffered tokens.
     size_t     tkn_buffer_len;
-    // Allocated capacity of the buffered-token array.
+    // Allocated capacity of the buffered-token array; always 0 or a power of 2.
     size_t     tkn_buffer_cap;
-    // Buffered tokens (FIFO; index 0 is the next token returned).
+    // Buffered tokens (circular FIFO starting at `tkn_buffer_head`).
     token_t   *tkn_buffer;
     // Function to call to get next token.
     token_t (*next)(tokenizer_t *tkn_ctx);
@@ -81,6 +83,9 @@ token_t tkn_peek(tokenizer_t *tkn_ctx);
 token_t tkn_peek_n(tokenizer_t *tkn_ctx, size_t depth);
 // Opposite of tkn_next; stuff a token back to the front of the buffer.
 void    tkn_unget(tokenizer_t *tkn_ctx, token_t token);
+// Discard all buffered tokens and move the tokenizer back to where the first of them started.
+// Only valid for tokenizers whose state is fully described by `pos`, and if no foreign tokens were pushed by `tkn_unget`.
+void    tkn_rewind(tokenizer_t *tkn_ctx);
 
 // Create an array-backed tokenizer. The token array is borrowed (not copied
 // and not freed on destroy); it must outlive the returned tokenizer. Each
@@ -96,6 +101,11 @@ int tkn_getc(token_t const *tkn, tknoff_t *off);
 void    tkn_delete(token_t token);
 // Perform a deep copy of a token.
 token_t tkn_clone(token_t const *token);
+// Replace a borrowed `strval` with an owned, NUL-terminated copy.
+void    tkn_own_strval(token_t *token);
+// Copy a token string into the compiler context's token arena.
+// The result is NUL-terminated and should be marked with `strval_borrowed`; it is freed with the context.
+char   *tkn_arena_strval(cctx_t *cctx, char const *str, size_t len);
 // Delete an array of tokens and each token within.
 void    tkn_arr_delete(size_t tokens_len, token_t *tokens);
 
@@ -241,6 +241,22 @@ static token_t ir_tkn_ident(tokenizer_t *ctx, pos_t start_pos, char first, bool
     ptr[0]     = first;
 
     pos_t pos0 = ctx->pos;
+    while (1) {
+        // Copy runs of plain ASCII identifier characters directly from the source.
+        srcspan_t span = srcfile_span(ctx->file, pos0.off, SIZE_MAX);
+        size_t    n    = 0;
+        while (span.is_ascii && n < span.len && ir_is_sym_char(span.data[n])) {
+            n++;
+        }
+        if (!n) {
+            break;
+        }
+        array_lencap_insert_n_strong(&ptr, 1, &len, &cap, span.data, len, n);
+        srcfile_advance(ctx->file, &pos0, n);
+        if (n < span.len) {
+            break;
+        }
+    }
     while (1) {
         pos_t pos1 = pos0;
         int   c    = srcfile_getc(ctx->file, &pos1);
@@ -433,6 +449,14 @@ static token_t ir_tkn_str(tokenizer_t *ctx, pos_t start_pos, bool is_char) {
 // Skip past a line comment.
 static void ir_line_comment(tokenizer_t *ctx) {
     while (1) {
+        // Skip plain ASCII comment text in bulk.
+        srcspan_t span = srcfile_span(ctx->file, ctx->pos.off, SIZE_MAX);
+        size_t    n    = 0;
+        while (span.is_ascii && n < span.len && span.data[n] != '\n' && span.data[n] != '\r'
+               && span.data[n] != '\\') {
+            n++;
+        }
+        srcfile_advance(ctx->file, &ctx->pos, n);
         int c = srcfile_getc(ctx->file, &ctx->pos);
         if (c == '\\') {
             srcfile_getc(ctx->file, &ctx->pos);
@@ -446,6 +470,15 @@ static void ir_line_comment(tokenizer_t *ctx) {
 static void ir_block_comment(tokenizer_t *ctx) {
     int prev = 0;
     while (1) {
+        if (prev != '*') {
+            // Skip plain ASCII comment text in bulk.
+            srcspan_t span = srcfile_span(ctx->file, ctx->pos.off, SIZE_MAX);
+            size_t    n    = 0;
+            while (span.is_ascii && n < span.len && span.data[n] != '*') {
+                n++;
+            }
+            srcfile_advance(ctx->file, &ctx->pos, n);
+        }
         int c = srcfile_getc(ctx->file, &ctx->pos);
         if (c == '/' && prev == '*') {
             return;
@@ -8,6 +8,7 @@
 #include "arith128.h"
 #include "arrays.h"
 #include "c_parser.h"
+#include "c_parser2.h"
 #include "c_prepass.h"
 #include "c_preproc.h"
 #include "c_tokenizer.h"
@@ -49,6 +50,8 @@ c_compiler_t *c_compiler_create(cctx_t *cctx, c_options_t options) {
     cc->global_scope.locals_by_decl = PTR_MAP_EMPTY;
     cc->global_scope.typedefs       = STR_MAP_EMPTY;
     cc->global_scope.comp_types     = STR_MAP_EMPTY;
+    cc->lazy_funcs                  = STR_MAP_EMPTY;
+    cc->lazy_used                   = STR_SET_EMPTY;
 
     for (size_t i = 0; i < C_N_PRIM; i++) {
         cc->prim_types[i].primitive = i;
@@ -63,6 +66,15 @@ c_compiler_t *c_compiler_create(cctx_t *cctx, c_options_t options) {
 // Destroy a C compiler context.
 void c_compiler_delete(c_compiler_t *cc) {
     c_scope_destroy(cc->global_scope);
+    map_foreach_value(c_lazy_func_t, lazy, &cc->lazy_funcs) {
+        lilycc_free(lazy);
+    }
+    map_clear(&cc->lazy_funcs);
+    for (size_t i = 0; i < cc->lazy_referenced.len; i++) {
+        lilycc_free(cc->lazy_referenced.arr[i]);
+    }
+    vec_clear(&cc->lazy_referenced);
+    set_clear(&cc->lazy_used);
     lilycc_free(cc);
 }
 
@@ -82,8 +94,9 @@ tokenizer_t *c_tokenizer_create(c_compiler_t *cc, srcfile_t *src, bool do_prepro
 // Create a parsing context for this compiler.
 c_parser_t *c_parser_create(c_compiler_t *cc, tokenizer_t *tkn_ctx) {
     c_parser_t *ctx       = lilycc_calloc(1, sizeof(c_parser_t));
-    ctx->local_type_names = STR_SET_EMPTY;
-    ctx->type_names       = STR_SET_EMPTY;
+    ctx->local_type_names = PTR_SET_EMPTY;
+    ctx->type_names       = PTR_SET_EMPTY;
+    ctx->deferred_funcs   = PTR_MAP_EMPTY;
     ctx->tkn_ctx          = tkn_ctx;
     ctx->options          = &cc->options;
     return ctx;
@@ -93,7 +106,9 @@ c_parser_t *c_parser_create(c_compiler_t *cc, tokenizer_t *tkn_ctx) {
 void c_parser_delete(c_parser_t *parser) {
     set_clear(&parser->local_type_names);
     set_clear(&parser->type_names);
+    c_parse2_clear_deferred(parser);
     tkn_ctx_delete(parser->tkn_ctx);
+    arena_clear(&parser->ast_arena);
     lilycc_free(parser);
 }
 
@@ -7,6 +7,7 @@
 
 
 
+#include "c_ast.h"
 #include "c_options.h"
 #include "c_parser.h"
 #include "c_prepass.h"
@@ -17,6 +18,7 @@
 #include "ir_types.h"
 #include "map.h"
 #include "refcount.h"
+#include "set.h"
 #include "tokenizer.h"
 
 
@@ -39,6 +41,8 @@ typedef enum {
 typedef struct c_var          c_var_t;
 // C scope.
 typedef struct c_scope        c_scope_t;
+// Inline function whose body was skipped because it was not referenced yet.
+typedef struct c_lazy_func    c_lazy_func_t;
 // C compiler context.
 typedef struct c_compiler     c_compiler_t;
 // Used for compiling expressions.
@@ -83,6 +87,14 @@ struct c_scope {
     map_t      comp_types;
 };
 
+// Inline function whose body was skipped because it was not referenced yet.
+struct c_lazy_func {
+    // Definition of the function.
+    c_ast_def_func_t const *def;
+    // Number of bindings in scope at the definition; names bound after it are hidden from the body.
+    size_t                  bindings_len;
+};
+
 // C compiler context.
 struct c_compiler {
     // C compiler options.
@@ -95,6 +107,16 @@ struct c_compiler {
     c_scope_t   global_scope;
     // Generic compiler context.
     cctx_t     *cctx;
+    // Parser that skipped function bodies with `c_parse2_lazy` to parse them on demand, or NULL.
+    c_parser_t *lazy_parser;
+    // Inline functions that were only declared because their body was skipped and they were not referenced yet.
+    // Map of `char const *` -> `c_lazy_func_t *` (owned).
+    map_t       lazy_funcs;
+    // Functions from `lazy_funcs` that were referenced since, and have to be compiled by `c_compile2`.
+    // Array of `c_lazy_func_t *` (owned).
+    vec_ptr_t   lazy_referenced;
+    // Names of the functions referenced so far if `lazy_parser` is set; inline functions in it are not skipped.
+    set_t       lazy_used;
 };
 
 // Used for compiling expressions.
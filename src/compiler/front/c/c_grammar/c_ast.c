@@ -11,6 +11,13 @@
 #include "lilycc_malloc.h"
 
 #include <stdio.h>
+#include <string.h>
+
+
+
+// Allocate an AST node of type `type` from `arena`.
+#define C_AST_ALLOC(arena, type) ((type *)arena_alloc_aligned((arena), sizeof(type), _Alignof(type)))
+
 
 
 // Struct constructor functions.
@@ -19,12 +26,12 @@
         C_AST_STRUCT_DEF_##name(C_AST_IMPL_FUNCBODY, C_AST_IMPL_FUNCBODY_FIELD, C_AST_IMPL_FUNCBODY_CHILD)
 #define C_AST_IMPL_FUNCSIG(name, ...)                                                                                  \
     /* Construct a struct AST node. */                                                                                 \
-    c_ast_##name##_t *c_ast_##name##_create(pos_t pos __VA_ARGS__)
+    c_ast_##name##_t *c_ast_##name##_create(arena_t *arena, srcrange_t pos __VA_ARGS__)
 #define C_AST_IMPL_FUNCSIG_FIELD(parent, type, name) , type name
 #define C_AST_IMPL_FUNCSIG_CHILD(parent, type, name) C_AST_IMPL_FUNCSIG_FIELD(parent, c_ast_##type##_t *, name)
 #define C_AST_IMPL_FUNCBODY(name, ...)                                                                                 \
     {                                                                                                                  \
-        c_ast_##name##_t *ast = lilycc_malloc(sizeof(c_ast_##name##_t));                                               \
+        c_ast_##name##_t *ast = C_AST_ALLOC(arena, c_ast_##name##_t);                                                  \
         ast->pos              = pos;                                                                                   \
         __VA_ARGS__                                                                                                    \
         return ast;                                                                                                    \
@@ -37,8 +44,8 @@
 #define C_AST_UNION_DEF(name, ...) __VA_ARGS__
 #define C_AST_UNION_FIELD(parent, type, name, union_tag)                                                               \
     /* Construct a union AST node. */                                                                                  \
-    c_ast_##parent##_t *c_ast_##parent##_create_##name(pos_t pos, type parent##_##name) {                              \
-        c_ast_##parent##_t *ast = lilycc_malloc(sizeof(c_ast_##parent##_t));                                           \
+    c_ast_##parent##_t *c_ast_##parent##_create_##name(arena_t *arena, srcrange_t pos, type parent##_##name) {         \
+        c_ast_##parent##_t *ast = C_AST_ALLOC(arena, c_ast_##parent##_t);                                              \
         ast->pos                = pos;                                                                                 \
         ast->tag                = C_AST_TAG_##union_tag;                                                               \
         ast->parent##_##name    = parent##_##name;                                                                     \
@@ -47,8 +54,8 @@
 // Union constructor functions.
 #define C_AST_UNION_CHILD(parent, type, name, union_tag)                                                               \
     /* Construct a union AST node. */                                                                                  \
-    c_ast_##parent##_t *c_ast_##parent##_create_##name(c_ast_##type##_t *parent##_##name) {                            \
-        c_ast_##parent##_t *ast = lilycc_malloc(sizeof(c_ast_##parent##_t));                                           \
+    c_ast_##parent##_t *c_ast_##parent##_create_##name(arena_t *arena, c_ast_##type##_t *parent##_##name) {            \
+        c_ast_##parent##_t *ast = C_AST_ALLOC(arena, c_ast_##parent##_t);                                              \
         ast->pos                = parent##_##name->pos;                                                                \
         ast->tag                = C_AST_TAG_##union_tag;                                                               \
         ast->parent##_##name    = parent##_##name;                                                                     \
@@ -58,11 +65,19 @@
 
 // List constructor functions.
 #define C_AST_LIST_DEF(name)                                                                                           \
-    /* Construct a list AST node. */                                                                                   \
-    c_ast_##name##_list_t *c_ast_##name##_list_create(pos_t pos, vec_c_ast_##name##_t items) {                         \
-        c_ast_##name##_list_t *ast = lilycc_malloc(sizeof(c_ast_##name##_list_t));                                     \
+    /* Construct a list AST node; `items` is moved into the arena. */                                                  \
+    c_ast_##name##_list_t *c_ast_##name##_list_create(arena_t *arena, srcrange_t pos, vec_c_ast_##name##_t items) {    \
+        c_ast_##name##_list_t *ast = C_AST_ALLOC(arena, c_ast_##name##_list_t);                                        \
         ast->pos                   = pos;                                                                              \
-        ast->items                 = items;                                                                            \
+        ast->items.len             = items.len;                                                                        \
+        ast->items.cap             = items.len;                                                                        \
+        ast->items.arr             = NULL;                                                                             \
+        if (items.len) {                                                                                               \
+            size_t size    = items.len * sizeof(*items.arr);                                                           \
+            ast->items.arr = arena_alloc_aligned(arena, size, _Alignof(c_ast_##name##_t *));                           \
+            memcpy(ast->items.arr, items.arr, size);                                                                   \
+        }                                                                                                              \
+        vec_clear(&items);                                                                                             \
         return ast;                                                                                                    \
     }
 #include "c_ast.inc"
@@ -78,14 +93,16 @@ static void pindent(int indent, FILE *to) {
 }
 
 // String printing helper.
-static void pc_ast_cstr_t(c_ast_cstr_t const *value, int indent, FILE *to) {
+static void pc_ast_cstr_t(c_ast_cstr_t const *value, cctx_t const *ctx, int indent, FILE *to) {
+    (void)ctx;
     (void)indent;
     fputs(*value, to);
     fputc('\n', to);
 }
 
 // C string constant printing helper.
-static void pvec_char_t(vec_char_t const *value, int indent, FILE *to) {
+static void pvec_char_t(vec_char_t const *value, cctx_t const *ctx, int indent, FILE *to) {
+    (void)ctx;
     (void)indent;
     fputc('\"', to);
     print_cstr_repr(value->arr, value->len, to);
@@ -94,45 +111,51 @@ static void pvec_char_t(vec_char_t const *value, int indent, FILE *to) {
 }
 
 // Position printing helper.
-static void ppos_t(pos_t const *pos, int indent, FILE *to) {
+static void psrcrange_t(srcrange_t const *pos, cctx_t const *ctx, int indent, FILE *to) {
     (void)indent;
-    if (pos->srcfile) {
-        fputs(pos->srcfile->path, to);
+    pos_t decoded = srcrange_to_pos(ctx, *pos);
+    if (decoded.srcfile) {
+        fputs(decoded.srcfile->path, to);
     } else {
         fputs("???", to);
     }
-    fprintf(to, ":%d:%d (%lld bytes)\n", pos->line + 1, pos->col + 1, (long long)pos->len);
+    fprintf(to, ":%d:%d (%lld bytes)\n", decoded.line + 1, decoded.col + 1, (long long)decoded.len);
 }
 
 // C token type printing helper.
-static void pc_tokentype_t(c_tokentype_t const *value, int indent, FILE *to) {
+static void pc_tokentype_t(c_tokentype_t const *value, cctx_t const *ctx, int indent, FILE *to) {
+    (void)ctx;
     (void)indent;
     fputs(c_token_id[*value], to);
     fputc('\n', to);
 }
 
 // C primitive type printing helper.
-static void pc_prim_t(c_prim_t const *value, int indent, FILE *to) {
+static void pc_prim_t(c_prim_t const *value, cctx_t const *ctx, int indent, FILE *to) {
+    (void)ctx;
     (void)indent;
     fputs(c_prim_name[*value], to);
     fputc('\n', to);
 }
 
 // C primitive type printing helper.
-static void pc_keyw_t(c_keyw_t const *value, int indent, FILE *to) {
+static void pc_keyw_t(c_keyw_t const *value, cctx_t const *ctx, int indent, FILE *to) {
+    (void)ctx;
     (void)indent;
     fputs(c_keyw_name[*value], to);
     fputc('\n', to);
 }
 
 // Bool printing helper.
-static void pbool(bool const *value, int indent, FILE *to) {
+static void pbool(bool const *value, cctx_t const *ctx, int indent, FILE *to) {
+    (void)ctx;
     (void)indent;
     fputs(*value ? "true\n" : "false\n", to);
 }
 
 // IR constant printing helper.
-static void pi128_t(i128_t const *value, int indent, FILE *to) {
+static void pi128_t(i128_t const *value, cctx_t const *ctx, int indent, FILE *to) {
+    (void)ctx;
     (void)indent;
     char buf[40];
     itoa128(*value, 0, buf);
@@ -143,30 +166,30 @@ static void pi128_t(i128_t const *value, int indent, FILE *to) {
 // Struct printing functions.
 #define C_AST_STRUCT_DEF(name, ...)                                                                                    \
     /* Debug-print the given AST node. */                                                                              \
-    void c_ast_##name##_dbg(c_ast_##name##_t const *ast, int indent, FILE *to) {                                       \
+    void c_ast_##name##_dbg(c_ast_##name##_t const *ast, cctx_t const *ctx, int indent, FILE *to) {                    \
         indent++;                                                                                                      \
         fputs(#name "\n", to);                                                                                         \
         pindent(indent, to);                                                                                           \
         fputs("pos: ", to);                                                                                            \
-        ppos_t(&ast->pos, indent, to);                                                                                 \
+        psrcrange_t(&ast->pos, ctx, indent, to);                                                                       \
         __VA_ARGS__                                                                                                    \
     }
 #define C_AST_STRUCT_FIELD(parent, type, name)                                                                         \
     pindent(indent, to);                                                                                               \
     fputs(#name ": ", to);                                                                                             \
-    p##type(&ast->name, indent, to);
+    p##type(&ast->name, ctx, indent, to);
 #define C_AST_STRUCT_CHILD(parent, type, name)                                                                         \
     if (ast->name) {                                                                                                   \
         pindent(indent, to);                                                                                           \
         fputs(#name ": ", to);                                                                                         \
-        c_ast_##type##_dbg(ast->name, indent, to);                                                                     \
+        c_ast_##type##_dbg(ast->name, ctx, indent, to);                                                                \
     }
 #include "c_ast.inc"
 
 // Union printing helpers.
 #define C_AST_UNION_DEF(name, ...)                                                                                     \
     /* Debug-print the given AST node. */                                                                              \
-    void c_ast_##name##_dbg(c_ast_##name##_t const *ast, int indent, FILE *to) {                                       \
+    void c_ast_##name##_dbg(c_ast_##name##_t const *ast, cctx_t const *ctx, int indent, FILE *to) {                    \
         fputs(#name, to);                                                                                              \
         switch (ast->tag) { __VA_ARGS__ }                                                                              \
     }
@@ -176,112 +199,31 @@ static void pi128_t(i128_t const *value, int indent, FILE *to) {
         fputc('\n', to);                                                                                               \
         pindent(indent, to);                                                                                           \
         fputs("pos: ", to);                                                                                            \
-        ppos_t(&ast->pos, indent, to);                                                                                 \
+        psrcrange_t(&ast->pos, ctx, indent, to);                                                                       \
         pindent(indent, to);                                                                                           \
         fputs(#parent "_" #name ": ", to);                                                                             \
-        p##type(&ast->parent##_##name, indent, to);                                                                    \
+        p##type(&ast->parent##_##name, ctx, indent, to);                                                               \
         break;
 #define C_AST_UNION_CHILD(parent, type, name, union_tag)                                                               \
     case C_AST_TAG_##union_tag:                                                                                        \
         fputc(' ', to);                                                                                                \
-        c_ast_##type##_dbg(ast->parent##_##name, indent, to);                                                          \
+        c_ast_##type##_dbg(ast->parent##_##name, ctx, indent, to);                                                     \
         break;
 #include "c_ast.inc"
 
 // List printing helpers.
 #define C_AST_LIST_DEF(name)                                                                                           \
     /* Debug-print the given AST node. */                                                                              \
-    void c_ast_##name##_list_dbg(c_ast_##name##_list_t const *ast, int indent, FILE *to) {                             \
+    void c_ast_##name##_list_dbg(c_ast_##name##_list_t const *ast, cctx_t const *ctx, int indent, FILE *to) {          \
         indent++;                                                                                                      \
         fputs(#name "_list\n", to);                                                                                    \
         pindent(indent, to);                                                                                           \
         fputs("pos: ", to);                                                                                            \
-        ppos_t(&ast->pos, indent, to);                                                                                 \
+        psrcrange_t(&ast->pos, ctx, indent, to);                                                                       \
         for (size_t i = 0; i < ast->items.len; i++) {                                                                  \
             pindent(indent, to);                                                                                       \
             fprintf(to, "%zu: ", i);                                                                                   \
-            c_ast_##name##_dbg(ast->items.arr[i], indent, to);                                                         \
-        }                                                                                                              \
-    }
-#include "c_ast.inc"
-
-
-
-// String deletion helper.
-static void delc_ast_cstr_t(c_ast_cstr_t value) {
-    lilycc_free(value);
-}
-
-// C string constant deletion helper.
-static void delvec_char_t(vec_char_t value) {
-    vec_clear(&value);
-}
-
-// Position deletion helper.
-static void delpos_t(pos_t value) {
-    (void)value;
-}
-
-// C token type deletion helper.
-static void delc_tokentype_t(c_tokentype_t value) {
-    (void)value;
-}
-
-// C primitive type deletion helper.
-static void delc_prim_t(c_prim_t value) {
-    (void)value;
-}
-
-// C primitive type deletion helper.
-static void delc_keyw_t(c_keyw_t value) {
-    (void)value;
-}
-
-// Bool deletion helper.
-static void delbool(bool value) {
-    (void)value;
-}
-
-// IR constant deletion helper.
-static void deli128_t(i128_t value) {
-    (void)value;
-}
-
-// Struct deletion functions.
-#define C_AST_STRUCT_DEF(name, ...)                                                                                    \
-    /* Destroy an AST node. */                                                                                         \
-    void c_ast_##name##_delete(c_ast_##name##_t *ast) {                                                                \
-        __VA_ARGS__                                                                                                    \
-        lilycc_free(ast);                                                                                              \
-    }
-#define C_AST_STRUCT_FIELD(parent, type, name) del##type(ast->name);
-#define C_AST_STRUCT_CHILD(parent, type, name)                                                                         \
-    if (ast->name) {                                                                                                   \
-        c_ast_##type##_delete(ast->name);                                                                              \
-    }
-#include "c_ast.inc"
-
-// Union deletion functions.
-#define C_AST_UNION_DEF(name, ...)                                                                                     \
-    /* Destroy an AST node. */                                                                                         \
-    void c_ast_##name##_delete(c_ast_##name##_t *ast) {                                                                \
-        switch (ast->tag) { __VA_ARGS__ }                                                                              \
-        lilycc_free(ast);                                                                                              \
-    }
-#define C_AST_UNION_FIELD(parent, type, name, union_tag)                                                               \
-    case C_AST_TAG_##union_tag: del##type(ast->parent##_##name); break;
-#define C_AST_UNION_CHILD(parent, type, name, union_tag)                                                               \
-    case C_AST_TAG_##union_tag: c_ast_##type##_delete(ast->parent##_##name); break;
-#include "c_ast.inc"
-
-// List deletion functions.
-#define C_AST_LIST_DEF(name)                                                                                           \
-    /* Destroy an AST node. */                                                                                         \
-    void c_ast_##name##_list_delete(c_ast_##name##_list_t *ast) {                                                      \
-        for (size_t i = 0; i < ast->items.len; i++) {                                                                  \
-            c_ast_##name##_delete(ast->items.arr[i]);                                                                  \
+            c_ast_##name##_dbg(ast->items.arr[i], ctx, indent, to);                                                    \
         }                                                                                                              \
-        vec_clear(&ast->items);                                                                                        \
-        lilycc_free(ast);                                                                                              \
     }
 #include "c_ast.inc"
@@ -7,6 +7,7 @@
 
 
 
+#include "arena.h"
 #include "c_tokenizer.h"
 #include "c_types1.h"
 #include "compiler.h"
@@ -17,6 +18,9 @@
 // Needed a `char *` type but also for it to be one identifier.
 typedef char *c_ast_cstr_t;
 
+// AST nodes are allocated from an arena, along with the item arrays of lists and the strings they contain.
+// Nodes are never freed on their own; an entire AST is freed at once by resetting or clearing its arena.
+
 
 
 // Union tags.
@@ -36,7 +40,7 @@ typedef char *c_ast_cstr_t;
 #define C_AST_STRUCT_DEF(name, ...)                                                                                    \
     struct c_ast_##name {                                                                                              \
         /* Combined AST node position. */                                                                              \
-        pos_t pos;                                                                                                     \
+        srcrange_t pos;                                                                                                \
         __VA_ARGS__                                                                                                    \
     };
 #define C_AST_STRUCT_FIELD(parent, type, name) type name;
@@ -46,7 +50,7 @@ typedef char *c_ast_cstr_t;
 #define C_AST_UNION_DEF(name, ...)                                                                                     \
     struct c_ast_##name {                                                                                              \
         /* Combined AST node position. */                                                                              \
-        pos_t                pos;                                                                                      \
+        srcrange_t           pos;                                                                                      \
         /* Union tag. */                                                                                               \
         c_ast_##name##_tag_t tag;                                                                                      \
         union {                                                                                                        \
@@ -60,7 +64,7 @@ typedef char *c_ast_cstr_t;
 #define C_AST_LIST_DEF(name)                                                                                           \
     struct c_ast_##name##_list {                                                                                       \
         /* Combined AST node position. */                                                                              \
-        pos_t                pos;                                                                                      \
+        srcrange_t           pos;                                                                                      \
         vec_c_ast_##name##_t items;                                                                                    \
     };
 #include "c_ast.inc"
@@ -70,7 +74,7 @@ typedef char *c_ast_cstr_t;
 // Struct constructor functions.
 #define C_AST_STRUCT_DEF(name, ...)                                                                                    \
     /* Construct a struct AST node. */                                                                                 \
-    c_ast_##name##_t *c_ast_##name##_create(pos_t pos __VA_ARGS__);
+    c_ast_##name##_t *c_ast_##name##_create(arena_t *arena, srcrange_t pos __VA_ARGS__);
 #define C_AST_STRUCT_FIELD(parent, type, name) , type name
 #include "c_ast.inc"
 
@@ -78,23 +82,21 @@ typedef char *c_ast_cstr_t;
 #define C_AST_UNION_DEF(name, ...) __VA_ARGS__
 #define C_AST_UNION_FIELD(parent, type, name, union_tag)                                                               \
     /* Construct a union AST node. */                                                                                  \
-    c_ast_##parent##_t *c_ast_##parent##_create_##name(pos_t pos, type parent##_##name);
+    c_ast_##parent##_t *c_ast_##parent##_create_##name(arena_t *arena, srcrange_t pos, type parent##_##name);
 // Union constructor functions.
 #define C_AST_UNION_CHILD(parent, type, name, union_tag)                                                               \
     /* Construct a union AST node. */                                                                                  \
-    c_ast_##parent##_t *c_ast_##parent##_create_##name(c_ast_##type##_t *parent##_##name);
+    c_ast_##parent##_t *c_ast_##parent##_create_##name(arena_t *arena, c_ast_##type##_t *parent##_##name);
 #include "c_ast.inc"
 
 // List constructor functions.
 #define C_AST_LIST_DEF(name)                                                                                           \
-    /* Construct a list AST node. */                                                                                   \
-    c_ast_##name##_list_t *c_ast_##name##_list_create(pos_t pos, vec_c_ast_##name##_t items);
+    /* Construct a list AST node; `items` is moved into the arena. */                                                  \
+    c_ast_##name##_list_t *c_ast_##name##_list_create(arena_t *arena, srcrange_t pos, vec_c_ast_##name##_t items);
 #include "c_ast.inc"
 
 // Common function declarations.
 #define C_AST_DEF(name)                                                                                                \
-    /* Debug-print the given AST node. */                                                                              \
-    void c_ast_##name##_dbg(c_ast_##name##_t const *ast, int indent, FILE *to);                                        \
-    /* Destroy an AST node. */                                                                                         \
-    void c_ast_##name##_delete(c_ast_##name##_t *ast);
+    /* Debug-print the given AST node, with positions decoded using `ctx`. */                                          \
+    void c_ast_##name##_dbg(c_ast_##name##_t const *ast, cctx_t const *ctx, int indent, FILE *to);
 #include "c_ast.inc"
@@ -16,10 +16,15 @@
 #include "vec.h"
 
 #include <assert.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifdef _POSIX_C_SOURCE
+#include <pthread.h>
+#endif
+
 
 
 // Union tag of `lr_entry_t`.
@@ -44,9 +49,63 @@ typedef struct {
 } lr_entry_t;
 VEC_TYPE_DEF(vec_lr_entry_t, lr_entry_t)
 
+// Function body that was skipped to be parsed later; see `c_parse2_parallel`.
+struct c_deferred_body {
+    // Function definition that this is the body of; its `body` is NULL until the body is parsed.
+    c_ast_def_func_t *func;
+    // Tokens between the curly brackets.
+    token_t          *tokens;
+    // Number of `tokens`.
+    size_t            tokens_len;
+    // Position of the closing curly bracket.
+    pos_t             end_pos;
+    // Identifiers in the body that were type names at the point of the body; same format as `c_parser_t::type_names`.
+    set_t             type_names;
+    // Diagnostics produced while parsing the body.
+    dlist_t           diagnostics;
+    // Diagnostic after which `diagnostics` go, or NULL if they go at the start.
+    dlist_node_t     *diag_after;
+};
+
+// Shared state of the threads of `c_parse2_parallel`.
+typedef struct {
+    // Options to parse with.
+    c_options_t const  *options;
+    // Compiler context that AST node positions are decoded with.
+    cctx_t const       *src_cctx;
+    // Function bodies to parse.
+    c_deferred_body_t **bodies;
+    // Number of `bodies`.
+    size_t              len;
+    // Index of the next body to parse.
+    atomic_size_t       next;
+} c_parse2_pool_t;
+
+// State of one thread of `c_parse2_parallel`.
+typedef struct {
+    // Shared state of all threads.
+    c_parse2_pool_t *pool;
+    // Arena that this thread allocates its ASTs from.
+    arena_t          ast_arena;
+} c_parse2_worker_t;
+
+// Point in the AST arena that AST nodes discarded by error recovery can be freed back to.
+typedef struct {
+    // Position in `c_parser_t::ast_arena`.
+    arena_mark_t arena;
+    // Number of `c_parser_t::deferred_bodies`, which point into the AST arena.
+    size_t       deferred_len;
+} c_parse2_mark_t;
+
 // Destroy an LR parser stack entry.
 // Does not free the memory of `entry` itself.
-static void lr_entry_delete(lr_entry_t entry);
+static void            lr_entry_delete(lr_entry_t entry);
+// Decode the position of an AST node for a diagnostic.
+static pos_t           c_parse2_pos(c_parser_t const *ctx, srcrange_t pos);
+// Remember the current point in the AST arena.
+static c_parse2_mark_t c_parse2_mark(c_parser_t const *ctx);
+// Free the AST nodes allocated since `mark`, which error recovery has discarded.
+static void            c_parse2_rewind(c_parser_t *ctx, c_parse2_mark_t mark);
 
 // Parse a direct (abstract) declaration.
 static c_ast_decl_t           *c_parse2_ddecl(c_parser_t *ctx, bool allows_name, bool is_typedef);
@@ -89,8 +148,7 @@ static bool is_first_expr_tkn(c_parser_t *ctx, token_t tkn) {
         case TOKENTYPE_ICONST:
         case TOKENTYPE_SCONST: return true;
         case TOKENTYPE_IDENT:
-            return !set_contains(&ctx->type_names, tkn.strval)
-                   && (!ctx->func_body || !set_contains(&ctx->local_type_names, tkn.strval));
+            return !c_parser_is_type_name(ctx, &tkn);
         case TOKENTYPE_KEYWORD:
             switch (tkn.subtype) {
                 case C_KEYW_sizeof:
@@ -312,8 +370,7 @@ static bool is_type_specifier(token_t token) {
 // Is this a valid token for a specifier/qualifier list?
 static bool is_spec_qual_list_tkn(c_parser_t *ctx, token_t token) {
     if (token.type == TOKENTYPE_IDENT) {
-        return set_contains(&ctx->type_names, token.strval)
-               || (ctx->func_body && set_contains(&ctx->local_type_names, token.strval));
+        return c_parser_is_type_name(ctx, &token);
     } else if (token.type != TOKENTYPE_KEYWORD) {
         return false;
     }
@@ -322,12 +379,31 @@ static bool is_spec_qual_list_tkn(c_parser_t *ctx, token_t token) {
 }
 
 // Destroy an LR parser stack entry.
-// Does not free the memory of `entry` itself.
+// Does not free the memory of `entry` itself; AST nodes are freed with the AST arena.
 static void lr_entry_delete(lr_entry_t entry) {
-    switch (entry.tag) {
-        case LR_ENTRY_TOKEN: tkn_delete(entry.token); break;
-        case LR_ENTRY_EXPR: c_ast_expr_delete(entry.expr); break;
-        case LR_ENTRY_TYPE: c_ast_type_name_delete(entry.type); break;
+    if (entry.tag == LR_ENTRY_TOKEN) {
+        tkn_delete(entry.token);
+    }
+}
+
+// Decode the position of an AST node for a diagnostic.
+static pos_t c_parse2_pos(c_parser_t const *ctx, srcrange_t pos) {
+    return srcrange_to_pos(ctx->src_cctx ? ctx->src_cctx : ctx->tkn_ctx->cctx, pos);
+}
+
+// Remember the current point in the AST arena.
+static c_parse2_mark_t c_parse2_mark(c_parser_t const *ctx) {
+    return (c_parse2_mark_t){
+        .arena        = arena_mark(&ctx->ast_arena),
+        .deferred_len = ctx->deferred_bodies.len,
+    };
+}
+
+// Free the AST nodes allocated since `mark`, which error recovery has discarded.
+static void c_parse2_rewind(c_parser_t *ctx, c_parse2_mark_t mark) {
+    // A function body skipped since then still needs its definition.
+    if (ctx->deferred_bodies.len == mark.deferred_len) {
+        arena_rewind(&ctx->ast_arena, mark.arena);
     }
 }
 
@@ -337,74 +413,273 @@ static void lr_entry_delete(lr_entry_t entry) {
 c_ast_def_list_t *c_parse2(c_parser_t *ctx) {
     vec_c_ast_def_t items = {0};
     token_t         peek  = tkn_peek(ctx->tkn_ctx);
-    pos_t           pos   = peek.pos;
+    srcrange_t      pos   = srcrange_from_pos(peek.pos);
     pos.len               = 0;
 
     while (peek.type != TOKENTYPE_EOF) {
         c_ast_def_t *unit = c_parse2_def(ctx, true);
-        pos               = pos_including(pos, unit->pos);
+        pos               = srcrange_including(pos, unit->pos);
         vec_push(&items, unit);
         peek = tkn_peek(ctx->tkn_ctx);
     }
 
-    return c_ast_def_list_create(pos, items);
+    return c_ast_def_list_create(&ctx->ast_arena, pos, items);
+}
+
+// Parse a function body that was skipped by `c_parse2_skip_body`, reporting diagnostics to `cctx`.
+// Uses `ctx` only for its options and AST arena.
+static void c_parse2_deferred_body(c_parser_t *ctx, c_deferred_body_t *body, cctx_t *cctx) {
+    tkn_array_t *tkn_ctx = tkn_array_create(body->tokens, body->tokens_len, body->end_pos);
+    tkn_ctx->base.cctx   = cctx;
+
+    c_parser_t parser = *ctx;
+    parser.tkn_ctx    = &tkn_ctx->base;
+    parser.type_names = body->type_names;
+    parser.func_body  = false;
+
+    vec_c_ast_stmt_t args = {0};
+
+    token_t    peek = tkn_peek(parser.tkn_ctx);
+    srcrange_t pos  = srcrange_from_pos(peek.pos);
+    pos.len         = 0;
+    while (peek.type != TOKENTYPE_EOF) {
+        if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_RCURL) {
+            // A syntax error made a statement end at the wrong curly bracket.
+            cctx_diagnostic(cctx, peek.pos, DIAG_ERR, "Unexpected }");
+            tkn_delete(tkn_next(parser.tkn_ctx));
+        } else {
+            vec_push(&args, c_parse2_stmt(&parser));
+            pos = srcrange_including(pos, args.arr[args.len - 1]->pos);
+        }
+        peek = tkn_peek(parser.tkn_ctx);
+    }
+
+    body->func->body = c_ast_stmt_list_create(&parser.ast_arena, pos, args);
+    ctx->ast_arena   = parser.ast_arena;
+    tkn_ctx_delete(&tkn_ctx->base);
+}
+
+// Free a function body that was skipped.
+static void c_deferred_body_delete(c_deferred_body_t *body) {
+    tkn_arr_delete(body->tokens_len, body->tokens);
+    set_clear(&body->type_names);
+    dlist_node_t *node;
+    while ((node = dlist_pop_front(&body->diagnostics))) {
+        diagnostic_t *diag = (diagnostic_t *)node;
+        lilycc_free(diag->msg);
+        lilycc_free(diag);
+    }
+    lilycc_free(body);
+}
+
+// Function body parsing thread; takes bodies from the pool until all of them are taken.
+static void *c_parse2_worker(void *cookie) {
+    c_parse2_worker_t *worker = cookie;
+    c_parse2_pool_t   *pool   = worker->pool;
+
+    // Each thread has its own compiler context for diagnostics, which are moved to the body they belong to.
+    cctx_t    *cctx   = cctx_create();
+    c_parser_t parser = {
+        .options   = pool->options,
+        .src_cctx  = pool->src_cctx,
+        .ast_arena = worker->ast_arena,
+    };
+
+    while (1) {
+        size_t i = atomic_fetch_add(&pool->next, 1);
+        if (i >= pool->len) {
+            break;
+        }
+        c_deferred_body_t *body = pool->bodies[i];
+        c_parse2_deferred_body(&parser, body, cctx);
+
+        body->diagnostics = cctx->diagnostics;
+        cctx->diagnostics = DLIST_EMPTY;
+    }
+
+    worker->ast_arena = parser.ast_arena;
+    cctx_delete(cctx);
+    return NULL;
+}
+
+// Parse a whole translation unit like `c_parse2`, but parse the function bodies in it on up to `jobs` threads.
+// The result and diagnostics are the same as those of `c_parse2` unless a function body has syntax errors.
+c_ast_def_list_t *c_parse2_parallel(c_parser_t *ctx, size_t jobs) {
+    if (jobs <= 1) {
+        return c_parse2(ctx);
+    }
+
+    // Parse the declarations first, so the type names visible in each function body are known before parsing it.
+    ctx->defer_bodies      = true;
+    c_ast_def_list_t *defs = c_parse2(ctx);
+    ctx->defer_bodies      = false;
+
+    c_parse2_pool_t pool = {
+        .options  = ctx->options,
+        .src_cctx = ctx->tkn_ctx->cctx,
+        .bodies   = ctx->deferred_bodies.arr,
+        .len      = ctx->deferred_bodies.len,
+        .next     = 0,
+    };
+    if (jobs > pool.len) {
+        jobs = pool.len ? pool.len : 1;
+    }
+
+    // Line tables are built on first use, so build them now; the threads then only read them to decode positions.
+    for (size_t i = 0; i < pool.src_cctx->srcs_len; i++) {
+        srcfile_line_of(pool.src_cctx->srcs[i], 0);
+    }
+
+    // The calling thread is one of the workers; without POSIX threads, it is the only one.
+    c_parse2_worker_t *workers = lilycc_calloc(jobs, sizeof(c_parse2_worker_t));
+    for (size_t i = 0; i < jobs; i++) {
+        workers[i].pool = &pool;
+    }
+#ifdef _POSIX_C_SOURCE
+    pthread_t *threads   = lilycc_calloc(jobs, sizeof(pthread_t));
+    size_t     n_threads = 1;
+    while (n_threads < jobs && !pthread_create(&threads[n_threads], NULL, c_parse2_worker, &workers[n_threads])) {
+        n_threads++;
+    }
+    c_parse2_worker(&workers[0]);
+    for (size_t i = 1; i < n_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    lilycc_free(threads);
+#else
+    c_parse2_worker(&workers[0]);
+#endif
+    for (size_t i = 0; i < jobs; i++) {
+        arena_merge(&ctx->ast_arena, &workers[i].ast_arena);
+    }
+    lilycc_free(workers);
+
+    // Put the diagnostics of each body where `c_parse2` would have produced them.
+    // Going backwards keeps bodies whose diagnostics go after the same diagnostic in order.
+    dlist_t *diagnostics = &ctx->tkn_ctx->cctx->diagnostics;
+    for (size_t i = pool.len; i-- > 0;) {
+        c_deferred_body_t *body = pool.bodies[i];
+        dlist_node_t      *node;
+        while ((node = dlist_pop_back(&body->diagnostics))) {
+            if (body->diag_after) {
+                dlist_insert_after(diagnostics, body->diag_after, node);
+            } else {
+                dlist_prepend(diagnostics, node);
+            }
+        }
+        c_deferred_body_delete(body);
+    }
+    vec_clear(&ctx->deferred_bodies);
+
+    return defs;
+}
+
+// Parse a whole translation unit like `c_parse2`, but skip function bodies until `c_parse2_body` is called for them.
+c_ast_def_list_t *c_parse2_lazy(c_parser_t *ctx) {
+    ctx->defer_bodies      = true;
+    c_ast_def_list_t *defs = c_parse2(ctx);
+    ctx->defer_bodies      = false;
+
+    for (size_t i = 0; i < ctx->deferred_bodies.len; i++) {
+        map_set(&ctx->deferred_funcs, ctx->deferred_bodies.arr[i]->func, ctx->deferred_bodies.arr[i]);
+    }
+    return defs;
+}
+
+// Get the body of a function definition, parsing it first if `c_parse2_lazy` skipped it.
+c_ast_stmt_list_t *c_parse2_body(c_parser_t *ctx, c_ast_def_func_t const *func) {
+    if (func->body) {
+        return func->body;
+    }
+    c_deferred_body_t *body = map_get(&ctx->deferred_funcs, func);
+    assert(body != NULL);
+
+    // The tokens aren't needed after this, so free them now instead of along with the parser.
+    c_parse2_deferred_body(ctx, body, ctx->tkn_ctx->cctx);
+    tkn_arr_delete(body->tokens_len, body->tokens);
+    body->tokens     = NULL;
+    body->tokens_len = 0;
+    return body->func->body;
+}
+
+// Free the function bodies that were skipped and not parsed.
+void c_parse2_clear_deferred(c_parser_t *ctx) {
+    for (size_t i = 0; i < ctx->deferred_bodies.len; i++) {
+        c_deferred_body_delete(ctx->deferred_bodies.arr[i]);
+    }
+    vec_clear(&ctx->deferred_bodies);
+    map_clear(&ctx->deferred_funcs);
 }
 
 
 
 // Recursive implementation of `c_parse2_comp_init_field`.
 static c_ast_init_t *c_parse2_comp_init_field_r(c_parser_t *ctx) {
-    token_t peek = tkn_peek(ctx->tkn_ctx);
+    c_parse2_mark_t mark = c_parse2_mark(ctx);
+    token_t         peek = tkn_peek(ctx->tkn_ctx);
 
     if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_ASSIGN) {
         tkn_delete(tkn_next(ctx->tkn_ctx));
-        return c_ast_init_create_val(c_parse2_compinit_or_expr(ctx));
+        return c_ast_init_create_val(&ctx->ast_arena, c_parse2_compinit_or_expr(ctx));
 
     } else if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_LBRAC) {
-        token_t lbrac     = tkn_next(ctx->tkn_ctx);
-        pos_t   lbrac_pos = lbrac.pos;
+        token_t    lbrac     = tkn_next(ctx->tkn_ctx);
+        srcrange_t lbrac_pos = srcrange_from_pos(lbrac.pos);
         tkn_delete(lbrac);
         c_ast_expr_t *index = c_parse2_expr(ctx);
         peek                = tkn_peek(ctx->tkn_ctx);
         if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_RBRAC) {
             cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected ]");
-            pos_t pos = pos_including(lbrac_pos, index->pos);
-            c_ast_expr_delete(index);
-            return c_ast_init_create_garbage(c_ast_garbage_create(pos));
+            srcrange_t pos = srcrange_including(lbrac_pos, index->pos);
+            c_parse2_rewind(ctx, mark);
+            return c_ast_init_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos));
         }
-        token_t rbrac     = tkn_next(ctx->tkn_ctx);
-        pos_t   rbrac_pos = rbrac.pos;
+        token_t    rbrac     = tkn_next(ctx->tkn_ctx);
+        srcrange_t rbrac_pos = srcrange_from_pos(rbrac.pos);
         tkn_delete(rbrac);
         c_ast_init_t *inner = c_parse2_comp_init_field_r(ctx);
         if (inner->tag == C_AST_TAG_INIT_GARBAGE) {
-            pos_t pos = inner->pos;
-            c_ast_init_delete(inner);
-            return c_ast_init_create_garbage(c_ast_garbage_create(pos));
+            srcrange_t pos = inner->pos;
+            c_parse2_rewind(ctx, mark);
+            return c_ast_init_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos));
         }
-        return c_ast_init_create_indexed(c_ast_init_indexed_create(pos_including(lbrac_pos, rbrac_pos), index, inner));
+        return c_ast_init_create_indexed(
+            &ctx->ast_arena,
+            c_ast_init_indexed_create(&ctx->ast_arena, srcrange_including(lbrac_pos, rbrac_pos), index, inner)
+        );
 
     } else if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_DOT) {
-        token_t dot     = tkn_next(ctx->tkn_ctx);
-        pos_t   dot_pos = dot.pos;
+        token_t    dot     = tkn_next(ctx->tkn_ctx);
+        srcrange_t dot_pos = srcrange_from_pos(dot.pos);
         tkn_delete(dot);
         peek = tkn_peek(ctx->tkn_ctx);
         if (peek.type != TOKENTYPE_IDENT) {
-            return c_ast_init_create_garbage(c_ast_garbage_create(dot_pos));
+            return c_ast_init_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, dot_pos));
         }
         token_t        ident     = tkn_next(ctx->tkn_ctx);
-        c_ast_ident_t *ident_ast = c_ast_ident_create(ident.pos, lilycc_strdup(ident.strval));
+        c_ast_ident_t *ident_ast = c_ast_ident_create(
+            &ctx->ast_arena,
+            srcrange_from_pos(ident.pos),
+            arena_strndup(&ctx->ast_arena, ident.strval, ident.strval_len)
+        );
         tkn_delete(ident);
         c_ast_init_t *inner = c_parse2_comp_init_field_r(ctx);
         if (inner->tag == C_AST_TAG_INIT_GARBAGE) {
-            pos_t pos = inner->pos;
-            c_ast_init_delete(inner);
-            return c_ast_init_create_garbage(c_ast_garbage_create(pos));
+            srcrange_t pos = inner->pos;
+            c_parse2_rewind(ctx, mark);
+            return c_ast_init_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos));
         }
-        return c_ast_init_create_named(c_ast_init_named_create(dot_pos, ident_ast, inner));
+        return c_ast_init_create_named(
+            &ctx->ast_arena,
+            c_ast_init_named_create(&ctx->ast_arena, dot_pos, ident_ast, inner)
+        );
 
     } else {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected initializer");
-        return c_ast_init_create_garbage(c_ast_garbage_create(peek.pos));
+        return c_ast_init_create_garbage(
+            &ctx->ast_arena,
+            c_ast_garbage_create(&ctx->ast_arena, srcrange_from_pos(peek.pos))
+        );
     }
 }
 
@@ -412,7 +687,7 @@ static c_ast_init_t *c_parse2_comp_init_field_r(c_parser_t *ctx) {
 c_ast_init_t *c_parse2_comp_init_field(c_parser_t *ctx) {
     token_t peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_OTHER || (peek.subtype != C_TKN_DOT && peek.subtype != C_TKN_LBRAC)) {
-        return c_ast_init_create_val(c_parse2_compinit_or_expr(ctx));
+        return c_ast_init_create_val(&ctx->ast_arena, c_parse2_compinit_or_expr(ctx));
     } else {
         return c_parse2_comp_init_field_r(ctx);
     }
@@ -420,18 +695,18 @@ c_ast_init_t *c_parse2_comp_init_field(c_parser_t *ctx) {
 
 // Parse a compound initializer.
 c_ast_init_list_t *c_parse2_comp_init(c_parser_t *ctx) {
-    token_t lcurl = tkn_next(ctx->tkn_ctx);
-    pos_t   start = lcurl.pos;
+    token_t    lcurl = tkn_next(ctx->tkn_ctx);
+    srcrange_t start = srcrange_from_pos(lcurl.pos);
     if (lcurl.type != TOKENTYPE_OTHER || lcurl.subtype != C_TKN_LCURL) {
-        cctx_diagnostic(ctx->tkn_ctx->cctx, start, DIAG_ERR, "Expected {");
+        cctx_diagnostic(ctx->tkn_ctx->cctx, lcurl.pos, DIAG_ERR, "Expected {");
         tkn_delete(lcurl);
         c_eat_delim(ctx->tkn_ctx, true);
-        return c_ast_init_list_create(start, (vec_c_ast_init_t){0});
+        return c_ast_init_list_create(&ctx->ast_arena, start, (vec_c_ast_init_t){0});
     }
     tkn_delete(lcurl);
 
     vec_c_ast_init_t fields = {0};
-    pos_t            end    = start;
+    srcrange_t       end    = start;
 
     while (1) {
         // Parse initializer.
@@ -443,7 +718,7 @@ c_ast_init_list_t *c_parse2_comp_init(c_parser_t *ctx) {
         }
         if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_RCURL) {
             token_t rcurl = tkn_next(ctx->tkn_ctx);
-            end           = rcurl.pos;
+            end           = srcrange_from_pos(rcurl.pos);
             tkn_delete(rcurl);
             break;
         }
@@ -456,7 +731,7 @@ c_ast_init_list_t *c_parse2_comp_init(c_parser_t *ctx) {
         peek = tkn_peek(ctx->tkn_ctx);
         if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_RCURL) {
             token_t rcurl = tkn_next(ctx->tkn_ctx);
-            end           = rcurl.pos;
+            end           = srcrange_from_pos(rcurl.pos);
             tkn_delete(rcurl);
             break;
         } else if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_COMMA) {
@@ -466,27 +741,27 @@ c_ast_init_list_t *c_parse2_comp_init(c_parser_t *ctx) {
         tkn_delete(tkn_next(ctx->tkn_ctx));
     }
 
-    return c_ast_init_list_create(pos_including(start, end), fields);
+    return c_ast_init_list_create(&ctx->ast_arena, srcrange_including(start, end), fields);
 }
 
 // Parse one or more C expressions separated by commas.
 c_ast_expr_list_t *c_parse2_exprs(c_parser_t *ctx) {
     vec_c_ast_expr_t args = {0};
     vec_push(&args, c_parse2_expr(ctx));
-    pos_t pos = args.arr[0]->pos;
+    srcrange_t pos = args.arr[0]->pos;
 
     // While the next token is a comma, more expressions can be parsed.
     token_t tkn = tkn_peek(ctx->tkn_ctx);
     while (tkn.type == TOKENTYPE_OTHER && tkn.subtype == C_TKN_COMMA) {
         tkn_delete(tkn_next(ctx->tkn_ctx));
         c_ast_expr_t *expr = c_parse2_expr(ctx);
-        pos                = pos_including(pos, expr->pos);
+        pos                = srcrange_including(pos, expr->pos);
         vec_push(&args, expr);
         tkn = tkn_peek(ctx->tkn_ctx);
     }
 
     // When the next token is not a comma, there are no more expressions to parse.
-    return c_ast_expr_list_create(pos, args);
+    return c_ast_expr_list_create(&ctx->ast_arena, pos, args);
 }
 
 // Parse a C expression.
@@ -495,12 +770,13 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
     token_t peek = tkn_peek(ctx->tkn_ctx);
     if (!is_first_expr_tkn(ctx, peek)) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected expression");
-        pos_t pos = peek.pos;
+        srcrange_t pos = srcrange_from_pos(peek.pos);
         tkn_delete(tkn_next(ctx->tkn_ctx));
-        return c_ast_expr_create_garbage(c_ast_garbage_create(pos));
+        return c_ast_expr_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos));
     }
 
-    vec_lr_entry_t stack = {0};
+    c_parse2_mark_t mark  = c_parse2_mark(ctx);
+    vec_lr_entry_t  stack = {0};
 
     // Push a node/token to the stack.
 #define push(thing)        vec_push(&stack, thing)
@@ -584,11 +860,14 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
                 push_expr(rhs);
                 goto err;
             }
-            pos_t rbrac_pos = peek2.pos;
+            srcrange_t rbrac_pos = srcrange_from_pos(peek2.pos);
             tkn_delete(tkn_next(ctx->tkn_ctx));
             lr_entry_delete(pop());
             c_ast_expr_t *lhs = pop_expr();
-            push_expr(c_ast_expr_create_index(c_ast_expr_index_create(pos_including(lhs->pos, rbrac_pos), lhs, rhs)));
+            push_expr(c_ast_expr_create_index(
+                &ctx->ast_arena,
+                c_ast_expr_index_create(&ctx->ast_arena, srcrange_including(lhs->pos, rbrac_pos), lhs, rhs)
+            ));
 
         } else if (is_punct(0, C_TKN_LPAR)) { // Recursively parse exprs.
             token_t lpar = pop_token();
@@ -596,9 +875,9 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
             bool    is_type = false;
             if (is_expr(0) && peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_RPAR) {
                 // Function call may have zero params.
-                pos_t pos = peek.pos;
-                pos.len   = 0;
-                res       = c_ast_expr_list_create(pos, (vec_c_ast_expr_t){0});
+                srcrange_t pos = srcrange_from_pos(peek.pos);
+                pos.len        = 0;
+                res            = c_ast_expr_list_create(&ctx->ast_arena, pos, (vec_c_ast_expr_t){0});
             } else {
                 // If not a function call, then it must have something in the parentheses.
                 res = c_parse2_exprs_or_type(ctx, &is_type);
@@ -608,20 +887,20 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
                 if (is_type) {
                     push_type(res);
                 } else {
-                    push_expr(c_ast_expr_create_exprs(res));
+                    push_expr(c_ast_expr_create_exprs(&ctx->ast_arena, res));
                 }
                 tkn_delete(lpar);
                 cctx_diagnostic(ctx->tkn_ctx->cctx, rpar.pos, DIAG_ERR, "Expected )");
                 goto err;
             }
             tkn_delete(tkn_next(ctx->tkn_ctx));
-            pos_t pos = pos_including(lpar.pos, rpar.pos);
+            srcrange_t pos = srcrange_from_pos(pos_including(lpar.pos, rpar.pos));
             if (is_type) {
                 ((c_ast_type_name_t *)res)->pos = pos;
                 push_type(res);
             } else {
                 ((c_ast_expr_list_t *)res)->pos = pos;
-                push_expr(c_ast_expr_create_exprs(res));
+                push_expr(c_ast_expr_create_exprs(&ctx->ast_arena, res));
             }
 
         } else if (
@@ -631,7 +910,13 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
             c_ast_init_list_t *init     = c_parse2_comp_init(ctx);
             c_ast_type_name_t *typename = pop_type();
             push_expr(c_ast_expr_create_compliteral(
-                c_ast_expr_compliteral_create(pos_including(init->pos, typename->pos), typename, init)
+                &ctx->ast_arena,
+                c_ast_expr_compliteral_create(
+                    &ctx->ast_arena,
+                    srcrange_including(init->pos, typename->pos),
+                    typename,
+                    init
+                )
             ));
 
         } else if (
@@ -640,26 +925,30 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
         ) { // Reduce call.
             c_ast_expr_t      *wrapped_params = pop_expr();
             c_ast_expr_t      *func           = pop_expr();
-            pos_t              pos            = pos_including(func->pos, wrapped_params->pos);
+            srcrange_t         pos            = srcrange_including(func->pos, wrapped_params->pos);
             c_ast_expr_list_t *params         = wrapped_params->expr_exprs;
-            lilycc_free(wrapped_params);
-            push_expr(c_ast_expr_create_call(c_ast_expr_call_create(pos, func, params)));
+            push_expr(c_ast_expr_create_call(
+                &ctx->ast_arena,
+                c_ast_expr_call_create(&ctx->ast_arena, pos, func, params)
+            ));
 
         } else if (is_expr(0) && is_type(1)) { // Reduce cast.
             c_ast_expr_t *val           = pop_expr();
             c_ast_type_name_t *typename = pop_type();
-            push_expr(
-                c_ast_expr_create_cast(c_ast_expr_cast_create(pos_including(val->pos, typename->pos), typename, val))
-            );
+            push_expr(c_ast_expr_create_cast(
+                &ctx->ast_arena,
+                c_ast_expr_cast_create(&ctx->ast_arena, srcrange_including(val->pos, typename->pos), typename, val)
+            ));
 
         } else if (is_expr(1) && (is_punct(0, C_TKN_INC) || is_punct(0, C_TKN_DEC))) { // Reduce suffix.
             token_t       op       = pop_token();
             c_tokentype_t oper     = op.subtype;
-            pos_t         oper_pos = op.pos;
+            srcrange_t    oper_pos = srcrange_from_pos(op.pos);
             tkn_delete(op);
             c_ast_expr_t *val = pop_expr();
             push_expr(c_ast_expr_create_suffix(
-                c_ast_expr_suffix_create(pos_including(oper_pos, val->pos), oper, oper_pos, val)
+                &ctx->ast_arena,
+                c_ast_expr_suffix_create(&ctx->ast_arena, srcrange_including(oper_pos, val->pos), oper, oper_pos, val)
             ));
 
         } else if (
@@ -669,7 +958,7 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
         ) { // Reduce prefix (sizeof/alignof).
             c_ast_expr_t      *val  = NULL;
             c_ast_type_name_t *type = NULL;
-            pos_t              val_pos;
+            srcrange_t         val_pos;
             if (is_type(0)) {
                 type    = pop_type();
                 val_pos = type->pos;
@@ -677,12 +966,19 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
                 val     = pop_expr();
                 val_pos = val->pos;
             }
-            token_t op         = pop_token();
-            bool    is_alignof = op.subtype == C_KEYW_alignof || op.subtype == C_KEYW__Alignof;
-            pos_t   oper_pos   = op.pos;
+            token_t    op         = pop_token();
+            bool       is_alignof = op.subtype == C_KEYW_alignof || op.subtype == C_KEYW__Alignof;
+            srcrange_t oper_pos   = srcrange_from_pos(op.pos);
             tkn_delete(op);
             push_expr(c_ast_expr_create_sizealign(
-                c_ast_expr_sizealign_create(pos_including(oper_pos, val_pos), type, val, is_alignof)
+                &ctx->ast_arena,
+                c_ast_expr_sizealign_create(
+                    &ctx->ast_arena,
+                    srcrange_including(oper_pos, val_pos),
+                    type,
+                    val,
+                    is_alignof
+                )
             ));
 
         } else if (
@@ -693,10 +989,11 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
             c_ast_expr_t *val      = pop_expr();
             token_t       op       = pop_token();
             c_tokentype_t oper     = op.subtype;
-            pos_t         oper_pos = op.pos;
+            srcrange_t    oper_pos = srcrange_from_pos(op.pos);
             tkn_delete(op);
             push_expr(c_ast_expr_create_prefix(
-                c_ast_expr_prefix_create(pos_including(oper_pos, val->pos), oper, oper_pos, val)
+                &ctx->ast_arena,
+                c_ast_expr_prefix_create(&ctx->ast_arena, srcrange_including(oper_pos, val->pos), oper, oper_pos, val)
             ));
 
         } else if (
@@ -707,10 +1004,18 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
             token_t       op       = pop_token();
             c_ast_expr_t *lhs      = pop_expr();
             c_tokentype_t oper     = op.subtype;
-            pos_t         oper_pos = op.pos;
+            srcrange_t    oper_pos = srcrange_from_pos(op.pos);
             tkn_delete(op);
             push_expr(c_ast_expr_create_infix(
-                c_ast_expr_infix_create(pos_including(lhs->pos, rhs->pos), lhs, oper, oper_pos, rhs)
+                &ctx->ast_arena,
+                c_ast_expr_infix_create(
+                    &ctx->ast_arena,
+                    srcrange_including(lhs->pos, rhs->pos),
+                    lhs,
+                    oper,
+                    oper_pos,
+                    rhs
+                )
             ));
 
         } else if (
@@ -725,39 +1030,55 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
             tkn_delete(colon);
             tkn_delete(question);
             push_expr(c_ast_expr_create_ternary(
-                c_ast_expr_ternary_create(pos_including(cond->pos, else_expr->pos), cond, if_expr, else_expr)
+                &ctx->ast_arena,
+                c_ast_expr_ternary_create(
+                    &ctx->ast_arena,
+                    srcrange_including(cond->pos, else_expr->pos),
+                    cond,
+                    if_expr,
+                    else_expr
+                )
             ));
 
         } else if (is_token(0, TOKENTYPE_ICONST) || is_token(0, TOKENTYPE_CCONST)) { // Reduce iconst / cconst to expr.
-            token_t  tkn  = pop_token();
-            pos_t    pos  = tkn.pos;
-            c_prim_t prim = tkn.type == TOKENTYPE_CCONST ? C_PRIM_CHAR : tkn.subtype;
-            i128_t   val  = i128_pack(tkn.ivalh, tkn.ival);
+            token_t    tkn  = pop_token();
+            srcrange_t pos  = srcrange_from_pos(tkn.pos);
+            c_prim_t   prim = tkn.type == TOKENTYPE_CCONST ? C_PRIM_CHAR : tkn.subtype;
+            i128_t     val  = i128_pack(tkn.ivalh, tkn.ival);
             tkn_delete(tkn);
-            push_expr(c_ast_expr_create_iconst(c_ast_expr_iconst_create(pos, prim, val)));
+            push_expr(c_ast_expr_create_iconst(
+                &ctx->ast_arena,
+                c_ast_expr_iconst_create(&ctx->ast_arena, pos, prim, val)
+            ));
 
         } else if (is_keyw(0, C_KEYW_true)) { // Reduce true.
-            token_t  tkn  = pop_token();
-            pos_t    pos  = tkn.pos;
-            c_prim_t prim = C_PRIM_BOOL;
-            i128_t   val  = ui128(1);
+            token_t    tkn  = pop_token();
+            srcrange_t pos  = srcrange_from_pos(tkn.pos);
+            c_prim_t   prim = C_PRIM_BOOL;
+            i128_t     val  = ui128(1);
             tkn_delete(tkn);
-            push_expr(c_ast_expr_create_iconst(c_ast_expr_iconst_create(pos, prim, val)));
+            push_expr(c_ast_expr_create_iconst(
+                &ctx->ast_arena,
+                c_ast_expr_iconst_create(&ctx->ast_arena, pos, prim, val)
+            ));
 
         } else if (is_keyw(0, C_KEYW_false)) { // Reduce false.
-            token_t  tkn  = pop_token();
-            pos_t    pos  = tkn.pos;
-            c_prim_t prim = C_PRIM_BOOL;
-            i128_t   val  = UI128_ZERO;
+            token_t    tkn  = pop_token();
+            srcrange_t pos  = srcrange_from_pos(tkn.pos);
+            c_prim_t   prim = C_PRIM_BOOL;
+            i128_t     val  = UI128_ZERO;
             tkn_delete(tkn);
-            push_expr(c_ast_expr_create_iconst(c_ast_expr_iconst_create(pos, prim, val)));
+            push_expr(c_ast_expr_create_iconst(
+                &ctx->ast_arena,
+                c_ast_expr_iconst_create(&ctx->ast_arena, pos, prim, val)
+            ));
 
         } else if (is_token(0, TOKENTYPE_IDENT)) { // Reduce ident to expr.
-            token_t tkn = pop_token();
-            pos_t   pos = tkn.pos;
-            char   *val = lilycc_strdup(tkn.strval);
+            token_t    tkn = pop_token();
+            srcrange_t pos = srcrange_from_pos(tkn.pos);
+            char      *val = arena_strndup(&ctx->ast_arena, tkn.strval, tkn.strval_len);
             tkn_delete(tkn);
-            push_expr(c_ast_expr_create_ident(c_ast_ident_create(pos, val)));
+            push_expr(c_ast_expr_create_ident(&ctx->ast_arena, c_ast_ident_create(&ctx->ast_arena, pos, val)));
 
         } else if (is_token(1, TOKENTYPE_SCONST) && is_token(0, TOKENTYPE_SCONST)) { // Reduce sconst pasting.
             token_t rhs    = pop_token();
@@ -778,15 +1099,15 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
 
         } else if (is_token(0, TOKENTYPE_SCONST) && peek.type != TOKENTYPE_SCONST) { // Reduce sconst to expr.
             token_t    tkn = pop_token();
-            pos_t      pos = tkn.pos;
-            vec_char_t val = {0};
-            // The `strval`, being a C-string too is always NUL-terminated.
-            // We simply copy in its NUL terminator too here.
-            vec_reserve_exact(&val, tkn.strval_len + 1);
-            val.len = tkn.strval_len + 1;
-            memcpy(val.arr, tkn.strval, val.len);
+            srcrange_t pos = srcrange_from_pos(tkn.pos);
+            // The `strval` may be borrowed from the source, so add the NUL terminator separately.
+            vec_char_t val = {
+                .len = tkn.strval_len + 1,
+                .cap = tkn.strval_len + 1,
+                .arr = arena_strndup(&ctx->ast_arena, tkn.strval, tkn.strval_len),
+            };
             tkn_delete(tkn);
-            push_expr(c_ast_expr_create_sconst(c_ast_expr_sconst_create(pos, val)));
+            push_expr(c_ast_expr_create_sconst(&ctx->ast_arena, c_ast_expr_sconst_create(&ctx->ast_arena, pos, val)));
 
         } else if (can_push) { // Push next token.
             token_t next = tkn_next(ctx->tkn_ctx);
@@ -821,8 +1142,8 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
         pos_t pos;
         switch (stack.arr[1].tag) {
             case LR_ENTRY_TOKEN: pos = stack.arr[1].token.pos; break;
-            case LR_ENTRY_EXPR: pos = stack.arr[1].expr->pos; break;
-            case LR_ENTRY_TYPE: pos = stack.arr[1].type->pos; break;
+            case LR_ENTRY_EXPR: pos = c_parse2_pos(ctx, stack.arr[1].expr->pos); break;
+            case LR_ENTRY_TYPE: pos = c_parse2_pos(ctx, stack.arr[1].type->pos); break;
         }
         cctx_diagnostic(ctx->tkn_ctx->cctx, pos, DIAG_ERR, "Expected end of expression or operator");
         goto err;
@@ -831,8 +1152,8 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
         pos_t pos;
         switch (stack.arr[0].tag) {
             case LR_ENTRY_TOKEN: pos = stack.arr[0].token.pos; break;
-            case LR_ENTRY_EXPR: pos = stack.arr[0].expr->pos; break;
-            case LR_ENTRY_TYPE: pos = stack.arr[0].type->pos; break;
+            case LR_ENTRY_EXPR: pos = c_parse2_pos(ctx, stack.arr[0].expr->pos); break;
+            case LR_ENTRY_TYPE: pos = c_parse2_pos(ctx, stack.arr[0].type->pos); break;
         }
         cctx_diagnostic(ctx->tkn_ctx->cctx, pos, DIAG_ERR, "Expected expression");
         goto err;
@@ -844,28 +1165,29 @@ c_ast_expr_t *c_parse2_expr(c_parser_t *ctx) {
     }
 
 err:;
-    pos_t pos0;
+    srcrange_t pos0;
     switch (stack.arr[0].tag) {
-        case LR_ENTRY_TOKEN: pos0 = stack.arr[0].token.pos; break;
+        case LR_ENTRY_TOKEN: pos0 = srcrange_from_pos(stack.arr[0].token.pos); break;
         case LR_ENTRY_EXPR: pos0 = stack.arr[0].expr->pos; break;
         case LR_ENTRY_TYPE: pos0 = stack.arr[0].type->pos; break;
     }
     if (stack.len > 1) {
-        pos_t pos1;
+        srcrange_t pos1;
         switch (stack.arr[1].tag) {
-            case LR_ENTRY_TOKEN: pos1 = stack.arr[1].token.pos; break;
+            case LR_ENTRY_TOKEN: pos1 = srcrange_from_pos(stack.arr[1].token.pos); break;
             case LR_ENTRY_EXPR: pos1 = stack.arr[1].expr->pos; break;
             case LR_ENTRY_TYPE: pos1 = stack.arr[1].type->pos; break;
         }
-        pos0 = pos_including(pos0, pos1);
+        pos0 = srcrange_including(pos0, pos1);
     }
 
     for (size_t i = 0; i < stack.len; i++) {
         lr_entry_delete(stack.arr[i]);
     }
     vec_clear(&stack);
+    c_parse2_rewind(ctx, mark);
 
-    return c_ast_expr_create_garbage(c_ast_garbage_create(pos0));
+    return c_ast_expr_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos0));
 }
 
 // Parse a type name.
@@ -873,16 +1195,17 @@ c_ast_type_name_t *c_parse2_type_name(c_parser_t *ctx) {
     bool                    is_typedef;
     c_ast_spec_qual_list_t *spec_qual = c_parse2_spec_qual_list(ctx, &is_typedef);
     if (is_typedef) {
-        cctx_diagnostic(ctx->tkn_ctx->cctx, spec_qual->pos, DIAG_ERR, "`typedef` not allowed here");
+        pos_t pos = c_parse2_pos(ctx, spec_qual->pos);
+        cctx_diagnostic(ctx->tkn_ctx->cctx, pos, DIAG_ERR, "`typedef` not allowed here");
     }
     token_t peek = tkn_peek(ctx->tkn_ctx);
     if ((peek.type == TOKENTYPE_OTHER
          && (peek.subtype == C_TKN_MUL || peek.subtype == C_TKN_LBRAC || peek.subtype == C_TKN_LPAR))
         || peek.subtype == TOKENTYPE_IDENT) {
         c_ast_decl_t *decl = c_parse2_decl(ctx, false, false);
-        return c_ast_type_name_create(pos_including(spec_qual->pos, decl->pos), spec_qual, decl);
+        return c_ast_type_name_create(&ctx->ast_arena, srcrange_including(spec_qual->pos, decl->pos), spec_qual, decl);
     } else {
-        return c_ast_type_name_create(spec_qual->pos, spec_qual, NULL);
+        return c_ast_type_name_create(&ctx->ast_arena, spec_qual->pos, spec_qual, NULL);
     }
 }
 
@@ -906,35 +1229,36 @@ static c_ast_decl_t *c_parse2_ddecl(c_parser_t *ctx, bool allows_name, bool is_t
         peek = tkn_peek(ctx->tkn_ctx);
         if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_RPAR) {
             cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected )");
-            pos_t pos = pos_including(lpar.pos, inner->pos);
+            srcrange_t pos = srcrange_including(srcrange_from_pos(lpar.pos), inner->pos);
             tkn_delete(lpar);
-            return c_ast_decl_create_garbage(c_ast_garbage_create(pos));
+            return c_ast_decl_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos));
         }
         token_t rpar = tkn_next(ctx->tkn_ctx);
-        inner->pos   = pos_including(lpar.pos, rpar.pos);
+        inner->pos   = srcrange_from_pos(pos_including(lpar.pos, rpar.pos));
         tkn_delete(lpar);
         tkn_delete(rpar);
 
     } else if (peek.type == TOKENTYPE_IDENT && allows_name) {
         // Identifier.
-        token_t tkn = tkn_next(ctx->tkn_ctx);
-        inner       = c_ast_decl_create_ident(c_ast_ident_create(tkn.pos, lilycc_strdup(tkn.strval)));
+        token_t        tkn   = tkn_next(ctx->tkn_ctx);
+        c_ast_ident_t *ident = c_ast_ident_create(
+            &ctx->ast_arena,
+            srcrange_from_pos(tkn.pos),
+            arena_strndup(&ctx->ast_arena, tkn.strval, tkn.strval_len)
+        );
+        inner = c_ast_decl_create_ident(&ctx->ast_arena, ident);
         if (is_typedef) {
-            if (ctx->func_body) {
-                set_add(&ctx->local_type_names, tkn.strval);
-            } else {
-                set_add(&ctx->type_names, tkn.strval);
-            }
+            c_parser_add_type_name(ctx, tkn.strval, ctx->func_body);
         }
         tkn_delete(tkn);
 
     } else if (peek.type != TOKENTYPE_OTHER || (peek.subtype != C_TKN_LBRAC && peek.subtype != C_TKN_LPAR)) {
         // Garbaj.
-        pos_t pos = peek.pos;
+        srcrange_t pos = srcrange_from_pos(peek.pos);
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected ( or [");
         tkn_delete(tkn_next(ctx->tkn_ctx));
         pos.len = 0;
-        return c_ast_decl_create_garbage(c_ast_garbage_create(pos));
+        return c_ast_decl_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos));
     } else {
         inner = NULL;
     }
@@ -956,27 +1280,35 @@ static c_ast_decl_t *c_parse2_ddecl(c_parser_t *ctx, bool allows_name, bool is_t
 
             if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_RBRAC) {
                 // Undimensioned array.
-                pos_t pos = inner ? pos_including(inner->pos, peek.pos) : peek.pos;
-                inner     = c_ast_decl_create_array(c_ast_decl_array_create(pos, inner, NULL));
+                srcrange_t rbrac = srcrange_from_pos(peek.pos);
+                srcrange_t pos   = inner ? srcrange_including(inner->pos, rbrac) : rbrac;
+                inner            = c_ast_decl_create_array(
+                    &ctx->ast_arena,
+                    c_ast_decl_array_create(&ctx->ast_arena, pos, inner, NULL)
+                );
                 tkn_delete(tkn_next(ctx->tkn_ctx));
             } else {
                 // Dimensioned array.
-                pos_t         pos  = inner ? pos_including(inner->pos, peek.pos) : peek.pos;
-                c_ast_expr_t *expr = c_ast_expr_create_exprs(c_parse2_exprs(ctx));
+                srcrange_t    pos  = srcrange_from_pos(peek.pos);
+                pos                = inner ? srcrange_including(inner->pos, pos) : pos;
+                c_ast_expr_t *expr = c_ast_expr_create_exprs(&ctx->ast_arena, c_parse2_exprs(ctx));
                 peek               = tkn_peek(ctx->tkn_ctx);
                 if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_RBRAC) {
                     tkn_delete(tkn_next(ctx->tkn_ctx));
                 } else {
                     cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected ]");
                 }
-                inner = c_ast_decl_create_array(c_ast_decl_array_create(pos, inner, expr));
+                inner = c_ast_decl_create_array(
+                    &ctx->ast_arena,
+                    c_ast_decl_array_create(&ctx->ast_arena, pos, inner, expr)
+                );
             }
 
         } else {
             // Function type.
-            peek      = tkn_peek(ctx->tkn_ctx);
-            pos_t pos = peek.pos;
-            pos.len   = 0;
+            peek           = tkn_peek(ctx->tkn_ctx);
+            srcrange_t pos = srcrange_from_pos(peek.pos);
+            pos.len        = 0;
 
             vec_c_ast_arg_def_t params = {0};
             if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_RPAR) {
@@ -985,20 +1317,24 @@ static c_ast_decl_t *c_parse2_ddecl(c_parser_t *ctx, bool allows_name, bool is_t
                     bool                    is_typedef;
                     c_ast_spec_qual_list_t *param_qual = c_parse2_spec_qual_list(ctx, &is_typedef);
                     if (is_typedef) {
-                        cctx_diagnostic(ctx->tkn_ctx->cctx, param_qual->pos, DIAG_ERR, "`typedef` not allowed here");
+                        pos_t qual_pos = c_parse2_pos(ctx, param_qual->pos);
+                        cctx_diagnostic(ctx->tkn_ctx->cctx, qual_pos, DIAG_ERR, "`typedef` not allowed here");
                     }
                     peek = tkn_peek(ctx->tkn_ctx);
                     if (peek.type == TOKENTYPE_OTHER && (peek.subtype == C_TKN_RPAR || peek.subtype == C_TKN_COMMA)) {
-                        vec_push(&params, c_ast_arg_def_create(param_qual->pos, param_qual, NULL));
+                        vec_push(&params, c_ast_arg_def_create(&ctx->ast_arena, param_qual->pos, param_qual, NULL));
                     } else {
                         c_ast_decl_t *param_decl = c_parse2_decl(ctx, true, false);
-                        vec_push(&params, c_ast_arg_def_create(param_qual->pos, param_qual, param_decl));
+                        vec_push(
+                            &params,
+                            c_ast_arg_def_create(&ctx->ast_arena, param_qual->pos, param_qual, param_decl)
+                        );
                         peek = tkn_peek(ctx->tkn_ctx);
                     }
                     if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_COMMA) {
                         tkn_delete(tkn_next(ctx->tkn_ctx));
                     } else if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_RPAR) {
-                        pos = pos_including(pos, peek.pos);
+                        pos = srcrange_including(pos, srcrange_from_pos(peek.pos));
                         break;
                     }
                 }
@@ -1007,11 +1343,18 @@ static c_ast_decl_t *c_parse2_ddecl(c_parser_t *ctx, bool allows_name, bool is_t
             if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_RPAR) {
                 tkn_delete(tkn_next(ctx->tkn_ctx));
             } else {
-                pos = pos_between(pos, peek.pos);
+                pos = srcrange_between(pos, srcrange_from_pos(peek.pos));
                 cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected )");
             }
             inner = c_ast_decl_create_func(
-                c_ast_decl_func_create(pos, inner, c_ast_arg_def_list_create(pos, params), false)
+                &ctx->ast_arena,
+                c_ast_decl_func_create(
+                    &ctx->ast_arena,
+                    pos,
+                    inner,
+                    c_ast_arg_def_list_create(&ctx->ast_arena, pos, params),
+                    false
+                )
             );
         }
 
@@ -1030,8 +1373,8 @@ static c_ast_decl_t *c_parse2_decl(c_parser_t *ctx, bool allows_name, bool is_ty
     }
 
     // Parse the pointer before the ddecl.
-    token_t ptr     = tkn_next(ctx->tkn_ctx);
-    pos_t   ptr_pos = ptr.pos;
+    token_t    ptr     = tkn_next(ctx->tkn_ctx);
+    srcrange_t ptr_pos = srcrange_from_pos(ptr.pos);
     tkn_delete(ptr);
     c_ast_spec_qual_list_t *list = c_parse2_type_qual_list(ctx);
     peek                         = tkn_peek(ctx->tkn_ctx);
@@ -1042,12 +1385,12 @@ static c_ast_decl_t *c_parse2_decl(c_parser_t *ctx, bool allows_name, bool is_ty
         empty = false;
     }
     c_ast_decl_t *inner = NULL;
-    pos_t         pos   = ptr_pos;
+    srcrange_t    pos   = ptr_pos;
     if (!empty) {
         inner = c_parse2_decl(ctx, allows_name, is_typedef);
-        pos   = pos_including(ptr_pos, inner->pos);
+        pos   = srcrange_including(ptr_pos, inner->pos);
     }
-    return c_ast_decl_create_ptr(c_ast_decl_ptr_create(pos, ptr_pos, list, inner));
+    return c_ast_decl_create_ptr(&ctx->ast_arena, c_ast_decl_ptr_create(&ctx->ast_arena, pos, ptr_pos, list, inner));
 }
 
 // Parse a type qualifier list.
@@ -1060,12 +1403,12 @@ static c_ast_spec_qual_list_t *c_parse2_type_qual_list(c_parser_t *ctx) {
     while (is_type_qualifier(peek)) {
         pos         = pos_including(pos, pos);
         token_t tkn = tkn_next(ctx->tkn_ctx);
-        vec_push(&args, c_ast_spec_qual_create_keyw(tkn.pos, tkn.subtype));
+        vec_push(&args, c_ast_spec_qual_create_keyw(&ctx->ast_arena, srcrange_from_pos(tkn.pos), tkn.subtype));
         tkn_delete(tkn);
         peek = tkn_peek(ctx->tkn_ctx);
     }
 
-    return c_ast_spec_qual_list_create(pos, args);
+    return c_ast_spec_qual_list_create(&ctx->ast_arena, srcrange_from_pos(pos), args);
 }
 
 // Parse one or more C expressions separated by commas or a type.
@@ -1084,9 +1427,9 @@ static void *c_parse2_exprs_or_type(c_parser_t *ctx, bool *is_type_out) {
 static c_ast_initval_t *c_parse2_compinit_or_expr(c_parser_t *ctx) {
     token_t peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_LCURL) {
-        return c_ast_initval_create_compound(c_parse2_comp_init(ctx));
+        return c_ast_initval_create_compound(&ctx->ast_arena, c_parse2_comp_init(ctx));
     } else {
-        return c_ast_initval_create_expr(c_parse2_expr(ctx));
+        return c_ast_initval_create_expr(&ctx->ast_arena, c_parse2_expr(ctx));
     }
 }
 
@@ -1109,14 +1452,10 @@ c_ast_spec_qual_list_t *c_parse2_spec_qual_list(c_parser_t *ctx, bool *is_typede
 
             // Token added verbatim.
             token_t tkn = tkn_next(ctx->tkn_ctx);
-            vec_push(&args, c_ast_spec_qual_create_keyw(tkn.pos, tkn.subtype));
+            vec_push(&args, c_ast_spec_qual_create_keyw(&ctx->ast_arena, srcrange_from_pos(tkn.pos), tkn.subtype));
             tkn_delete(tkn);
 
-        } else if (
-            peek.type == TOKENTYPE_IDENT
-            && (set_contains(&ctx->type_names, peek.strval)
-                || (ctx->func_body && set_contains(&ctx->local_type_names, peek.strval)))
-        ) {
+        } else if (peek.type == TOKENTYPE_IDENT && c_parser_is_type_name(ctx, &peek)) {
             // Identifier added verbatim.
             if (seen_type_spec) {
                 // This check guards against a parsing error that might happen if you `typedef int foo` and proceed to
@@ -1124,18 +1463,28 @@ c_ast_spec_qual_list_t *c_parse2_spec_qual_list(c_parser_t *ctx, bool *is_typede
                 break;
             }
             token_t tkn = tkn_next(ctx->tkn_ctx);
-            vec_push(&args, c_ast_spec_qual_create_typedef(c_ast_ident_create(tkn.pos, lilycc_strdup(tkn.strval))));
+            vec_push(
+                &args,
+                c_ast_spec_qual_create_typedef(
+                    &ctx->ast_arena,
+                    c_ast_ident_create(
+                        &ctx->ast_arena,
+                        srcrange_from_pos(tkn.pos),
+                        arena_strndup(&ctx->ast_arena, tkn.strval, tkn.strval_len)
+                    )
+                )
+            );
             tkn_delete(tkn);
             seen_type_spec = true;
 
         } else if (peek.type == TOKENTYPE_KEYWORD && (peek.subtype == C_KEYW_struct || peek.subtype == C_KEYW_union)) {
             // Parse a struct/union specifier.
-            vec_push(&args, c_ast_spec_qual_create_struct(c_parse2_struct_spec(ctx)));
+            vec_push(&args, c_ast_spec_qual_create_struct(&ctx->ast_arena, c_parse2_struct_spec(ctx)));
             seen_type_spec = true;
 
         } else if (peek.type == TOKENTYPE_KEYWORD && (peek.subtype == C_KEYW_enum)) {
             // Parse an enum specifier.
-            vec_push(&args, c_ast_spec_qual_create_enum(c_parse2_enum_spec(ctx)));
+            vec_push(&args, c_ast_spec_qual_create_enum(&ctx->ast_arena, c_parse2_enum_spec(ctx)));
             seen_type_spec = true;
 
         } else {
@@ -1146,7 +1495,7 @@ c_ast_spec_qual_list_t *c_parse2_spec_qual_list(c_parser_t *ctx, bool *is_typede
         peek = tkn_peek(ctx->tkn_ctx);
     }
 
-    return c_ast_spec_qual_list_create(pos, args);
+    return c_ast_spec_qual_list_create(&ctx->ast_arena, srcrange_from_pos(pos), args);
 }
 
 // Parse a `_Static_assert(cond);` or `_Static_assert(cond, message);` declaration.
@@ -1160,7 +1509,7 @@ static c_ast_def_t *c_parse2_static_assert(c_parser_t *ctx) {
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_LPAR) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected (");
         c_eat_delim(ctx->tkn_ctx, false);
-        return c_ast_def_create_garbage(c_ast_garbage_create(pos));
+        return c_ast_def_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, srcrange_from_pos(pos)));
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
@@ -1190,7 +1539,57 @@ static c_ast_def_t *c_parse2_static_assert(c_parser_t *ctx) {
         tkn_delete(tkn_next(ctx->tkn_ctx));
     }
 
-    return c_ast_def_create_static_assert(c_ast_def_static_assert_create(pos, cond, message));
+    return c_ast_def_create_static_assert(
+        &ctx->ast_arena,
+        c_ast_def_static_assert_create(&ctx->ast_arena, srcrange_from_pos(pos), cond, message)
+    );
+}
+
+// Skip over the body of a function definition so it can be parsed later by `c_parse2_parallel`.
+// Called after the opening curly bracket; returns NULL without consuming anything if the body has to be parsed now.
+static c_deferred_body_t *c_parse2_skip_body(c_parser_t *ctx) {
+    // Find the closing curly bracket.
+    size_t len   = 0;
+    size_t depth = 0;
+    while (1) {
+        token_t peek = tkn_peek_n(ctx->tkn_ctx, len);
+        if (peek.type == TOKENTYPE_EOF) {
+            // The error is reported by parsing the body in order.
+            return NULL;
+        } else if (peek.type == TOKENTYPE_KEYWORD && peek.subtype == C_KEYW_typedef) {
+            // Type names defined in function bodies are also type names in the rest of the file.
+            return NULL;
+        } else if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_LCURL) {
+            depth++;
+        } else if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_RCURL) {
+            if (!depth) {
+                break;
+            }
+            depth--;
+        }
+        len++;
+    }
+
+    vec_token_t tokens = {0};
+    vec_reserve_exact(&tokens, len);
+    c_deferred_body_t *body = lilycc_calloc(1, sizeof(c_deferred_body_t));
+    body->type_names        = PTR_SET_EMPTY;
+    for (size_t i = 0; i < len; i++) {
+        token_t tkn = tkn_next(ctx->tkn_ctx);
+        if (tkn.type == TOKENTYPE_IDENT && c_parser_is_type_name(ctx, &tkn)) {
+            set_add(&body->type_names, tkn.strval);
+        }
+        vec_push(&tokens, tkn);
+    }
+    body->tokens     = tokens.arr;
+    body->tokens_len = tokens.len;
+
+    token_t rcurl    = tkn_next(ctx->tkn_ctx);
+    body->end_pos    = rcurl.pos;
+    body->diag_after = ctx->tkn_ctx->cctx->diagnostics.tail;
+    tkn_delete(rcurl);
+
+    return body;
 }
 
 // Parse a variable/function declarations/definition.
@@ -1200,15 +1599,16 @@ c_ast_def_t *c_parse2_def(c_parser_t *ctx, bool allow_func_body) {
         return c_parse2_static_assert(ctx);
     }
 
+    c_parse2_mark_t         mark  = c_parse2_mark(ctx);
     vec_c_ast_init_decl_t   decls = {0};
     bool                    is_typedef;
     c_ast_spec_qual_list_t *spec_qual = c_parse2_spec_qual_list(ctx, &is_typedef);
 
 
     // Decls are actually allowed to be empty.
-    peek            = tkn_peek(ctx->tkn_ctx);
-    pos_t decls_pos = peek.pos;
-    decls_pos.len   = 0;
+    peek                 = tkn_peek(ctx->tkn_ctx);
+    srcrange_t decls_pos = srcrange_from_pos(peek.pos);
+    decls_pos.len        = 0;
     if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_SEMIC) {
         tkn_delete(tkn_next(ctx->tkn_ctx));
         goto exit;
@@ -1229,9 +1629,9 @@ c_ast_def_t *c_parse2_def(c_parser_t *ctx, bool allow_func_body) {
             peek = tkn_peek(ctx->tkn_ctx);
         }
 
-        pos_t decl_pos = init ? pos_including(decl->pos, init->pos) : decl->pos;
-        decls_pos      = pos_including(decls_pos, decl_pos);
-        vec_push(&decls, c_ast_init_decl_create(decl_pos, decl, init));
+        srcrange_t decl_pos = init ? srcrange_including(decl->pos, init->pos) : decl->pos;
+        decls_pos           = srcrange_including(decls_pos, decl_pos);
+        vec_push(&decls, c_ast_init_decl_create(&ctx->ast_arena, decl_pos, decl, init));
     } while (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_COMMA);
 
     if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_LCURL) {
@@ -1242,14 +1642,31 @@ c_ast_def_t *c_parse2_def(c_parser_t *ctx, bool allow_func_body) {
         }
 
         tkn_delete(tkn_next(ctx->tkn_ctx));
+        c_deferred_body_t *deferred = ctx->defer_bodies ? c_parse2_skip_body(ctx) : NULL;
+        if (deferred) {
+            // The body is parsed later; see `c_parse2_parallel`.
+            decls_pos          = srcrange_including(decls_pos, srcrange_from_pos(deferred->end_pos));
+            c_ast_decl_t *decl = decls.arr[0]->decl;
+            vec_clear(&decls);
+            deferred->func = c_ast_def_func_create(
+                &ctx->ast_arena,
+                srcrange_including(spec_qual->pos, decls_pos),
+                spec_qual,
+                decl,
+                NULL
+            );
+            vec_push(&ctx->deferred_bodies, deferred);
+            return c_ast_def_create_func(&ctx->ast_arena, deferred->func);
+        }
+
         c_ast_stmt_list_t *body = c_parse2_stmts(ctx);
-        decls_pos               = pos_including(decls_pos, body->pos);
+        decls_pos               = srcrange_including(decls_pos, body->pos);
 
         peek = tkn_peek(ctx->tkn_ctx);
         if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_RCURL) {
             cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected }");
         } else {
-            decls_pos = pos_including(decls_pos, peek.pos);
+            decls_pos = srcrange_including(decls_pos, srcrange_from_pos(peek.pos));
             tkn_delete(tkn_next(ctx->tkn_ctx));
         }
 
@@ -1258,11 +1675,10 @@ c_ast_def_t *c_parse2_def(c_parser_t *ctx, bool allow_func_body) {
         }
 
         c_ast_decl_t *decl = decls.arr[0]->decl;
-        decls.arr[0]->decl = NULL;
-        c_ast_init_decl_delete(decls.arr[0]);
         vec_clear(&decls);
         return c_ast_def_create_func(
-            c_ast_def_func_create(pos_including(spec_qual->pos, decls_pos), spec_qual, decl, body)
+            &ctx->ast_arena,
+            c_ast_def_func_create(&ctx->ast_arena, srcrange_including(spec_qual->pos, decls_pos), spec_qual, decl, body)
         );
 
     } else if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_SEMIC) {
@@ -1270,23 +1686,26 @@ c_ast_def_t *c_parse2_def(c_parser_t *ctx, bool allow_func_body) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected ;");
         c_eat_delim(ctx->tkn_ctx, false);
     } else {
-        decls_pos = pos_including(decls_pos, peek.pos);
+        decls_pos = srcrange_including(decls_pos, srcrange_from_pos(peek.pos));
         tkn_delete(tkn_next(ctx->tkn_ctx));
     }
 
 exit:
-    return c_ast_def_create_defs(c_ast_defs_create(
-        pos_including(spec_qual->pos, decls_pos),
-        spec_qual,
-        c_ast_init_decl_list_create(decls_pos, decls)
-    ));
+    return c_ast_def_create_defs(
+        &ctx->ast_arena,
+        c_ast_defs_create(
+            &ctx->ast_arena,
+            srcrange_including(spec_qual->pos, decls_pos),
+            spec_qual,
+            c_ast_init_decl_list_create(&ctx->ast_arena, decls_pos, decls)
+        )
+    );
 
 garbage:
-    for (size_t i = 0; i < decls.len; i++) {
-        c_ast_init_decl_delete(decls.arr[i]);
-    }
     vec_clear(&decls);
-    return c_ast_def_create_garbage(c_ast_garbage_create(pos_including(spec_qual->pos, decls_pos)));
+    decls_pos = srcrange_including(spec_qual->pos, decls_pos);
+    c_parse2_rewind(ctx, mark);
+    return c_ast_def_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, decls_pos));
 }
 
 // Parse a struct or union specifier/definition.
@@ -1294,18 +1713,22 @@ c_ast_struct_spec_t *c_parse2_struct_spec(c_parser_t *ctx) {
     c_ast_def_list_t *body = NULL;
     c_ast_ident_t    *name = NULL;
 
-    token_t keyw     = tkn_next(ctx->tkn_ctx);
-    pos_t   keyw_pos = keyw.pos;
-    bool    is_union = keyw.subtype == C_KEYW_union;
+    token_t    keyw     = tkn_next(ctx->tkn_ctx);
+    srcrange_t keyw_pos = srcrange_from_pos(keyw.pos);
+    bool       is_union = keyw.subtype == C_KEYW_union;
     tkn_delete(keyw);
-    pos_t   pos  = keyw_pos;
-    token_t peek = tkn_peek(ctx->tkn_ctx);
+    srcrange_t pos  = keyw_pos;
+    token_t    peek = tkn_peek(ctx->tkn_ctx);
 
     if (peek.type == TOKENTYPE_IDENT) {
         token_t tkn = tkn_next(ctx->tkn_ctx);
-        name        = c_ast_ident_create(tkn.pos, lilycc_strdup(tkn.strval));
+        name        = c_ast_ident_create(
+            &ctx->ast_arena,
+            srcrange_from_pos(tkn.pos),
+            arena_strndup(&ctx->ast_arena, tkn.strval, tkn.strval_len)
+        );
         tkn_delete(tkn);
-        pos  = pos_including(pos, name->pos);
+        pos  = srcrange_including(pos, name->pos);
         peek = tkn_peek(ctx->tkn_ctx);
 
         if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_LCURL) {
@@ -1317,33 +1740,33 @@ c_ast_struct_spec_t *c_parse2_struct_spec(c_parser_t *ctx) {
     if (!name && (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_LCURL)) {
         // There should be a decl here since it's anonymous.
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected {");
-        return c_ast_struct_spec_create(pos, is_union, keyw_pos, NULL, NULL);
+        return c_ast_struct_spec_create(&ctx->ast_arena, pos, is_union, keyw_pos, NULL, NULL);
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
     vec_c_ast_def_t args = {0};
     peek                 = tkn_peek(ctx->tkn_ctx);
-    pos_t body_pos       = peek.pos;
+    srcrange_t body_pos  = srcrange_from_pos(peek.pos);
     body_pos.len         = 0;
     while (peek.type != TOKENTYPE_EOF && (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_RCURL)) {
         c_ast_def_t *def = c_parse2_def(ctx, false);
-        body_pos         = pos_including(body_pos, def->pos);
+        body_pos         = srcrange_including(body_pos, def->pos);
         vec_push(&args, def);
         peek = tkn_peek(ctx->tkn_ctx);
     }
-    body = c_ast_def_list_create(body_pos, args);
-    pos  = pos_including(pos, body_pos);
+    body = c_ast_def_list_create(&ctx->ast_arena, body_pos, args);
+    pos  = srcrange_including(pos, body_pos);
 
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_RCURL) {
         // There should be a decl here since it's anonymous.
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected }");
     } else {
-        pos = pos_including(pos, peek.pos);
+        pos = srcrange_including(pos, srcrange_from_pos(peek.pos));
         tkn_delete(tkn_next(ctx->tkn_ctx));
     }
 
 exit:
-    return c_ast_struct_spec_create(pos, is_union, keyw_pos, name, body);
+    return c_ast_struct_spec_create(&ctx->ast_arena, pos, is_union, keyw_pos, name, body);
 }
 
 // Parse an enum specifier/definition.
@@ -1351,17 +1774,21 @@ c_ast_enum_spec_t *c_parse2_enum_spec(c_parser_t *ctx) {
     c_ast_enumvar_list_t *body = NULL;
     c_ast_ident_t        *name = NULL;
 
-    token_t keyw     = tkn_next(ctx->tkn_ctx);
-    pos_t   keyw_pos = keyw.pos;
+    token_t    keyw     = tkn_next(ctx->tkn_ctx);
+    srcrange_t keyw_pos = srcrange_from_pos(keyw.pos);
     tkn_delete(keyw);
-    pos_t   pos  = keyw_pos;
-    token_t peek = tkn_peek(ctx->tkn_ctx);
+    srcrange_t pos  = keyw_pos;
+    token_t    peek = tkn_peek(ctx->tkn_ctx);
 
     if (peek.type == TOKENTYPE_IDENT) {
         token_t tkn = tkn_next(ctx->tkn_ctx);
-        name        = c_ast_ident_create(tkn.pos, lilycc_strdup(tkn.strval));
+        name        = c_ast_ident_create(
+            &ctx->ast_arena,
+            srcrange_from_pos(tkn.pos),
+            arena_strndup(&ctx->ast_arena, tkn.strval, tkn.strval_len)
+        );
         tkn_delete(tkn);
-        pos  = pos_including(pos, name->pos);
+        pos  = srcrange_including(pos, name->pos);
         peek = tkn_peek(ctx->tkn_ctx);
 
         if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_LCURL) {
@@ -1373,13 +1800,13 @@ c_ast_enum_spec_t *c_parse2_enum_spec(c_parser_t *ctx) {
     if (!name && (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_LCURL)) {
         // There should be a decl here since it's anonymous.
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected {");
-        return c_ast_enum_spec_create(pos, keyw_pos, NULL, NULL);
+        return c_ast_enum_spec_create(&ctx->ast_arena, pos, keyw_pos, NULL, NULL);
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
     vec_c_ast_enumvar_t args = {0};
     peek                     = tkn_peek(ctx->tkn_ctx);
-    pos_t body_pos           = peek.pos;
+    srcrange_t body_pos      = srcrange_from_pos(peek.pos);
     body_pos.len             = 0;
     while (1) {
         peek = tkn_peek(ctx->tkn_ctx);
@@ -1390,7 +1817,11 @@ c_ast_enum_spec_t *c_parse2_enum_spec(c_parser_t *ctx) {
             break;
         } else {
             token_t        ident     = tkn_next(ctx->tkn_ctx);
-            c_ast_ident_t *ident_ast = c_ast_ident_create(ident.pos, lilycc_strdup(ident.strval));
+            c_ast_ident_t *ident_ast = c_ast_ident_create(
+                &ctx->ast_arena,
+                srcrange_from_pos(ident.pos),
+                arena_strndup(&ctx->ast_arena, ident.strval, ident.strval_len)
+            );
             tkn_delete(ident);
             peek = tkn_peek(ctx->tkn_ctx);
 
@@ -1398,14 +1829,22 @@ c_ast_enum_spec_t *c_parse2_enum_spec(c_parser_t *ctx) {
                 // Enum variant with specific index.
                 tkn_delete(tkn_next(ctx->tkn_ctx));
                 c_ast_expr_t *expr = c_parse2_expr(ctx);
-                vec_push(&args, c_ast_enumvar_create(pos_including(ident_ast->pos, expr->pos), ident_ast, expr));
+                vec_push(
+                    &args,
+                    c_ast_enumvar_create(
+                        &ctx->ast_arena,
+                        srcrange_including(ident_ast->pos, expr->pos),
+                        ident_ast,
+                        expr
+                    )
+                );
 
                 peek = tkn_peek(ctx->tkn_ctx);
             } else {
                 // Enum variant with implicit index.
-                vec_push(&args, c_ast_enumvar_create(ident_ast->pos, ident_ast, NULL));
+                vec_push(&args, c_ast_enumvar_create(&ctx->ast_arena, ident_ast->pos, ident_ast, NULL));
             }
-            body_pos = pos_including(body_pos, args.arr[args.len - 1]->pos);
+            body_pos = srcrange_including(body_pos, args.arr[args.len - 1]->pos);
             if (peek.type != TOKENTYPE_OTHER || (peek.subtype != C_TKN_COMMA && peek.subtype != C_TKN_RCURL)) {
                 cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected ,");
                 c_eat_delim(ctx->tkn_ctx, true);
@@ -1414,49 +1853,56 @@ c_ast_enum_spec_t *c_parse2_enum_spec(c_parser_t *ctx) {
             }
         }
     }
-    body = c_ast_enumvar_list_create(body_pos, args);
-    pos  = pos_including(pos, body_pos);
+    body = c_ast_enumvar_list_create(&ctx->ast_arena, body_pos, args);
+    pos  = srcrange_including(pos, body_pos);
 
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_RCURL) {
         // There should be a decl here since it's anonymous.
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected }");
     } else {
-        pos = pos_including(pos, peek.pos);
+        pos = srcrange_including(pos, srcrange_from_pos(peek.pos));
         tkn_delete(tkn_next(ctx->tkn_ctx));
     }
 
 exit:
-    return c_ast_enum_spec_create(pos, keyw_pos, name, body);
+    return c_ast_enum_spec_create(&ctx->ast_arena, pos, keyw_pos, name, body);
 }
 
 // Parse a switch statement.
 static c_ast_stmt_t *c_parse2_switch(c_parser_t *ctx) {
     token_t keyw = tkn_next(ctx->tkn_ctx);
     assert(keyw.type == TOKENTYPE_KEYWORD && keyw.subtype == C_KEYW_switch);
-    pos_t keyw_pos = keyw.pos;
+    srcrange_t keyw_pos = srcrange_from_pos(keyw.pos);
     tkn_delete(keyw);
 
     token_t peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_LPAR) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected (");
-        return c_ast_stmt_create_garbage(c_ast_garbage_create(keyw_pos));
+        return c_ast_stmt_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, keyw_pos));
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
+    c_parse2_mark_t    mark = c_parse2_mark(ctx);
     c_ast_expr_list_t *cond = c_parse2_exprs(ctx);
 
     peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_RPAR) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected )");
-        pos_t pos = pos_including(keyw_pos, cond->pos);
-        c_ast_expr_list_delete(cond);
-        return c_ast_stmt_create_garbage(c_ast_garbage_create(pos));
+        srcrange_t pos = srcrange_including(keyw_pos, cond->pos);
+        c_parse2_rewind(ctx, mark);
+        return c_ast_stmt_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos));
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
     c_ast_stmt_t *body = c_parse2_stmt(ctx);
     return c_ast_stmt_create_switch(
-        c_ast_stmt_switch_create(pos_including(keyw_pos, body->pos), c_ast_expr_create_exprs(cond), body)
+        &ctx->ast_arena,
+        c_ast_stmt_switch_create(
+            &ctx->ast_arena,
+            srcrange_including(keyw_pos, body->pos),
+            c_ast_expr_create_exprs(&ctx->ast_arena, cond),
+            body
+        )
     );
 }
 
@@ -1464,7 +1910,7 @@ static c_ast_stmt_t *c_parse2_switch(c_parser_t *ctx) {
 static c_ast_stmt_t *c_parse2_case(c_parser_t *ctx) {
     token_t keyw = tkn_next(ctx->tkn_ctx);
     assert(keyw.type == TOKENTYPE_KEYWORD && keyw.subtype == C_KEYW_case);
-    pos_t keyw_pos = keyw.pos;
+    srcrange_t keyw_pos = srcrange_from_pos(keyw.pos);
     tkn_delete(keyw);
 
     c_ast_expr_t *lo = c_parse2_expr(ctx);
@@ -1484,35 +1930,38 @@ static c_ast_stmt_t *c_parse2_case(c_parser_t *ctx) {
     }
 
     c_ast_stmt_t *inner = c_parse2_stmt(ctx);
-    c_ast_stmt_t *res
-        = c_ast_stmt_create_case(c_ast_stmt_case_create(pos_including(keyw_pos, inner->pos), lo, hi, inner));
+    c_ast_stmt_t *res = c_ast_stmt_create_case(
+        &ctx->ast_arena,
+        c_ast_stmt_case_create(&ctx->ast_arena, srcrange_including(keyw_pos, inner->pos), lo, hi, inner)
+    );
     return res;
 }
 
 // Parse a do...while statement.
 static c_ast_stmt_t *c_parse2_do_while(c_parser_t *ctx) {
-    pos_t err_pos;
+    srcrange_t err_pos;
 
     token_t keyw = tkn_next(ctx->tkn_ctx);
     assert(keyw.type == TOKENTYPE_KEYWORD && keyw.subtype == C_KEYW_do);
-    pos_t keyw_pos = keyw.pos;
+    srcrange_t keyw_pos = srcrange_from_pos(keyw.pos);
     tkn_delete(keyw);
 
-    c_ast_stmt_t *body = c_parse2_stmt(ctx);
+    c_parse2_mark_t mark = c_parse2_mark(ctx);
+    c_ast_stmt_t   *body = c_parse2_stmt(ctx);
 
     token_t peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_KEYWORD || peek.subtype != C_KEYW_while) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected while");
-        err_pos = pos_including(keyw_pos, body->pos);
-        goto err1;
+        err_pos = srcrange_including(keyw_pos, body->pos);
+        goto err;
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
     peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_LPAR) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected (");
-        err_pos = pos_including(keyw_pos, body->pos);
-        goto err1;
+        err_pos = srcrange_including(keyw_pos, body->pos);
+        goto err;
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
@@ -1521,59 +1970,72 @@ static c_ast_stmt_t *c_parse2_do_while(c_parser_t *ctx) {
     peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_RPAR) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected )");
-        err_pos = pos_including(keyw_pos, cond->pos);
-        goto err2;
+        err_pos = srcrange_including(keyw_pos, cond->pos);
+        goto err;
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
     peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_SEMIC) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected ;");
-        err_pos = pos_including(keyw_pos, cond->pos);
-        goto err2;
+        err_pos = srcrange_including(keyw_pos, cond->pos);
+        goto err;
     }
-    pos_t end_pos = peek.pos;
+    srcrange_t end_pos = srcrange_from_pos(peek.pos);
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
     return c_ast_stmt_create_while(
-        c_ast_stmt_while_create(pos_including(keyw_pos, end_pos), c_ast_expr_create_exprs(cond), body, true)
+        &ctx->ast_arena,
+        c_ast_stmt_while_create(
+            &ctx->ast_arena,
+            srcrange_including(keyw_pos, end_pos),
+            c_ast_expr_create_exprs(&ctx->ast_arena, cond),
+            body,
+            true
+        )
     );
 
-err2:
-    c_ast_expr_list_delete(cond);
-err1:
-    c_ast_stmt_delete(body);
-    return c_ast_stmt_create_garbage(c_ast_garbage_create(err_pos));
+err:
+    c_parse2_rewind(ctx, mark);
+    return c_ast_stmt_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, err_pos));
 }
 
 // Parse a while statement.
 static c_ast_stmt_t *c_parse2_while(c_parser_t *ctx) {
     token_t keyw = tkn_next(ctx->tkn_ctx);
     assert(keyw.type == TOKENTYPE_KEYWORD && keyw.subtype == C_KEYW_while);
-    pos_t keyw_pos = keyw.pos;
+    srcrange_t keyw_pos = srcrange_from_pos(keyw.pos);
     tkn_delete(keyw);
 
     token_t peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_LPAR) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected (");
-        return c_ast_stmt_create_garbage(c_ast_garbage_create(keyw_pos));
+        return c_ast_stmt_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, keyw_pos));
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
+    c_parse2_mark_t    mark = c_parse2_mark(ctx);
     c_ast_expr_list_t *cond = c_parse2_exprs(ctx);
 
     peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_RPAR) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected )");
-        pos_t pos = pos_including(keyw_pos, cond->pos);
-        c_ast_expr_list_delete(cond);
-        return c_ast_stmt_create_garbage(c_ast_garbage_create(pos));
+        srcrange_t pos = srcrange_including(keyw_pos, cond->pos);
+        c_parse2_rewind(ctx, mark);
+        return c_ast_stmt_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos));
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
     c_ast_stmt_t *body = c_parse2_stmt(ctx);
     return c_ast_stmt_create_while(
-        c_ast_stmt_while_create(pos_including(keyw_pos, body->pos), c_ast_expr_create_exprs(cond), body, false)
+        &ctx->ast_arena,
+        c_ast_stmt_while_create(
+            &ctx->ast_arena,
+            srcrange_including(keyw_pos, body->pos),
+            c_ast_expr_create_exprs(&ctx->ast_arena, cond),
+            body,
+            false
+        )
     );
 }
 
@@ -1581,17 +2043,18 @@ static c_ast_stmt_t *c_parse2_while(c_parser_t *ctx) {
 static c_ast_stmt_t *c_parse2_for(c_parser_t *ctx) {
     token_t keyw = tkn_next(ctx->tkn_ctx);
     assert(keyw.type == TOKENTYPE_KEYWORD && keyw.subtype == C_KEYW_for);
-    pos_t keyw_pos = keyw.pos;
+    srcrange_t keyw_pos = srcrange_from_pos(keyw.pos);
     tkn_delete(keyw);
 
     token_t peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_LPAR) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected (");
-        return c_ast_stmt_create_garbage(c_ast_garbage_create(keyw_pos));
+        return c_ast_stmt_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, keyw_pos));
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
-    peek = tkn_peek(ctx->tkn_ctx);
+    c_parse2_mark_t mark = c_parse2_mark(ctx);
+    peek                 = tkn_peek(ctx->tkn_ctx);
     c_ast_stmt_t *init;
     if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_SEMIC) {
         // No initializer.
@@ -1599,17 +2062,17 @@ static c_ast_stmt_t *c_parse2_for(c_parser_t *ctx) {
         init = NULL;
     } else if (is_spec_qual_list_tkn(ctx, peek)) {
         // Declaration as initializer.
-        init = c_ast_stmt_create_def(c_parse2_def(ctx, false));
+        init = c_ast_stmt_create_def(&ctx->ast_arena, c_parse2_def(ctx, false));
     } else {
         // Expression as initializer.
-        init = c_ast_stmt_create_expr(c_parse2_exprs(ctx));
+        init = c_ast_stmt_create_expr(&ctx->ast_arena, c_parse2_exprs(ctx));
 
         peek = tkn_peek(ctx->tkn_ctx);
         if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_SEMIC) {
             cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected ;");
-            pos_t pos = pos_including(keyw_pos, init->pos);
-            c_ast_stmt_delete(init);
-            return c_ast_stmt_create_garbage(c_ast_garbage_create(pos));
+            srcrange_t pos = srcrange_including(keyw_pos, init->pos);
+            c_parse2_rewind(ctx, mark);
+            return c_ast_stmt_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos));
         }
         tkn_delete(tkn_next(ctx->tkn_ctx));
     }
@@ -1627,12 +2090,9 @@ static c_ast_stmt_t *c_parse2_for(c_parser_t *ctx) {
         peek = tkn_peek(ctx->tkn_ctx);
         if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_SEMIC) {
             cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected ;");
-            pos_t pos = pos_including(keyw_pos, cond->pos);
-            if (init) {
-                c_ast_stmt_delete(init);
-            }
-            c_ast_expr_list_delete(cond);
-            return c_ast_stmt_create_garbage(c_ast_garbage_create(pos));
+            srcrange_t pos = srcrange_including(keyw_pos, cond->pos);
+            c_parse2_rewind(ctx, mark);
+            return c_ast_stmt_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos));
         }
         tkn_delete(tkn_next(ctx->tkn_ctx));
     }
@@ -1650,53 +2110,49 @@ static c_ast_stmt_t *c_parse2_for(c_parser_t *ctx) {
 
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_RPAR) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected )");
-        pos_t pos = pos_between(keyw_pos, peek.pos);
-        if (init) {
-            c_ast_stmt_delete(init);
-        }
-        if (cond) {
-            c_ast_expr_list_delete(cond);
-        }
-        if (inc) {
-            c_ast_expr_list_delete(inc);
-        }
-        return c_ast_stmt_create_garbage(c_ast_garbage_create(pos));
+        srcrange_t pos = srcrange_between(keyw_pos, srcrange_from_pos(peek.pos));
+        c_parse2_rewind(ctx, mark);
+        return c_ast_stmt_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos));
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
     c_ast_stmt_t *body = c_parse2_stmt(ctx);
-    return c_ast_stmt_create_for(c_ast_stmt_for_create(pos_including(keyw_pos, body->pos), init, cond, inc, body));
+    return c_ast_stmt_create_for(
+        &ctx->ast_arena,
+        c_ast_stmt_for_create(&ctx->ast_arena, srcrange_including(keyw_pos, body->pos), init, cond, inc, body)
+    );
 }
 
 // Parse a if statement.
 static c_ast_stmt_t *c_parse2_if(c_parser_t *ctx) {
     token_t keyw = tkn_next(ctx->tkn_ctx);
     assert(keyw.type == TOKENTYPE_KEYWORD && keyw.subtype == C_KEYW_if);
-    pos_t keyw_pos = keyw.pos;
+    srcrange_t keyw_pos = srcrange_from_pos(keyw.pos);
     tkn_delete(keyw);
 
     token_t peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_LPAR) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected (");
-        return c_ast_stmt_create_garbage(c_ast_garbage_create(keyw_pos));
+        return c_ast_stmt_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, keyw_pos));
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
+    c_parse2_mark_t    mark = c_parse2_mark(ctx);
     c_ast_expr_list_t *cond = c_parse2_exprs(ctx);
 
     peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_RPAR) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected )");
-        pos_t pos = pos_including(keyw_pos, cond->pos);
-        c_ast_expr_list_delete(cond);
-        return c_ast_stmt_create_garbage(c_ast_garbage_create(pos));
+        srcrange_t pos = srcrange_including(keyw_pos, cond->pos);
+        c_parse2_rewind(ctx, mark);
+        return c_ast_stmt_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos));
     }
     tkn_delete(tkn_next(ctx->tkn_ctx));
 
     c_ast_stmt_t *body = c_parse2_stmt(ctx);
 
     c_ast_stmt_t *else_body = NULL;
-    pos_t         end_pos   = body->pos;
+    srcrange_t    end_pos   = body->pos;
     peek                    = tkn_peek(ctx->tkn_ctx);
     if (peek.type == TOKENTYPE_KEYWORD && peek.subtype == C_KEYW_else) {
         // An if...else statement.
@@ -1706,7 +2162,14 @@ static c_ast_stmt_t *c_parse2_if(c_parser_t *ctx) {
     }
 
     return c_ast_stmt_create_if(
-        c_ast_stmt_if_create(pos_including(keyw_pos, end_pos), c_ast_expr_create_exprs(cond), body, else_body)
+        &ctx->ast_arena,
+        c_ast_stmt_if_create(
+            &ctx->ast_arena,
+            srcrange_including(keyw_pos, end_pos),
+            c_ast_expr_create_exprs(&ctx->ast_arena, cond),
+            body,
+            else_body
+        )
     );
 }
 
@@ -1714,19 +2177,24 @@ static c_ast_stmt_t *c_parse2_if(c_parser_t *ctx) {
 static c_ast_stmt_t *c_parse2_goto(c_parser_t *ctx) {
     token_t keyw = tkn_next(ctx->tkn_ctx);
     assert(keyw.type == TOKENTYPE_KEYWORD && keyw.subtype == C_KEYW_goto);
-    pos_t keyw_pos = keyw.pos;
+    srcrange_t keyw_pos = srcrange_from_pos(keyw.pos);
     tkn_delete(keyw);
 
     token_t peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_IDENT) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected identifier");
-        return c_ast_stmt_create_garbage(c_ast_garbage_create(keyw_pos));
+        return c_ast_stmt_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, keyw_pos));
     }
 
     token_t            ident  = tkn_next(ctx->tkn_ctx);
     c_ast_stmt_goto_t *s_goto = c_ast_stmt_goto_create(
-        pos_including(keyw_pos, ident.pos),
-        c_ast_ident_create(ident.pos, lilycc_strdup(ident.strval))
+        &ctx->ast_arena,
+        srcrange_including(keyw_pos, srcrange_from_pos(ident.pos)),
+        c_ast_ident_create(
+            &ctx->ast_arena,
+            srcrange_from_pos(ident.pos),
+            arena_strndup(&ctx->ast_arena, ident.strval, ident.strval_len)
+        )
     );
     tkn_delete(ident);
 
@@ -1737,7 +2205,7 @@ static c_ast_stmt_t *c_parse2_goto(c_parser_t *ctx) {
         cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected ;");
     }
 
-    return c_ast_stmt_create_goto(s_goto);
+    return c_ast_stmt_create_goto(&ctx->ast_arena, s_goto);
 }
 
 // Parse a return statement.
@@ -1746,33 +2214,32 @@ static c_ast_stmt_t *c_parse2_return(c_parser_t *ctx) {
 
     token_t keyw = tkn_next(ctx->tkn_ctx);
     assert(keyw.type == TOKENTYPE_KEYWORD && keyw.subtype == C_KEYW_return);
-    pos_t keyw_pos = keyw.pos;
-    pos_t pos      = keyw_pos;
+    srcrange_t pos = srcrange_from_pos(keyw.pos);
     tkn_delete(keyw);
     token_t peek = tkn_peek(ctx->tkn_ctx);
     if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_SEMIC) {
         expr = c_parse2_exprs(ctx);
         peek = tkn_peek(ctx->tkn_ctx);
         if (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_SEMIC) {
-            pos = pos_between(pos, peek.pos);
+            pos = srcrange_between(pos, srcrange_from_pos(peek.pos));
             cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected ;");
             c_eat_delim(ctx->tkn_ctx, false);
         } else {
-            pos = pos_including(pos, peek.pos);
+            pos = srcrange_including(pos, srcrange_from_pos(peek.pos));
             tkn_delete(tkn_next(ctx->tkn_ctx));
         }
     } else {
         tkn_delete(tkn_next(ctx->tkn_ctx));
     }
 
-    return c_ast_stmt_create_return(c_ast_stmt_return_create(pos, expr));
+    return c_ast_stmt_create_return(&ctx->ast_arena, c_ast_stmt_return_create(&ctx->ast_arena, pos, expr));
 }
 
 // Parse a default-labelled statement.
 static c_ast_stmt_t *c_parse2_default(c_parser_t *ctx) {
     token_t keyw = tkn_next(ctx->tkn_ctx);
     assert(keyw.type == TOKENTYPE_KEYWORD && keyw.subtype == C_KEYW_default);
-    pos_t keyw_pos = keyw.pos;
+    srcrange_t keyw_pos = srcrange_from_pos(keyw.pos);
     tkn_delete(keyw);
 
     token_t peek = tkn_peek(ctx->tkn_ctx);
@@ -1783,8 +2250,10 @@ static c_ast_stmt_t *c_parse2_default(c_parser_t *ctx) {
     }
 
     c_ast_stmt_t *inner = c_parse2_stmt(ctx);
-    c_ast_stmt_t *res
-        = c_ast_stmt_create_case(c_ast_stmt_case_create(pos_including(keyw_pos, inner->pos), NULL, NULL, inner));
+    c_ast_stmt_t *res = c_ast_stmt_create_case(
+        &ctx->ast_arena,
+        c_ast_stmt_case_create(&ctx->ast_arena, srcrange_including(keyw_pos, inner->pos), NULL, NULL, inner)
+    );
 
     return res;
 }
@@ -1802,11 +2271,19 @@ static c_ast_stmt_t *c_parse2_label(c_parser_t *ctx) {
     }
 
     c_ast_stmt_t *inner = c_parse2_stmt(ctx);
-    c_ast_stmt_t *res   = c_ast_stmt_create_label(c_ast_stmt_label_create(
-        pos_including(ident.pos, inner->pos),
-        c_ast_ident_create(ident.pos, lilycc_strdup(ident.strval)),
-        inner
-    ));
+    c_ast_stmt_t *res   = c_ast_stmt_create_label(
+        &ctx->ast_arena,
+        c_ast_stmt_label_create(
+            &ctx->ast_arena,
+            srcrange_including(srcrange_from_pos(ident.pos), inner->pos),
+            c_ast_ident_create(
+                &ctx->ast_arena,
+                srcrange_from_pos(ident.pos),
+                arena_strndup(&ctx->ast_arena, ident.strval, ident.strval_len)
+            ),
+            inner
+        )
+    );
 
     tkn_delete(ident);
     return res;
@@ -1816,7 +2293,10 @@ static c_ast_stmt_t *c_parse2_label(c_parser_t *ctx) {
 static c_ast_stmt_t *c_parse2_break(c_parser_t *ctx) {
     token_t keyw = tkn_next(ctx->tkn_ctx);
     assert(keyw.type == TOKENTYPE_KEYWORD && (keyw.subtype == C_KEYW_break || keyw.subtype == C_KEYW_continue));
-    c_ast_stmt_t *res = c_ast_stmt_create_break(c_ast_stmt_break_create(keyw.pos, keyw.subtype == C_KEYW_continue));
+    c_ast_stmt_t *res = c_ast_stmt_create_break(
+        &ctx->ast_arena,
+        c_ast_stmt_break_create(&ctx->ast_arena, srcrange_from_pos(keyw.pos), keyw.subtype == C_KEYW_continue)
+    );
     tkn_delete(keyw);
 
     token_t peek = tkn_peek(ctx->tkn_ctx);
@@ -1839,15 +2319,18 @@ c_ast_stmt_t *c_parse2_stmt(c_parser_t *ctx) {
     } else if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_SEMIC) {
         // No-op statement.
         tkn_delete(tkn_next(ctx->tkn_ctx));
-        return c_ast_stmt_create_nop(c_ast_stmt_nop_create(peek.pos));
+        return c_ast_stmt_create_nop(
+            &ctx->ast_arena,
+            c_ast_stmt_nop_create(&ctx->ast_arena, srcrange_from_pos(peek.pos))
+        );
     } else if (peek.type == TOKENTYPE_OTHER && peek.subtype == C_TKN_LCURL) {
         // Multi-statement parser will always continue until RCRUL token.
         tkn_delete(tkn_next(ctx->tkn_ctx));
         c_ast_stmt_list_t *stmts = c_parse2_stmts(ctx);
         tkn_delete(tkn_next(ctx->tkn_ctx));
-        return c_ast_stmt_create_stmts(stmts);
+        return c_ast_stmt_create_stmts(&ctx->ast_arena, stmts);
     } else if (is_spec_qual_list_tkn(ctx, peek)) {
-        return c_ast_stmt_create_def(c_parse2_def(ctx, false));
+        return c_ast_stmt_create_def(&ctx->ast_arena, c_parse2_def(ctx, false));
     } else if (peek.type == TOKENTYPE_KEYWORD) {
         switch (peek.subtype) {
             case C_KEYW_break:
@@ -1864,9 +2347,9 @@ c_ast_stmt_t *c_parse2_stmt(c_parser_t *ctx) {
             default: {
                 cctx_diagnostic(ctx->tkn_ctx->cctx, peek.pos, DIAG_ERR, "Expected a statement");
                 c_eat_delim(ctx->tkn_ctx, false);
-                pos_t pos = peek.pos;
-                pos.len   = 0;
-                return c_ast_stmt_create_garbage(c_ast_garbage_create(pos));
+                srcrange_t pos = srcrange_from_pos(peek.pos);
+                pos.len        = 0;
+                return c_ast_stmt_create_garbage(&ctx->ast_arena, c_ast_garbage_create(&ctx->ast_arena, pos));
             }
         }
     } else {
@@ -1878,7 +2361,7 @@ c_ast_stmt_t *c_parse2_stmt(c_parser_t *ctx) {
         } else {
             tkn_delete(tkn_next(ctx->tkn_ctx));
         }
-        return c_ast_stmt_create_expr(expr);
+        return c_ast_stmt_create_expr(&ctx->ast_arena, expr);
     }
 }
 
@@ -1886,16 +2369,16 @@ c_ast_stmt_t *c_parse2_stmt(c_parser_t *ctx) {
 c_ast_stmt_list_t *c_parse2_stmts(c_parser_t *ctx) {
     vec_c_ast_stmt_t args = {0};
 
-    token_t peek = tkn_peek(ctx->tkn_ctx);
-    pos_t   pos  = peek.pos;
-    pos.len      = 0;
+    token_t    peek = tkn_peek(ctx->tkn_ctx);
+    srcrange_t pos  = srcrange_from_pos(peek.pos);
+    pos.len         = 0;
     while (peek.type != TOKENTYPE_EOF && (peek.type != TOKENTYPE_OTHER || peek.subtype != C_TKN_RCURL)) {
         vec_push(&args, c_parse2_stmt(ctx));
-        pos  = pos_including(pos, args.arr[args.len - 1]->pos);
+        pos  = srcrange_including(pos, args.arr[args.len - 1]->pos);
         peek = tkn_peek(ctx->tkn_ctx);
     }
 
-    return c_ast_stmt_list_create(pos, args);
+    return c_ast_stmt_list_create(&ctx->ast_arena, pos, args);
 }
 
 
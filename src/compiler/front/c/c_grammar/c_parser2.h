@@ -13,7 +13,16 @@
 
 
 // Parse a whole translation unit (all global declarations until EOF).
-c_ast_def_list_t *c_parse2(c_parser_t *ctx);
+c_ast_def_list_t  *c_parse2(c_parser_t *ctx);
+// Parse a whole translation unit like `c_parse2`, but parse the function bodies in it on up to `jobs` threads.
+// The result and diagnostics are the same as those of `c_parse2` unless a function body has syntax errors.
+c_ast_def_list_t  *c_parse2_parallel(c_parser_t *ctx, size_t jobs);
+// Parse a whole translation unit like `c_parse2`, but skip function bodies until `c_parse2_body` is called for them.
+c_ast_def_list_t  *c_parse2_lazy(c_parser_t *ctx);
+// Get the body of a function definition, parsing it first if `c_parse2_lazy` skipped it.
+c_ast_stmt_list_t *c_parse2_body(c_parser_t *ctx, c_ast_def_func_t const *func);
+// Free the function bodies that were skipped and not parsed.
+void               c_parse2_clear_deferred(c_parser_t *ctx);
 
 // Parse a compound initializer.
 c_ast_init_list_t      *c_parse2_comp_init(c_parser_t *ctx);
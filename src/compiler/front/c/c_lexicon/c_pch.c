@@ -0,0 +1,1205 @@
+// SPDX-FileCopyrightText: 2026 Julian Scheffers <julian@scheffers.net>
+// SPDX-FileType: SOURCE
+// SPDX-License-Identifier: MIT
+
+#include "c_pch.h"
+
+#include "c_tokenizer.h"
+#include "lilycc_malloc.h"
+#include "map.h"
+#include "set.h"
+#include "vec.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef SRCFILE_USE_MMAP
+#include <sys/mman.h>
+#endif
+
+#ifdef _POSIX_C_SOURCE
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+
+// Magic bytes at the start of a precompiled header; the last character is the format version.
+#define PCH_MAGIC "LILYPCH3"
+// Magic bytes at the start of a token cache file; the last character is the format version.
+#define TKC_MAGIC "LILYTKC1"
+
+// Token flag: the token has a `strval`.
+#define PCH_TKN_STRVAL   0x01
+// Token flag: the token's `strval` is interned.
+#define PCH_TKN_INTERNED 0x02
+// Token flag: the token has a nonzero `ival` or `ivalh`; only used in token caches.
+#define PCH_TKN_IVAL     0x04
+// Token flag: the token's `strval` is its source text, so it isn't stored; only used in token caches.
+#define PCH_TKN_SRCTEXT  0x08
+
+// Macro flag: function-like macro.
+#define PCH_MACRO_ARGS     0x01
+// Macro flag: variadic macro.
+#define PCH_MACRO_VARIADIC 0x02
+
+// File flag: the file executed `#pragma once`.
+#define PCH_FILE_ONCE 0x01
+// File flag: tokens were read from the file, as opposed to it only being probed by `__has_include`.
+#define PCH_FILE_READ 0x02
+
+
+
+// What the file table records about a file to tell whether it changed.
+typedef struct {
+    // Modification time in seconds, or a hash of the content where `stat` isn't available.
+    uint64_t mtime;
+    // Nanoseconds part of the modification time, or 0 where it isn't available.
+    uint64_t mtime_ns;
+    // Size in bytes.
+    uint64_t size;
+} pch_stamp_t;
+
+// State used while writing a precompiled header.
+typedef struct {
+    // Header, file table, macro table and replayed tokens.
+    vec_char_t        head;
+    // Macro bodies, referred to by offset from the macro table.
+    vec_char_t        bodies;
+    // Source files that positions refer to.
+    srcfile_t *const *files;
+    // Number of `files`.
+    size_t            files_len;
+} pch_writer_t;
+
+// Cursor used while reading a precompiled header.
+typedef struct {
+    // Data to read from.
+    uint8_t const *data;
+    // Size of `data` in bytes.
+    size_t         len;
+    // Current read offset.
+    size_t         off;
+    // Set when trying to read past the end of `data`.
+    bool           error;
+} pch_reader_t;
+
+// File table entry read from a precompiled header.
+typedef struct {
+    // NUL-terminated path.
+    char       *path;
+    // `PCH_FILE_*` flags.
+    uint8_t     flags;
+    // Include guard macro name, if any.
+    char const *guard;
+    // Length of `guard`.
+    size_t      guard_len;
+} pch_file_ent_t;
+
+// Macro table entry read from a precompiled header.
+typedef struct {
+    // Macro name.
+    char const *name;
+    // Length of `name`.
+    size_t      name_len;
+    // `PCH_MACRO_*` flags.
+    uint8_t     flags;
+    // Offset of the body from the start of the bodies.
+    uint64_t    body_off;
+} pch_macro_ent_t;
+
+// Tokenizer that decodes the tokens of a file from its token cache data.
+typedef struct {
+    // Common tokenizer data.
+    tokenizer_t  base;
+    // Token cache data; either memory-mapped or heap-allocated.
+    pch_reader_t rd;
+    // `rd.data` is memory-mapped (as opposed to heap-allocated).
+    bool         mapped;
+    // The EOF token was reached.
+    bool         done;
+    // Position of the previous token, which the next one is relative to.
+    pos_t        prev;
+    // Interned identifiers that tokens refer to by index.
+    char const **idents;
+    // Number of `idents`.
+    size_t       idents_len;
+} tkc_tokenizer_t;
+
+// State used while encoding token cache data.
+typedef struct {
+    // Encoded tokens.
+    vec_char_t tokens;
+    // Identifier table; length-prefixed strings.
+    vec_char_t idents;
+    // Number of strings in `idents`.
+    size_t     idents_len;
+    // Index plus one in `idents` of each interned string that was already added.
+    map_t      ident_index;
+    // Position of the previous token, which the next one is stored relative to.
+    pos_t      prev;
+} tkc_writer_t;
+
+VEC_TYPE_DEF(vec_pch_file_ent_t, pch_file_ent_t)
+VEC_TYPE_DEF(vec_pch_macro_ent_t, pch_macro_ent_t)
+
+
+
+#pragma region files
+
+// Read an entire file into memory; maps it if possible, otherwise reads it in one go.
+// `*mapped_out` tells whether the data must be released with `munmap` rather than `lilycc_free`; see `pch_free_file`.
+static bool pch_read_file(char const *path, uint8_t const **data_out, size_t *len_out, bool *mapped_out) {
+    FILE *fd = fopen(path, "rb");
+    if (!fd) {
+        return false;
+    }
+#ifdef SRCFILE_USE_MMAP
+    struct stat statbuf;
+    if (!fstat(fileno(fd), &statbuf) && S_ISREG(statbuf.st_mode) && statbuf.st_size > 0) {
+        void *mem = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fileno(fd), 0);
+        if (mem != MAP_FAILED) {
+            fclose(fd);
+            *data_out   = mem;
+            *len_out    = statbuf.st_size;
+            *mapped_out = true;
+            return true;
+        }
+    }
+#endif
+
+    vec_uint8_t buf = {0};
+    while (1) {
+        vec_reserve(&buf, 4096);
+        size_t n  = fread(buf.arr + buf.len, 1, buf.cap - buf.len, fd);
+        buf.len  += n;
+        if (n == 0) {
+            break;
+        }
+    }
+    bool ok = !ferror(fd);
+    fclose(fd);
+    if (!ok) {
+        vec_clear(&buf);
+        return false;
+    }
+    *data_out   = buf.arr;
+    *len_out    = buf.len;
+    *mapped_out = false;
+    return true;
+}
+
+// Release file data returned by `pch_read_file`.
+static void pch_free_file(uint8_t const *data, size_t len, bool mapped) {
+#ifdef SRCFILE_USE_MMAP
+    if (mapped) {
+        munmap((void *)data, len);
+        return;
+    }
+#else
+    (void)len;
+    (void)mapped;
+#endif
+    lilycc_free((void *)data);
+}
+
+// Get the stamp of a file on disk for the file table of a precompiled header.
+static bool pch_file_stamp(char const *path, pch_stamp_t *stamp) {
+#ifdef SRCFILE_CHECK_INO
+    struct stat statbuf;
+    if (stat(path, &statbuf)) {
+        return false;
+    }
+    stamp->mtime = statbuf.st_mtime;
+#if _POSIX_C_SOURCE >= 200809L
+    stamp->mtime_ns = statbuf.st_mtim.tv_nsec;
+#else
+    stamp->mtime_ns = 0;
+#endif
+    stamp->size = statbuf.st_size;
+    return true;
+#else
+    // No modification times without `stat`; hash the content instead (64-bit FNV-1a).
+    uint8_t const *data;
+    size_t         len;
+    bool           mapped;
+    if (!pch_read_file(path, &data, &len, &mapped)) {
+        return false;
+    }
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3;
+    }
+    pch_free_file(data, len, mapped);
+    stamp->mtime    = hash;
+    stamp->mtime_ns = 0;
+    stamp->size     = len;
+    return true;
+#endif
+}
+
+#pragma endregion files
+
+
+
+#pragma region writing
+
+// Append raw bytes.
+static void pch_put(vec_char_t *out, void const *data, size_t len) {
+    vec_reserve(out, len);
+    memcpy(out->arr + out->len, data, len);
+    out->len += len;
+}
+
+// Append an 8-bit integer.
+static void pch_put_u8(vec_char_t *out, uint8_t val) {
+    pch_put(out, &val, sizeof(val));
+}
+
+// Append a 32-bit integer.
+static void pch_put_u32(vec_char_t *out, uint32_t val) {
+    pch_put(out, &val, sizeof(val));
+}
+
+// Append a 64-bit integer.
+static void pch_put_u64(vec_char_t *out, uint64_t val) {
+    pch_put(out, &val, sizeof(val));
+}
+
+// Append a length-prefixed string.
+static void pch_put_str(vec_char_t *out, char const *str, size_t len) {
+    pch_put_u32(out, len);
+    pch_put(out, str, len);
+}
+
+// Append a position as a file index (0 for none) and the position in that file.
+static void pch_put_pos(vec_char_t *out, pch_writer_t const *wr, pos_t pos) {
+    uint32_t file = 0;
+    for (size_t i = 0; pos.srcfile && i < wr->files_len; i++) {
+        if (wr->files[i] == pos.srcfile) {
+            file = i + 1;
+            break;
+        }
+    }
+    pch_put_u32(out, file);
+    pch_put_u64(out, pos.off);
+    pch_put_u32(out, pos.line);
+    pch_put_u32(out, pos.col);
+    pch_put_u64(out, pos.len);
+}
+
+// Append a preprocessing token.
+static void pch_put_token(vec_char_t *out, pch_writer_t const *wr, token_t const *tkn) {
+    assert(tkn->params_len == 0);
+    uint8_t flags = 0;
+    if (tkn->strval) {
+        flags |= PCH_TKN_STRVAL;
+    }
+    if (tkn->strval_interned) {
+        flags |= PCH_TKN_INTERNED;
+    }
+    pch_put_pos(out, wr, tkn->pos);
+    pch_put_u8(out, tkn->type);
+    pch_put_u8(out, flags);
+    pch_put_u32(out, tkn->subtype);
+    pch_put_u64(out, tkn->ival);
+    pch_put_u64(out, tkn->ivalh);
+    if (tkn->strval) {
+        pch_put_str(out, tkn->strval, tkn->strval_len);
+    }
+}
+
+// Append an array of preprocessing tokens.
+static void pch_put_tokens(vec_char_t *out, pch_writer_t const *wr, token_t const *tokens, size_t len) {
+    pch_put_u32(out, len);
+    for (size_t i = 0; i < len; i++) {
+        pch_put_token(out, wr, &tokens[i]);
+    }
+}
+
+// Append the argument names and substitutions of a regular macro.
+static void pch_put_macro_body(vec_char_t *out, pch_writer_t const *wr, c_macro_t const *macro) {
+    pch_put_u32(out, macro->regular.args.len);
+    for (size_t i = 0; i < macro->regular.args.len; i++) {
+        pch_put_str(out, macro->regular.args.arr[i], strlen(macro->regular.args.arr[i]));
+    }
+    pch_put_u32(out, macro->regular.subst.len);
+    for (size_t i = 0; i < macro->regular.subst.len; i++) {
+        c_macro_subst_t const *subst = &macro->regular.subst.arr[i];
+        pch_put_u8(out, subst->type);
+        pch_put_u8(out, subst->stringize);
+        pch_put_u8(out, subst->pasting);
+        switch (subst->type) {
+            case C_SUBST_TOKEN: pch_put_token(out, wr, &subst->token); break;
+            case C_SUBST_ARG: pch_put_u32(out, subst->arg_index); break;
+            case C_SUBST_VA_ARGS: break;
+            case C_SUBST_VA_OPT:
+                pch_put_pos(out, wr, subst->va_opt.pos);
+                pch_put_tokens(out, wr, subst->va_opt.tokens.arr, subst->va_opt.tokens.len);
+                for (size_t j = 0; j < subst->va_opt.tokens.len; j++) {
+                    pch_put_u8(out, subst->va_opt.ws_before.arr[j]);
+                }
+                break;
+        }
+    }
+}
+
+// Append the C options that affect preprocessing.
+static void pch_put_options(vec_char_t *out, c_options_t const *options, bool keep_comments) {
+    uint32_t flags = options->gnu_ext_enable | options->char_is_signed << 1 | options->short16 << 2
+                     | options->int32 << 3 | options->long64 << 4 | options->big_endian << 5 | keep_comments << 6;
+    pch_put_u32(out, options->c_std);
+    pch_put_u32(out, flags);
+    pch_put_u32(out, options->size_type);
+}
+
+// Append the directories that are searched for include files, in order.
+static void pch_put_include_dirs(vec_char_t *out, c_preproc_shared_t const *shared) {
+    pch_put_u32(out, shared->include_dirs_len);
+    for (size_t i = 0; i < shared->include_dirs_len; i++) {
+        pch_put_str(out, shared->include_dirs[i], strlen(shared->include_dirs[i]));
+    }
+}
+
+// Write the state of a preprocessor that has run to EOF, along with the tokens it emitted, to a precompiled header.
+static bool pch_write(c_preproc_t *pre, vec_token_t const *tokens, char const *pch_path) {
+    cctx_t      *cctx = pre->shared->cctx;
+    pch_writer_t wr   = {
+          .files     = cctx->srcs,
+          .files_len = cctx->srcs_len,
+    };
+
+    pch_put(&wr.head, PCH_MAGIC, 8);
+    pch_put_options(&wr.head, pre->shared->options, pre->keep_comments);
+    pch_put_include_dirs(&wr.head, pre->shared);
+    pch_put_u64(&wr.head, pre->shared->counter_macro);
+
+    // Files that went into the header, so they can be checked for changes.
+    set_t read = PTR_SET_EMPTY;
+    for (size_t i = 0; i < pre->shared->read_files.len; i++) {
+        set_add(&read, pre->shared->read_files.arr[i]);
+    }
+    pch_put_u32(&wr.head, wr.files_len);
+    for (size_t i = 0; i < wr.files_len; i++) {
+        srcfile_t  *file = wr.files[i];
+        pch_stamp_t stamp;
+        if (file->is_ram_file || !pch_file_stamp(file->path, &stamp)) {
+            set_clear(&read);
+            vec_clear(&wr.head);
+            return false;
+        }
+        char const *guard = map_get(&pre->shared->guard_macros, file);
+        pch_put_str(&wr.head, file->path, strlen(file->path));
+        pch_put_u64(&wr.head, stamp.mtime);
+        pch_put_u64(&wr.head, stamp.mtime_ns);
+        pch_put_u64(&wr.head, stamp.size);
+        uint8_t flags = set_contains(&pre->shared->once_files, file) ? PCH_FILE_ONCE : 0;
+        if (set_contains(&read, file)) {
+            flags |= PCH_FILE_READ;
+        }
+        pch_put_u8(&wr.head, flags);
+        pch_put_str(&wr.head, guard ?: "", guard ? strlen(guard) : 0);
+    }
+    set_clear(&read);
+
+    // Macro table; the bodies are written separately so they can be loaded lazily.
+    size_t n_macros = 0;
+    map_foreach(ent, &pre->shared->macros) {
+        c_macro_t const *macro = ent->value;
+        n_macros              += !macro->is_builtin && !macro->is_proc_macro;
+    }
+    pch_put_u32(&wr.head, n_macros);
+    map_foreach(ent, &pre->shared->macros) {
+        c_macro_t const *macro = ent->value;
+        if (macro->is_builtin || macro->is_proc_macro) {
+            continue;
+        }
+        uint8_t flags = 0;
+        if (macro->uses_args) {
+            flags |= PCH_MACRO_ARGS;
+        }
+        if (macro->regular.is_variadic) {
+            flags |= PCH_MACRO_VARIADIC;
+        }
+        pch_put_str(&wr.head, ent->key, strlen(ent->key));
+        pch_put_u8(&wr.head, flags);
+        pch_put_u64(&wr.head, wr.bodies.len);
+        pch_put_macro_body(&wr.bodies, &wr, macro);
+    }
+
+    pch_put_tokens(&wr.head, &wr, tokens->arr, tokens->len);
+
+    // Write to a temporary file first so that concurrent compilations never see a partial file.
+    size_t tmp_cap  = strlen(pch_path) + 5;
+    char  *tmp_path = lilycc_malloc(tmp_cap);
+    snprintf(tmp_path, tmp_cap, "%s.tmp", pch_path);
+    uint64_t bodies_off = wr.head.len + sizeof(uint64_t);
+    FILE    *fd         = fopen(tmp_path, "wb");
+    bool     ok         = fd && fwrite(wr.head.arr, 1, wr.head.len, fd) == wr.head.len
+                && fwrite(&bodies_off, sizeof(bodies_off), 1, fd) == 1
+                && fwrite(wr.bodies.arr, 1, wr.bodies.len, fd) == wr.bodies.len;
+    if (fd) {
+        ok &= !fclose(fd);
+    }
+    ok = ok && !rename(tmp_path, pch_path);
+    if (!ok) {
+        remove(tmp_path);
+    }
+
+    lilycc_free(tmp_path);
+    vec_clear(&wr.head);
+    vec_clear(&wr.bodies);
+    return ok;
+}
+
+// Preprocess `header` and write the resulting preprocessor state to a precompiled header at `pch_path`.
+// Include files are searched for in `include_dirs`, like `c_preproc_shared_t::include_dirs`.
+// Diagnostics in the header are printed to stderr; returns false if it had errors or `pch_path` can't be written.
+bool c_pch_create(
+    c_options_t const *options, char const *const *include_dirs, size_t include_dirs_len, char const *header,
+    char const *pch_path, bool keep_comments
+) {
+    cctx_t    *cctx = cctx_create();
+    srcfile_t *src  = srcfile_open(cctx, header);
+    if (!src) {
+        perror(header);
+        cctx_delete(cctx);
+        return false;
+    }
+    c_preproc_t *pre = c_preproc_create(src, options, true, keep_comments);
+    if (!pre) {
+        cctx_delete(cctx);
+        return false;
+    }
+    pre->shared->include_dirs     = include_dirs;
+    pre->shared->include_dirs_len = include_dirs_len;
+
+    // Tokens are stored the way they come out of the preprocessor in raw mode, so they can be replayed in either mode.
+    vec_token_t tokens = {0};
+    while (1) {
+        token_t tkn = c_preproc_next(&pre->base);
+        if (tkn.type == TOKENTYPE_EOF) {
+            tkn_delete(tkn);
+            break;
+        }
+        vec_push(&tokens, tkn);
+    }
+
+    bool                ok   = true;
+    diagnostic_t const *diag = (diagnostic_t const *)cctx->diagnostics.head;
+    while (diag) {
+        ok &= diag->lvl != DIAG_ERR;
+        print_diagnostic(diag, stderr);
+        diag = (diagnostic_t const *)diag->node.next;
+    }
+    if (ok && !pch_write(pre, &tokens, pch_path)) {
+        perror(pch_path);
+        ok = false;
+    }
+
+    for (size_t i = 0; i < tokens.len; i++) {
+        tkn_delete(tokens.arr[i]);
+    }
+    vec_clear(&tokens);
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+    return ok;
+}
+
+#pragma endregion writing
+
+
+
+#pragma region reading
+
+// Read raw bytes; returns NULL and sets `error` if there are not enough left.
+static uint8_t const *pch_get(pch_reader_t *rd, size_t len) {
+    if (rd->error || len > rd->len - rd->off) {
+        rd->error = true;
+        return NULL;
+    }
+    uint8_t const *ptr  = rd->data + rd->off;
+    rd->off            += len;
+    return ptr;
+}
+
+// Read an 8-bit integer.
+static uint8_t pch_get_u8(pch_reader_t *rd) {
+    uint8_t const *ptr = pch_get(rd, sizeof(uint8_t));
+    return ptr ? *ptr : 0;
+}
+
+// Read a 32-bit integer.
+static uint32_t pch_get_u32(pch_reader_t *rd) {
+    uint32_t       val = 0;
+    uint8_t const *ptr = pch_get(rd, sizeof(val));
+    if (ptr) {
+        memcpy(&val, ptr, sizeof(val));
+    }
+    return val;
+}
+
+// Read a 64-bit integer.
+static uint64_t pch_get_u64(pch_reader_t *rd) {
+    uint64_t       val = 0;
+    uint8_t const *ptr = pch_get(rd, sizeof(val));
+    if (ptr) {
+        memcpy(&val, ptr, sizeof(val));
+    }
+    return val;
+}
+
+// Read a length-prefixed string; the result is not NUL-terminated.
+static char const *pch_get_str(pch_reader_t *rd, size_t *len_out) {
+    *len_out = pch_get_u32(rd);
+    return (char const *)pch_get(rd, *len_out);
+}
+
+// Read a position.
+static pos_t pch_get_pos(pch_reader_t *rd, c_pch_t const *pch) {
+    uint32_t file = pch_get_u32(rd);
+    pos_t    pos  = {
+            .srcfile = file && file <= pch->files_len ? pch->files[file - 1] : NULL,
+            .off     = (off_t)pch_get_u64(rd),
+            .line    = (int)pch_get_u32(rd),
+            .col     = (int)pch_get_u32(rd),
+            .len     = (off_t)pch_get_u64(rd),
+    };
+    return pos;
+}
+
+// Set the `strval` of a token read from a file; it is interned or copied to the token arena depending on `flags`.
+static void pch_set_strval(token_t *tkn, cctx_t *cctx, uint8_t flags, char const *str, size_t len) {
+    if (!str) {
+        return;
+    } else if (flags & PCH_TKN_INTERNED) {
+        tkn->strval          = (char *)strpool_intern(&cctx->idents, str, len);
+        tkn->strval_interned = true;
+    } else {
+        tkn->strval          = tkn_arena_strval(cctx, str, len);
+        tkn->strval_borrowed = true;
+    }
+    tkn->strval_len = len;
+}
+
+// Read a preprocessing token; strings are interned or copied to the token arena.
+static token_t pch_get_token(pch_reader_t *rd, c_pch_t const *pch, cctx_t *cctx) {
+    token_t tkn   = {.pos = pch_get_pos(rd, pch)};
+    tkn.type      = pch_get_u8(rd);
+    uint8_t flags = pch_get_u8(rd);
+    tkn.subtype   = (int)pch_get_u32(rd);
+    tkn.ival      = pch_get_u64(rd);
+    tkn.ivalh     = pch_get_u64(rd);
+    if (flags & PCH_TKN_STRVAL) {
+        size_t      len;
+        char const *str = pch_get_str(rd, &len);
+        pch_set_strval(&tkn, cctx, flags, str, len);
+    }
+    return tkn;
+}
+
+// Read an array of preprocessing tokens.
+static vec_token_t pch_get_tokens(pch_reader_t *rd, c_pch_t const *pch, cctx_t *cctx) {
+    vec_token_t tokens = {0};
+    uint32_t    len    = pch_get_u32(rd);
+    for (uint32_t i = 0; i < len && !rd->error; i++) {
+        vec_push(&tokens, pch_get_token(rd, pch, cctx));
+    }
+    return tokens;
+}
+
+// Read and compare the C options and include directories that affect preprocessing.
+static bool pch_check_options(pch_reader_t *rd, c_preproc_shared_t const *shared, bool keep_comments) {
+    vec_char_t expect = {0};
+    pch_put_options(&expect, shared->options, keep_comments);
+    pch_put_include_dirs(&expect, shared);
+    uint8_t const *actual = pch_get(rd, expect.len);
+    bool           ok     = actual && !memcmp(actual, expect.arr, expect.len);
+    vec_clear(&expect);
+    return ok;
+}
+
+// Free the file table read from a precompiled header.
+static void pch_files_clear(vec_pch_file_ent_t *files) {
+    for (size_t i = 0; i < files->len; i++) {
+        lilycc_free(files->arr[i].path);
+    }
+    vec_clear(files);
+}
+
+// Read the file table and check that none of the files changed since the precompiled header was created.
+static bool pch_get_files(pch_reader_t *rd, vec_pch_file_ent_t *files) {
+    uint32_t len = pch_get_u32(rd);
+    for (uint32_t i = 0; i < len && !rd->error; i++) {
+        size_t      path_len;
+        char const *path  = pch_get_str(rd, &path_len);
+        pch_stamp_t saved;
+        saved.mtime       = pch_get_u64(rd);
+        saved.mtime_ns    = pch_get_u64(rd);
+        saved.size        = pch_get_u64(rd);
+        uint8_t     flags = pch_get_u8(rd);
+        size_t      guard_len;
+        char const *guard = pch_get_str(rd, &guard_len);
+        if (rd->error) {
+            return false;
+        }
+
+        pch_file_ent_t ent = {
+            .path      = lilycc_malloc(path_len + 1),
+            .flags     = flags,
+            .guard     = guard_len ? guard : NULL,
+            .guard_len = guard_len,
+        };
+        memcpy(ent.path, path, path_len);
+        ent.path[path_len] = 0;
+        vec_push(files, ent);
+
+        pch_stamp_t stamp;
+        if (!pch_file_stamp(ent.path, &stamp) || stamp.mtime != saved.mtime || stamp.mtime_ns != saved.mtime_ns
+            || stamp.size != saved.size) {
+            return false;
+        }
+    }
+    return !rd->error;
+}
+
+// Read the macro table.
+static bool pch_get_macros(pch_reader_t *rd, vec_pch_macro_ent_t *macros) {
+    uint32_t len = pch_get_u32(rd);
+    for (uint32_t i = 0; i < len && !rd->error; i++) {
+        pch_macro_ent_t ent;
+        ent.name     = pch_get_str(rd, &ent.name_len);
+        ent.flags    = pch_get_u8(rd);
+        ent.body_off = pch_get_u64(rd);
+        vec_push(macros, ent);
+    }
+    return !rd->error;
+}
+
+// Load a precompiled header into a root preprocessor that has not emitted any tokens yet.
+// Returns false without loading anything if the file is missing, malformed, was created with different options or
+// include directories, or if any of the files that went into it changed since.
+bool c_pch_load(c_preproc_t *pre, char const *pch_path) {
+    c_preproc_shared_t *shared = pre->shared;
+    if (shared->pch) {
+        return false;
+    }
+
+    c_pch_t *pch = lilycc_calloc(1, sizeof(c_pch_t));
+    if (!pch_read_file(pch_path, &pch->data, &pch->len, &pch->mapped)) {
+        lilycc_free(pch);
+        return false;
+    }
+
+    pch_reader_t        rd      = {.data = pch->data, .len = pch->len};
+    vec_pch_file_ent_t  files   = {0};
+    vec_pch_macro_ent_t macros  = {0};
+    vec_token_t         tokens  = {0};
+    uint8_t const      *magic   = pch_get(&rd, 8);
+    bool                ok      = magic && !memcmp(magic, PCH_MAGIC, 8);
+    ok                          = ok && pch_check_options(&rd, shared, pre->keep_comments);
+    uint64_t            counter = pch_get_u64(&rd);
+    ok                          = ok && pch_get_files(&rd, &files) && pch_get_macros(&rd, &macros);
+
+    if (ok) {
+        // Positions in the precompiled header refer to these files, so they need to be opened.
+        pch->files     = lilycc_calloc(files.len ?: 1, sizeof(srcfile_t *));
+        pch->files_len = files.len;
+        for (size_t i = 0; ok && i < files.len; i++) {
+            pch->files[i] = srcfile_open(shared->cctx, files.arr[i].path);
+            ok            = pch->files[i] != NULL;
+        }
+    }
+    if (ok) {
+        tokens          = pch_get_tokens(&rd, pch, shared->cctx);
+        pch->bodies_off = pch_get_u64(&rd);
+        ok              = !rd.error && pch->bodies_off <= pch->len;
+        for (size_t i = 0; ok && i < macros.len; i++) {
+            ok = macros.arr[i].body_off < pch->len - pch->bodies_off;
+        }
+    }
+
+    if (!ok) {
+        for (size_t i = 0; i < tokens.len; i++) {
+            tkn_delete(tokens.arr[i]);
+        }
+        vec_clear(&tokens);
+        pch_files_clear(&files);
+        vec_clear(&macros);
+        c_pch_unload(pch);
+        return false;
+    }
+
+    // Everything checks out; apply the saved state.
+    shared->pch           = pch;
+    shared->counter_macro = counter;
+    for (size_t i = 0; i < files.len; i++) {
+        if (files.arr[i].flags & PCH_FILE_ONCE) {
+            set_add(&shared->once_files, pch->files[i]);
+        }
+        if (files.arr[i].flags & PCH_FILE_READ) {
+            vec_push(&shared->read_files, pch->files[i]);
+        }
+        if (files.arr[i].guard) {
+            char const *guard = strpool_intern(&shared->cctx->idents, files.arr[i].guard, files.arr[i].guard_len);
+            map_set(&shared->guard_macros, pch->files[i], guard);
+        }
+    }
+    for (size_t i = 0; i < macros.len; i++) {
+        c_macro_t *macro           = lilycc_calloc(1, sizeof(c_macro_t));
+        macro->uses_args           = macros.arr[i].flags & PCH_MACRO_ARGS;
+        macro->regular.is_variadic = macros.arr[i].flags & PCH_MACRO_VARIADIC;
+        macro->pch_body            = pch->data + pch->bodies_off + macros.arr[i].body_off;
+
+        char const *key      = strpool_intern(&shared->cctx->idents, macros.arr[i].name, macros.arr[i].name_len);
+        c_macro_t  *existing = map_get(&shared->macros, key);
+        if (existing) {
+            c_macro_destroy(existing);
+        }
+        map_set(&shared->macros, key, macro);
+        shared->macros_gen++;
+    }
+    pre->pch_tokens = tokens;
+    pre->pch_index  = 0;
+
+    pch_files_clear(&files);
+    vec_clear(&macros);
+    return true;
+}
+
+// Load the precompiled header for `header`, (re)creating it first if it is missing or out of date.
+// The precompiled header is stored next to `header`, with `.pch` appended to the name.
+bool c_pch_use(c_preproc_t *pre, char const *header) {
+    size_t path_cap = strlen(header) + 5;
+    char  *pch_path = lilycc_malloc(path_cap);
+    snprintf(pch_path, path_cap, "%s.pch", header);
+    bool ok = c_pch_load(pre, pch_path)
+              || (c_pch_create(
+                      pre->shared->options,
+                      pre->shared->include_dirs,
+                      pre->shared->include_dirs_len,
+                      header,
+                      pch_path,
+                      pre->keep_comments
+                  )
+                  && c_pch_load(pre, pch_path));
+    lilycc_free(pch_path);
+    return ok;
+}
+
+// Build the body of a macro that was loaded from a precompiled header.
+void c_pch_materialize(c_preproc_t *pre, c_macro_t *macro) {
+    c_pch_t const *pch  = pre->shared->pch;
+    cctx_t        *cctx = pre->shared->cctx;
+    pch_reader_t   rd   = {
+            .data = macro->pch_body,
+            .len  = pch->data + pch->len - macro->pch_body,
+    };
+    macro->pch_body = NULL;
+
+    uint32_t n_args = pch_get_u32(&rd);
+    for (uint32_t i = 0; i < n_args && !rd.error; i++) {
+        size_t      len;
+        char const *name = pch_get_str(&rd, &len);
+        if (name) {
+            char *arg = lilycc_malloc(len + 1);
+            memcpy(arg, name, len);
+            arg[len] = 0;
+            vec_push(&macro->regular.args, arg);
+        }
+    }
+
+    uint32_t n_subst = pch_get_u32(&rd);
+    for (uint32_t i = 0; i < n_subst && !rd.error; i++) {
+        c_macro_subst_t subst = {0};
+        subst.type            = pch_get_u8(&rd);
+        subst.stringize       = pch_get_u8(&rd);
+        subst.pasting         = pch_get_u8(&rd);
+        switch (subst.type) {
+            case C_SUBST_TOKEN: subst.token = pch_get_token(&rd, pch, cctx); break;
+            case C_SUBST_ARG:
+                subst.arg_index = pch_get_u32(&rd);
+                rd.error       |= subst.arg_index >= macro->regular.args.len;
+                break;
+            case C_SUBST_VA_ARGS: break;
+            case C_SUBST_VA_OPT:
+                subst.va_opt.pos    = pch_get_pos(&rd, pch);
+                subst.va_opt.tokens = pch_get_tokens(&rd, pch, cctx);
+                for (size_t j = 0; j < subst.va_opt.tokens.len; j++) {
+                    vec_push(&subst.va_opt.ws_before, pch_get_u8(&rd) != 0);
+                }
+                break;
+            default: rd.error = true; break;
+        }
+        if (rd.error) {
+            // Drop the incomplete substitution so the macro stays safe to expand.
+            if (subst.type == C_SUBST_TOKEN) {
+                tkn_delete(subst.token);
+            } else if (subst.type == C_SUBST_VA_OPT) {
+                for (size_t j = 0; j < subst.va_opt.tokens.len; j++) {
+                    tkn_delete(subst.va_opt.tokens.arr[j]);
+                }
+                vec_clear(&subst.va_opt.tokens);
+                vec_clear(&subst.va_opt.ws_before);
+            }
+            break;
+        }
+        vec_push(&macro->regular.subst, subst);
+    }
+
+    if (rd.error) {
+        cctx_diagnostic(cctx, (pos_t){0}, DIAG_ERR, "Corrupt precompiled header");
+    }
+}
+
+// Unmap a precompiled header and free its memory.
+void c_pch_unload(c_pch_t *pch) {
+    pch_free_file(pch->data, pch->len, pch->mapped);
+    lilycc_free(pch->files);
+    lilycc_free(pch);
+}
+
+#pragma endregion reading
+
+
+
+#pragma region token cache
+
+// Hash the contents of a source file and the options it is tokenized with, for use as the token cache key.
+static uint64_t tkc_hash(srcfile_t const *file, vec_char_t const *options) {
+    // 64-bit FNV-1a; `hash_mem` is too narrow to use as a file name without also risking collisions.
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < file->content_len; i++) {
+        hash = (hash ^ file->content[i]) * 0x100000001b3;
+    }
+    for (size_t i = 0; i < options->len; i++) {
+        hash = (hash ^ (uint8_t)options->arr[i]) * 0x100000001b3;
+    }
+    return hash;
+}
+
+// Append an unsigned LEB128 integer.
+static void tkc_put_uleb(vec_char_t *out, uint64_t val) {
+    do {
+        uint8_t byte   = val & 0x7f;
+        val          >>= 7;
+        pch_put_u8(out, byte | (val ? 0x80 : 0));
+    } while (val);
+}
+
+// Append a signed integer as a zigzag-encoded LEB128 integer.
+static void tkc_put_sleb(vec_char_t *out, int64_t val) {
+    tkc_put_uleb(out, ((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+}
+
+// Read an unsigned LEB128 integer.
+static inline uint64_t tkc_get_uleb(pch_reader_t *rd) {
+    // Reads the data directly; this is the hot path of replaying a token cache and most values fit in one byte.
+    if (rd->off < rd->len && rd->data[rd->off] < 0x80) {
+        return rd->data[rd->off++];
+    }
+    uint64_t val = 0;
+    for (int shift = 0; shift < 64 && rd->off < rd->len; shift += 7) {
+        uint8_t byte  = rd->data[rd->off++];
+        val          |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return val;
+        }
+    }
+    rd->error = true;
+    return 0;
+}
+
+// Read a zigzag-encoded LEB128 integer.
+static inline int64_t tkc_get_sleb(pch_reader_t *rd) {
+    uint64_t val = tkc_get_uleb(rd);
+    return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+// Append a token to token cache data.
+// Tokens of a file are contiguous, so positions are stored relative to the previous token.
+// Interned strings are stored once in the identifier table and referred to by index.
+static void tkc_put_token(tkc_writer_t *wr, token_t const *tkn) {
+    assert(tkn->params_len == 0);
+    uint8_t flags = 0;
+    if (tkn->strval) {
+        flags |= PCH_TKN_STRVAL;
+    }
+    if (tkn->strval_interned) {
+        flags |= PCH_TKN_INTERNED;
+    }
+    if (tkn->ival || tkn->ivalh) {
+        flags |= PCH_TKN_IVAL;
+    }
+    srcfile_t const *file = tkn->pos.srcfile;
+    if (tkn->strval && file && (size_t)tkn->pos.len == tkn->strval_len
+        && !memcmp(file->content + tkn->pos.off, tkn->strval, tkn->strval_len)) {
+        flags |= PCH_TKN_SRCTEXT;
+    }
+
+    vec_char_t *out        = &wr->tokens;
+    pos_t      *prev       = &wr->prev;
+    int         line_delta = tkn->pos.line - prev->line;
+    pch_put_u8(out, tkn->type);
+    pch_put_u8(out, flags);
+    tkc_put_uleb(out, tkn->subtype);
+    tkc_put_sleb(out, tkn->pos.off - (prev->off + prev->len));
+    tkc_put_sleb(out, line_delta);
+    tkc_put_sleb(out, tkn->pos.col - (line_delta ? 0 : prev->col + prev->len));
+    tkc_put_uleb(out, tkn->pos.len);
+    if (flags & PCH_TKN_IVAL) {
+        pch_put_u64(out, tkn->ival);
+        pch_put_u64(out, tkn->ivalh);
+    }
+    if (flags & PCH_TKN_INTERNED) {
+        size_t index = (size_t)map_get(&wr->ident_index, tkn->strval);
+        if (!index) {
+            pch_put_str(&wr->idents, tkn->strval, tkn->strval_len);
+            index = ++wr->idents_len;
+            map_set(&wr->ident_index, tkn->strval, (void *)index);
+        }
+        tkc_put_uleb(out, index - 1);
+    } else if (tkn->strval && !(flags & PCH_TKN_SRCTEXT)) {
+        tkc_put_uleb(out, tkn->strval_len);
+        pch_put(out, tkn->strval, tkn->strval_len);
+    }
+    *prev = tkn->pos;
+}
+
+// Read a token from token cache data.
+static inline token_t tkc_get_token(tkc_tokenizer_t *ctx) {
+    pch_reader_t *rd    = &ctx->rd;
+    pos_t        *prev  = &ctx->prev;
+    uint8_t       type  = pch_get_u8(rd);
+    uint8_t       flags = pch_get_u8(rd);
+    token_t       tkn   = {
+              .pos     = *prev,
+              .type    = type,
+              .subtype = (int)tkc_get_uleb(rd),
+    };
+
+    off_t off_delta   = (off_t)tkc_get_sleb(rd);
+    int   line_delta  = (int)tkc_get_sleb(rd);
+    tkn.pos.off      += prev->len + off_delta;
+    tkn.pos.line     += line_delta;
+    tkn.pos.col       = (int)tkc_get_sleb(rd) + (line_delta ? 0 : prev->col + prev->len);
+    tkn.pos.len       = (off_t)tkc_get_uleb(rd);
+    if (flags & PCH_TKN_IVAL) {
+        tkn.ival  = pch_get_u64(rd);
+        tkn.ivalh = pch_get_u64(rd);
+    }
+
+    if (tkn.pos.off < 0 || tkn.pos.len < 0 || (size_t)(tkn.pos.off + tkn.pos.len) > tkn.pos.srcfile->content_len) {
+        rd->error = true;
+    } else if (flags & PCH_TKN_INTERNED) {
+        uint64_t index = tkc_get_uleb(rd);
+        if (index < ctx->idents_len) {
+            tkn.strval          = (char *)ctx->idents[index];
+            tkn.strval_len      = strpool_ent(tkn.strval)->len;
+            tkn.strval_interned = true;
+        } else {
+            rd->error = true;
+        }
+    } else if (flags & PCH_TKN_SRCTEXT) {
+        // Like the tokenizer does, reference the source text directly instead of copying it.
+        tkn.strval          = (char *)tkn.pos.srcfile->content + tkn.pos.off;
+        tkn.strval_len      = tkn.pos.len;
+        tkn.strval_borrowed = true;
+    } else if (flags & PCH_TKN_STRVAL) {
+        size_t      len = tkc_get_uleb(rd);
+        char const *str = (char const *)pch_get(rd, len);
+        pch_set_strval(&tkn, ctx->base.cctx, flags, str, len);
+    }
+    *prev = tkn.pos;
+    return tkn;
+}
+
+// Get the path of the token cache file for a source file.
+static char *tkc_path(char const *dir, uint64_t hash) {
+    size_t cap  = strlen(dir) + 22;
+    char  *path = lilycc_malloc(cap);
+    snprintf(path, cap, "%s/%016" PRIx64 ".tkc", dir, hash);
+    return path;
+}
+
+// Next-token callback for `tkc_tokenizer_t`.
+static token_t tkc_next(tokenizer_t *tkn_ctx) {
+    tkc_tokenizer_t *ctx = (tkc_tokenizer_t *)tkn_ctx;
+    if (ctx->done) {
+        return (token_t){.pos = ctx->prev, .type = TOKENTYPE_EOF};
+    }
+    token_t tkn = tkc_get_token(ctx);
+    if (ctx->rd.error) {
+        // The cache file was checked against the source file when opened, so this can only be a damaged file.
+        tkn_delete(tkn);
+        cctx_diagnostic(tkn_ctx->cctx, ctx->prev, DIAG_ERR, "Corrupt token cache file for %s", tkn_ctx->file->path);
+        tkn = (token_t){.pos = ctx->prev, .type = TOKENTYPE_EOF};
+    }
+    if (tkn.type == TOKENTYPE_EOF) {
+        ctx->done     = true;
+        ctx->prev     = tkn.pos;
+        ctx->prev.len = 0;
+    }
+    tkn_ctx->pos = tkn.pos;
+    return tkn;
+}
+
+// Cleanup callback for `tkc_tokenizer_t`.
+static void tkc_cleanup(tokenizer_t *tkn_ctx) {
+    tkc_tokenizer_t *ctx = (tkc_tokenizer_t *)tkn_ctx;
+    pch_free_file(ctx->rd.data, ctx->rd.len, ctx->mapped);
+    lilycc_free(ctx->idents);
+}
+
+// Create a tokenizer that decodes tokens from token cache data, if the data is valid for `file`.
+// The data is unmapped or freed, depending on `mapped`, when the tokenizer is deleted or if this fails.
+static tokenizer_t *
+    tkc_create(srcfile_t *file, uint8_t const *data, size_t len, bool mapped, vec_char_t const *options) {
+    tkc_tokenizer_t *ctx = lilycc_calloc(1, sizeof(tkc_tokenizer_t));
+    ctx->base.cctx       = file->ctx;
+    ctx->base.file       = file;
+    ctx->base.pos        = (pos_t){.srcfile = file};
+    ctx->base.next       = tkc_next;
+    ctx->base.cleanup    = tkc_cleanup;
+    ctx->rd              = (pch_reader_t){.data = data, .len = len};
+    ctx->prev            = (pos_t){.srcfile = file};
+    ctx->mapped          = mapped;
+
+    uint8_t const *magic = pch_get(&ctx->rd, 8);
+    bool           ok    = magic && !memcmp(magic, TKC_MAGIC, 8);
+    uint8_t const *opts  = pch_get(&ctx->rd, options->len);
+    ok                   = ok && opts && !memcmp(opts, options->arr, options->len);
+    // The hash is only the key; the length is checked as well to make a collision less likely to go unnoticed.
+    ok                   = ok && pch_get_u64(&ctx->rd) == file->content_len;
+
+    // Intern every identifier once up front, so tokens only need to look them up by index.
+    uint64_t idents_len = ok ? tkc_get_uleb(&ctx->rd) : 0;
+    ok                  = ok && idents_len <= ctx->rd.len - ctx->rd.off;
+    if (ok && idents_len) {
+        ctx->idents     = lilycc_malloc(idents_len * sizeof(char const *));
+        ctx->idents_len = idents_len;
+    }
+    for (size_t i = 0; ok && i < ctx->idents_len; i++) {
+        size_t      len;
+        char const *str = pch_get_str(&ctx->rd, &len);
+        ok              = str != NULL;
+        if (ok) {
+            ctx->idents[i] = strpool_intern(&file->ctx->idents, str, len);
+        }
+    }
+
+    if (!ok) {
+        tkn_ctx_delete(&ctx->base);
+        return NULL;
+    }
+    return &ctx->base;
+}
+
+// Try to open the token cache file for `file`.
+static tokenizer_t *tkc_load(srcfile_t *file, char const *path, vec_char_t const *options) {
+    uint8_t const *data;
+    size_t         len;
+    bool           mapped;
+    if (!pch_read_file(path, &data, &len, &mapped)) {
+        return NULL;
+    }
+    return tkc_create(file, data, len, mapped, options);
+}
+
+// Write token cache data to its file.
+// Failure is not an error; the file will simply be tokenized again next time.
+static void tkc_store(char const *dir, char const *path, vec_char_t const *data) {
+    // Other compilations may be using the same cache; write to a file of our own and rename it into place.
+    size_t tmp_cap  = strlen(path) + 32;
+    char  *tmp_path = lilycc_malloc(tmp_cap);
+#ifdef _POSIX_C_SOURCE
+    mkdir(dir, 0777);
+    snprintf(tmp_path, tmp_cap, "%s.%ld.tmp", path, (long)getpid());
+#else
+    // The cache directory must already exist, and without process IDs the data's address has to make the name unique.
+    (void)dir;
+    snprintf(tmp_path, tmp_cap, "%s.%p.tmp", path, (void const *)data->arr);
+#endif
+    FILE *fd = fopen(tmp_path, "wb");
+    bool  ok = fd && fwrite(data->arr, 1, data->len, fd) == data->len;
+    if (fd) {
+        ok &= !fclose(fd);
+    }
+    if (!ok || rename(tmp_path, path)) {
+        remove(tmp_path);
+    }
+    lilycc_free(tmp_path);
+}
+
+// Tokenize an entire file in preprocessor mode and encode the tokens as token cache data.
+// Returns false if the tokenizer produced diagnostics; these are discarded, because a token cache can't replay them.
+static bool tkc_tokenize(srcfile_t *file, c_options_t const *c_options, vec_char_t const *options, vec_char_t *out) {
+    c_tokenizer_t *c_ctx = c_tkn_create_impl(file, c_options);
+    if (!c_ctx) {
+        return false;
+    }
+    c_ctx->preproc_mode = true;
+
+    cctx_t      *cctx      = file->ctx;
+    size_t       diag_mark = cctx->diagnostics.len;
+    tkc_writer_t wr        = {.ident_index = PTR_MAP_EMPTY};
+    while (1) {
+        token_t tkn = tkn_next(&c_ctx->base);
+        tkc_put_token(&wr, &tkn);
+        tkn_delete(tkn);
+        if (tkn.type == TOKENTYPE_EOF) {
+            break;
+        }
+    }
+    tkn_ctx_delete(&c_ctx->base);
+
+    bool ok = cctx->diagnostics.len == diag_mark;
+    while (cctx->diagnostics.len > diag_mark) {
+        diagnostic_t *diag = (diagnostic_t *)dlist_pop_back(&cctx->diagnostics);
+        lilycc_free(diag->msg);
+        lilycc_free(diag);
+    }
+    if (ok) {
+        pch_put(out, TKC_MAGIC, 8);
+        pch_put(out, options->arr, options->len);
+        pch_put_u64(out, file->content_len);
+        tkc_put_uleb(out, wr.idents_len);
+        pch_put(out, wr.idents.arr, wr.idents.len);
+        pch_put(out, wr.tokens.arr, wr.tokens.len);
+    }
+    map_clear(&wr.ident_index);
+    vec_clear(&wr.idents);
+    vec_clear(&wr.tokens);
+    return ok;
+}
+
+// Get a tokenizer for an include file that replays its tokens from the token cache.
+// Returns NULL if the token cache is disabled or the file can't be cached, in which case it should be tokenized as usual.
+tokenizer_t *c_tkn_cache_open(c_preproc_t *pre, srcfile_t *file) {
+    c_preproc_shared_t *shared = pre->shared;
+    if (!shared->tkn_cache_dir) {
+        return NULL;
+    }
+
+    vec_char_t options = {0};
+    pch_put_options(&options, shared->options, false);
+    char        *path    = tkc_path(shared->tkn_cache_dir, tkc_hash(file, &options));
+    tokenizer_t *tkn_ctx = tkc_load(file, path, &options);
+    if (!tkn_ctx) {
+        // Not cached yet; tokenize it now and replay the freshly encoded tokens.
+        vec_char_t data = {0};
+        if (tkc_tokenize(file, shared->options, &options, &data)) {
+            tkc_store(shared->tkn_cache_dir, path, &data);
+            tkn_ctx = tkc_create(file, (uint8_t const *)data.arr, data.len, false, &options);
+        } else {
+            vec_clear(&data);
+        }
+    }
+    lilycc_free(path);
+    vec_clear(&options);
+    return tkn_ctx;
+}
+
+#pragma endregion token cache
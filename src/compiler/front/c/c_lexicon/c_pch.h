@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2026 Julian Scheffers <julian@scheffers.net>
+// SPDX-FileType: SOURCE
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "c_options.h"
+#include "c_preproc.h"
+#include "tokenizer.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+// Loaded precompiled header.
+// A precompiled header holds the state of the preprocessor after running a prefix header: the macro table, which
+// files had `#pragma once` or an include guard, the value of `__COUNTER__`, and the tokens the header emitted.
+// It is stored in native byte order and is only valid for the options it was created with.
+struct c_pch {
+    // File content, memory-mapped if possible; stays loaded while there are macros whose body has not been built yet.
+    uint8_t const *data;
+    // Size of `data` in bytes.
+    size_t         len;
+    // `data` is memory-mapped (as opposed to heap-allocated).
+    bool           mapped;
+    // Offset in `data` of the macro bodies.
+    size_t         bodies_off;
+    // Source files that positions in the precompiled header refer to, by index.
+    srcfile_t    **files;
+    // Number of `files`.
+    size_t         files_len;
+};
+
+
+
+// Preprocess `header` and write the resulting preprocessor state to a precompiled header at `pch_path`.
+// Include files are searched for in `include_dirs`, like `c_preproc_shared_t::include_dirs`.
+// Diagnostics in the header are printed to stderr; returns false if it had errors or `pch_path` can't be written.
+bool c_pch_create(
+    c_options_t const *options, char const *const *include_dirs, size_t include_dirs_len, char const *header,
+    char const *pch_path, bool keep_comments
+);
+// Load a precompiled header into a root preprocessor that has not emitted any tokens yet.
+// Returns false without loading anything if the file is missing, malformed, was created with different options or
+// include directories, or if any of the files that went into it changed since.
+bool c_pch_load(c_preproc_t *pre, char const *pch_path);
+// Load the precompiled header for `header`, (re)creating it first if it is missing or out of date.
+// The precompiled header is stored next to `header`, with `.pch` appended to the name.
+bool c_pch_use(c_preproc_t *pre, char const *header);
+// Build the body of a macro that was loaded from a precompiled header.
+void c_pch_materialize(c_preproc_t *pre, c_macro_t *macro);
+// Unmap a precompiled header and free its memory.
+void c_pch_unload(c_pch_t *pch);
+
+// Get a tokenizer for an include file that replays its tokens from the token cache.
+// Returns NULL if the token cache is disabled or the file can't be cached, in which case it should be tokenized as usual.
+tokenizer_t *c_tkn_cache_open(c_preproc_t *pre, srcfile_t *file);
@@ -6,6 +6,7 @@
 #include "c_preproc.h"
 
 #include "arith128.h"
+#include "c_pch.h"
 #include "c_tokenizer.h"
 #include "compiler.h"
 #include "lilycc_malloc.h"
@@ -49,9 +50,12 @@ static void c_preproc_builtin_macros(c_preproc_t *preproc);
 static void c_pragma_once(c_preproc_t *pre, pos_t pos, char const *args);
 static void c_preproc_pragma(c_preproc_t *pre, pos_t pos, char const *pragma);
 
-static srcfile_t *c_incfile_find(c_preproc_t *pre, pos_t pos, char const *path, bool sysinc);
-static void       c_incfile_push(c_preproc_t *pre, pos_t pos, char const *path, bool sysinc);
+static srcfile_t *c_incfile_find(c_preproc_t *pre, char const *path, bool sysinc, bool next, size_t *search_next);
+static void       c_incfile_push(c_preproc_t *pre, pos_t pos, char const *path, bool sysinc, bool include_next);
 static void       c_incfile_pop(c_preproc_t *pre);
+static void       c_incfile_guard_directive(c_preproc_t *pre, token_t const *name);
+static void       c_incfile_guard_content(c_preproc_t *pre);
+static void       c_incfile_guard_eof(c_preproc_t *pre);
 static void       c_incfile_eof(c_preproc_t *pre);
 
 static int     c_preproc_op_precedence(c_tokentype_t type);
@@ -61,7 +65,7 @@ static i128_t  c_preproc_eval_infix(bool is_signed, i128_t lhs, c_tokentype_t op
 static token_t c_preproc_eval_get_helper(c_preproc_t *pre);
 static bool    c_preproc_eval(c_preproc_t *pre, pos_t pos);
 
-static void c_directive_include(c_preproc_t *pre, pos_t pos);
+static void c_directive_include(c_preproc_t *pre, pos_t pos, bool include_next);
 static void c_directive_pragma(c_preproc_t *pre, pos_t pos);
 static void c_directive_if(c_preproc_t *pre, pos_t pos, bool elif, bool ifdef, bool ifndef);
 static void c_directive_else(c_preproc_t *pre, pos_t pos);
@@ -70,6 +74,9 @@ static void c_directive_warning(c_preproc_t *pre, pos_t pos, bool is_error);
 static void c_directive_define(c_preproc_t *pre, pos_t pos);
 static void c_directive_undef(c_preproc_t *pre, pos_t pos);
 
+static char const *c_preproc_macro_key(c_preproc_t *pre, token_t const *name);
+static c_macro_t  *c_preproc_find_macro(c_preproc_t *pre, token_t const *name);
+
 static char   *c_preproc_read_bytes(c_preproc_t *pre, pos_t *pos_out);
 static token_t c_preproc_get_pathspec(c_preproc_t *pre);
 static void    c_preproc_until_eol(c_preproc_t *pre, bool warn_extra_tok);
@@ -79,13 +86,127 @@ static void    c_preproc_directive(c_preproc_t *pre);
 static bool    c_preproc_tkn_paste(c_preproc_t *pre, token_t const *lhs, token_t const *rhs, token_t *out);
 static char   *c_preproc_esc_str(char const *raw);
 static token_t c_preproc_raw_peek(c_preproc_t *pre);
+static bool    c_preproc_expand_pending(c_preproc_t *pre);
 static token_t c_preproc_raw_next(c_preproc_t *pre);
+static token_t c_preproc_outer_peek(c_preproc_t *pre);
 
 static bool    c_macro_parse_body(c_macro_t *macro, tokenizer_t *tkn_ctx);
 static void    c_macro_mark_pasting(vec_macro_subst_t *tokens);
-static token_t c_macro_arg_stringize(c_macro_arg_t *arg, pos_t pos);
+static token_t c_macro_arg_stringize(cctx_t *cctx, c_macro_arg_t *arg, pos_t pos);
 static void    c_macro_arg_preexpand(c_preproc_t *pre, c_macro_arg_t *arg);
-static void    c_macro_expand(c_preproc_t *pre, pos_t pos, c_macro_t const *macro);
+static void    c_macro_expand(c_preproc_t *pre, pos_t pos, c_macro_t *macro);
+
+
+
+#pragma region memo
+
+// Hash the tokens of a macro argument for `arg_memo`.
+static uint32_t c_arg_memo_hash(void const *key) {
+    vec_token_t const *tokens = key;
+    uint32_t           hash   = tokens->len;
+    for (size_t i = 0; i < tokens->len; i++) {
+        token_t const *tkn = &tokens->arr[i];
+        hash               = hash * 31 + (tkn->type << 16) + tkn->subtype;
+        if (tkn->strval) {
+            hash = hash * 31 + hash_mem(tkn->strval, tkn->strval_len);
+        }
+    }
+    return hash;
+}
+
+// Compare the tokens of two macro arguments for `arg_memo`; returns 0 if they are spelled the same.
+static int c_arg_memo_cmp(void const *a, void const *b) {
+    vec_token_t const *lhs = a;
+    vec_token_t const *rhs = b;
+    if (lhs->len != rhs->len) {
+        return 1;
+    }
+    for (size_t i = 0; i < lhs->len; i++) {
+        token_t const *x = &lhs->arr[i];
+        token_t const *y = &rhs->arr[i];
+        if (x->type != y->type || x->subtype != y->subtype || x->ival != y->ival || x->ivalh != y->ivalh
+            || x->strval_len != y->strval_len) {
+            return 1;
+        }
+        if (x->strval_len && x->strval != y->strval && memcmp(x->strval, y->strval, x->strval_len)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Vtable for `arg_memo`, which is keyed by the tokens of a macro argument.
+static map_vtable_t const c_arg_memo_vtable = {
+    .key_hash = c_arg_memo_hash,
+    .key_cmp  = c_arg_memo_cmp,
+    .key_dup  = dup_nop,
+    .key_del  = del_nop,
+};
+
+// Delete all memoized macro argument pre-expansions.
+static void c_arg_memo_clear(c_preproc_t *pre) {
+    map_foreach(ent, &pre->shared->arg_memo) {
+        c_arg_memo_t *memo = ent->value;
+        for (size_t i = 0; i < memo->tokens.len; i++) {
+            tkn_delete(memo->tokens.arr[i]);
+        }
+        for (size_t i = 0; i < memo->expanded.len; i++) {
+            tkn_delete(memo->expanded.arr[i]);
+        }
+        vec_clear(&memo->tokens);
+        vec_clear(&memo->expanded);
+        vec_clear(&memo->macros);
+        lilycc_free(memo);
+    }
+    map_clear(&pre->shared->arg_memo);
+    set_clear(&pre->shared->arg_memo_deps);
+}
+
+// Called when the macro with interned name `key` is (re)defined or undefined.
+// Clears the memoized pre-expansions if any of them could have expanded differently.
+static void c_arg_memo_invalidate(c_preproc_t *pre, char const *key) {
+    if (set_contains(&pre->shared->arg_memo_deps, key)) {
+        c_arg_memo_clear(pre);
+    }
+}
+
+// Delete all memoized `#if` condition results.
+static void c_cond_memo_clear(c_preproc_t *pre) {
+    map_foreach(ent, &pre->shared->cond_memo) {
+        c_cond_memo_t *memo = ent->value;
+        vec_clear(&memo->defined);
+        vec_clear(&memo->undefined);
+        lilycc_free(memo);
+    }
+    map_clear(&pre->shared->cond_memo);
+}
+
+// Whether a memoized `#if` condition result still holds, which it does if no macro it looked up changed.
+static bool c_cond_memo_valid(c_preproc_t *pre, c_cond_memo_t *memo) {
+    if (memo->macros_gen == pre->shared->macros_gen) {
+        return true;
+    }
+    for (size_t i = 0; i < memo->defined.len; i++) {
+        if (!map_get(&pre->shared->macros, memo->defined.arr[i])) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < memo->undefined.len; i++) {
+        if (map_get(&pre->shared->macros, memo->undefined.arr[i])) {
+            return false;
+        }
+    }
+    memo->macros_gen = pre->shared->macros_gen;
+    return true;
+}
+
+// Called when the macro with interned name `key` is (re)defined or undefined.
+static void c_preproc_macro_changed(c_preproc_t *pre, char const *key) {
+    pre->shared->macros_gen++;
+    c_arg_memo_invalidate(pre, key);
+}
+
+#pragma endregion memo
 
 
 
@@ -124,7 +245,7 @@ static c_expansion_t c_proc_macro_file(c_preproc_t *pre, vec_macro_arg_t const *
     (void)args;
     (void)cookie;
 
-    token_t peek = c_preproc_raw_peek(pre->root);
+    token_t peek = c_preproc_outer_peek(pre);
     char   *path;
     if (peek.pos.srcfile) {
         path = c_preproc_esc_str(peek.pos.srcfile->path);
@@ -150,7 +271,7 @@ static c_expansion_t c_proc_macro_file_name(c_preproc_t *pre, vec_macro_arg_t co
     (void)args;
     (void)cookie;
 
-    token_t peek = c_preproc_raw_peek(pre->root);
+    token_t peek = c_preproc_outer_peek(pre);
     char   *path;
     if (peek.pos.srcfile) {
         path = c_preproc_esc_str(peek.pos.srcfile->name);
@@ -176,7 +297,7 @@ static c_expansion_t c_proc_macro_line(c_preproc_t *pre, vec_macro_arg_t const *
     (void)cookie;
     (void)args;
 
-    token_t peek = c_preproc_raw_peek(pre->root);
+    token_t peek = c_preproc_outer_peek(pre);
 
     int cap = snprintf(NULL, 0, "%d", peek.pos.line);
     if (cap < 0) {
@@ -213,7 +334,7 @@ __attribute__((format(printf, 2, 3))) static void c_preproc_fmt_builtin_macro(c_
     va_end(vl);
 
     char      *name;
-    c_macro_t *macro  = c_macro_create(pre->shared->options, "<built-in>", spec, &name);
+    c_macro_t *macro  = c_macro_create(&pre->shared->cctx->idents, pre->shared->options, "<built-in>", spec, &name);
     macro->is_builtin = true;
     c_preproc_add_macro(pre, name, macro);
     lilycc_free(name);
@@ -222,8 +343,14 @@ __attribute__((format(printf, 2, 3))) static void c_preproc_fmt_builtin_macro(c_
 
 // Create all (standard and extension) pre-defined macros for a given C frontend.
 static void c_preproc_builtin_macros(c_preproc_t *pre) {
-    time_t    ts       = time(NULL);
-    struct tm datetime = *localtime(&ts);
+    time_t    ts = time(NULL);
+    struct tm datetime;
+#ifdef _POSIX_C_SOURCE
+    // Preprocessors may be created on several threads at once (see `lily-cpp -M`); `localtime` isn't reentrant.
+    localtime_r(&ts, &datetime);
+#else
+    datetime = *localtime(&ts);
+#endif
 
     // __DATE__
     char const *month[] = {
@@ -302,22 +429,26 @@ c_preproc_t *c_preproc_create(srcfile_t *srcfile, c_options_t const *options, bo
 
     c_preproc_shared_t *shared = lilycc_calloc(1, sizeof(c_preproc_shared_t));
     shared->cctx               = srcfile->ctx;
-    shared->macros             = STR_MAP_EMPTY;
+    shared->macros             = PTR_MAP_EMPTY;
     shared->once_files         = PTR_SET_EMPTY;
+    shared->guard_macros       = PTR_MAP_EMPTY;
+    shared->arg_memo           = (map_t){NULL, 0, 0, &c_arg_memo_vtable};
+    shared->arg_memo_deps      = PTR_SET_EMPTY;
+    shared->entered_files      = PTR_SET_EMPTY;
+    shared->cond_memo          = PTR_MAP_EMPTY;
     shared->options            = options;
 
     // Note: `base` has a `pos` and `file`, but we do not use either.
     pre->base.cctx           = srcfile->ctx;
     pre->base.next           = c_preproc_next;
     pre->base.cleanup        = c_preproc_destroy;
-    pre->root                = pre;
     pre->shared              = shared;
-    pre->owns_shared         = true;
     c_incfile_t root_incfile = {
         .tkn_ctx = &srctok->base,
         .ifdir   = {0},
     };
     vec_push(&pre->stack, root_incfile);
+    vec_push(&shared->read_files, srcfile);
     pre->blank_line    = true;
     pre->raw_mode      = raw_mode;
     pre->keep_comments = keep_comments;
@@ -327,22 +458,6 @@ c_preproc_t *c_preproc_create(srcfile_t *srcfile, c_options_t const *options, bo
     return pre;
 }
 
-// Create a nested preprocessor that shares macro/file/pragma state with `parent`.
-c_preproc_t *c_preproc_create_nested(c_preproc_t *parent) {
-    c_preproc_t *pre = lilycc_calloc(1, sizeof(c_preproc_t));
-
-    pre->base.next     = c_preproc_next;
-    pre->base.cleanup  = c_preproc_destroy;
-    pre->shared        = parent->shared;
-    pre->root          = parent->root;
-    pre->owns_shared   = false;
-    pre->blank_line    = true;
-    pre->raw_mode      = true;
-    pre->keep_comments = false;
-
-    return pre;
-}
-
 // Destroy a preprocessor.
 static void c_preproc_destroy(tokenizer_t *tkn) {
     c_preproc_t *pre = (c_preproc_t *)tkn;
@@ -356,19 +471,33 @@ static void c_preproc_destroy(tokenizer_t *tkn) {
     }
     vec_clear(&pre->expand);
 
+    for (size_t i = pre->pch_index; i < pre->pch_tokens.len; i++) {
+        tkn_delete(pre->pch_tokens.arr[i]);
+    }
+    vec_clear(&pre->pch_tokens);
+    vec_clear(&pre->memo_macros);
+    vec_clear(&pre->cond_defined);
+    vec_clear(&pre->cond_undefined);
+
     while (pre->stack.len) {
         c_incfile_pop(pre);
     }
     vec_clear(&pre->stack);
 
-    if (pre->owns_shared) {
-        map_foreach(ent, &pre->shared->macros) {
-            c_macro_destroy(ent->value);
-        }
-        map_clear(&pre->shared->macros);
-        set_clear(&pre->shared->once_files);
-        lilycc_free(pre->shared);
+    map_foreach(ent, &pre->shared->macros) {
+        c_macro_destroy(ent->value);
+    }
+    map_clear(&pre->shared->macros);
+    set_clear(&pre->shared->once_files);
+    map_clear(&pre->shared->guard_macros);
+    c_arg_memo_clear(pre);
+    c_cond_memo_clear(pre);
+    set_clear(&pre->shared->entered_files);
+    vec_clear(&pre->shared->read_files);
+    if (pre->shared->pch) {
+        c_pch_unload(pre->shared->pch);
     }
+    lilycc_free(pre->shared);
 }
 
 #pragma region pragmas
@@ -412,23 +541,55 @@ static void c_preproc_pragma(c_preproc_t *pre, pos_t pos, char const *pragma) {
 
 #pragma region incfile
 
-// Search for an include file, emit a diagnostic if it is not found.
-static srcfile_t *c_incfile_find(c_preproc_t *pre, pos_t pos, char const *path, bool sysinc) {
-    (void)sysinc;
-
-    // TODO: Replace with _popen when include search paths are implemented.
-    srcfile_t *file = srcfile_open(pre->shared->cctx, path);
-    if (!file) {
-        cctx_diagnostic(pre->shared->cctx, pos, DIAG_ERR, "Cannot open include file: %s", path);
-    }
-
+// Search for an include file; if `next` is true, continue the search after the directory the current file was found in.
+// Stores the index in the include path to continue from for an `#include_next` in the found file in `search_next`.
+static srcfile_t *c_incfile_find(c_preproc_t *pre, char const *path, bool sysinc, bool next, size_t *search_next) {
+    cctx_t            *cctx     = pre->shared->cctx;
+    c_incfile_t const *current  = &pre->stack.arr[pre->stack.len - 1];
+    char const *const *dirs     = pre->shared->include_dirs;
+    size_t             dirs_len = pre->shared->include_dirs_len;
+    if (!dirs_len) {
+        // Without an include path, include files are looked for in the working directory.
+        static char const *const cwd[] = {"."};
+        dirs                           = cwd;
+        dirs_len                       = 1;
+    }
+
+    size_t start = 0;
+    if (next) {
+        start = current->search_next;
+    } else if (!sysinc) {
+        // Quoted includes are looked for next to the including file first.
+        char const *from    = current->tkn_ctx->file->path;
+        char const *sep     = strrchr(from, '/');
+        size_t      dir_len = sep ? (sep == from ? 1 : sep - from) : 1;
+        char       *dir     = lilycc_malloc(dir_len + 1);
+        memcpy(dir, sep ? from : ".", dir_len);
+        dir[dir_len]    = 0;
+        srcfile_t *file = srcfile_popen(cctx, path, (char const *const *)&dir, 1, NULL);
+        lilycc_free(dir);
+        if (file) {
+            *search_next = 0;
+            return file;
+        }
+    }
+
+    size_t     found = SIZE_MAX;
+    srcfile_t *file  = srcfile_popen(cctx, path, dirs + start, dirs_len - start, &found);
+    *search_next     = found == SIZE_MAX ? 0 : start + found + 1;
     return file;
 }
 
 // Search for an include file and push it into the include stack.
-static void c_incfile_push(c_preproc_t *pre, pos_t pos, char const *path, bool sysinc) {
-    srcfile_t *file = c_incfile_find(pre, pos, path, sysinc);
+static void c_incfile_push(c_preproc_t *pre, pos_t pos, char const *path, bool sysinc, bool include_next) {
+    if (include_next && pre->stack.len == 1) {
+        cctx_diagnostic(pre->shared->cctx, pos, DIAG_WARN, "#include_next in primary source file");
+        include_next = false;
+    }
+    size_t     search_next;
+    srcfile_t *file = c_incfile_find(pre, path, sysinc, include_next, &search_next);
     if (!file) {
+        cctx_diagnostic(pre->shared->cctx, pos, DIAG_ERR, "Cannot open include file: %s", path);
         return;
     }
 
@@ -437,12 +598,28 @@ static void c_incfile_push(c_preproc_t *pre, pos_t pos, char const *path, bool s
         return;
     }
 
+    char const *guard = map_get(&pre->shared->guard_macros, file);
+    if (guard && map_get(&pre->shared->macros, guard)) {
+        // The file is wrapped in an include guard whose macro is still defined, so it would produce nothing.
+        return;
+    }
+
     // TODO: Add include stack info to the tokenizer's position.
-    c_tokenizer_t *tkn_ctx = c_tkn_create_impl(file, pre->shared->options);
-    tkn_ctx->preproc_mode  = true;
-    c_incfile_t incfile    = {
-        .tkn_ctx = &tkn_ctx->base,
-        .ifdir   = {0},
+    tokenizer_t *tkn_ctx = c_tkn_cache_open(pre, file);
+    if (!tkn_ctx) {
+        c_tokenizer_t *c_ctx = c_tkn_create_impl(file, pre->shared->options);
+        c_ctx->preproc_mode  = true;
+        tkn_ctx              = &c_ctx->base;
+    }
+    bool first_entry = set_add(&pre->shared->entered_files, file);
+    if (first_entry) {
+        vec_push(&pre->shared->read_files, file);
+    }
+    c_incfile_t incfile = {
+        .tkn_ctx     = tkn_ctx,
+        .ifdir       = {0},
+        .search_next = search_next,
+        .memo_conds  = !first_entry,
     };
     vec_push(&pre->stack, incfile);
     pre->blank_line = true;
@@ -459,6 +636,99 @@ static void c_incfile_pop(c_preproc_t *pre) {
     pre->stack.len--;
 }
 
+// Peek past whitespace in an include file, starting at lookahead `*depth`.
+// Returns the first other token and updates `*depth` to point after it.
+static token_t c_incfile_peek_nonws(c_incfile_t *file, size_t *depth) {
+    while (1) {
+        token_t peek = tkn_peek_n(file->tkn_ctx, (*depth)++);
+        if (peek.type != TOKENTYPE_WHITESPACE) {
+            return peek;
+        }
+    }
+}
+
+// Match the rest of an `#ifndef X` or `#if !defined X` line without consuming it.
+// Returns the interned macro name if the line has that form, NULL otherwise.
+static char const *c_incfile_guard_match(c_preproc_t *pre, c_incfile_t *file, bool is_if) {
+    size_t  depth = 0;
+    token_t tkn   = c_incfile_peek_nonws(file, &depth);
+    bool    paren = false;
+    if (is_if) {
+        if (tkn.type != TOKENTYPE_OTHER || tkn.subtype != C_TKN_LNOT) {
+            return NULL;
+        }
+        tkn = c_incfile_peek_nonws(file, &depth);
+        if (tkn.type != TOKENTYPE_IDENT || tkn.strval_len != 7 || memcmp(tkn.strval, "defined", 7)) {
+            return NULL;
+        }
+        tkn = c_incfile_peek_nonws(file, &depth);
+        if (tkn.type == TOKENTYPE_OTHER && tkn.subtype == C_TKN_LPAR) {
+            paren = true;
+            tkn   = c_incfile_peek_nonws(file, &depth);
+        }
+    }
+    if (tkn.type != TOKENTYPE_IDENT) {
+        return NULL;
+    }
+    token_t name = tkn;
+    if (paren) {
+        tkn = c_incfile_peek_nonws(file, &depth);
+        if (tkn.type != TOKENTYPE_OTHER || tkn.subtype != C_TKN_RPAR) {
+            return NULL;
+        }
+    }
+    tkn = c_incfile_peek_nonws(file, &depth);
+    if (tkn.type != TOKENTYPE_EOL && tkn.type != TOKENTYPE_EOF) {
+        return NULL;
+    }
+    return strpool_intern(&pre->shared->cctx->idents, name.strval, name.strval_len);
+}
+
+// Update include guard detection of the top-most include file for a directive about to be run.
+// The guard is an `#ifndef X` or `#if !defined X` as the first directive whose `#endif` ends the file.
+static void c_incfile_guard_directive(c_preproc_t *pre, token_t const *name) {
+    c_incfile_t *file = &pre->stack.arr[pre->stack.len - 1];
+    if (file->guard_state == C_GUARD_START) {
+        char const *macro = NULL;
+        if (!strcmp(name->strval, "ifndef")) {
+            macro = c_incfile_guard_match(pre, file, false);
+        } else if (!strcmp(name->strval, "if")) {
+            macro = c_incfile_guard_match(pre, file, true);
+        }
+        file->guard_state = macro ? C_GUARD_INSIDE : C_GUARD_NONE;
+        file->guard_macro = macro;
+    } else if (file->guard_state == C_GUARD_INSIDE && file->ifdir.len == 1) {
+        if (!strcmp(name->strval, "endif")) {
+            file->guard_state = C_GUARD_AFTER;
+        } else if (!strncmp(name->strval, "el", 2)) {
+            // An `#else` or `#elif` on the guard means the file has content when the macro is defined.
+            file->guard_state = C_GUARD_NONE;
+        }
+    } else if (file->guard_state == C_GUARD_AFTER) {
+        file->guard_state = C_GUARD_NONE;
+    }
+}
+
+// Update include guard detection of the top-most include file before emitting tokens.
+static void c_incfile_guard_content(c_preproc_t *pre) {
+    c_incfile_t *file = &pre->stack.arr[pre->stack.len - 1];
+    if (file->guard_state != C_GUARD_START && file->guard_state != C_GUARD_AFTER) {
+        return;
+    }
+    token_t peek = tkn_peek(file->tkn_ctx);
+    if (peek.type != TOKENTYPE_WHITESPACE && peek.type != TOKENTYPE_EOL && peek.type != TOKENTYPE_EOF) {
+        file->guard_state = C_GUARD_NONE;
+    }
+}
+
+// Remember the include guard of the top-most include file after reaching its EOF.
+static void c_incfile_guard_eof(c_preproc_t *pre) {
+    c_incfile_t *file = &pre->stack.arr[pre->stack.len - 1];
+    if (file->guard_state == C_GUARD_AFTER) {
+        map_set(&pre->shared->guard_macros, file->tkn_ctx->file, file->guard_macro);
+    }
+}
+
 // Do end-of-file checks for top-most file of the include stack.
 static void c_incfile_eof(c_preproc_t *pre) {
     assert(pre->stack.len >= 1);
@@ -480,6 +750,30 @@ static void c_incfile_eof(c_preproc_t *pre) {
 
 #pragma region eval
 
+// Value of an expression in an `#if` condition.
+typedef struct {
+    // Position of the expression.
+    pos_t  pos;
+    // Value of the expression.
+    i128_t value;
+    // Whether the value has a signed type.
+    bool   is_signed;
+} c_eval_value_t;
+
+// State of the evaluation of an `#if` condition.
+typedef struct {
+    // Preprocessor that the condition is read from.
+    c_preproc_t *pre;
+    // Next token of the condition, as returned by `c_preproc_eval_get_helper`.
+    token_t      peek;
+    // Position of the last token consumed.
+    pos_t        last;
+    // Whether the condition is malformed.
+    bool         error;
+} c_eval_t;
+
+static c_eval_value_t c_preproc_eval_cond(c_eval_t *eval, bool live);
+
 // Get operator precedence.
 // Returns -1 if not an operator token.
 // Note: Unlike C proper, there are no suffix operators.
@@ -610,12 +904,29 @@ static i128_t c_preproc_eval_infix(bool is_signed, i128_t lhs, c_tokentype_t ope
     }
 }
 
+// Record that the `#if` condition being evaluated depends on whether identifier `name` is a macro.
+static void c_preproc_eval_depends(c_preproc_t *pre, token_t const *name, bool defined) {
+    if (!pre->cond_recording) {
+        return;
+    }
+    char const *key = c_preproc_macro_key(pre, name);
+    if (!key) {
+        // A name that was never interned can't be recognized when it gets defined later.
+        pre->cond_memo_ok = false;
+    } else if (defined) {
+        vec_push(&pre->cond_defined, key);
+    } else {
+        vec_push(&pre->cond_undefined, key);
+    }
+}
+
 // Evaluates `defined` for `c_preproc_eval_get_helper`.
 static token_t c_preproc_eval_defined(c_preproc_t *pre, pos_t pos) {
     bool    eval = false;
     token_t lpar = c_preproc_get_tkn(pre, LINE_NOWS_RAW);
     if (lpar.type == TOKENTYPE_IDENT && lpar.subtype == C_IDENT) {
-        eval = map_get(&pre->shared->macros, lpar.strval) != NULL;
+        eval = c_preproc_find_macro(pre, &lpar) != NULL;
+        c_preproc_eval_depends(pre, &lpar, eval);
     } else if (lpar.type == TOKENTYPE_OTHER && lpar.subtype == C_TKN_LPAR) {
         token_t name = c_preproc_get_tkn(pre, LINE_NOWS_RAW);
         token_t rpar = c_preproc_get_tkn(pre, LINE_NOWS_RAW);
@@ -624,7 +935,8 @@ static token_t c_preproc_eval_defined(c_preproc_t *pre, pos_t pos) {
         } else if (rpar.type != TOKENTYPE_OTHER || rpar.subtype != C_TKN_RPAR) {
             cctx_diagnostic(pre->shared->cctx, name.pos, DIAG_ERR, "Expected )");
         } else {
-            eval = map_get(&pre->shared->macros, name.strval) != NULL;
+            eval = c_preproc_find_macro(pre, &name) != NULL;
+            c_preproc_eval_depends(pre, &name, eval);
         }
         tkn_delete(name);
         tkn_delete(rpar);
@@ -642,6 +954,9 @@ static token_t c_preproc_eval_defined(c_preproc_t *pre, pos_t pos) {
 
 // Evaluates `__has_include` for `c_preproc_eval_get_helper`.
 static token_t c_preproc_eval_has_include(c_preproc_t *pre, pos_t pos) {
+    // Files can be created between one evaluation of the condition and the next.
+    pre->cond_memo_ok = false;
+
     token_t lpar = c_preproc_get_tkn(pre, LINE_NOWS_EXPAND);
     bool    eval = false;
     if (lpar.type != TOKENTYPE_OTHER || lpar.subtype != C_TKN_LPAR) {
@@ -651,15 +966,20 @@ static token_t c_preproc_eval_has_include(c_preproc_t *pre, pos_t pos) {
     token_t name = c_preproc_get_pathspec(pre);
     if (name.type != TOKENTYPE_SCONST || name.subtype == C_STR_RAW_SQUOT) {
         cctx_diagnostic(pre->shared->cctx, name.pos, DIAG_ERR, "Expected a path");
+        tkn_delete(name);
         goto exit;
     }
-    eval         = c_incfile_find(pre, name.pos, name.strval, name.subtype == C_STR_ANGLEBRAC);
+    size_t search_next;
+    eval         = c_incfile_find(pre, name.strval, name.subtype == C_STR_ANGLEBRAC, false, &search_next) != NULL;
     token_t rpar = c_preproc_get_tkn(pre, LINE_NOWS_EXPAND);
     if (rpar.type != TOKENTYPE_OTHER || rpar.subtype != C_TKN_RPAR) {
-        cctx_diagnostic(pre->shared->cctx, lpar.pos, DIAG_ERR, "Expected (");
+        cctx_diagnostic(pre->shared->cctx, rpar.pos, DIAG_ERR, "Expected )");
     }
+    tkn_delete(name);
+    tkn_delete(rpar);
 
 exit:
+    tkn_delete(lpar);
     return (token_t){
         .pos  = pos,
         .type = TOKENTYPE_ICONST,
@@ -713,139 +1033,227 @@ static token_t c_preproc_eval_get_helper(c_preproc_t *pre) {
     return res;
 }
 
-// Evaluate the condition for an `#if` or `#elif` directive.
-static bool c_preproc_eval(c_preproc_t *pre, pos_t pos) {
-    enum entry_type {
-        ENTRY_TOKEN,
-        ENTRY_VALUE,
-        ENTRY_GARBAGE,
+// Consume the next token of an `#if` condition.
+static void c_preproc_eval_advance(c_eval_t *eval) {
+    eval->last = eval->peek.pos;
+    tkn_delete(eval->peek);
+    eval->peek = c_preproc_eval_get_helper(eval->pre);
+}
+
+// Is the next token of an `#if` condition a specific punctuator?
+static bool c_preproc_eval_is(c_eval_t const *eval, c_tokentype_t type) {
+    return eval->peek.type == TOKENTYPE_OTHER && eval->peek.subtype == (int)type;
+}
+
+// Mark an `#if` condition as malformed at the next token.
+static c_eval_value_t c_preproc_eval_fail(c_eval_t *eval) {
+    eval->error = true;
+    return (c_eval_value_t){
+        .pos       = eval->peek.pos,
+        .is_signed = true,
     };
-    typedef struct entry {
-        enum entry_type type;
-        pos_t           pos;
-        union {
-            c_tokentype_t token;
-            struct {
-                i128_t value;
-                bool   is_signed;
-            } value;
-        };
-    } entry_t;
-    VEC_TYPE_DEF(vec_entry_t, entry_t)
-
-    vec_entry_t stack = {0};
-    bool        has_peek;
-    entry_t     peek;
-
-#pragma region
-    // Push a node/token to the stack.
-#define push(thing) vec_push(&stack, (thing))
-    // Pop a node/token from the stack.
-#define pop()                                                                                                          \
-    ({                                                                                                                 \
-        entry_t pop_temporary_value = stack.arr[stack.len - 1];                                                        \
-        stack.len--;                                                                                                   \
-        pop_temporary_value;                                                                                           \
-    })
-    // Index by depth.
-#define by_depth(depth) stack.arr[stack.len - (depth) - 1]
-    // Is this a specific kind of token?
-#define is_token2(depth, subtype)                                                                                      \
-    (stack.len > (depth) && by_depth(depth).type == ENTRY_TOKEN && by_depth(depth).token == (subtype))
-    // Is this a token?
-#define is_token(depth) (stack.len > (depth) && by_depth(depth).type == ENTRY_TOKEN)
-    // Is this a value?
-#define is_value(depth) (stack.len > (depth) && by_depth(depth).type == ENTRY_VALUE)
-    // Read the next token into peek.
-#define peek()                                                                                                         \
-    do {                                                                                                               \
-        token_t tkn = c_preproc_eval_get_helper(pre);                                                                  \
-        has_peek    = tkn.type != TOKENTYPE_EOL;                                                                       \
-        if (has_peek) {                                                                                                \
-            peek.pos = tkn.pos;                                                                                        \
-            if (tkn.type == TOKENTYPE_ICONST || tkn.type == TOKENTYPE_CCONST) {                                        \
-                peek.type            = ENTRY_VALUE;                                                                    \
-                peek.value.value     = i128_pack(tkn.ivalh, tkn.ival);                                                 \
-                peek.value.is_signed = (tkn.subtype & 1) == 0;                                                         \
-            } else if (                                                                                                \
-                tkn.type == TOKENTYPE_OTHER                                                                            \
-                && (tkn.subtype == C_TKN_LPAR || tkn.subtype == C_TKN_RPAR                                             \
-                    || c_preproc_op_precedence(tkn.subtype) != -1 || c_preproc_is_prefix_op(tkn.subtype))              \
-            ) {                                                                                                        \
-                peek.type  = ENTRY_TOKEN;                                                                              \
-                peek.token = tkn.subtype;                                                                              \
-            } else if (tkn.type == TOKENTYPE_IDENT) {                                                                  \
-                peek.type            = ENTRY_VALUE;                                                                    \
-                peek.value.is_signed = true;                                                                           \
-                peek.value.value     = ui128(pre->shared->options->c_std >= C_STD_C23 && !strcmp(tkn.strval, "true")); \
-            } else {                                                                                                   \
-                peek.type = ENTRY_GARBAGE;                                                                             \
-            }                                                                                                          \
-        }                                                                                                              \
-        tkn_delete(tkn);                                                                                               \
-    } while (0)
-#pragma endregion
-
-    peek();
-    while (1) {
-        if (is_token2(2, C_TKN_LPAR) && is_value(1) && is_token2(0, C_TKN_RPAR)) {
-            // Reduce parentheses.
-            struct entry rpar = pop();
-            struct entry tmp  = pop();
-            struct entry lpar = pop();
-            tmp.pos           = pos_including(lpar.pos, rpar.pos);
-            push(tmp);
-        } else if (!is_value(2) && is_token(1) && c_preproc_is_prefix_op(by_depth(1).token) && is_value(0)) {
-            // Reduce prefix.
-            struct entry value = pop();
-            struct entry oper  = pop();
-            value.value.value  = c_preproc_eval_prefix(oper.token, value.value.value);
-            value.pos          = pos_including(oper.pos, value.pos);
-            push(value);
-        } else if (
-            is_value(2) && is_token(1) && is_value(0)
-            && (!has_peek || peek.type != ENTRY_TOKEN
-                || c_preproc_op_precedence(by_depth(1).token) >= c_preproc_op_precedence(peek.token))
-        ) {
-            // Reduce infix.
-            struct entry rhs       = pop();
-            struct entry oper      = pop();
-            struct entry lhs       = pop();
-            bool         is_signed = lhs.value.is_signed && rhs.value.is_signed;
-            struct entry res       = {
-                .type  = ENTRY_VALUE,
-                .value = {
-                    .value     = c_preproc_eval_infix(is_signed, lhs.value.value, oper.token, rhs.value.value),
-                    .is_signed = is_signed,
-                },
-            };
-            push(res);
-        } else if (has_peek) {
-            // Push a token.
-            push(peek);
-            peek();
-        } else {
-            // Nothing to push, can't reduce anymore.
+}
+
+// Evaluate a primary expression or a prefix operator and its operand.
+static c_eval_value_t c_preproc_eval_unary(c_eval_t *eval, bool live) {
+    token_t const  tkn = eval->peek;
+    c_eval_value_t res = {
+        .pos       = tkn.pos,
+        .is_signed = true,
+    };
+
+    if (tkn.type == TOKENTYPE_ICONST || tkn.type == TOKENTYPE_CCONST) {
+        res.value     = i128_pack(tkn.ivalh, tkn.ival);
+        res.is_signed = (tkn.subtype & 1) == 0;
+        c_preproc_eval_advance(eval);
+
+    } else if (tkn.type == TOKENTYPE_IDENT) {
+        // Identifiers that are left after macro expansion are 0, except for `true` in C23.
+        res.value = ui128(eval->pre->shared->options->c_std >= C_STD_C23 && !strcmp(tkn.strval, "true"));
+        c_preproc_eval_depends(eval->pre, &tkn, false);
+        c_preproc_eval_advance(eval);
+
+    } else if (tkn.type == TOKENTYPE_OTHER && tkn.subtype == C_TKN_LPAR) {
+        c_preproc_eval_advance(eval);
+        res = c_preproc_eval_cond(eval, live);
+        if (eval->error) {
+            return res;
+        } else if (!c_preproc_eval_is(eval, C_TKN_RPAR)) {
+            return c_preproc_eval_fail(eval);
+        }
+        res.pos = pos_including(tkn.pos, eval->peek.pos);
+        c_preproc_eval_advance(eval);
+
+    } else if (tkn.type == TOKENTYPE_OTHER && c_preproc_is_prefix_op(tkn.subtype)) {
+        c_preproc_eval_advance(eval);
+        c_eval_value_t value = c_preproc_eval_unary(eval, live);
+        res.value            = c_preproc_eval_prefix(tkn.subtype, value.value);
+        res.is_signed        = tkn.subtype == C_TKN_LNOT || value.is_signed;
+        res.pos              = pos_including(tkn.pos, value.pos);
+
+    } else {
+        return c_preproc_eval_fail(eval);
+    }
+
+    return res;
+}
+
+// Evaluate the infix operators with a precedence of at least `min_prec`, by precedence climbing.
+// If `live` is false, the result is not used and division by zero is not reported.
+static c_eval_value_t c_preproc_eval_binary(c_eval_t *eval, int min_prec, bool live) {
+    c_eval_value_t lhs = c_preproc_eval_unary(eval, live);
+
+    while (!eval->error && eval->peek.type == TOKENTYPE_OTHER) {
+        c_tokentype_t oper = eval->peek.subtype;
+        int           prec = c_preproc_op_precedence(oper);
+        if (prec < min_prec) {
             break;
         }
+        c_preproc_eval_advance(eval);
+
+        // The right-hand side of `&&` and `||` is not evaluated if the left-hand side decides the result.
+        bool lhs_true = cmp128u(lhs.value, I128_ZERO) != 0;
+        bool rhs_live = live;
+        if (oper == C_TKN_LAND) {
+            rhs_live = live && lhs_true;
+        } else if (oper == C_TKN_LOR) {
+            rhs_live = live && !lhs_true;
+        }
+        c_eval_value_t rhs = c_preproc_eval_binary(eval, prec + 1, rhs_live);
+
+        bool is_signed = lhs.is_signed && rhs.is_signed;
+        if (oper == C_TKN_SHL || oper == C_TKN_SHR) {
+            // Shifts have the type of their left-hand side.
+            is_signed = lhs.is_signed;
+        }
+        if ((oper == C_TKN_DIV || oper == C_TKN_MOD) && cmp128u(rhs.value, I128_ZERO) == 0) {
+            if (live && !eval->error) {
+                cctx_diagnostic(eval->pre->shared->cctx, rhs.pos, DIAG_ERR, "Division by zero");
+            }
+            lhs.value = I128_ZERO;
+        } else {
+            lhs.value = c_preproc_eval_infix(is_signed, lhs.value, oper, rhs.value);
+        }
+        lhs.is_signed = is_signed;
+        lhs.pos       = pos_including(lhs.pos, rhs.pos);
+        switch (oper) {
+            case C_TKN_LT:
+            case C_TKN_LE:
+            case C_TKN_GT:
+            case C_TKN_GE:
+            case C_TKN_NE:
+            case C_TKN_EQ:
+            case C_TKN_LAND:
+            case C_TKN_LOR:
+                // Comparisons and logical operators result in an `int`.
+                lhs.is_signed = true;
+                break;
+            default: break;
+        }
+    }
+
+    return lhs;
+}
+
+// Evaluate a conditional expression; the top level of an `#if` condition.
+static c_eval_value_t c_preproc_eval_cond(c_eval_t *eval, bool live) {
+    c_eval_value_t cond = c_preproc_eval_binary(eval, 1, live);
+    if (eval->error || !c_preproc_eval_is(eval, C_TKN_QUESTION)) {
+        return cond;
     }
+    bool cond_true = cmp128u(cond.value, I128_ZERO) != 0;
+    c_preproc_eval_advance(eval);
+
+    c_eval_value_t lhs = c_preproc_eval_cond(eval, live && cond_true);
+    if (eval->error) {
+        return lhs;
+    } else if (!c_preproc_eval_is(eval, C_TKN_COLON)) {
+        return c_preproc_eval_fail(eval);
+    }
+    c_preproc_eval_advance(eval);
+    c_eval_value_t rhs = c_preproc_eval_cond(eval, live && !cond_true);
+
+    c_eval_value_t res = cond_true ? lhs : rhs;
+    res.is_signed      = lhs.is_signed && rhs.is_signed;
+    res.pos            = pos_including(cond.pos, rhs.pos);
+    return res;
+}
 
-    bool result;
-    if (stack.len == 0) {
+// Evaluate the condition for an `#if` or `#elif` directive, reading it one token at a time.
+static bool c_preproc_eval_line(c_preproc_t *pre, pos_t pos) {
+    c_eval_t eval = {
+        .pre  = pre,
+        .peek = c_preproc_eval_get_helper(pre),
+        .last = pos,
+    };
+    if (eval.peek.type == TOKENTYPE_EOL) {
         cctx_diagnostic(pre->shared->cctx, pos, DIAG_ERR, "Expected preprocessor expression");
-        result = false;
-    } else if (stack.len == 1 && stack.arr[0].type == ENTRY_VALUE) {
-        result = cmp128u(stack.arr[0].value.value, I128_ZERO) != 0;
+        return false;
+    }
+
+    pos_t          start = eval.peek.pos;
+    c_eval_value_t res   = c_preproc_eval_cond(&eval, true);
+    if (!eval.error && eval.peek.type == TOKENTYPE_EOL) {
+        return cmp128u(res.value, I128_ZERO) != 0;
+    }
+
+    // Consume the rest of the condition so that none of it is left in a macro expansion.
+    while (eval.peek.type != TOKENTYPE_EOL && eval.peek.type != TOKENTYPE_EOF) {
+        c_preproc_eval_advance(&eval);
+    }
+    tkn_delete(eval.peek);
+    cctx_diagnostic(pre->shared->cctx, pos_including(start, eval.last), DIAG_ERR, "Invalid preprocessor expression");
+    return false;
+}
+
+// Evaluate the condition for an `#if` or `#elif` directive.
+// In include files that are entered more than once, conditions that only depend on which macros are defined are
+// memoized by their position, so that evaluating them again only costs a few macro table lookups.
+static bool c_preproc_eval(c_preproc_t *pre, pos_t pos) {
+    c_incfile_t *file    = &pre->stack.arr[pre->stack.len - 1];
+    tokenizer_t *tkn_ctx = file->tkn_ctx;
+    if (!file->memo_conds || tkn_ctx->next != c_tkn_next || pos.srcfile != tkn_ctx->file
+        || c_preproc_expand_pending(pre)) {
+        // Only conditions tokenized straight from a source file can be skipped over.
+        return c_preproc_eval_line(pre, pos);
+    }
+
+    uint8_t const *key  = pos.srcfile->content + pos.off;
+    c_cond_memo_t *memo = map_get(&pre->shared->cond_memo, key);
+    if (memo && c_cond_memo_valid(pre, memo)) {
+        // Jump to the end of the line without tokenizing the condition.
+        tkn_rewind(tkn_ctx);
+        tkn_ctx->pos = memo->end;
+        return memo->result;
+    }
+
+    size_t diag_count   = pre->shared->cctx->diagnostics.len;
+    pre->cond_recording = true;
+    pre->cond_memo_ok   = true;
+    bool result         = c_preproc_eval_line(pre, pos);
+    pre->cond_recording = false;
+
+    token_t eol = c_preproc_raw_peek(pre);
+    if (pre->cond_memo_ok && pre->shared->cctx->diagnostics.len == diag_count && eol.type == TOKENTYPE_EOL
+        && eol.pos.srcfile == pos.srcfile) {
+        if (!memo) {
+            memo = lilycc_calloc(1, sizeof(c_cond_memo_t));
+            map_set(&pre->shared->cond_memo, key, memo);
+        }
+        vec_clear(&memo->defined);
+        vec_clear(&memo->undefined);
+        memo->macros_gen    = pre->shared->macros_gen;
+        memo->result        = result;
+        memo->end           = eol.pos;
+        memo->end.len       = 0;
+        memo->defined       = pre->cond_defined;
+        memo->undefined     = pre->cond_undefined;
+        pre->cond_defined   = (vec_name_t){0};
+        pre->cond_undefined = (vec_name_t){0};
     } else {
-        cctx_diagnostic(
-            pre->shared->cctx,
-            pos_including(stack.arr[0].pos, stack.arr[stack.len - 1].pos),
-            DIAG_ERR,
-            "Invalid preprocessor expression"
-        );
-        result = false;
+        pre->cond_defined.len   = 0;
+        pre->cond_undefined.len = 0;
     }
-    vec_clear(&stack);
     return result;
 }
 
@@ -854,7 +1262,7 @@ static bool c_preproc_eval(c_preproc_t *pre, pos_t pos) {
 #pragma region directives
 
 // Preprocessor directive: include.
-static void c_directive_include(c_preproc_t *pre, pos_t pos) {
+static void c_directive_include(c_preproc_t *pre, pos_t pos, bool include_next) {
     (void)pos;
     token_t tkn = c_preproc_get_pathspec(pre);
     if (tkn.type != TOKENTYPE_SCONST || tkn.subtype == C_STR_RAW_SQUOT) {
@@ -865,7 +1273,7 @@ static void c_directive_include(c_preproc_t *pre, pos_t pos) {
     // This needs to happen *before* the include file is pushed.
     c_preproc_until_eol(pre, true);
 
-    c_incfile_push(pre, tkn.pos, tkn.strval, tkn.subtype == C_STR_ANGLEBRAC);
+    c_incfile_push(pre, tkn.pos, tkn.strval, tkn.subtype == C_STR_ANGLEBRAC, include_next);
     tkn_delete(tkn);
 }
 
@@ -885,14 +1293,21 @@ static void c_directive_pragma(c_preproc_t *pre, pos_t pos) {
 static void c_directive_if(c_preproc_t *pre, pos_t pos, bool elif, bool ifdef, bool ifndef) {
     c_incfile_t *file = &pre->stack.arr[pre->stack.len - 1];
 
+    // The enclosing if directive of an `#elif` is one further down the stack than that of a new `#if`.
+    size_t parent_depth = elif ? 2 : 1;
+    bool   parent_emit  = file->ifdir.len < parent_depth || file->ifdir.arr[file->ifdir.len - parent_depth].do_emit;
+
     bool eval;
-    if (ifdef || ifndef) {
+    if (!parent_emit) {
+        // Conditions inside inactive groups are not evaluated.
+        eval = false;
+    } else if (ifdef || ifndef) {
         token_t tkn = c_preproc_get_tkn(pre, LINE_NOWS_RAW);
         if (tkn.type != TOKENTYPE_IDENT) {
             cctx_diagnostic(pre->shared->cctx, tkn.pos, DIAG_ERR, "Expected an identifier");
             return;
         }
-        eval = map_get(&pre->shared->macros, tkn.strval) != NULL;
+        eval = c_preproc_find_macro(pre, &tkn) != NULL;
         if (ifndef) {
             eval = !eval;
         }
@@ -900,7 +1315,6 @@ static void c_directive_if(c_preproc_t *pre, pos_t pos, bool elif, bool ifdef, b
         eval = c_preproc_eval(pre, pos);
     }
 
-    bool parent_emit = file->ifdir.len < 2 || file->ifdir.arr[file->ifdir.len - 2].do_emit;
     if (elif) {
         if (!file->ifdir.len) {
             cctx_diagnostic(pre->shared->cctx, pos, DIAG_ERR, "#elif without matching #if");
@@ -1058,7 +1472,7 @@ static void c_directive_define(c_preproc_t *pre, pos_t pos) {
         goto error;
     }
 
-    c_macro_t *existing = map_get(&pre->shared->macros, name.strval);
+    c_macro_t *existing = c_preproc_find_macro(pre, &name);
     if (existing) {
         cctx_diagnostic(
             pre->shared->cctx,
@@ -1070,7 +1484,9 @@ static void c_directive_define(c_preproc_t *pre, pos_t pos) {
         );
         c_macro_destroy(existing);
     }
-    map_set(&pre->shared->macros, name.strval, macro);
+    char const *key = strpool_intern(&pre->shared->cctx->idents, name.strval, name.strval_len);
+    c_preproc_macro_changed(pre, key);
+    map_set(&pre->shared->macros, key, macro);
     tkn_delete(name);
     return;
 
@@ -1097,7 +1513,8 @@ static void c_directive_undef(c_preproc_t *pre, pos_t pos) {
         return;
     }
 
-    c_macro_t *macro = map_get(&pre->shared->macros, name.strval);
+    char const *key   = c_preproc_macro_key(pre, &name);
+    c_macro_t  *macro = key ? map_get(&pre->shared->macros, key) : NULL;
     if (!macro) {
         // Nothing to do.
         return;
@@ -1106,7 +1523,8 @@ static void c_directive_undef(c_preproc_t *pre, pos_t pos) {
     if (macro->is_builtin) {
         cctx_diagnostic(pre->shared->cctx, name.pos, DIAG_WARN, "Undefining a built-in macro");
     }
-    map_remove(&pre->shared->macros, name.strval);
+    c_preproc_macro_changed(pre, key);
+    map_remove(&pre->shared->macros, key);
     c_macro_destroy(macro);
 }
 
@@ -1121,6 +1539,7 @@ static void c_preproc_directive(c_preproc_t *pre) {
         tkn_delete(name);
         return;
     }
+    c_incfile_guard_directive(pre, &name);
 
     // The if directives are always processed.
     if (!strcmp(name.strval, "if")) {
@@ -1145,9 +1564,13 @@ static void c_preproc_directive(c_preproc_t *pre) {
         tkn_delete(name);
         return;
     } else if (!strcmp(name.strval, "include")) {
-        c_directive_include(pre, name.pos);
+        c_directive_include(pre, name.pos, false);
         tkn_delete(name);
         return; // `#include` pushes files to the stack, so it consumes until EOL itself.
+    } else if (!strcmp(name.strval, "include_next")) {
+        c_directive_include(pre, name.pos, true);
+        tkn_delete(name);
+        return;
     } else if (!strcmp(name.strval, "pragma")) {
         c_directive_pragma(pre, name.pos);
     } else if (!strcmp(name.strval, "warning")) {
@@ -1235,6 +1658,8 @@ static char *c_preproc_read_bytes(c_preproc_t *pre, pos_t *pos_out) {
 static token_t c_preproc_get_pathspec(c_preproc_t *pre) {
     token_t init = c_preproc_get_tkn(pre, LINE_NOWS_EXPAND);
     if (init.type != TOKENTYPE_OTHER || init.subtype != C_TKN_LT) {
+        // The path is used as a C-string.
+        tkn_own_strval(&init);
         return init;
     }
     // Consume the `<`.
@@ -1316,6 +1741,14 @@ static bool c_preproc_do_emit(c_preproc_t *pre) {
     return file->ifdir.len == 0 || file->ifdir.arr[file->ifdir.len - 1].do_emit;
 }
 
+// Get the EOF token at the end of a macro argument that is being pre-expanded.
+static token_t c_preproc_arg_eof(c_expansion_t const *expand) {
+    return (token_t){
+        .pos  = expand->arg->pos,
+        .type = TOKENTYPE_EOF,
+    };
+}
+
 // Look past any whitespace tokens in the current raw stream without consuming them.
 // Returns the first non-whitespace token (or EOF), and writes the number of
 // skipped whitespace tokens to `*ws_out`. The caller can commit by calling
@@ -1324,7 +1757,7 @@ static token_t c_preproc_raw_peek_nonws(c_preproc_t *pre, size_t *ws_out) {
     size_t ws = 0;
 
     // Walk the macro expansion stack from top to bottom.
-    for (size_t i = pre->expand.len; i-- > 0;) {
+    for (size_t i = pre->expand.len; i-- > pre->expand_base;) {
         c_expansion_t *expand = &pre->expand.arr[i];
         for (size_t j = expand->index; j < expand->tokens.len; j++) {
             if (expand->tokens.arr[j].type == TOKENTYPE_WHITESPACE) {
@@ -1336,6 +1769,12 @@ static token_t c_preproc_raw_peek_nonws(c_preproc_t *pre, size_t *ws_out) {
                 return expand->tokens.arr[j];
             }
         }
+        if (expand->arg) {
+            if (ws_out) {
+                *ws_out = ws;
+            }
+            return c_preproc_arg_eof(expand);
+        }
     }
 
     // Walk the include-file stack from top to bottom.
@@ -1365,13 +1804,25 @@ static token_t c_preproc_raw_peek_nonws(c_preproc_t *pre, size_t *ws_out) {
     return (token_t){.type = TOKENTYPE_EOF};
 }
 
+// Whether any macro expansion has tokens left to emit.
+static bool c_preproc_expand_pending(c_preproc_t *pre) {
+    for (size_t i = 0; i < pre->expand.len; i++) {
+        if (pre->expand.arr[i].index < pre->expand.arr[i].tokens.len) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // Helper function for `c_preproc_get_tkn` that peeks raw tokens, first from macros, then from the srcfiles.
 static token_t c_preproc_raw_peek(c_preproc_t *pre) {
     // First check the macro stack.
-    for (size_t i = pre->expand.len - 1; i != SIZE_MAX; i--) {
+    for (size_t i = pre->expand.len; i-- > pre->expand_base;) {
         c_expansion_t *expand = &pre->expand.arr[i];
         if (expand->index < expand->tokens.len) {
             return expand->tokens.arr[expand->index];
+        } else if (expand->arg) {
+            return c_preproc_arg_eof(expand);
         }
     }
 
@@ -1387,17 +1838,72 @@ static token_t c_preproc_raw_peek(c_preproc_t *pre) {
     return tkn_peek(pre->stack.arr[0].tkn_ctx);
 }
 
+// Peek the next raw token after the macro invocation whose arguments are being pre-expanded, if any.
+// Used by built-in macros that refer to the current position in the source.
+static token_t c_preproc_outer_peek(c_preproc_t *pre) {
+    size_t expand_len  = pre->expand.len;
+    size_t expand_base = pre->expand_base;
+    for (size_t i = 0; i < pre->expand.len; i++) {
+        if (pre->expand.arr[i].arg) {
+            pre->expand.len = i;
+            break;
+        }
+    }
+    pre->expand_base = 0;
+
+    token_t peek = c_preproc_raw_peek(pre);
+
+    pre->expand.len  = expand_len;
+    pre->expand_base = expand_base;
+    return peek;
+}
+
+// Get the hide depth of the next raw token: the number of entries at the bottom of the expansion stack that it
+// was produced by, or 0 if it is read from a file.
+static size_t c_preproc_raw_depth(c_preproc_t *pre) {
+    for (size_t i = pre->expand.len; i-- > pre->expand_base;) {
+        c_expansion_t const *expand = &pre->expand.arr[i];
+        if (expand->arg) {
+            return expand->arg->hide_depth;
+        } else if (expand->index < expand->tokens.len) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Whether a macro may not be expanded because it is already being expanded.
+// Macros expanded below `expand_base` are only hidden if the argument being pre-expanded came from them.
+static bool c_preproc_macro_hidden(c_preproc_t *pre, c_macro_t const *macro) {
+    size_t hide_depth = pre->expand_base ? pre->expand.arr[pre->expand_base].arg->hide_depth : 0;
+    for (size_t depth = macro->expand_depth; depth; depth = pre->expand.arr[depth - 1].prev_depth) {
+        if (depth > pre->expand_base || depth <= hide_depth) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // Helper function for `c_preproc_get_tkn` that gets raw tokens, first from macros, then from the srcfiles.
 static token_t c_preproc_raw_next(c_preproc_t *pre) {
     token_t tkn;
 
     // First check the macro stack.
-    for (size_t i = pre->expand.len - 1; i != SIZE_MAX; i--) {
+    for (size_t i = pre->expand.len; i-- > pre->expand_base;) {
         c_expansion_t *expand = &pre->expand.arr[i];
+        if (expand->arg) {
+            // The argument stays owned by the macro invocation it came from.
+            if (expand->index < expand->tokens.len) {
+                tkn = tkn_clone(&expand->tokens.arr[expand->index++]);
+                goto emit;
+            }
+            return c_preproc_arg_eof(expand);
+        }
         if (expand->index < expand->tokens.len) {
             tkn = expand->tokens.arr[expand->index++];
             goto emit;
         }
+        expand->macro->expand_depth = expand->prev_depth;
         vec_clear(&expand->tokens);
         pre->expand.len--;
     }
@@ -1410,12 +1916,17 @@ static token_t c_preproc_raw_next(c_preproc_t *pre) {
         } else {
             goto emit;
         }
+        c_incfile_guard_eof(pre);
         c_incfile_eof(pre);
         c_incfile_pop(pre);
     }
 
     // Check source file; if it EOFs, just return it verbatim.
     tkn = tkn_next(pre->stack.arr[0].tkn_ctx);
+    if (tkn.type == TOKENTYPE_EOF) {
+        // Record the guard of the main file too, so a precompiled header made from it can skip re-including it.
+        c_incfile_guard_eof(pre);
+    }
 
 emit:
     if (tkn.type == TOKENTYPE_EOL) {
@@ -1427,6 +1938,24 @@ emit:
     return tkn;
 }
 
+// Record an identifier looked up while pre-expanding a macro argument to memoize.
+static void c_preproc_memo_record(c_preproc_t *pre, token_t const *name, c_macro_t *macro) {
+    if (name->subtype == C_PPNUMBER) {
+        // Preprocessing numbers can't be macro names.
+        return;
+    }
+    char const *key = c_preproc_macro_key(pre, name);
+    if (!key) {
+        // A name that was never interned can't be found in `arg_memo_deps` when it gets defined later.
+        pre->memo_ok = false;
+        return;
+    }
+    set_add(&pre->shared->arg_memo_deps, key);
+    if (macro) {
+        vec_push(&pre->memo_macros, macro);
+    }
+}
+
 // Get the next token for preprocessing.
 static token_t c_preproc_get_tkn(c_preproc_t *pre, next_mode_t mode) {
     bool do_expand;
@@ -1487,15 +2016,20 @@ again:
     if (tkn.type != TOKENTYPE_IDENT || !do_expand) {
         return tkn;
     }
-    c_macro_t const *macro = map_get(&pre->shared->macros, tkn.strval);
+    c_macro_t *macro = c_preproc_find_macro(pre, &tkn);
+    if (pre->memo_recording) {
+        c_preproc_memo_record(pre, &tkn, macro);
+    }
+    if (pre->cond_recording && macro) {
+        // Conditions that expand macros are not memoized.
+        pre->cond_memo_ok = false;
+    }
     if (!macro) {
         return tkn;
     }
     // Check that this macro wasn't already expanded.
-    for (size_t i = 0; i < pre->expand.len; i++) {
-        if (pre->expand.arr[i].macro == macro) {
-            return tkn;
-        }
+    if (c_preproc_macro_hidden(pre, macro)) {
+        return tkn;
     }
 
     if (macro->uses_args) {
@@ -1509,6 +2043,9 @@ again:
             tkn_delete(c_preproc_raw_next(pre));
         }
     }
+    if (macro->pch_body) {
+        c_pch_materialize(pre, macro);
+    }
     c_macro_expand(pre, tkn.pos, macro);
     tkn_delete(tkn);
     goto again;
@@ -1520,6 +2057,18 @@ again:
 token_t c_preproc_next(tokenizer_t *ctx) {
     c_preproc_t *pre = (c_preproc_t *)ctx;
 
+    // Replay the output of a precompiled prefix header first.
+    while (pre->pch_index < pre->pch_tokens.len) {
+        token_t tkn = pre->pch_tokens.arr[pre->pch_index++];
+        if (pre->raw_mode) {
+            return tkn;
+        } else if (tkn.type == TOKENTYPE_WHITESPACE || tkn.type == TOKENTYPE_EOL) {
+            tkn_delete(tkn);
+        } else {
+            return c_preproc_tkn_to_c_tkn(pre, tkn);
+        }
+    }
+
 again:
     if (pre->no_directives || !pre->blank_line) {
         goto emit;
@@ -1535,7 +2084,8 @@ again:
     goto again;
 
 emit:
-    if (c_preproc_do_emit(pre)) {
+    c_incfile_guard_content(pre);
+    if (c_preproc_do_emit(pre) && !pre->directives_only) {
         token_t tkn = c_preproc_get_tkn(pre, NEXT_EXPAND);
         if (!pre->raw_mode) {
             if (tkn.type == TOKENTYPE_WHITESPACE || tkn.type == TOKENTYPE_EOL) {
@@ -1546,6 +2096,21 @@ emit:
         }
         return tkn;
     } else {
+        c_incfile_t *file = &pre->stack.arr[pre->stack.len - 1];
+        if (pre->blank_line && file->tkn_ctx->next == c_tkn_next && !c_preproc_expand_pending(pre)) {
+            // Jump straight to the next directive without tokenizing the lines in between.
+            if (c_tkn_skip_group((c_tokenizer_t *)file->tkn_ctx)) {
+                goto again;
+            }
+        }
+        if (pre->stack.len == 1 && c_preproc_raw_peek(pre).type == TOKENTYPE_EOF) {
+            if (pre->directives_only && !file->ifdir.len) {
+                return c_preproc_raw_next(pre);
+            }
+            // Report the unterminated directives so that the root file's EOF can be emitted.
+            c_incfile_eof(pre);
+            goto again;
+        }
         do {
             tkn_delete(c_preproc_get_tkn(pre, NEXT_RAW));
         } while (!pre->blank_line);
@@ -1563,23 +2128,18 @@ token_t c_preproc_tkn_to_c_tkn(c_preproc_t *pre, token_t tkn) {
         tkn_delete(tkn);
         return res;
     } else if (tkn.type == TOKENTYPE_IDENT) {
-        c_keyw_t keyw = c_keyw_get(pre->shared->options->c_std, tkn.strval);
+        c_keyw_t keyw = c_keyw_get(pre->shared->options->c_std, tkn.strval, tkn.strval_len);
         if (keyw >= C_N_KEYWS) {
             return tkn;
         }
-        // Replace alternate spellings with the main spelling, matching the
-        // mapping the C tokenizer applies when not in preprocessor mode.
-#define C_ALT_KEYW_DEF(main_spelling, alt_spelling)                                                                    \
-    if (keyw == C_KEYW_##main_spelling) {                                                                              \
-        keyw = C_KEYW_##alt_spelling;                                                                                  \
-    }
-#include "c_keywords.inc"
         pos_t pos = tkn.pos;
         tkn_delete(tkn);
+        // Replace alternate spellings with the main spelling, matching the
+        // mapping the C tokenizer applies when not in preprocessor mode.
         return (token_t){
             .pos     = pos,
             .type    = TOKENTYPE_KEYWORD,
-            .subtype = keyw,
+            .subtype = c_keyw_main(keyw),
         };
     } else if (tkn.type == TOKENTYPE_SCONST && tkn.subtype != C_STR_ANGLEBRAC) {
         token_t res = c_tkn_conv_str(pre->shared->cctx, pre->shared->options->c_std, &tkn);
@@ -1593,7 +2153,25 @@ token_t c_preproc_tkn_to_c_tkn(c_preproc_t *pre, token_t tkn) {
 
 // Add a command-line or predefined macro.
 void c_preproc_add_macro(c_preproc_t *pre, char const *name, c_macro_t *macro) {
-    map_set(&pre->shared->macros, name, macro);
+    char const *key = strpool_intern(&pre->shared->cctx->idents, name, strlen(name));
+    c_preproc_macro_changed(pre, key);
+    map_set(&pre->shared->macros, key, macro);
+}
+
+// Get the interned name of an identifier token for use as a key in the macros map.
+// Returns NULL if the name was never interned, in which case it can't be the name of a macro.
+static char const *c_preproc_macro_key(c_preproc_t *pre, token_t const *name) {
+    if (name->strval_interned) {
+        return name->strval;
+    }
+    // Identifiers created by pasting tokens are not interned.
+    return strpool_find(&pre->shared->cctx->idents, name->strval, name->strval_len);
+}
+
+// Look up the macro named by an identifier token, if any.
+static c_macro_t *c_preproc_find_macro(c_preproc_t *pre, token_t const *name) {
+    char const *key = c_preproc_macro_key(pre, name);
+    return key ? map_get(&pre->shared->macros, key) : NULL;
 }
 
 // Mark argument substitutions adjacent to a `##` token with the `pasting` flag.
@@ -1771,7 +2349,9 @@ static bool c_macro_parse_body(c_macro_t *macro, tokenizer_t *tkn_ctx) {
 }
 
 // Create a regular macro.
-c_macro_t *c_macro_create(c_options_t const *options, char const *virt_file, char const *spec, char **name_out) {
+c_macro_t *c_macro_create(
+    strpool_t *idents, c_options_t const *options, char const *virt_file, char const *spec, char **name_out
+) {
     cctx_t    *cctx     = cctx_create();
     size_t     spec_len = strlen(spec);
     srcfile_t *src      = srcfile_create(cctx, virt_file, spec, spec_len);
@@ -1885,6 +2465,7 @@ c_macro_t *c_macro_create(c_options_t const *options, char const *virt_file, cha
         // just past the '='.
         tkn               = c_tkn_create_impl(src, options);
         tkn->preproc_mode = true;
+        tkn->idents       = idents;
         tkn->base.pos.off = (off_t)i;
         tkn->base.pos.col = (int)i;
         if (!c_macro_parse_body(macro, &tkn->base)) {
@@ -1899,6 +2480,20 @@ c_macro_t *c_macro_create(c_options_t const *options, char const *virt_file, cha
         goto error;
     }
 
+    // Strings may borrow from `spec`'s source file, which is freed with the temporary context.
+    if (!macro->is_proc_macro) {
+        for (size_t i = 0; i < macro->regular.subst.len; i++) {
+            c_macro_subst_t *subst = &macro->regular.subst.arr[i];
+            if (subst->type == C_SUBST_TOKEN) {
+                tkn_own_strval(&subst->token);
+            } else if (subst->type == C_SUBST_VA_OPT) {
+                for (size_t j = 0; j < subst->va_opt.tokens.len; j++) {
+                    tkn_own_strval(&subst->va_opt.tokens.arr[j]);
+                }
+            }
+        }
+    }
+
     if (tkn) {
         tkn_ctx_delete(&tkn->base);
     }
@@ -1927,7 +2522,7 @@ error:
 
 // Create a procedural macro.
 c_macro_t *c_proc_macro_create(bool uses_args, c_proc_macro_cb_t callback, void *cookie) {
-    c_macro_t *macro     = lilycc_malloc(sizeof(c_macro_t));
+    c_macro_t *macro     = lilycc_calloc(1, sizeof(c_macro_t));
     macro->is_proc_macro = true;
     macro->uses_args     = uses_args;
     macro->proc.callback = callback;
@@ -1955,7 +2550,6 @@ void c_macro_destroy(c_macro_t *macro) {
                 }
                 vec_clear(&subst->va_opt.tokens);
                 vec_clear(&subst->va_opt.expanded);
-                lilycc_free(subst->va_opt.stringized);
                 vec_clear(&subst->va_opt.ws_before);
             }
         }
@@ -1965,20 +2559,8 @@ void c_macro_destroy(c_macro_t *macro) {
 }
 
 // Paste two preprocessing tokens together.
+// The spelling of the result is classified directly instead of being tokenized again.
 static bool c_preproc_tkn_paste(c_preproc_t *pre, token_t const *lhs, token_t const *rhs, token_t *out) {
-    vec_char_t buf = {0};
-
-    c_tkn_append_src(lhs, &buf.arr, &buf.len, &buf.cap);
-    c_tkn_append_src(rhs, &buf.arr, &buf.len, &buf.cap);
-    size_t strval_len = buf.len;
-    vec_push(&buf, '\0');
-    token_t tkn = (token_t){
-        .pos        = pos_including(lhs->pos, rhs->pos),
-        .type       = TOKENTYPE_IDENT,
-        .strval     = buf.arr,
-        .strval_len = strval_len,
-    };
-
     // In macro expansion, *placemarker* tokens may be created temporarily.
     // Lily-CC encodes these as empty identifiers.
     // Concatenations of two placemarkers returns another,
@@ -1993,105 +2575,156 @@ static bool c_preproc_tkn_paste(c_preproc_t *pre, token_t const *lhs, token_t co
         return true;
     }
 
-    // Check for symbolic tokens.
-    for (int i = 0; i < C_N_TKNS; i++) {
-        if (!strcmp(tkn.strval, c_token_name[i])) {
-            tkn.type    = TOKENTYPE_OTHER;
-            tkn.subtype = i;
-            lilycc_free(tkn.strval);
-            tkn.strval     = NULL;
-            tkn.strval_len = 0;
-            *out           = tkn;
-            return true;
-        }
-    }
+    // Pasted tokens are nearly always short enough for the stack buffer.
+    cctx_t *cctx    = pre->shared->cctx;
+    size_t  lhs_len = c_tkn_src_len(lhs);
+    size_t  len     = lhs_len + c_tkn_src_len(rhs);
+    char    stack_buf[64];
+    char   *buf = len <= sizeof(stack_buf) ? stack_buf : lilycc_malloc(len);
+    c_tkn_write_src(lhs, buf);
+    c_tkn_write_src(rhs, buf + lhs_len);
 
-    // On matching arms, the relevant lexical syntax specification is shown.
-    // The following are checks in case `lhs` is a pp-number (C23 §6.4.9).
-    bool lhs_numeric = lhs->type == TOKENTYPE_IDENT && lhs->strval[0] >= '0' && lhs->strval[0] <= '9';
-    char lhs_last    = lhs->type == TOKENTYPE_IDENT ? lhs->strval[lhs->strval_len - 1] : 0;
-    if (lhs_numeric && rhs->type == TOKENTYPE_IDENT) {
-        // pp-number identifier-continue
-        // pp-number digit
-        // pp-number `.` digit
-        *out = tkn;
-        return true;
+    // The result must be exactly one identifier (C23 §6.4.3.1), pp-number (C23 §6.4.9) or punctuator (C23 §6.4.7).
+    *out = (token_t){
+        .pos = pos_including(lhs->pos, rhs->pos),
+    };
+    bool          valid = true;
+    c_tokentype_t punct;
+    if (c_is_first_sym_char(buf[0])) {
+        for (size_t i = 1; valid && i < len; i++) {
+            valid = c_is_sym_char(buf[i]);
+        }
+        if (valid) {
+            out->type            = TOKENTYPE_IDENT;
+            out->subtype         = C_IDENT;
+            out->strval          = (char *)strpool_intern(&cctx->idents, buf, len);
+            out->strval_len      = len;
+            out->strval_interned = true;
+        }
+    } else if (c_is_ppnumber(buf, len)) {
+        out->type            = TOKENTYPE_IDENT;
+        out->subtype         = C_PPNUMBER;
+        out->strval          = tkn_arena_strval(cctx, buf, len);
+        out->strval_len      = len;
+        out->strval_borrowed = true;
+    } else if ((punct = c_tkn_punct_get(buf, len)) < C_N_TKNS) {
+        out->type    = TOKENTYPE_OTHER;
+        out->subtype = punct;
+    } else {
+        valid = false;
     }
-    if (lhs_numeric && rhs->type == TOKENTYPE_OTHER && rhs->subtype == C_TKN_DOT) {
-        // pp-number `.`
-        *out = tkn;
-        return true;
+
+    if (!valid) {
+        cctx_diagnostic(
+            cctx,
+            out->pos,
+            DIAG_ERR,
+            "Pasting would create `%.*s`, an invalid preprocessing token",
+            (int)len,
+            buf
+        );
     }
-    if (lhs_numeric && (lhs_last == 'e' || lhs_last == 'E' || lhs_last == 'p' || lhs_last == 'P')
-        && rhs->type == TOKENTYPE_OTHER && (rhs->subtype == C_TKN_ADD || rhs->subtype == C_TKN_SUB)) {
-        // pp-number `e` sign
-        // pp-number `E` sign
-        // pp-number `p` sign
-        // pp-number `P` sign
-        *out = tkn;
-        return true;
+    if (buf != stack_buf) {
+        lilycc_free(buf);
     }
+    return valid;
+}
 
-    // The following are checks in case `lhs` is an identifier (C23 §6.4.3.1).
-    if (lhs->type == TOKENTYPE_IDENT && rhs->type == TOKENTYPE_IDENT) {
-        // identifier identifier-continue
-        *out = tkn;
-        return true;
+// Count the `\` and `"` in the source representation of a token, which need escaping in a string.
+// Only strings, comments and garbage can contain them.
+static size_t c_macro_stringize_escapes(token_t const *tkn) {
+    size_t count = 0;
+    if (tkn->type == TOKENTYPE_SCONST && tkn->subtype == C_STR_RAW_DQUOT) {
+        count = 2;
+    } else if (tkn->type != TOKENTYPE_SCONST && tkn->type != TOKENTYPE_WHITESPACE && tkn->type != TOKENTYPE_GARBAGE) {
+        return 0;
     }
-
-    // If we get here, the resulting token is invalid.
-    cctx_diagnostic(
-        pre->shared->cctx,
-        tkn.pos,
-        DIAG_ERR,
-        "Pasting would create `%s`, an invalid preprocessing token",
-        tkn.strval
-    );
-    tkn_delete(tkn);
-    return false;
+    for (size_t i = 0; i < tkn->strval_len; i++) {
+        count += tkn->strval[i] == '\\' || tkn->strval[i] == '"';
+    }
+    return count;
 }
 
 // Stringize a function-like macro argument (`#` operator).
 // Builds the source-form of the argument's tokens with a single space between
 // tokens that were separated by whitespace in the original input, then escapes
 // `\` and `"` for use inside a double-quoted preprocessor string token.
-static token_t c_macro_arg_stringize(c_macro_arg_t *arg, pos_t pos) {
+// The result is sized up front and written once, into the token arena.
+static token_t c_macro_arg_stringize(cctx_t *cctx, c_macro_arg_t *arg, pos_t pos) {
     if (arg->stringized == NULL) {
-        // Build the unescaped source-form.
-        vec_char_t src = {0};
+        size_t len = 0;
         for (size_t i = 0; i < arg->tokens.len; i++) {
-            if (i > 0 && arg->ws_before.arr[i]) {
-                vec_push(&src, ' ');
-            }
-            c_tkn_append_src(&arg->tokens.arr[i], &src.arr, &src.len, &src.cap);
+            len += (i > 0 && arg->ws_before.arr[i]) + c_tkn_src_len(&arg->tokens.arr[i]);
+            len += c_macro_stringize_escapes(&arg->tokens.arr[i]);
         }
 
-        // Escape `\` and `"` and NUL-terminate. Preprocessor strings have C-string
-        // syntax with unprocessed escape sequences, so any literal `\` or `"` in
-        // the source-form must be escaped.
-        vec_char_t out = {0};
-        for (size_t i = 0; i < src.len; i++) {
-            if (src.arr[i] == '\\' || src.arr[i] == '"') {
-                vec_push(&out, '\\');
+        char *buf = arena_alloc(&cctx->tkn_arena, len + 1);
+        char *out = buf;
+        for (size_t i = 0; i < arg->tokens.len; i++) {
+            token_t const *tkn     = &arg->tokens.arr[i];
+            size_t         escapes = c_macro_stringize_escapes(tkn);
+            if (i > 0 && arg->ws_before.arr[i]) {
+                *out++ = ' ';
+            }
+            if (!escapes) {
+                out = c_tkn_write_src(tkn, out);
+                continue;
+            }
+            // Write the token past where it goes, then move it into place while inserting the escapes.
+            // The escaped copy never catches up with the characters it has yet to read.
+            char const *src = out + escapes;
+            char const *end = c_tkn_write_src(tkn, out + escapes);
+            while (src < end) {
+                if (*src == '\\' || *src == '"') {
+                    *out++ = '\\';
+                }
+                *out++ = *src++;
             }
-            vec_push(&out, src.arr[i]);
         }
-        vec_push(&out, '\0');
-        vec_clear(&src);
+        *out = '\0';
 
         // Cache the stringized value.
-        arg->stringized = out.arr;
+        arg->stringized     = buf;
+        arg->stringized_len = len;
     }
 
     return (token_t){
-        .pos        = pos,
-        .type       = TOKENTYPE_SCONST,
-        .subtype    = C_STR_RAW_DQUOT,
-        .strval     = lilycc_strdup(arg->stringized),
-        .strval_len = strlen(arg->stringized),
+        .pos             = pos,
+        .type            = TOKENTYPE_SCONST,
+        .subtype         = C_STR_RAW_DQUOT,
+        .strval          = arg->stringized,
+        .strval_len      = arg->stringized_len,
+        .strval_borrowed = true,
     };
 }
 
+// Whether a memoized argument pre-expansion that looked up `macros` gives the same result here.
+// It doesn't if it used procedural macros, which may expand differently every time, or if any of the macros are
+// disabled because the argument came from their expansion.
+static bool c_arg_memo_usable(c_preproc_t *pre, vec_macro_ptr_t const *macros) {
+    for (size_t i = 0; i < macros->len; i++) {
+        if (macros->arr[i]->is_proc_macro || c_preproc_macro_hidden(pre, macros->arr[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Memoize the pre-expansion of a macro argument.
+static void c_arg_memo_store(c_preproc_t *pre, c_macro_arg_t const *arg) {
+    c_arg_memo_t *memo = lilycc_calloc(1, sizeof(c_arg_memo_t));
+    for (size_t i = 0; i < arg->tokens.len; i++) {
+        vec_push(&memo->tokens, tkn_clone(&arg->tokens.arr[i]));
+    }
+    for (size_t i = 0; i < arg->expanded.len; i++) {
+        vec_push(&memo->expanded, tkn_clone(&arg->expanded.arr[i]));
+    }
+    for (size_t i = 0; i < pre->memo_macros.len; i++) {
+        vec_push(&memo->macros, pre->memo_macros.arr[i]);
+    }
+    map_set(&pre->shared->arg_memo, &memo->tokens, memo);
+}
+
 // Pre-expand a function-like macro argument.
 // If it would expand to an empty sequence (or already is), then `expanded` is set to a single placemarker token.
 static void c_macro_arg_preexpand(c_preproc_t *pre, c_macro_arg_t *arg) {
@@ -2100,21 +2733,39 @@ static void c_macro_arg_preexpand(c_preproc_t *pre, c_macro_arg_t *arg) {
         return;
     }
 
-    c_preproc_t *recurse   = c_preproc_create_nested(pre);
-    recurse->keep_comments = false;
-    recurse->raw_mode      = true;
-    recurse->no_directives = true;
-
-    // Note: EOF pos not important, just needs to be valid.
-    tkn_array_t *arr_tkn = tkn_array_create(arg->tokens.arr, arg->tokens.len, arg->pos);
-    c_incfile_t  incfile = {
-        .tkn_ctx = &arr_tkn->base,
-        .ifdir   = {0},
+    // Expand the argument on top of the expansion stack, hiding the expansions below it for the duration.
+    // Macros being expanded below the argument can therefore be expanded again inside of it.
+    size_t        prev_base  = pre->expand_base;
+    bool          prev_blank = pre->blank_line;
+    c_expansion_t expand     = {
+        .tokens = arg->tokens,
+        .arg    = arg,
     };
-    vec_push(&recurse->stack, incfile);
+    vec_push(&pre->expand, expand);
+    pre->expand_base = pre->expand.len - 1;
+
+    // Arguments pre-expanded while recording are part of the recorded one and aren't memoized separately.
+    bool   record     = pre->shared->memo_args && !pre->memo_recording;
+    size_t diag_count = pre->shared->cctx->diagnostics.len;
+    if (record) {
+        c_arg_memo_t *memo = map_get(&pre->shared->arg_memo, &arg->tokens);
+        if (memo && c_arg_memo_usable(pre, &memo->macros)) {
+            for (size_t i = 0; i < memo->expanded.len; i++) {
+                vec_push(&arg->expanded, tkn_clone(&memo->expanded.arr[i]));
+            }
+            goto done;
+        }
+        // Keep the existing memo if it just doesn't apply here.
+        record = !memo;
+    }
+    if (record) {
+        pre->memo_recording  = true;
+        pre->memo_ok         = true;
+        pre->memo_macros.len = 0;
+    }
 
     while (1) {
-        token_t tkn = tkn_next(&recurse->base);
+        token_t tkn = c_preproc_get_tkn(pre, NEXT_EXPAND);
         if (tkn.type == TOKENTYPE_EOF) {
             tkn_delete(tkn);
             break;
@@ -2126,8 +2777,6 @@ static void c_macro_arg_preexpand(c_preproc_t *pre, c_macro_arg_t *arg) {
         }
     }
 
-    tkn_ctx_delete(&recurse->base);
-
     // Empty result, replace with one placemarker.
     if (arg->expanded.len == 0) {
         token_t marker = {
@@ -2137,10 +2786,26 @@ static void c_macro_arg_preexpand(c_preproc_t *pre, c_macro_arg_t *arg) {
         };
         vec_push(&arg->expanded, marker);
     }
+
+    if (record) {
+        // Diagnostics would not be repeated when reusing the expansion, so it is not memoized if there were any.
+        pre->memo_recording = false;
+        if (pre->memo_ok && pre->shared->cctx->diagnostics.len == diag_count
+            && c_arg_memo_usable(pre, &pre->memo_macros)) {
+            c_arg_memo_store(pre, arg);
+        }
+    }
+
+done:
+    // Expansions inside the argument were all popped on the way to its end.
+    assert(pre->expand.len == pre->expand_base + 1 && pre->expand.arr[pre->expand_base].arg == arg);
+    pre->expand.len  = pre->expand_base;
+    pre->expand_base = prev_base;
+    pre->blank_line  = prev_blank;
 }
 
 // Perform macro-expansion.
-static void c_macro_expand(c_preproc_t *pre, pos_t pos, c_macro_t const *macro) {
+static void c_macro_expand(c_preproc_t *pre, pos_t pos, c_macro_t *macro) {
     vec_macro_arg_t args = {0};
     // TODO: Add expansion info to the position.
 
@@ -2164,12 +2829,13 @@ static void c_macro_expand(c_preproc_t *pre, pos_t pos, c_macro_t const *macro)
         } else {
             // Collect tokens for each argument. Parentheses nest, and at depth > 0
             // commas are part of the argument rather than separators.
-            int         depth   = 0;
-            vec_token_t cur     = {0};
-            vec_bool_t  cur_ws  = {0};
-            bool        saw_ws  = false;
-            bool        has_pos = false;
-            size_t      lim     = SIZE_MAX;
+            int         depth      = 0;
+            vec_token_t cur        = {0};
+            vec_bool_t  cur_ws     = {0};
+            bool        saw_ws     = false;
+            bool        has_pos    = false;
+            size_t      lim        = SIZE_MAX;
+            size_t      hide_depth = 0;
             pos_t       arg_pos; // Start position of the argument.
             if (!macro->is_proc_macro && macro->regular.is_variadic) {
                 lim = macro->regular.args.len;
@@ -2212,21 +2878,27 @@ static void c_macro_expand(c_preproc_t *pre, pos_t pos, c_macro_t const *macro)
                     bool is_end = p.subtype == C_TKN_RPAR;
                     tkn_delete(c_preproc_raw_next(pre));
                     c_macro_arg_t arg = {
-                        .pos       = pos_between(arg_pos, p.pos),
-                        .tokens    = cur,
-                        .ws_before = cur_ws,
+                        .pos        = pos_between(arg_pos, p.pos),
+                        .tokens     = cur,
+                        .ws_before  = cur_ws,
+                        .hide_depth = hide_depth,
                     };
                     vec_push(&args, arg);
                     if (is_end) {
                         break;
                     }
                     cur     = (vec_token_t){0};
-                    cur_ws  = (vec_bool_t){0};
-                    saw_ws  = false;
-                    has_pos = false;
+                    cur_ws     = (vec_bool_t){0};
+                    saw_ws     = false;
+                    has_pos    = false;
+                    hide_depth = 0;
                     continue;
                 }
 
+                size_t t_depth = c_preproc_raw_depth(pre);
+                if (t_depth > hide_depth) {
+                    hide_depth = t_depth;
+                }
                 token_t t = c_preproc_raw_next(pre);
                 if (t.type == TOKENTYPE_OTHER) {
                     if (t.subtype == C_TKN_LPAR) {
@@ -2318,11 +2990,12 @@ static void c_macro_expand(c_preproc_t *pre, pos_t pos, c_macro_t const *macro)
                 if (subst->stringize) {
                     // To emit an empty string.
                     token_t tkn = {
-                        .pos        = pos,
-                        .type       = TOKENTYPE_SCONST,
-                        .subtype    = C_STR_RAW_DQUOT,
-                        .strval     = lilycc_calloc(1, 1),
-                        .strval_len = 0,
+                        .pos             = pos,
+                        .type            = TOKENTYPE_SCONST,
+                        .subtype         = C_STR_RAW_DQUOT,
+                        .strval          = (char *)"",
+                        .strval_len      = 0,
+                        .strval_borrowed = true,
                     };
                     vec_push(&expand.tokens, tkn);
 
@@ -2338,7 +3011,7 @@ static void c_macro_expand(c_preproc_t *pre, pos_t pos, c_macro_t const *macro)
 
             } else if (subst->stringize) {
                 // Stringization: turn the argument's tokens into a single string literal.
-                token_t tkn = c_macro_arg_stringize(arg, pos);
+                token_t tkn = c_macro_arg_stringize(pre->shared->cctx, arg, pos);
                 vec_push(&expand.tokens, tkn);
 
             } else {
@@ -2432,10 +3105,11 @@ static void c_macro_expand(c_preproc_t *pre, pos_t pos, c_macro_t const *macro)
         }
         for (size_t i = 0; i < extra; i++) {
             out[i * 2 + 1] = (token_t){
-                .pos        = pos,
-                .type       = TOKENTYPE_WHITESPACE,
-                .strval     = lilycc_strdup(" "),
-                .strval_len = 1,
+                .pos             = pos,
+                .type            = TOKENTYPE_WHITESPACE,
+                .strval          = (char *)" ",
+                .strval_len      = 1,
+                .strval_borrowed = true,
             };
         }
         lilycc_free(expand.tokens.arr);
@@ -2445,7 +3119,9 @@ static void c_macro_expand(c_preproc_t *pre, pos_t pos, c_macro_t const *macro)
     }
 
     // If it succeeded, the expanded tokens are put on the stack.
+    expand.prev_depth   = macro->expand_depth;
     vec_push(&pre->expand, expand);
+    macro->expand_depth = pre->expand.len;
 
 exit:
     for (size_t i = 0; i < args.len; i++) {
@@ -2457,7 +3133,6 @@ exit:
         }
         vec_clear(&args.arr[i].tokens);
         vec_clear(&args.arr[i].expanded);
-        lilycc_free(args.arr[i].stringized);
         vec_clear(&args.arr[i].ws_before);
     }
     vec_clear(&args);
@@ -26,9 +26,21 @@ typedef enum __attribute__((packed)) {
     C_SUBST_VA_OPT,
 } c_subst_type_t;
 
+// Progress of include guard detection in an include file.
+typedef enum __attribute__((packed)) {
+    // Nothing but whitespace seen yet; the first directive may open an include guard.
+    C_GUARD_START,
+    // Inside the `#ifndef` that may be an include guard.
+    C_GUARD_INSIDE,
+    // After the `#endif` of the include guard; only whitespace may follow.
+    C_GUARD_AFTER,
+    // This file does not consist of a single include guard.
+    C_GUARD_NONE,
+} c_guard_state_t;
+
 // C compiler context.
 typedef struct c_compiler       c_compiler_t;
-// State shared between a root preprocessor and any nested expansion contexts.
+// Macro, pragma and include state of a preprocessor.
 typedef struct c_preproc_shared c_preproc_shared_t;
 // C preprocessor state.
 typedef struct c_preproc        c_preproc_t;
@@ -44,47 +56,81 @@ typedef struct c_macro_subst    c_macro_subst_t;
 typedef struct c_macro_arg      c_macro_arg_t;
 // Expanded macro value.
 typedef struct c_expansion      c_expansion_t;
+// Loaded precompiled header.
+typedef struct c_pch            c_pch_t;
+// Memoized pre-expansion of a macro argument.
+typedef struct c_arg_memo       c_arg_memo_t;
+// Memoized result of an `#if` condition.
+typedef struct c_cond_memo      c_cond_memo_t;
 
 VEC_TYPE_DEF(vec_incfile_t, c_incfile_t)
 VEC_TYPE_DEF(vec_ifdir_t, c_ifdir_t)
 VEC_TYPE_DEF(vec_macro_subst_t, c_macro_subst_t)
 VEC_TYPE_DEF(vec_macro_arg_t, c_macro_arg_t)
 VEC_TYPE_DEF(vec_expansion_t, c_expansion_t)
+VEC_TYPE_DEF(vec_macro_ptr_t, c_macro_t *)
+VEC_TYPE_DEF(vec_name_t, char const *)
 
 // Procedural macro callback.
 typedef c_expansion_t (*c_proc_macro_cb_t)(c_preproc_t *pre, vec_macro_arg_t const *args, void *cookie);
 
-// State shared between a root preprocessor and any nested expansion contexts.
-// Nested contexts (used for recursive argument expansion) hold a pointer to
-// the same `c_preproc_shared_t` as the root, so macro definitions, pragma
-// state, and the diagnostics sink stay consistent across all expansions.
+// Macro, pragma and include state of a preprocessor.
 struct c_preproc_shared {
     // Parent compiler context.
     cctx_t            *cctx;
     // Pointer to active C options.
     c_options_t const *options;
     // Macro definitions by name.
-    // Map of `char *` -> `c_macro_t *`.
+    // Map of interned `char const *` -> `c_macro_t *`.
     map_t              macros;
     // Set of files which have already executed a `#pragma once`.
     set_t              once_files;
+    // Controlling macros of files wrapped in an include guard.
+    // Map of `srcfile_t *` -> interned `char const *`.
+    map_t              guard_macros;
     // Next value for `__COUNTER__`.
     uint64_t           counter_macro;
+    // Precompiled header that macros were loaded from, if any.
+    c_pch_t           *pch;
+    // Directories to search for include files in, in order; the working directory if empty.
+    char const *const *include_dirs;
+    // Number of `include_dirs`.
+    size_t             include_dirs_len;
+    // Directory to cache the tokens of include files in, or NULL to disable the token cache.
+    char const        *tkn_cache_dir;
+    // Reuse the pre-expansion of macro arguments that have the same tokens as an earlier argument.
+    bool               memo_args;
+    // Memoized pre-expansions of macro arguments.
+    // Map of `vec_token_t const *` -> `c_arg_memo_t *`.
+    map_t              arg_memo;
+    // Names of the identifiers looked up while pre-expanding memoized arguments.
+    // Defining or undefining any of them clears `arg_memo`.
+    // Set of interned `char const *`.
+    set_t              arg_memo_deps;
+    // Incremented whenever a macro is defined or undefined.
+    uint64_t           macros_gen;
+    // Set of include files that were entered at least once.
+    set_t              entered_files;
+    // Files that tokens were read from, in the order they were first read: the primary source file, the include files
+    // and the files a loaded precompiled header was made from. Files only probed by `__has_include` are not in it.
+    // Array of `srcfile_t *`.
+    vec_ptr_t          read_files;
+    // Memoized results of `#if` conditions that only depend on which macros are defined.
+    // Map of `uint8_t const *` (the position of the directive in its file's content) -> `c_cond_memo_t *`.
+    map_t              cond_memo;
 };
 
 // C preprocessor state.
 struct c_preproc {
     // Base tokenizer.
     tokenizer_t         base;
-    // Pointer to the root preprocessor (may be pointer to self).
-    c_preproc_t        *root;
-    // State shared with the root preprocessor.
+    // Macro, pragma and include state.
     c_preproc_shared_t *shared;
-    // Whether this preprocessor owns `shared` and should free it on destroy.
-    // True for the root preprocessor; false for nested expansion contexts.
-    bool                owns_shared;
     // Queue of tokens to emit from macro expansions.
     vec_expansion_t     expand;
+    // Index of the first entry in `expand` visible to tokenizing; non-zero while a macro argument is pre-expanded.
+    // The argument's tokens are at this index, and everything below belongs to the macro invocation it came from.
+    size_t              expand_base;
     // Include-file tokenizer stack, bottom is the original file.
     vec_incfile_t       stack;
     // Whether the current line has non-whitespace tokens on it.
@@ -95,14 +141,44 @@ struct c_preproc {
     bool                keep_comments;
     // Disable processing of directives.
     bool                no_directives;
+    // Only process directives; other lines are skipped like those of inactive groups and only EOF is emitted.
+    // Used to find the include files of a source file without preprocessing the rest of it.
+    bool                directives_only;
+    // Tokens emitted by the prefix header of a loaded precompiled header, replayed before the source file.
+    vec_token_t         pch_tokens;
+    // Number of `pch_tokens` already emitted.
+    size_t              pch_index;
+    // Whether a macro argument is being pre-expanded to be memoized.
+    bool                memo_recording;
+    // Whether the macro argument being recorded can still be memoized.
+    bool                memo_ok;
+    // Macros looked up while recording a macro argument.
+    vec_macro_ptr_t     memo_macros;
+    // Whether the `#if` condition being evaluated is recorded to be memoized.
+    bool                cond_recording;
+    // Whether the `#if` condition being recorded can still be memoized.
+    bool                cond_memo_ok;
+    // Interned names of the macros the recorded condition found to be defined.
+    vec_name_t          cond_defined;
+    // Interned names of the identifiers the recorded condition found not to be macros.
+    vec_name_t          cond_undefined;
 };
 
 // Include-file stack entry.
 struct c_incfile {
     // Associated tokenizer.
-    tokenizer_t *tkn_ctx;
+    tokenizer_t    *tkn_ctx;
     // Active if/ifdef/ifndef directives.
-    vec_ifdir_t  ifdir;
+    vec_ifdir_t     ifdir;
+    // Include guard detection progress.
+    c_guard_state_t guard_state;
+    // Controlling macro of the include guard, if `guard_state` is not `C_GUARD_START`.
+    char const     *guard_macro;
+    // Index in the include search path after the one this file was found in, where `#include_next` continues.
+    // 0 if it was not found through the include search path.
+    size_t          search_next;
+    // Memoize the results of `#if` conditions in this file, because it was entered before.
+    bool            memo_conds;
 };
 
 // If-directive stack entry.
@@ -120,11 +196,15 @@ struct c_ifdir {
 // A macro definition.
 struct c_macro {
     // Uses a callback instead of subsitution tokens and args.
-    bool is_proc_macro;
+    bool           is_proc_macro;
     // Is a built-in macro (that shouldn't be undefined).
-    bool is_builtin;
+    bool           is_builtin;
     // Is a function-like macro.
-    bool uses_args;
+    bool           uses_args;
+    // Serialized body in the precompiled header this macro was loaded from; NULL once the body is built.
+    uint8_t const *pch_body;
+    // One more than the index in the expansion stack of the innermost expansion of this macro, or 0 if none.
+    size_t         expand_depth;
     union {
         struct {
             // Variadic macros (with ...).
@@ -152,10 +232,15 @@ struct c_macro_arg {
     // Per-token: was there whitespace (or newlines) before this token in the
     // original argument source? The first token's entry is always false.
     vec_bool_t  ws_before;
-    // Lazily-computed stringized version.
+    // Lazily-computed stringized version; lives in the token arena.
     char       *stringized;
+    // Length of `stringized`.
+    size_t      stringized_len;
     // Lazily-computed macro-expanded version.
     vec_token_t expanded;
+    // Number of entries at the bottom of the expansion stack that the tokens were read from.
+    // Macros expanded by those entries stay hidden while the argument is pre-expanded.
+    size_t      hide_depth;
 };
 
 // A single substitution position within a regular macro's body.
@@ -176,14 +261,43 @@ struct c_macro_subst {
     };
 };
 
+// Memoized pre-expansion of a macro argument.
+struct c_arg_memo {
+    // Tokens of the argument; the key in `arg_memo`.
+    vec_token_t     tokens;
+    // Pre-expanded tokens.
+    vec_token_t     expanded;
+    // Macros looked up by the pre-expansion; it can only be reused where none of them are disabled.
+    vec_macro_ptr_t macros;
+};
+
+// Memoized result of an `#if` condition.
+struct c_cond_memo {
+    // Value of `macros_gen` when the result was last known to be valid.
+    uint64_t   macros_gen;
+    // Value of the condition.
+    bool       result;
+    // Position of the end of the line that the condition is on.
+    pos_t      end;
+    // The result can be reused while all of these are defined...
+    vec_name_t defined;
+    // ...and none of these are.
+    vec_name_t undefined;
+};
+
 // Expanded macro value.
 struct c_expansion {
     // Source macro; as the return value of a procedural macro, this field is ignored.
-    c_macro_t const *macro;
+    c_macro_t           *macro;
     // Number of tokens already expanded.
-    size_t           index;
+    size_t               index;
     // Tokens to expand.
-    vec_token_t      tokens;
+    vec_token_t          tokens;
+    // Previous `expand_depth` of `macro`, restored when this expansion is popped.
+    size_t               prev_depth;
+    // Macro argument that is being pre-expanded, if any.
+    // Its tokens are borrowed from the argument and the token stream ends after them.
+    c_macro_arg_t const *arg;
 };
 
 
@@ -192,12 +306,6 @@ struct c_expansion {
 // See `c_preproc_t` for details about `raw_mode` and `keep_comments`.
 // Applying either flag after creation of the preprocessor will create incorrect output.
 c_preproc_t *c_preproc_create(srcfile_t *srcfile, c_options_t const *options, bool raw_mode, bool keep_comments);
-// Create a nested preprocessor that shares macro/file/pragma state with `parent`.
-// Used for recursively expanding a function-like macro's arguments before
-// they are substituted. The caller is responsible for feeding input tokens
-// into the returned context (via its `expand` queue or include stack) and
-// for destroying it with `tkn_ctx_delete(&nested->base)` once done.
-c_preproc_t *c_preproc_create_nested(c_preproc_t *parent);
 // Get the next token from the preprocessor.
 token_t      c_preproc_next(tokenizer_t *tkn_ctx);
 // Convert a preprocessor token to a C token.
@@ -208,10 +316,13 @@ void         c_preproc_add_macro(c_preproc_t *pre, char const *name, c_macro_t *
 void         c_preproc_add_path(c_preproc_t *pre, char const *path, bool is_sysinc);
 
 // Create a regular macro by parsing it from a string.
+// Identifiers in the body are interned in `idents`, which must outlive the macro.
 // On success, `*name_out` is set to a heap-allocated copy of the parsed macro
 // name (caller takes ownership). On failure, prints diagnostics to stdout,
 // returns NULL, and leaves `*name_out` unchanged.
-c_macro_t *c_macro_create(c_options_t const *options, char const *virt_file, char const *spec, char **name_out);
+c_macro_t *c_macro_create(
+    strpool_t *idents, c_options_t const *options, char const *virt_file, char const *spec, char **name_out
+);
 // Create a procedural macro.
 c_macro_t *c_proc_macro_create(bool uses_args, c_proc_macro_cb_t callback, void *cookie);
 // Destroy a macro.
@@ -9,6 +9,7 @@
 #include "c_prim.h"
 #include "c_std.h"
 #include "compiler.h"
+#include "hash.h"
 #include "lilycc_malloc.h"
 #include "tokenizer.h"
 #include "utf8.h"
@@ -47,12 +48,62 @@ char const *const c_token_name[] = {
 #include "c_tokens.inc"
 };
 
+// Token spelling lengths.
+static uint8_t const c_token_len[] = {
+#define C_TOKEN_DEF(id, name) sizeof(name) - 1,
+#include "c_tokens.inc"
+};
+
 // Token introduction dates.
 static long c_keyw_since[] = {
 #define C_KEYW_DEF(since, deprecated, name) since,
 #include "c_keywords.inc"
 };
 
+// Keyword lengths.
+static uint8_t const c_keyw_len[] = {
+#define C_KEYW_DEF(since, deprecated, name) sizeof(#name) - 1,
+#include "c_keywords.inc"
+};
+
+// Main spelling of keywords with alternate spellings, plus one; 0 for keywords that are their own main spelling.
+static uint8_t const c_keyw_main_spelling[C_N_KEYWS] = {
+#define C_ALT_KEYW_DEF(main_spelling, alt_spelling) [C_KEYW_##main_spelling] = C_KEYW_##alt_spelling + 1,
+#include "c_keywords.inc"
+};
+
+// Number of bits in a keyword hash; the keyword hash table has 2^`C_KEYW_HASH_BITS` entries.
+#define C_KEYW_HASH_BITS 8
+// Hash multiplier, chosen such that no two keywords have the same hash.
+#define C_KEYW_HASH_MUL  0x10a09
+
+// Keyword perfect hash table; keyword index plus one, or 0 if no keyword has this hash.
+static uint8_t c_keyw_table[1 << C_KEYW_HASH_BITS];
+
+// Compute the keyword hash of an identifier.
+static inline uint32_t c_keyw_hash(char const *name, size_t len) {
+    return (hash_mem(name, len) * C_KEYW_HASH_MUL) >> (32 - C_KEYW_HASH_BITS);
+}
+
+// Build the keyword perfect hash table.
+__attribute__((constructor)) static void c_keyw_table_init() {
+    for (size_t i = 0; i < C_N_KEYWS; i++) {
+        uint32_t hash = c_keyw_hash(c_keywords[i], c_keyw_len[i]);
+        if (c_keyw_table[hash]) {
+            fprintf(stderr, "Keyword hash collision: %s and %s\n", c_keywords[c_keyw_table[hash] - 1], c_keywords[i]);
+            fprintf(stderr, "Please change C_KEYW_HASH_MUL in %s\n", __FILE__);
+            abort();
+        }
+        c_keyw_table[hash] = i + 1;
+    }
+}
+
+
+// Clean up a C tokenizer.
+static void c_tkn_cleanup(tokenizer_t *ctx) {
+    c_tokenizer_t *c_ctx = (c_tokenizer_t *)ctx;
+    vec_clear(&c_ctx->str_buf);
+}
 
 // Create a new C tokenizer.
 c_tokenizer_t *c_tkn_create_impl(srcfile_t *srcfile, c_options_t const *options) {
@@ -61,18 +112,13 @@ c_tokenizer_t *c_tkn_create_impl(srcfile_t *srcfile, c_options_t const *options)
     tkn_ctx->base.pos.srcfile = srcfile;
     tkn_ctx->base.file        = srcfile;
     tkn_ctx->base.next        = c_tkn_next;
+    tkn_ctx->base.cleanup     = c_tkn_cleanup;
     tkn_ctx->options          = options;
+    tkn_ctx->idents           = &srcfile->ctx->idents;
     return tkn_ctx;
 }
 
 
-// Comparator function for searching for keywords.
-static int keyw_comp(void const *a0, void const *b0) {
-    char const *a = *(char const *const *)a0;
-    char const *b = b0;
-    return strcmp(a, b);
-}
-
 // Helper function to create tokens for better readability.
 token_t other_tkn(c_tokentype_t type, pos_t from, pos_t to) {
     return ((token_t){
@@ -107,9 +153,10 @@ bool c_is_sym_char(int c) {
 
 // Preprocessing number token.
 static token_t c_tkn_pre_number(tokenizer_t *ctx) {
-    size_t len = 0;
-    size_t cap = 8;
-    char  *buf = lilycc_malloc(cap);
+    c_tokenizer_t *c_ctx = (c_tokenizer_t *)ctx;
+    size_t         len   = 0;
+    size_t         cap   = c_ctx->str_buf.cap;
+    char          *buf   = c_ctx->str_buf.arr;
 
     pos_t pos0 = ctx->pos;
     int   c    = c_srcfile_getc(ctx->file, &ctx->pos);
@@ -157,16 +204,44 @@ static token_t c_tkn_pre_number(tokenizer_t *ctx) {
         }
     }
 
-    array_lencap_insert_strong(&buf, 1, &len, &cap, "", len);
+    c_ctx->str_buf.arr = buf;
+    c_ctx->str_buf.cap = cap;
     return (token_t){
-        .pos        = pos_including(pos0, ctx->pos),
-        .type       = TOKENTYPE_IDENT,
-        .subtype    = C_PPNUMBER,
-        .strval     = buf,
-        .strval_len = len - 1,
+        .pos             = pos_including(pos0, ctx->pos),
+        .type            = TOKENTYPE_IDENT,
+        .subtype         = C_PPNUMBER,
+        .strval          = tkn_arena_strval(ctx->cctx, buf, len),
+        .strval_len      = len,
+        .strval_borrowed = true,
     };
 }
 
+// Test whether a spelling is exactly one preprocessing number, following the same rules as `c_tkn_pre_number`.
+bool c_is_ppnumber(char const *spelling, size_t len) {
+    size_t i = 0;
+    if (len && spelling[0] == '.') {
+        i++;
+    }
+    if (i >= len || spelling[i] < '0' || spelling[i] > '9') {
+        return false;
+    }
+    i++;
+    while (i < len) {
+        char c = spelling[i];
+        if ((c == 'e' || c == 'E' || c == 'p' || c == 'P') && i + 1 < len
+            && (spelling[i + 1] == '+' || spelling[i + 1] == '-')) {
+            i += 2;
+        } else if (c == '.' || c_is_sym_char(c)) {
+            i++;
+        } else if (c == '\'' && i + 1 < len && c_is_sym_char(spelling[i + 1])) {
+            i += 2;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
 // Convert preprocessing number token to C number token.
 // TODO: Convert to options, gate binary behind C23 || gnu extension flag, gate _x128 behind Lily-CC extension flag.
 token_t c_tkn_conv_number(cctx_t *cctx, int c_std, token_t const *pre_tkn) {
@@ -390,13 +465,30 @@ token_t c_tkn_conv_number(cctx_t *cctx, int c_std, token_t const *pre_tkn) {
 // Tokenize identifier.
 static token_t c_tkn_ident(tokenizer_t *ctx, pos_t start_pos, char first) {
     c_tokenizer_t *c_ctx = (c_tokenizer_t *)ctx;
-    size_t         cap   = 32;
-    size_t         len   = 1;
-    char          *ptr   = lilycc_malloc(cap);
-    ptr[0]               = first;
+    vec_char_t    *buf   = &c_ctx->str_buf;
+    buf->len             = 0;
+    vec_push(buf, first);
 
     pos_t pos0 = ctx->pos;
     pos_t pos1;
+    while (1) {
+        // Copy runs of plain ASCII identifier characters directly from the source.
+        srcspan_t span = srcfile_span(ctx->file, pos0.off, SIZE_MAX);
+        size_t    n    = 0;
+        while (span.is_ascii && n < span.len && c_is_sym_char(span.data[n])) {
+            n++;
+        }
+        if (!n) {
+            break;
+        }
+        vec_reserve(buf, n);
+        memcpy(buf->arr + buf->len, span.data, n);
+        buf->len += n;
+        srcfile_advance(ctx->file, &pos0, n);
+        if (n < span.len) {
+            break;
+        }
+    }
     while (1) {
         pos1  = pos0;
         int c = c_srcfile_getc(ctx->file, &pos1);
@@ -404,32 +496,20 @@ static token_t c_tkn_ident(tokenizer_t *ctx, pos_t start_pos, char first) {
             // End of identifier.
             break;
         }
-        if (len == cap - 1) {
-            // Even longer name, allocate more memory.
-            cap *= 2;
-            ptr  = lilycc_realloc(ptr, cap);
-        }
-        ptr[len++] = (char)c;
-        pos0       = pos1;
-    }
-    ptr[len] = 0;
-    ctx->pos = pos0;
-
-    // Test for keywords.
-    c_keyw_t keyw = c_keyw_get(c_ctx->options->c_std, ptr);
-    if (keyw < C_N_KEYWS && !c_ctx->preproc_mode) {
-        // Replace alternate spellings with main spellings, even if the main spelling is from a later C standard.
-#define C_ALT_KEYW_DEF(main_spelling, alt_spelling)                                                                    \
-    if (keyw == C_KEYW_##main_spelling) {                                                                              \
-        keyw = C_KEYW_##alt_spelling;                                                                                  \
+        vec_push(buf, (char)c);
+        pos0 = pos1;
     }
-#include "c_keywords.inc"
-        lilycc_free(ptr);
+    size_t len = buf->len;
+    ctx->pos   = pos0;
+
+    // Test for keywords; the preprocessor treats them as identifiers.
+    c_keyw_t keyw = c_ctx->preproc_mode ? C_N_KEYWS : c_keyw_get(c_ctx->options->c_std, buf->arr, len);
+    if (keyw < C_N_KEYWS) {
         // Return keyword token with main spelling.
         return (token_t){
             .pos        = pos_between(start_pos, pos0),
             .type       = TOKENTYPE_KEYWORD,
-            .subtype    = keyw,
+            .subtype    = c_keyw_main(keyw),
             .strval     = NULL,
             .strval_len = 0,
             .params_len = 0,
@@ -438,24 +518,23 @@ static token_t c_tkn_ident(tokenizer_t *ctx, pos_t start_pos, char first) {
     }
 
     return (token_t){
-        .pos        = pos_between(start_pos, pos0),
-        .type       = TOKENTYPE_IDENT,
-        .strval     = ptr,
-        .strval_len = len,
-        .subtype    = C_IDENT,
-        .params_len = 0,
-        .params     = NULL,
+        .pos             = pos_between(start_pos, pos0),
+        .type            = TOKENTYPE_IDENT,
+        .strval          = (char *)strpool_intern(c_ctx->idents, buf->arr, len),
+        .strval_len      = len,
+        .strval_interned = true,
+        .subtype         = C_IDENT,
+        .params_len      = 0,
+        .params          = NULL,
     };
 }
 
 // Preprocessing string token.
 static token_t c_tkn_pre_str(tokenizer_t *ctx, pos_t start_pos, c_strtype_t subtype) {
-    size_t cap     = 32;
-    size_t len     = 0;
-    char  *buf     = lilycc_malloc(cap);
-    pos_t  end_pos = start_pos;
-    char   start;
-    char   end;
+    c_tokenizer_t *c_ctx   = (c_tokenizer_t *)ctx;
+    pos_t          end_pos = start_pos;
+    char           start;
+    char           end;
     switch (subtype) {
         default: abort();
         case C_STR_RAW_DQUOT: start = end = '\"'; break;
@@ -465,7 +544,31 @@ static token_t c_tkn_pre_str(tokenizer_t *ctx, pos_t start_pos, c_strtype_t subt
     // Skip start char.
     c_srcfile_getc(ctx->file, &end_pos);
     pos_t open_pos = pos_between(start_pos, end_pos);
-    bool  esc      = false;
+
+    // Plain ASCII literals without backslashes are identical to their source bytes and can reference them directly.
+    srcspan_t span = srcfile_span(ctx->file, end_pos.off, SIZE_MAX);
+    for (size_t n = 0; span.is_ascii && n < span.len; n++) {
+        char c = span.data[n];
+        if (c == end) {
+            srcfile_advance(ctx->file, &end_pos, n + 1);
+            ctx->pos = end_pos;
+            return (token_t){
+                .pos             = pos_including(start_pos, end_pos),
+                .type            = TOKENTYPE_SCONST,
+                .subtype         = subtype,
+                .strval          = (char *)span.data,
+                .strval_len      = n,
+                .strval_borrowed = true,
+            };
+        } else if (c == '\\' || c == '\n' || c == '\r') {
+            break;
+        }
+    }
+
+    size_t cap = c_ctx->str_buf.cap;
+    size_t len = 0;
+    char  *buf = c_ctx->str_buf.arr;
+    bool   esc = false;
     while (1) {
         pos_t pos1 = end_pos;
         int   c    = c_srcfile_getc(ctx->file, &end_pos);
@@ -488,14 +591,16 @@ static token_t c_tkn_pre_str(tokenizer_t *ctx, pos_t start_pos, c_strtype_t subt
         }
     }
 
-    array_lencap_insert_strong(&buf, 1, &len, &cap, "", len);
-    ctx->pos = end_pos;
+    c_ctx->str_buf.arr = buf;
+    c_ctx->str_buf.cap = cap;
+    ctx->pos           = end_pos;
     return (token_t){
-        .pos        = pos_including(start_pos, end_pos),
-        .type       = TOKENTYPE_SCONST,
-        .subtype    = subtype,
-        .strval     = buf,
-        .strval_len = len - 1, // -1 excludes the NUL terminator
+        .pos             = pos_including(start_pos, end_pos),
+        .type            = TOKENTYPE_SCONST,
+        .subtype         = subtype,
+        .strval          = tkn_arena_strval(ctx->cctx, buf, len),
+        .strval_len      = len,
+        .strval_borrowed = true,
     };
 }
 
@@ -554,6 +659,18 @@ static int c_str_conv_octal(cctx_t *cctx, token_t const *pre_tkn, tknoff_t *off,
 // Convert preprocessing string token to C string token.
 token_t c_tkn_conv_str(cctx_t *cctx, int c_std, token_t const *pre_tkn) {
     (void)c_std;
+    if (pre_tkn->subtype == C_STR_RAW_DQUOT && pre_tkn->strval_borrowed
+        && !memchr(pre_tkn->strval, '\\', pre_tkn->strval_len)) {
+        // Without escape sequences, the string's value is its spelling; keep borrowing it.
+        return (token_t){
+            .pos             = pre_tkn->pos,
+            .type            = TOKENTYPE_SCONST,
+            .strval          = pre_tkn->strval,
+            .strval_len      = pre_tkn->strval_len,
+            .strval_borrowed = true,
+        };
+    }
+
     size_t cap     = 32;
     size_t len     = 0;
     char  *ptr     = lilycc_malloc(cap);
@@ -660,17 +777,52 @@ token_t c_tkn_conv_str(cctx_t *cctx, int c_std, token_t const *pre_tkn) {
     }
 }
 
+// Number of bytes at the start of `span` that can be consumed as whitespace of the given type
+// without needing special treatment like newlines, line continuations or the end of a block comment.
+static size_t c_whitespace_run(srcspan_t span, c_whitespace_t subtype) {
+    if (!span.is_ascii) {
+        return 0;
+    }
+    size_t n = 0;
+    if (subtype == C_WHITESPACE) {
+        while (n < span.len && span.data[n] <= 0x20 && span.data[n] != '\n' && span.data[n] != '\r') {
+            n++;
+        }
+    } else if (subtype == C_LINE_COMMENT) {
+        while (n < span.len && span.data[n] != '\n' && span.data[n] != '\r' && span.data[n] != '\\') {
+            n++;
+        }
+    } else {
+        assert(subtype == C_BLOCK_COMMENT);
+        while (n < span.len && span.data[n] != '*' && span.data[n] != '\r' && span.data[n] != '\\') {
+            n++;
+        }
+    }
+    return n;
+}
+
 // Read in a span of whitespace as a token.
 static token_t c_tkn_whitespace(tokenizer_t *ctx, pos_t start_pos, c_whitespace_t subtype) {
     c_tokenizer_t *c_ctx = (c_tokenizer_t *)ctx;
     int            prev  = 0;
 
     size_t len = 0;
-    size_t cap = 32;
-    char  *buf = lilycc_malloc(cap);
+    size_t cap = c_ctx->str_buf.cap;
+    char  *buf = c_ctx->str_buf.arr;
 
     pos_t pos;
     while (1) {
+        size_t run = 0;
+        if (prev != '*') {
+            run = c_whitespace_run(srcfile_span(ctx->file, ctx->pos.off, SIZE_MAX), subtype);
+        }
+        if (run) {
+            if (c_ctx->keep_comments) {
+                array_lencap_insert_n_strong(&buf, 1, &len, &cap, ctx->file->content + ctx->pos.off, len, run);
+            }
+            srcfile_advance(ctx->file, &ctx->pos, run);
+            prev = 0;
+        }
         pos   = ctx->pos;
         int c = c_srcfile_getc(ctx->file, &pos);
         if (subtype == C_WHITESPACE) {
@@ -703,26 +855,31 @@ static token_t c_tkn_whitespace(tokenizer_t *ctx, pos_t start_pos, c_whitespace_
         ctx->pos = pos;
     }
 
+    c_ctx->str_buf.arr = buf;
+    c_ctx->str_buf.cap = cap;
+    char *strval;
     if (c_ctx->keep_comments) {
-        array_lencap_insert_strong(&buf, 1, &len, &cap, "", len);
+        strval = tkn_arena_strval(ctx->cctx, buf, len);
     } else {
-        buf[0]  = ' ';
-        buf[1]  = 0;
-        len     = 2;
+        strval  = (char *)" ";
+        len     = 1;
         subtype = C_WHITESPACE;
     }
     return (token_t){
-        .pos        = pos_between(start_pos, pos),
-        .type       = TOKENTYPE_WHITESPACE,
-        .subtype    = subtype,
-        .strval     = buf,
-        .strval_len = len - 1,
+        .pos             = pos_between(start_pos, pos),
+        .type            = TOKENTYPE_WHITESPACE,
+        .subtype         = subtype,
+        .strval          = strval,
+        .strval_len      = len,
+        .strval_borrowed = true,
     };
 }
 
 // A line comment.
 static void c_line_comment(tokenizer_t *ctx) {
     while (1) {
+        size_t run = c_whitespace_run(srcfile_span(ctx->file, ctx->pos.off, SIZE_MAX), C_LINE_COMMENT);
+        srcfile_advance(ctx->file, &ctx->pos, run);
         int c = c_srcfile_getc(ctx->file, &ctx->pos);
         if (c == '\\') {
             c_srcfile_getc(ctx->file, &ctx->pos);
@@ -736,6 +893,10 @@ static void c_line_comment(tokenizer_t *ctx) {
 static void c_block_comment(tokenizer_t *ctx) {
     int prev = 0;
     while (1) {
+        if (prev != '*') {
+            size_t run = c_whitespace_run(srcfile_span(ctx->file, ctx->pos.off, SIZE_MAX), C_BLOCK_COMMENT);
+            srcfile_advance(ctx->file, &ctx->pos, run);
+        }
         int c = c_srcfile_getc(ctx->file, &ctx->pos);
         if (c == '/' && prev == '*') {
             return;
@@ -764,6 +925,117 @@ int c_srcfile_getc(srcfile_t *file, pos_t *pos) {
     return c;
 }
 
+// Length of the newline sequence at `off`, or 0 if there is none.
+static inline size_t c_skip_eol_len(uint8_t const *data, size_t len, size_t off) {
+    if (data[off] == '\n') {
+        return 1;
+    } else if (data[off] == '\r') {
+        return off + 1 < len && data[off + 1] == '\n' ? 2 : 1;
+    }
+    return 0;
+}
+
+// Skip source text up to the next line that starts with `#`, without building any tokens.
+// Used for conditional groups that are not emitted; only recognizes line starts, line continuations, comments and
+// string and character literals. Discards buffered tokens; the tokenizer must be preceded by only whitespace on its
+// line. Returns true and leaves the tokenizer at the `#` if one was found, false if EOF was reached first.
+bool c_tkn_skip_group(c_tokenizer_t *c_ctx) {
+    tokenizer_t *ctx = &c_ctx->base;
+    tkn_rewind(ctx);
+
+    uint8_t const *data       = ctx->file->content;
+    size_t         len        = ctx->file->content_len;
+    size_t         off        = ctx->pos.off;
+    int            line       = ctx->pos.line;
+    int            col        = ctx->pos.col;
+    bool           line_start = true;
+    size_t         eol;
+
+// Advance over one byte that is not a newline.
+#define skip_byte() (col += (data[off++] & 0xc0) != 0x80)
+// Advance over a newline of `eol` bytes.
+#define skip_eol()  (off += eol, line++, col = 0)
+
+    while (off < len) {
+        uint8_t c = data[off];
+        if ((eol = c_skip_eol_len(data, len, off))) {
+            skip_eol();
+            line_start = true;
+
+        } else if (c == '\\' && off + 1 < len && (eol = c_skip_eol_len(data, len, off + 1))) {
+            // Line continuation.
+            off++;
+            skip_eol();
+
+        } else if (c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == 0) {
+            skip_byte();
+
+        } else if (c == '#' && line_start) {
+            ctx->pos = (pos_t){.srcfile = ctx->file, .off = (off_t)off, .line = line, .col = col};
+            return true;
+
+        } else if (c == '/' && off + 1 < len && data[off + 1] == '*') {
+            // Block comments count as whitespace.
+            pos_t start = {.srcfile = ctx->file, .off = (off_t)off, .line = line, .col = col};
+            skip_byte();
+            skip_byte();
+            while (off < len && !(data[off] == '*' && off + 1 < len && data[off + 1] == '/')) {
+                if ((eol = c_skip_eol_len(data, len, off))) {
+                    skip_eol();
+                } else {
+                    skip_byte();
+                }
+            }
+            if (off >= len) {
+                // Leave the unterminated comment for the tokenizer to report.
+                ctx->pos = start;
+                return false;
+            }
+            skip_byte();
+            skip_byte();
+
+        } else if (c == '/' && off + 1 < len && data[off + 1] == '/') {
+            // Line comments run up to the next newline that isn't escaped.
+            while (off < len && !c_skip_eol_len(data, len, off)) {
+                if (data[off] == '\\' && off + 1 < len && (eol = c_skip_eol_len(data, len, off + 1))) {
+                    off++;
+                    skip_eol();
+                } else {
+                    skip_byte();
+                }
+            }
+
+        } else if (c == '"' || c == '\'') {
+            // String and character literals end at the matching quote or the end of the line.
+            line_start = false;
+            skip_byte();
+            while (off < len && data[off] != c && !c_skip_eol_len(data, len, off)) {
+                if (data[off] == '\\' && off + 1 < len) {
+                    skip_byte();
+                    if ((eol = c_skip_eol_len(data, len, off))) {
+                        skip_eol();
+                        continue;
+                    }
+                }
+                skip_byte();
+            }
+            if (off < len && data[off] == c) {
+                skip_byte();
+            }
+
+        } else {
+            line_start = false;
+            skip_byte();
+        }
+    }
+
+#undef skip_byte
+#undef skip_eol
+
+    ctx->pos = (pos_t){.srcfile = ctx->file, .off = (off_t)off, .line = line, .col = col};
+    return false;
+}
+
 // Get next token from C tokenizer.
 token_t c_tkn_next(tokenizer_t *ctx) {
     c_tokenizer_t *c_ctx = (c_tokenizer_t *)ctx;
@@ -792,6 +1064,8 @@ retry:
             return c_tkn_whitespace(ctx, pos0, C_WHITESPACE);
         } else {
             // Only the preprocessor cares about whitespace.
+            size_t run = c_whitespace_run(srcfile_span(ctx->file, ctx->pos.off, SIZE_MAX), C_WHITESPACE);
+            srcfile_advance(ctx->file, &ctx->pos, run);
             goto retry;
         }
     }
@@ -1045,15 +1319,38 @@ retry:
 
 // Try to find the matching C keyword.
 // Returns C_N_KEYWS if not a keyword in the current C standard.
-c_keyw_t c_keyw_get(int c_std, char const *name) {
-    array_binsearch_t res = array_binsearch(c_keywords, sizeof(char *), C_N_KEYWS, name, keyw_comp);
-    if (res.found && c_keyw_since[res.index] <= c_std) {
-        return res.index;
+c_keyw_t c_keyw_get(int c_std, char const *name, size_t len) {
+    uint8_t ent = c_keyw_table[c_keyw_hash(name, len)];
+    if (!ent) {
+        return C_N_KEYWS;
+    }
+    c_keyw_t keyw = ent - 1;
+    if (c_keyw_len[keyw] == len && !memcmp(c_keywords[keyw], name, len) && c_keyw_since[keyw] <= c_std) {
+        return keyw;
     }
-
     return C_N_KEYWS;
 }
 
+// Get the main spelling of a keyword, even if the main spelling is from a later C standard.
+c_keyw_t c_keyw_main(c_keyw_t keyw) {
+    return c_keyw_main_spelling[keyw] ? (c_keyw_t)(c_keyw_main_spelling[keyw] - 1) : keyw;
+}
+
+// Find the punctuator with a certain spelling.
+// Returns `C_N_TKNS` if there is none.
+c_tokentype_t c_tkn_punct_get(char const *spelling, size_t len) {
+    if (!len) {
+        // Not the placemarker.
+        return C_N_TKNS;
+    }
+    for (int i = 0; i < C_N_TKNS; i++) {
+        if (c_token_len[i] == len && !memcmp(c_token_name[i], spelling, len)) {
+            return i;
+        }
+    }
+    return C_N_TKNS;
+}
+
 // Print the source representation of a token.
 void c_tkn_print_src(token_t const *pre_tkn, FILE *to) {
     switch (pre_tkn->type) {
@@ -1093,45 +1390,71 @@ void c_tkn_print_src(token_t const *pre_tkn, FILE *to) {
     }
 }
 
-// Append the source representation of a token to a heap-allocated string.
-// WARNING: Does not NUL-terminate!
-void c_tkn_append_src(token_t const *pre_tkn, char **buf_ptr, size_t *len_ptr, size_t *cap_ptr) {
-#define append_cstr(what) array_lencap_insert_n_strong(buf_ptr, 1, len_ptr, cap_ptr, (what), *len_ptr, strlen(what))
+// Get the length of the source representation of a token.
+size_t c_tkn_src_len(token_t const *pre_tkn) {
     switch (pre_tkn->type) {
-        case TOKENTYPE_KEYWORD: append_cstr(c_keywords[pre_tkn->subtype]); break;
-        case TOKENTYPE_SCONST:
-            switch (pre_tkn->subtype) {
-                case C_STR_ANGLEBRAC: append_cstr("<"); break;
-                case C_STR_RAW_DQUOT: append_cstr("\""); break;
-                case C_STR_RAW_SQUOT: append_cstr("\'"); break;
-                default: abort(); // Not a valid preprocessor token.
+        case TOKENTYPE_KEYWORD: return c_keyw_len[pre_tkn->subtype];
+        case TOKENTYPE_SCONST: return pre_tkn->strval_len + 2;
+        case TOKENTYPE_OTHER: return c_token_len[pre_tkn->subtype];
+        case TOKENTYPE_IDENT:
+        case TOKENTYPE_GARBAGE: return pre_tkn->strval_len;
+        case TOKENTYPE_WHITESPACE:
+            if (pre_tkn->subtype == C_LINE_COMMENT) {
+                return pre_tkn->strval_len + 2;
+            } else if (pre_tkn->subtype == C_BLOCK_COMMENT) {
+                return pre_tkn->strval_len + 4;
             }
-            array_lencap_insert_n_strong(buf_ptr, 1, len_ptr, cap_ptr, pre_tkn->strval, *len_ptr, pre_tkn->strval_len);
+            return pre_tkn->strval_len;
+        case TOKENTYPE_EOL: return 1;
+        case TOKENTYPE_EOF: return 0;
+        default: abort(); // Not a valid preprocessor token.
+    }
+}
+
+// Write the source representation of a token to `out`, which must have room for `c_tkn_src_len` bytes.
+// Returns a pointer to the end of what was written. WARNING: Does not NUL-terminate!
+char *c_tkn_write_src(token_t const *pre_tkn, char *out) {
+#define write_mem(what, len) (memcpy(out, (what), (len)), out += (len))
+    switch (pre_tkn->type) {
+        case TOKENTYPE_KEYWORD: write_mem(c_keywords[pre_tkn->subtype], c_keyw_len[pre_tkn->subtype]); break;
+        case TOKENTYPE_SCONST: {
+            char open, close;
             switch (pre_tkn->subtype) {
-                case C_STR_ANGLEBRAC: append_cstr(">"); break;
-                case C_STR_RAW_DQUOT: append_cstr("\""); break;
-                case C_STR_RAW_SQUOT: append_cstr("\'"); break;
+                case C_STR_ANGLEBRAC: open = '<', close = '>'; break;
+                case C_STR_RAW_DQUOT: open = close = '\"'; break;
+                case C_STR_RAW_SQUOT: open = close = '\''; break;
                 default: abort(); // Not a valid preprocessor token.
             }
-            break;
-        case TOKENTYPE_OTHER: append_cstr(c_token_name[pre_tkn->subtype]); break;
+            *out++ = open;
+            write_mem(pre_tkn->strval, pre_tkn->strval_len);
+            *out++ = close;
+        } break;
+        case TOKENTYPE_OTHER: write_mem(c_token_name[pre_tkn->subtype], c_token_len[pre_tkn->subtype]); break;
         case TOKENTYPE_IDENT:
-        case TOKENTYPE_GARBAGE:
-            array_lencap_insert_n_strong(buf_ptr, 1, len_ptr, cap_ptr, pre_tkn->strval, *len_ptr, pre_tkn->strval_len);
-            break;
+        case TOKENTYPE_GARBAGE: write_mem(pre_tkn->strval, pre_tkn->strval_len); break;
         case TOKENTYPE_WHITESPACE:
             if (pre_tkn->subtype == C_LINE_COMMENT) {
-                append_cstr("//");
+                write_mem("//", 2);
             } else if (pre_tkn->subtype == C_BLOCK_COMMENT) {
-                append_cstr("/*");
+                write_mem("/*", 2);
             }
-            array_lencap_insert_n_strong(buf_ptr, 1, len_ptr, cap_ptr, pre_tkn->strval, *len_ptr, pre_tkn->strval_len);
+            write_mem(pre_tkn->strval, pre_tkn->strval_len);
             if (pre_tkn->subtype == C_BLOCK_COMMENT) {
-                append_cstr("*/");
+                write_mem("*/", 2);
             }
             break;
-        case TOKENTYPE_EOL: append_cstr("\n"); break;
+        case TOKENTYPE_EOL: *out++ = '\n'; break;
         case TOKENTYPE_EOF: break;
         default: abort(); // Not a valid preprocessor token.
     }
+#undef write_mem
+    return out;
+}
+
+// Append the source representation of a token to a heap-allocated string.
+// WARNING: Does not NUL-terminate!
+void c_tkn_append_src(token_t const *pre_tkn, char **buf_ptr, size_t *len_ptr, size_t *cap_ptr) {
+    size_t off = *len_ptr;
+    array_lencap_resize_strong(buf_ptr, 1, len_ptr, cap_ptr, off + c_tkn_src_len(pre_tkn));
+    c_tkn_write_src(pre_tkn, *buf_ptr + off);
 }
@@ -70,6 +70,10 @@ struct c_tokenizer {
     bool               preproc_mode;
     // Keep comments instead of replacing them with a single space each.
     bool               keep_comments;
+    // Pool that identifiers are interned in; defaults to that of the source file's compiler context.
+    strpool_t         *idents;
+    // Scratch buffer used to assemble token strings before they are interned or copied to the token arena.
+    vec_char_t         str_buf;
 };
 
 
@@ -90,6 +94,11 @@ c_tokenizer_t *c_tkn_create_impl(srcfile_t *srcfile, c_options_t const *options)
 bool           c_is_first_sym_char(int c);
 // Test whether a character is legal in a C identifier.
 bool           c_is_sym_char(int c);
+// Test whether a spelling is exactly one preprocessing number.
+bool           c_is_ppnumber(char const *spelling, size_t len);
+// Find the punctuator with a certain spelling.
+// Returns `C_N_TKNS` if there is none.
+c_tokentype_t  c_tkn_punct_get(char const *spelling, size_t len);
 
 // Convert preprocessing number token to C number token.
 token_t c_tkn_conv_number(cctx_t *cctx, int c_std, token_t const *pre_tkn);
@@ -100,11 +109,21 @@ token_t c_tkn_conv_str(cctx_t *cctx, int c_std, token_t const *pre_tkn);
 int      c_srcfile_getc(srcfile_t *srcfile, pos_t *pos);
 // Get next token from C tokenizer.
 token_t  c_tkn_next(tokenizer_t *ctx);
+// Skip source text up to the next line that starts with `#`, without building any tokens.
+// Returns true and leaves the tokenizer at the `#` if one was found, false if EOF was reached first.
+bool     c_tkn_skip_group(c_tokenizer_t *c_ctx);
 // Try to find the matching C keyword.
-// Returns -1 if not a keyword in the current C standard.
-c_keyw_t c_keyw_get(int c_std, char const *name);
+// Returns `C_N_KEYWS` if not a keyword in the current C standard.
+c_keyw_t c_keyw_get(int c_std, char const *name, size_t len);
+// Get the main spelling of a keyword, even if the main spelling is from a later C standard.
+c_keyw_t c_keyw_main(c_keyw_t keyw);
 // Print the source representation of a token.
 void     c_tkn_print_src(token_t const *pre_tkn, FILE *to);
+// Get the length of the source representation of a token.
+size_t   c_tkn_src_len(token_t const *pre_tkn);
+// Write the source representation of a token to `out`, which must have room for `c_tkn_src_len` bytes.
+// Returns a pointer to the end of what was written. WARNING: Does not NUL-terminate!
+char    *c_tkn_write_src(token_t const *pre_tkn, char *out);
 // Append the source representation of a token to a heap-allocated string.
 // WARNING: Does not NUL-terminate!
 void     c_tkn_append_src(token_t const *pre_tkn, char **buf_ptr, size_t *len_ptr, size_t *cap_ptr);
@@ -11,6 +11,8 @@
 #include "lilycc_malloc.h"
 #include "tokenizer.h"
 
+#include <string.h>
+
 
 
 // Parse a direct (abstract) declaration.
@@ -90,8 +92,7 @@ static bool is_first_expr_tkn(c_parser_t *ctx, token_t tkn) {
         case TOKENTYPE_ICONST:
         case TOKENTYPE_SCONST: return true;
         case TOKENTYPE_IDENT:
-            return !set_contains(&ctx->type_names, tkn.strval)
-                   && (!ctx->func_body || !set_contains(&ctx->local_type_names, tkn.strval));
+            return !c_parser_is_type_name(ctx, &tkn);
         case TOKENTYPE_KEYWORD: return tkn.subtype == C_KEYW_alignof || tkn.subtype == C_KEYW_sizeof;
         case TOKENTYPE_OTHER:
             switch (tkn.subtype) {
@@ -256,8 +257,7 @@ static bool is_type_specifier(token_t token) {
 // Is this a valid token for a specifier/qualifier list?
 static bool is_spec_qual_list_tkn(c_parser_t *ctx, token_t token) {
     if (token.type == TOKENTYPE_IDENT) {
-        return set_contains(&ctx->type_names, token.strval)
-               || (ctx->func_body && set_contains(&ctx->local_type_names, token.strval));
+        return c_parser_is_type_name(ctx, &token);
     } else if (token.type != TOKENTYPE_KEYWORD) {
         return false;
     }
@@ -275,6 +275,14 @@ static bool is_type_node(c_parser_t *ctx, token_t node) {
 
 
 
+// Add a type name to a parser; `local` type names are only recognized in function bodies.
+void c_parser_add_type_name(c_parser_t *ctx, char const *name, bool local) {
+    char const *interned = strpool_intern(&ctx->tkn_ctx->cctx->idents, name, strlen(name));
+    set_add(local ? &ctx->local_type_names : &ctx->type_names, interned);
+}
+
+
+
 // Recursive implementation of `c_parse_comp_init_field`.
 static token_t c_parse_comp_init_field_r(c_parser_t *ctx) {
     token_t peek = tkn_peek(ctx->tkn_ctx);
@@ -612,11 +620,7 @@ static token_t c_parse_ddecl(c_parser_t *ctx, bool allows_name, bool is_typedef)
         tkn_next(ctx->tkn_ctx);
         inner = peek;
         if (is_typedef) {
-            if (ctx->func_body) {
-                set_add(&ctx->local_type_names, inner.strval);
-            } else {
-                set_add(&ctx->type_names, inner.strval);
-            }
+            c_parser_add_type_name(ctx, inner.strval, ctx->func_body);
         }
 
     } else if (peek.type != TOKENTYPE_OTHER || (peek.subtype != C_TKN_LBRAC && peek.subtype != C_TKN_LPAR)) {
@@ -772,9 +776,7 @@ token_t c_parse_spec_qual_list(c_parser_t *ctx, bool *is_typedef_out) {
     while (1) {
         token_t peek = tkn_peek(tkn_ctx);
         if (is_type_specifier(peek) || is_type_qualifier(peek)
-            || (peek.type == TOKENTYPE_IDENT
-                && (set_contains(&ctx->type_names, peek.strval)
-                    || (ctx->func_body && set_contains(&ctx->local_type_names, peek.strval))))) {
+            || (peek.type == TOKENTYPE_IDENT && c_parser_is_type_name(ctx, &peek))) {
             if (peek.type == TOKENTYPE_KEYWORD && peek.subtype == C_KEYW_typedef && is_typedef_out) {
                 *is_typedef_out = true;
             }
@@ -5,9 +5,12 @@
 
 #pragma once
 
+#include "arena.h"
 #include "c_options.h"
+#include "map.h"
 #include "set.h"
 #include "tokenizer.h"
+#include "vec.h"
 
 
 
@@ -117,18 +120,34 @@ typedef enum {
     C_AST_COMPLITERAL,
 } c_asttype_t;
 
+// Function body that was skipped to be parsed later; see `c_parse2_parallel`.
+typedef struct c_deferred_body c_deferred_body_t;
+VEC_TYPE_DEF(vec_c_deferred_body_t, c_deferred_body_t *)
+
 // C parser context.
 typedef struct {
     // Tokenizer to use.
-    tokenizer_t       *tkn_ctx;
+    tokenizer_t          *tkn_ctx;
+    // Compiler context that AST node positions are decoded with, if not the one of `tkn_ctx`.
+    cctx_t const         *src_cctx;
     // Pointer to active C options.
-    c_options_t const *options;
+    c_options_t const    *options;
     // Set of type names; this makes parsing a great deal easier.
-    set_t              type_names;
-    // Local set of type names (types local to a function).
-    set_t              local_type_names;
+    // Pointer set of names interned in the compiler context's `idents` pool; see `c_parser_add_type_name`.
+    set_t                 type_names;
+    // Local set of type names (types local to a function); same format as `type_names`.
+    set_t                 local_type_names;
     // Currently parsing a function body.
-    bool               func_body;
+    bool                  func_body;
+    // Arena that the nodes of ASTs made by `c_parse2` are allocated from.
+    arena_t               ast_arena;
+    // Skip function bodies in `c_parse2` and add them to `deferred_bodies` instead; set by `c_parse2_parallel`.
+    bool                  defer_bodies;
+    // Function bodies skipped because of `defer_bodies`, in source order.
+    vec_c_deferred_body_t deferred_bodies;
+    // Function bodies skipped by `c_parse2_lazy` by the function definition they belong to.
+    // Map of `c_ast_def_func_t const *` -> `c_deferred_body_t *`.
+    map_t                 deferred_funcs;
 } c_parser_t;
 
 
@@ -137,6 +156,16 @@ typedef struct {
 extern char const *const c_asttype_name[];
 #endif
 
+// Add a type name to a parser; `local` type names are only recognized in function bodies.
+void c_parser_add_type_name(c_parser_t *ctx, char const *name, bool local);
+
+// Is identifier token `tkn` a type name?
+static inline bool c_parser_is_type_name(c_parser_t const *ctx, token_t const *tkn) {
+    // Every identifier the parser sees is interned, including ones created by token pasting.
+    return set_contains(&ctx->type_names, tkn->strval)
+           || (ctx->func_body && set_contains(&ctx->local_type_names, tkn->strval));
+}
+
 // Parse a compound initializer.
 token_t c_parse_comp_init(c_parser_t *ctx);
 // Parse one or more C expressions separated by commas.
@@ -10,6 +10,7 @@
 #include "c_compile_expr.h"
 #include "c_compile_stmt.h"
 #include "c_ir.h"
+#include "c_parser2.h"
 #include "c_prim.h"
 #include "c_tokenizer.h"
 #include "c_types.h"
@@ -29,6 +30,11 @@
 
 
 
+// Get the position of an AST node with the line and column filled in.
+pos_t c_compile2_pos(c_compiler_t const *cc, srcrange_t pos) {
+    return srcrange_to_pos(cc->cctx, pos);
+}
+
 // Compile one entire C translation unit into C IR.
 // Returns `NULL` if a a semantic error occurred (`-Werror` excluded).
 cir_trans_unit_t *c_compile2(c_compiler_t *cc, c_ast_def_list_t const *ast) {
@@ -46,7 +52,12 @@ cir_trans_unit_t *c_compile2(c_compiler_t *cc, c_ast_def_list_t const *ast) {
 
                 vec_c_ast_init_decl_t const *decls = &def->def_defs->decls->items;
                 if (decls->len == 0 && spec_qual_type.prim < C_N_PRIM) {
-                    cctx_diagnostic(cc->cctx, def->def_defs->pos, DIAG_WARN, "This statement declares nothing");
+                    cctx_diagnostic(
+                        cc->cctx,
+                        c_compile2_pos(cc, def->def_defs->pos),
+                        DIAG_WARN,
+                        "This statement declares nothing"
+                    );
                 }
 
                 for (size_t i = 0; i < decls->len; i++) {
@@ -59,9 +70,14 @@ cir_trans_unit_t *c_compile2(c_compiler_t *cc, c_ast_def_list_t const *ast) {
                             continue;
                         }
                         if (decl->init) {
-                            cctx_diagnostic(cc->cctx, decl->init->pos, DIAG_ERR, "Cannot have initializer for typedef");
+                            cctx_diagnostic(
+                                cc->cctx,
+                                c_compile2_pos(cc, decl->init->pos),
+                                DIAG_ERR,
+                                "Cannot have initializer for typedef"
+                            );
                         }
-                        cir_scope_add_typedef(cc->cctx, global_scope, name->name, name->pos, type);
+                        cir_scope_add_typedef(cc->cctx, global_scope, name->name, c_compile2_pos(cc, name->pos), type);
                     } else {
                         cir_unit_t *unit = c_compile2_decl(cc, global_scope, c_type_clone(spec_qual_type), decl);
                         if (unit) {
@@ -85,6 +101,22 @@ cir_trans_unit_t *c_compile2(c_compiler_t *cc, c_ast_def_list_t const *ast) {
         }
     }
 
+    // Compile the skipped inline functions that turned out to be referenced, which may reference more of them.
+    for (size_t i = 0; i < cc->lazy_referenced.len; i++) {
+        c_lazy_func_t *lazy = cc->lazy_referenced.arr[i];
+        // Parsing the body first makes `c_compile2_func` compile it instead of declaring it again.
+        c_parse2_body(cc->lazy_parser, lazy->def);
+        // Names declared after the definition must not resolve, like when the body is compiled in order.
+        cir_scope_hide_bindings(global_scope, lazy->bindings_len, cir_scope_bindings_len(global_scope));
+        cir_unit_t *unit = c_compile2_func(cc, global_scope, lazy->def);
+        cir_scope_hide_bindings(global_scope, 0, 0);
+        if (unit) {
+            vec_push(&units, unit);
+        }
+        lilycc_free(lazy);
+    }
+    vec_clear(&cc->lazy_referenced);
+
     return cir_trans_unit_create(global_scope, units);
 }
 
@@ -111,7 +143,13 @@ cir_unit_t *
     cir_expr_t *init = NULL;
     if (ast->init) {
         if (ast->init->tag == C_AST_TAG_INITVAL_COMPOUND) {
-            init = c_compile2_compinit(cc, scope, c_type_clone(type), ast->decl->pos, ast->init->initval_compound);
+            init = c_compile2_compinit(
+                cc,
+                scope,
+                c_type_clone(type),
+                c_compile2_pos(cc, ast->decl->pos),
+                ast->init->initval_compound
+            );
         } else {
             assert(ast->init->tag == C_AST_TAG_INITVAL_EXPR);
             init = c_compile2_expr(cc, scope, ast->init->initval_expr);
@@ -119,7 +157,7 @@ cir_unit_t *
         // If `init == NULL`, we still want the decl to be created to avoid noisy error recovery.
     }
 
-    cir_decl_t *decl = cir_decl_create(name->pos, type, lilycc_strdup(name->name), init);
+    cir_decl_t *decl = cir_decl_create(c_compile2_pos(cc, name->pos), type, lilycc_strdup(name->name), init);
 
     if (!cir_scope_add_decl(cc->cctx, scope, decl)) {
         cir_decl_delete(decl);
@@ -134,11 +172,13 @@ cir_unit_t *c_compile2_func(c_compiler_t *cc, cir_scope_t *scope, c_ast_def_func
     bool errors;
 
     // Compile decl type.
-    c_type_t             type = c_compile2_spec_qual_list(cc, def->spec_qual, scope);
-    c_ast_ident_t const *name = NULL;
+    c_type_t             type      = c_compile2_spec_qual_list(cc, def->spec_qual, scope);
+    c_ast_ident_t const *name      = NULL;
+    bool                 is_inline = false;
     if (c_type_is_valid(type)) {
+        is_inline = type.qual.s_inline;
         if (type.qual.s_typedef) {
-            cctx_diagnostic(cc->cctx, def->spec_qual->pos, DIAG_ERR, "typedef not allowed here");
+            cctx_diagnostic(cc->cctx, c_compile2_pos(cc, def->spec_qual->pos), DIAG_ERR, "typedef not allowed here");
             errors = true;
         }
         type   = c_compile2_type(cc, scope, type, def->declarator, &name);
@@ -147,6 +187,24 @@ cir_unit_t *c_compile2_func(c_compiler_t *cc, cir_scope_t *scope, c_ast_def_func
         errors = true;
     }
 
+    if (!def->body && is_inline && !errors && !set_contains(&cc->lazy_used, name->name)) {
+        // The body of an inline function is only needed if it is referenced; see `c_compile2_expr_ident`.
+        c_lazy_func_t *lazy = lilycc_malloc(sizeof(c_lazy_func_t));
+        lazy->def           = def;
+        // The function itself is not in scope in its own body unless it was declared before.
+        lazy->bindings_len  = cir_scope_bindings_len(scope);
+        cir_decl_t *decl    = cir_decl_create(c_compile2_pos(cc, name->pos), type, lilycc_strdup(name->name), NULL);
+        if (!cir_scope_add_decl(cc->cctx, scope, decl)) {
+            cir_decl_delete(decl);
+            lilycc_free(lazy);
+            return NULL;
+        }
+        // TODO: A second definition of the same function is not diagnosed; the last one wins.
+        lilycc_free(map_get(&cc->lazy_funcs, name->name));
+        map_set(&cc->lazy_funcs, name->name, lazy);
+        return cir_unit_create_decl(decl);
+    }
+
     cir_scope_t   *func_scope = cir_scope_create(CIR_SCOPE_FUNC, scope);
     vec_cir_stmt_t body       = {0};
 
@@ -166,11 +224,11 @@ cir_unit_t *c_compile2_func(c_compiler_t *cc, cir_scope_t *scope, c_ast_def_func
                 errors = true;
             }
         }
-        vec_push(&body, cir_stmt_create_units(cir_unit_list_create(def->pos, units)));
+        vec_push(&body, cir_stmt_create_units(cir_unit_list_create(c_compile2_pos(cc, def->pos), units)));
     }
 
     // Compile the body proper.
-    vec_c_ast_stmt_t const *body_ast = &def->body->items;
+    vec_c_ast_stmt_t const *body_ast = &c_parse2_body(cc->lazy_parser, def)->items;
     for (size_t i = 0; i < body_ast->len; i++) {
         cir_stmt_t *stmt = c_compile2_stmt(cc, func_scope, body_ast->arr[i]);
         if (stmt) {
@@ -190,6 +248,9 @@ cir_unit_t *c_compile2_func(c_compiler_t *cc, cir_scope_t *scope, c_ast_def_func
         }
     }
 
+    // The parameters and locals go out of scope before the function itself is added to `scope`.
+    cir_scope_exit(func_scope);
+
     if (errors) {
         for (size_t i = 0; i < body.len; i++) {
             cir_stmt_delete(body.arr[i]);
@@ -199,7 +260,7 @@ cir_unit_t *c_compile2_func(c_compiler_t *cc, cir_scope_t *scope, c_ast_def_func
 
         // For error recovery, we try to at least emit a decl of the function if the type is valid.
         if (c_type_is_valid(type)) {
-            cir_decl_t *decl = cir_decl_create(name->pos, type, lilycc_strdup(name->name), NULL);
+            cir_decl_t *decl = cir_decl_create(c_compile2_pos(cc, name->pos), type, lilycc_strdup(name->name), NULL);
             if (!cir_scope_add_decl(cc->cctx, scope, decl)) {
                 cir_decl_delete(decl);
                 return NULL;
@@ -210,7 +271,13 @@ cir_unit_t *c_compile2_func(c_compiler_t *cc, cir_scope_t *scope, c_ast_def_func
         return NULL;
     }
 
-    cir_func_t *func = cir_func_create(name->pos, func_scope, type, lilycc_strdup(name->name), body);
+    cir_func_t *func = cir_func_create(
+        c_compile2_pos(cc, name->pos),
+        func_scope,
+        type,
+        lilycc_strdup(name->name),
+        body
+    );
     if (!cir_scope_add_func(cc->cctx, scope, func)) {
         cir_func_delete(func);
         return NULL;
@@ -240,7 +307,12 @@ static void
             }
             if (res->tag != CIR_EXPR_VALUE || res->value->tag != CIR_VALUE_CONST
                 || res->common.type.prim >= C_PRIM_FLOAT) {
-                cctx_diagnostic(cc->cctx, value->pos, DIAG_ERR, "Expected integer constant expression");
+                cctx_diagnostic(
+                    cc->cctx,
+                    c_compile2_pos(cc, value->pos),
+                    DIAG_ERR,
+                    "Expected integer constant expression"
+                );
                 cir_expr_delete(res);
                 continue;
             }
@@ -248,11 +320,11 @@ static void
             cir_expr_delete(res);
         }
         if (map_get(&scope->values, name->name)) {
-            cctx_diagnostic(cc->cctx, name->pos, DIAG_ERR, "Redefinition of %s", name->name);
+            cctx_diagnostic(cc->cctx, c_compile2_pos(cc, name->pos), DIAG_ERR, "Redefinition of %s", name->name);
             continue;
         } else {
             ir_const_t   ir_const = ir_cast(ir_prim, IR_CONST_S32(cur));
-            cir_const_t *iconst   = cir_const_create(name->pos, C_PRIM_SINT, ir_const);
+            cir_const_t *iconst   = cir_const_create(c_compile2_pos(cc, name->pos), C_PRIM_SINT, ir_const);
             cir_scope_add_enum_const(cc->cctx, scope, name->name, iconst);
 
             c_enumvar_t enumvar;
@@ -339,7 +411,7 @@ static void c_compile2_struct_body(
             errors = true;
             continue;
         } else if (inner.qual.s_typedef) {
-            cctx_diagnostic(cc->cctx, def->spec_qual->pos, DIAG_ERR, "typedef not allowed here");
+            cctx_diagnostic(cc->cctx, c_compile2_pos(cc, def->spec_qual->pos), DIAG_ERR, "typedef not allowed here");
             c_type_delete(inner);
             errors = true;
             continue;
@@ -365,7 +437,7 @@ static void c_compile2_struct_body(
                 errors |= c_compile2_struct_field(
                     cc,
                     comp,
-                    decls->arr[x]->decl->pos,
+                    c_compile2_pos(cc, decls->arr[x]->decl->pos),
                     name_ast->name,
                     field_type,
                     target_size_max
@@ -406,12 +478,12 @@ static c_comp_type_t *c_compile2_comp_spec(c_compiler_t *cc, c_ast_spec_qual_t c
         comp       = lilycc_calloc(1, sizeof(c_comp_type_t));
         comp->name = name ? lilycc_strdup(name->name) : NULL;
         if (name) {
-            comp->pos = name->pos;
+            comp->pos = c_compile2_pos(cc, name->pos);
         } else if (comp_spec->tag == C_AST_TAG_SPEC_QUAL_ENUM) {
-            comp->pos = comp_spec->spec_qual_struct->keyw_pos;
+            comp->pos = c_compile2_pos(cc, comp_spec->spec_qual_struct->keyw_pos);
         } else {
             assert(comp_spec->tag == C_AST_TAG_SPEC_QUAL_STRUCT);
-            comp->pos = comp_spec->spec_qual_enum->keyw_pos;
+            comp->pos = c_compile2_pos(cc, comp_spec->spec_qual_enum->keyw_pos);
         }
         comp->tag      = tag;
         comp->refcount = 1;
@@ -432,7 +504,7 @@ static c_comp_type_t *c_compile2_comp_spec(c_compiler_t *cc, c_ast_spec_qual_t c
         };
         cctx_diagnostic(
             cc->cctx,
-            name->pos, // Non-NULL because it's impossible to get this error with anonymous structs
+            c_compile2_pos(cc, name->pos), // Non-NULL because it's impossible to get this error with anonymous structs
             DIAG_ERR,
             "Use of %s (which is %s) as %s",
             name->name,
@@ -520,17 +592,22 @@ c_type_opt_t c_compile2_spec_qual_list(c_compiler_t *cc, c_ast_spec_qual_list_t
         } else if (typedef_name || comp) {
             pos_t pos;
             if (typedef_name) {
-                pos = typedef_name->pos;
+                pos = c_compile2_pos(cc, typedef_name->pos);
             } else {
                 assert(comp);
                 if (comp->tag == C_AST_TAG_SPEC_QUAL_ENUM) {
-                    pos = comp->spec_qual_enum->keyw_pos;
+                    pos = c_compile2_pos(cc, comp->spec_qual_enum->keyw_pos);
                 } else {
                     assert(comp->tag == C_AST_TAG_SPEC_QUAL_STRUCT);
-                    pos = comp->spec_qual_struct->keyw_pos;
+                    pos = c_compile2_pos(cc, comp->spec_qual_struct->keyw_pos);
                 }
             }
-            cctx_diagnostic(cc->cctx, param->pos, DIAG_ERR, "Multiple types in specifier-qualifier list");
+            cctx_diagnostic(
+                cc->cctx,
+                c_compile2_pos(cc, param->pos),
+                DIAG_ERR,
+                "Multiple types in specifier-qualifier list"
+            );
             cctx_diagnostic(cc->cctx, pos, DIAG_INFO, "Previous type in this list");
         } else if (param->tag == C_AST_TAG_SPEC_QUAL_ENUM || param->tag == C_AST_TAG_SPEC_QUAL_STRUCT) {
             comp = param;
@@ -541,7 +618,7 @@ c_type_opt_t c_compile2_spec_qual_list(c_compiler_t *cc, c_ast_spec_qual_list_t
     }
 
     if (n_signed && n_unsigned) {
-        cctx_diagnostic(cc->cctx, list->pos, DIAG_ERR, "Invalid combination of type specifiers");
+        cctx_diagnostic(cc->cctx, c_compile2_pos(cc, list->pos), DIAG_ERR, "Invalid combination of type specifiers");
         return C_TYPE_INVALID;
     }
 
@@ -567,14 +644,24 @@ c_type_opt_t c_compile2_spec_qual_list(c_compiler_t *cc, c_ast_spec_qual_list_t
         cir_typedef_t const *inner = cir_scope_lookup_typedef(scope, typedef_name->name);
         if (!inner) {
             if (cir_scope_lookup_value(scope, typedef_name->name)) {
-                cctx_diagnostic(cc->cctx, typedef_name->pos, DIAG_ERR, "expected a typedef name");
+                cctx_diagnostic(cc->cctx, c_compile2_pos(cc, typedef_name->pos), DIAG_ERR, "expected a typedef name");
             } else {
-                cctx_diagnostic(cc->cctx, typedef_name->pos, DIAG_ERR, "use of undeclared identifier");
+                cctx_diagnostic(
+                    cc->cctx,
+                    c_compile2_pos(cc, typedef_name->pos),
+                    DIAG_ERR,
+                    "use of undeclared identifier"
+                );
             }
             return C_TYPE_INVALID;
         }
         if (type.qual.val & inner->type.qual.val) {
-            cctx_diagnostic(cc->cctx, list->pos, DIAG_WARN, "redundant items in specifier-qualifier list");
+            cctx_diagnostic(
+                cc->cctx,
+                c_compile2_pos(cc, list->pos),
+                DIAG_WARN,
+                "redundant items in specifier-qualifier list"
+            );
         }
         type.qual.val |= inner->type.qual.val;
 
@@ -698,7 +785,7 @@ c_type_opt_t c_compile2_spec_qual_list(c_compiler_t *cc, c_ast_spec_qual_list_t
 
     if (n_long || n_int || n_short || n_char || n_float || n_double || n_void || n_bool || n_unsigned || n_signed
         || n_int128) {
-        cctx_diagnostic(cc->cctx, list->pos, DIAG_ERR, "Invalid combination of type specifiers");
+        cctx_diagnostic(cc->cctx, c_compile2_pos(cc, list->pos), DIAG_ERR, "Invalid combination of type specifiers");
     }
 
     return type;
@@ -752,7 +839,12 @@ c_type_opt_t c_compile2_type(
                     continue;
                 }
                 if (type.qual.s_typedef) {
-                    cctx_diagnostic(cc->cctx, def->spec_qual->pos, DIAG_ERR, "typedef not allowed here");
+                    cctx_diagnostic(
+                        cc->cctx,
+                        c_compile2_pos(cc, def->spec_qual->pos),
+                        DIAG_ERR,
+                        "typedef not allowed here"
+                    );
                     errors = true;
                 }
                 if (def->decl) {
@@ -774,7 +866,7 @@ c_type_opt_t c_compile2_type(
                 arg.type         = type;
                 if (name) {
                     arg.name     = name->name;
-                    arg.name_pos = name->pos;
+                    arg.name_pos = c_compile2_pos(cc, name->pos);
                 }
                 vec_push(&func->args, arg);
             }
@@ -790,7 +882,7 @@ c_type_opt_t c_compile2_type(
         } else if (decl->tag == C_AST_TAG_DECL_ARRAY) {
             uint64_t inner_size, inner_align;
             if (!c_type_get_size(cc, cur, &inner_size, &inner_align)) {
-                cctx_diagnostic(cc->cctx, decl->pos, DIAG_ERR, "Array has incomplete element type");
+                cctx_diagnostic(cc->cctx, c_compile2_pos(cc, decl->pos), DIAG_ERR, "Array has incomplete element type");
                 c_type_delete(cur);
                 return C_TYPE_INVALID;
             }
@@ -815,7 +907,7 @@ c_type_opt_t c_compile2_type(
                     || res->common.type.prim >= C_PRIM_FLOAT) {
                     cctx_diagnostic(
                         cc->cctx,
-                        decl->decl_array->size->pos,
+                        c_compile2_pos(cc, decl->decl_array->size->pos),
                         DIAG_ERR,
                         "Expected integer constant expression"
                     );
@@ -832,7 +924,7 @@ c_type_opt_t c_compile2_type(
                     itoa128(neg128(length.const128), 0, buf);
                     cctx_diagnostic(
                         cc->cctx,
-                        decl->decl_array->size->pos,
+                        c_compile2_pos(cc, decl->decl_array->size->pos),
                         DIAG_ERR,
                         "Array length -%s is negative",
                         buf
@@ -848,7 +940,7 @@ c_type_opt_t c_compile2_type(
                     itoa128(length.const128, 0, buf);
                     cctx_diagnostic(
                         cc->cctx,
-                        decl->decl_array->size->pos,
+                        c_compile2_pos(cc, decl->decl_array->size->pos),
                         DIAG_ERR,
                         "Array length %s exceeds implementation limits (%" PRId32 ")",
                         buf,
@@ -12,6 +12,8 @@
 
 
 
+// Get the position of an AST node with the line and column filled in.
+pos_t             c_compile2_pos(c_compiler_t const *cc, srcrange_t pos);
 // Compile one entire C translation unit into C IR.
 // Returns `NULL` if a a semantic error occurred (`-Werror` excluded).
 cir_trans_unit_t *c_compile2(c_compiler_t *cc, c_ast_def_list_t const *ast);
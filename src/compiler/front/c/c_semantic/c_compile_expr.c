@@ -17,6 +17,8 @@
 #include "ir_interpreter.h"
 #include "ir_types.h"
 #include "lilycc_malloc.h"
+#include "map.h"
+#include "set.h"
 #include "unreachable.h"
 #include "vec.h"
 
@@ -466,15 +468,15 @@ cir_expr_t *c_compile2_expr_ternary(c_compiler_t *cc, cir_scope_t *scope, c_ast_
         goto error;
     }
 
-    c_type_opt_t type
-        = c_compile2_ternary_result_type(cc, expr->pos, (if_expr ?: cond)->common.type, else_expr->common.type);
+    pos_t        pos  = c_compile2_pos(cc, expr->pos);
+    c_type_opt_t type = c_compile2_ternary_result_type(cc, pos, (if_expr ?: cond)->common.type, else_expr->common.type);
     if (!c_type_is_valid(type)) {
         goto error;
     }
 
     cir_expr_common_t common = {
         .type         = type,
-        .pos          = expr->pos,
+        .pos          = pos,
         .is_lvalue    = false,
         .allow_addrof = false,
     };
@@ -528,7 +530,7 @@ cir_expr_t *c_compile2_expr_index(c_compiler_t *cc, cir_scope_t *scope, c_ast_ex
 
             cir_expr_t *const_prop = c_compile2_const_from_bytes(
                 cc,
-                expr->pos,
+                c_compile2_pos(cc, expr->pos),
                 elem_type,
                 lhs->value->comp_const->blob + size * ir_index.constl
             );
@@ -541,13 +543,13 @@ cir_expr_t *c_compile2_expr_index(c_compiler_t *cc, cir_scope_t *scope, c_ast_ex
     }
 
 non_const_prop:;
-    cir_expr_t *add = expand_calc(cc, expr->pos, CIR_CALC_ADD, lhs, rhs, false);
+    cir_expr_t *add = expand_calc(cc, c_compile2_pos(cc, expr->pos), CIR_CALC_ADD, lhs, rhs, false);
     if (!add) {
         return NULL;
     }
 
     cir_expr_common_t common = {
-        .pos          = expr->pos,
+        .pos          = c_compile2_pos(cc, expr->pos),
         .type         = c_type_clone(add->common.type.extra->inner),
         .allow_addrof = true,
         .is_lvalue    = true,
@@ -610,7 +612,7 @@ static cir_expr_t *
     c_compile2_expr_field(c_compiler_t *cc, cir_scope_t *scope, c_ast_expr_infix_t const *expr, bool is_arrow) {
     // RHS must be a bare identifier denoting the member name.
     if (expr->rhs->tag != C_AST_TAG_EXPR_IDENT) {
-        cctx_diagnostic(cc->cctx, expr->rhs->pos, DIAG_ERR, "Expected member name");
+        cctx_diagnostic(cc->cctx, c_compile2_pos(cc, expr->rhs->pos), DIAG_ERR, "Expected member name");
         return NULL;
     }
     char const *name = expr->rhs->expr_ident->name;
@@ -623,7 +625,7 @@ static cir_expr_t *
     // Const-propagation logic.
     if (lhs->tag == CIR_EXPR_VALUE && lhs->value->tag == CIR_VALUE_COMP_CONST) {
         c_type_ref_t   struct_type = lhs->value->comp_const->type;
-        c_field_info_t field       = c_type_get_field(cc, struct_type, name, expr->pos);
+        c_field_info_t field       = c_type_get_field(cc, struct_type, name, c_compile2_pos(cc, expr->pos));
         if (!c_type_is_valid(field.type)) {
             cir_expr_delete(lhs);
             return NULL;
@@ -643,7 +645,12 @@ static cir_expr_t *
     if (is_arrow) {
         c_type_ref_t type = lhs->common.type;
         if (type.prim != C_COMP_POINTER) {
-            cctx_diagnostic(cc->cctx, expr->oper_pos, DIAG_ERR, "Left operand of -> must be a pointer");
+            cctx_diagnostic(
+                cc->cctx,
+                c_compile2_pos(cc, expr->oper_pos),
+                DIAG_ERR,
+                "Left operand of -> must be a pointer"
+            );
             cir_expr_delete(lhs);
             return NULL;
         }
@@ -652,7 +659,12 @@ static cir_expr_t *
     } else {
         c_type_ref_t type = lhs->common.type;
         if (type.prim != C_COMP_STRUCT && type.prim != C_COMP_UNION) {
-            cctx_diagnostic(cc->cctx, expr->oper_pos, DIAG_ERR, "Left operand of . must be a struct or union");
+            cctx_diagnostic(
+                cc->cctx,
+                c_compile2_pos(cc, expr->oper_pos),
+                DIAG_ERR,
+                "Left operand of . must be a struct or union"
+            );
             cir_expr_delete(lhs);
             return NULL;
         }
@@ -660,7 +672,7 @@ static cir_expr_t *
         c_type_t ptr_rc = c_type_clone_pointer(lhs->common.type);
         ptr_expr        = cir_expr_create_addrof(cir_addrof_create(
             (cir_expr_common_t){
-                .pos          = expr->pos,
+                .pos          = c_compile2_pos(cc, expr->pos),
                 .is_lvalue    = false,
                 .allow_addrof = false,
                 .type         = ptr_rc,
@@ -670,12 +682,17 @@ static cir_expr_t *
     }
 
     if (struct_type.prim != C_COMP_STRUCT && struct_type.prim != C_COMP_UNION) {
-        cctx_diagnostic(cc->cctx, expr->oper_pos, DIAG_ERR, "Member access on non-struct/union type");
+        cctx_diagnostic(
+            cc->cctx,
+            c_compile2_pos(cc, expr->oper_pos),
+            DIAG_ERR,
+            "Member access on non-struct/union type"
+        );
         cir_expr_delete(ptr_expr);
         return NULL;
     }
 
-    c_field_info_t field = c_type_get_field(cc, struct_type, name, expr->pos);
+    c_field_info_t field = c_type_get_field(cc, struct_type, name, c_compile2_pos(cc, expr->pos));
     if (!c_type_is_valid(field.type)) {
         cir_expr_delete(ptr_expr);
         return NULL;
@@ -683,10 +700,15 @@ static cir_expr_t *
 
     // Build a pointer-to-field type, then `ptr + offset` as that type, then deref.
     c_type_t    field_ptr_type = c_type_clone_pointer(field.type);
-    cir_expr_t *off_iconst = c_compile2_synth_iconst(cc, expr->oper_pos, cc->options.size_type, ui128(field.offset));
+    cir_expr_t *off_iconst = c_compile2_synth_iconst(
+        cc,
+        c_compile2_pos(cc, expr->oper_pos),
+        cc->options.size_type,
+        ui128(field.offset)
+    );
     cir_expr_t *add        = cir_expr_create_calc(cir_calc_create(
         (cir_expr_common_t){
-            .pos          = expr->pos,
+            .pos          = c_compile2_pos(cc, expr->pos),
             .is_lvalue    = false,
             .allow_addrof = false,
             .type         = field_ptr_type,
@@ -697,7 +719,7 @@ static cir_expr_t *
     ));
     return cir_expr_create_deref(cir_deref_create(
         (cir_expr_common_t){
-            .pos          = expr->pos,
+            .pos          = c_compile2_pos(cc, expr->pos),
             .is_lvalue    = true,
             .allow_addrof = true,
             .type         = c_type_clone(field.type),
@@ -728,11 +750,16 @@ cir_expr_t *c_compile2_expr_infix(c_compiler_t *cc, cir_scope_t *scope, c_ast_ex
     // Plain assignment: type-check, then emit an assign node.
     if (expr->oper == C_TKN_ASSIGN) {
         if (!lhs->common.is_lvalue || ltyp.qual.q_const) {
-            cctx_diagnostic(cc->cctx, expr->oper_pos, DIAG_ERR, "Left operand of = is not a modifiable lvalue");
+            cctx_diagnostic(
+                cc->cctx,
+                c_compile2_pos(cc, expr->oper_pos),
+                DIAG_ERR,
+                "Left operand of = is not a modifiable lvalue"
+            );
             goto error;
         }
         if (!c_type_is_castable(ltyp, rhs->common.type)) {
-            cctx_diagnostic(cc->cctx, expr->oper_pos, DIAG_ERR, "Incompatible types in assignment");
+            cctx_diagnostic(cc->cctx, c_compile2_pos(cc, expr->oper_pos), DIAG_ERR, "Incompatible types in assignment");
             goto error;
         }
         // Insert an implicit cast if the RHS type differs.
@@ -760,7 +787,7 @@ cir_expr_t *c_compile2_expr_infix(c_compiler_t *cc, cir_scope_t *scope, c_ast_ex
     if (compound && (!lhs->common.is_lvalue || ltyp.qual.q_const)) {
         cctx_diagnostic(
             cc->cctx,
-            expr->oper_pos,
+            c_compile2_pos(cc, expr->oper_pos),
             DIAG_ERR,
             "Left operand of %s is not a modifiable lvalue",
             c_token_name[expr->oper]
@@ -769,9 +796,9 @@ cir_expr_t *c_compile2_expr_infix(c_compiler_t *cc, cir_scope_t *scope, c_ast_ex
     }
 
     if (compound) {
-        return expand_calc_assign(cc, expr->pos, op, lhs, rhs);
+        return expand_calc_assign(cc, c_compile2_pos(cc, expr->pos), op, lhs, rhs);
     } else {
-        return expand_calc(cc, expr->pos, op, lhs, rhs, false);
+        return expand_calc(cc, c_compile2_pos(cc, expr->pos), op, lhs, rhs, false);
     }
 
 error:
@@ -790,6 +817,7 @@ cir_expr_t *c_compile2_expr_prefix(c_compiler_t *cc, cir_scope_t *scope, c_ast_e
     if (!val) {
         return NULL;
     }
+    pos_t pos = c_compile2_pos(cc, expr->pos);
 
     // All prefix operators require pointer or integral type.
     if (
@@ -805,7 +833,7 @@ cir_expr_t *c_compile2_expr_prefix(c_compiler_t *cc, cir_scope_t *scope, c_ast_e
     ) {
         cctx_diagnostic(
             cc->cctx,
-            expr->oper_pos,
+            c_compile2_pos(cc, expr->oper_pos),
             DIAG_ERR,
             "Invalid argument type supplied to %s",
             c_token_name[expr->oper]
@@ -817,32 +845,32 @@ cir_expr_t *c_compile2_expr_prefix(c_compiler_t *cc, cir_scope_t *scope, c_ast_e
 
     switch (expr->oper) {
         case C_TKN_LNOT: { // Logical NOT `!expr`
-            cir_expr_t *zero = c_compile2_synth_iconst(cc, expr->pos, prim, I128_ZERO);
-            return expand_calc(cc, expr->pos, CIR_CALC_EQ, val, zero, false);
+            cir_expr_t *zero = c_compile2_synth_iconst(cc, pos, prim, I128_ZERO);
+            return expand_calc(cc, pos, CIR_CALC_EQ, val, zero, false);
         }
         case C_TKN_NOT: { // Bitwise NOT `~expr`
-            cir_expr_t *mask = c_compile2_synth_iconst(cc, expr->pos, prim, UI128_MAX);
-            return expand_calc(cc, expr->pos, CIR_CALC_BXOR, val, mask, false);
+            cir_expr_t *mask = c_compile2_synth_iconst(cc, pos, prim, UI128_MAX);
+            return expand_calc(cc, pos, CIR_CALC_BXOR, val, mask, false);
         }
         case C_TKN_INC:   // Pre-increment `++expr`
         case C_TKN_DEC: { // Pre-decrement `--expr`
             c_type_t    type = c_type_clone(val->common.type);
-            cir_expr_t *one  = c_compile2_synth_iconst(cc, expr->pos, cc->options.size_type, ui128(1));
+            cir_expr_t *one  = c_compile2_synth_iconst(cc, pos, cc->options.size_type, ui128(1));
             cir_expr_t *calc
-                = expand_calc_assign(cc, expr->pos, expr->oper == C_TKN_INC ? CIR_CALC_ADD : CIR_CALC_SUB, val, one);
+                = expand_calc_assign(cc, pos, expr->oper == C_TKN_INC ? CIR_CALC_ADD : CIR_CALC_SUB, val, one);
             if (!calc) {
                 return NULL;
             }
-            return raw_cast(cc, expr->pos, type, calc);
+            return raw_cast(cc, pos, type, calc);
         }
         case C_TKN_ADD: { // Arithmetic promote `+`.
             c_prim_t conv = usual_arith_conv(cc, val->common.type, C_TYPE_INVALID);
             assert(conv != C_N_PRIM); // Should always be possible.
-            return raw_cast(cc, expr->pos, C_TYPE_FROM_PRIM(conv), val);
+            return raw_cast(cc, pos, C_TYPE_FROM_PRIM(conv), val);
         }
         case C_TKN_SUB: { // Arithmetic negate `-`.
-            cir_expr_t *zero = c_compile2_synth_iconst(cc, expr->pos, prim, I128_ZERO);
-            return expand_calc(cc, expr->pos, CIR_CALC_SUB, zero, val, false);
+            cir_expr_t *zero = c_compile2_synth_iconst(cc, pos, prim, I128_ZERO);
+            return expand_calc(cc, pos, CIR_CALC_SUB, zero, val, false);
         }
         case C_TKN_AND: { // Address-of `&`
             if (val->common.type.prim == C_COMP_FUNCTION) {
@@ -850,14 +878,14 @@ cir_expr_t *c_compile2_expr_prefix(c_compiler_t *cc, cir_scope_t *scope, c_ast_e
                 // The function instead decays implicitly into a function pointer as needed.
                 return val;
             }
-            return raw_addrof(cc, expr->pos, val);
+            return raw_addrof(cc, pos, val);
         }
         case C_TKN_MUL: { // Dereference `*expr`
             if (val->common.type.prim != C_COMP_POINTER) {
                 goto err0;
             }
             cir_expr_common_t common = {
-                .pos          = expr->pos,
+                .pos          = pos,
                 .is_lvalue    = false,
                 .allow_addrof = false,
                 .type         = c_type_clone(val->common.type),
@@ -886,6 +914,7 @@ cir_expr_t *c_compile2_expr_suffix(c_compiler_t *cc, cir_scope_t *scope, c_ast_e
     if (!val) {
         return NULL;
     }
+    pos_t pos = c_compile2_pos(cc, expr->pos);
 
     if (expr->oper != C_TKN_DEC && expr->oper != C_TKN_INC) {
         fprintf(stderr, "BUG: Unhandled suffix operator\n");
@@ -896,7 +925,7 @@ cir_expr_t *c_compile2_expr_suffix(c_compiler_t *cc, cir_scope_t *scope, c_ast_e
     if (val->common.type.prim >= C_PRIM_VOID && val->common.type.prim != C_COMP_POINTER) {
         cctx_diagnostic(
             cc->cctx,
-            expr->oper_pos,
+            c_compile2_pos(cc, expr->oper_pos),
             DIAG_ERR,
             "Invalid argument type supplied to %s",
             c_token_name[expr->oper]
@@ -905,18 +934,16 @@ cir_expr_t *c_compile2_expr_suffix(c_compiler_t *cc, cir_scope_t *scope, c_ast_e
     }
 
     c_type_t    type  = c_type_clone(val->common.type);
-    cir_expr_t *one_a = c_compile2_synth_iconst(cc, expr->pos, cc->options.size_type, ui128(1));
-    cir_expr_t *res
-        = expand_calc_assign(cc, expr->pos, expr->oper == C_TKN_INC ? CIR_CALC_ADD : CIR_CALC_SUB, val, one_a);
+    cir_expr_t *one_a = c_compile2_synth_iconst(cc, pos, cc->options.size_type, ui128(1));
+    cir_expr_t *res   = expand_calc_assign(cc, pos, expr->oper == C_TKN_INC ? CIR_CALC_ADD : CIR_CALC_SUB, val, one_a);
     if (!res) {
         return NULL;
     }
     // Simply offset by one in the opposite direction to effectively get the same result as post-increment/decrement.
-    cir_expr_t *one_b = c_compile2_synth_iconst(cc, expr->pos, cc->options.size_type, ui128(1));
-    cir_expr_t *undo
-        = expand_calc(cc, expr->pos, expr->oper == C_TKN_INC ? CIR_CALC_SUB : CIR_CALC_ADD, res, one_b, false);
+    cir_expr_t *one_b = c_compile2_synth_iconst(cc, pos, cc->options.size_type, ui128(1));
+    cir_expr_t *undo  = expand_calc(cc, pos, expr->oper == C_TKN_INC ? CIR_CALC_SUB : CIR_CALC_ADD, res, one_b, false);
     assert(undo != NULL); // If the calc one worked, so should this one.
-    return raw_cast(cc, expr->pos, type, undo);
+    return raw_cast(cc, pos, type, undo);
 
 err0:
     cir_expr_delete(val);
@@ -930,7 +957,7 @@ cir_expr_t *c_compile2_expr_cast(c_compiler_t *cc, cir_scope_t *scope, c_ast_exp
         return NULL;
     }
     if (spec_qual.qual.s_typedef) {
-        cctx_diagnostic(cc->cctx, cast->type->spec_qual->pos, DIAG_ERR, "typedef not allowed here");
+        cctx_diagnostic(cc->cctx, c_compile2_pos(cc, cast->type->spec_qual->pos), DIAG_ERR, "typedef not allowed here");
         c_type_delete(spec_qual);
         return NULL;
     }
@@ -938,7 +965,7 @@ cir_expr_t *c_compile2_expr_cast(c_compiler_t *cc, cir_scope_t *scope, c_ast_exp
 
     c_type_t type = c_compile2_type(cc, scope, spec_qual, cast->type->decl, &name);
     if (name) {
-        cctx_diagnostic(cc->cctx, name->pos, DIAG_ERR, "Identifier not allowed here");
+        cctx_diagnostic(cc->cctx, c_compile2_pos(cc, name->pos), DIAG_ERR, "Identifier not allowed here");
     }
 
     cir_expr_t *val = c_compile2_expr(cc, scope, cast->val);
@@ -947,7 +974,7 @@ cir_expr_t *c_compile2_expr_cast(c_compiler_t *cc, cir_scope_t *scope, c_ast_exp
         return NULL;
     }
 
-    return raw_cast(cc, cast->pos, type, val);
+    return raw_cast(cc, c_compile2_pos(cc, cast->pos), type, val);
 }
 
 // Compile a call expression.
@@ -976,14 +1003,19 @@ cir_expr_t *c_compile2_expr_call(c_compiler_t *cc, cir_scope_t *scope, c_ast_exp
         func_type = func_type.extra->inner;
     }
     if (func_type.prim != C_COMP_FUNCTION) {
-        cctx_diagnostic(cc->cctx, call->pos, DIAG_ERR, "Called object is not a function or function pointer");
+        cctx_diagnostic(
+            cc->cctx,
+            c_compile2_pos(cc, call->pos),
+            DIAG_ERR,
+            "Called object is not a function or function pointer"
+        );
         goto error;
     }
 
     if (args.len != func_type.extra->func_type->args.len) {
         cctx_diagnostic(
             cc->cctx,
-            call->pos,
+            c_compile2_pos(cc, call->pos),
             DIAG_ERR,
             "Function expects %zu argument(s), got %zu",
             func_type.extra->func_type->args.len,
@@ -1014,7 +1046,7 @@ cir_expr_t *c_compile2_expr_call(c_compiler_t *cc, cir_scope_t *scope, c_ast_exp
 
     return cir_expr_create_call(cir_call_create(
         (cir_expr_common_t){
-            .pos          = call->pos,
+            .pos          = c_compile2_pos(cc, call->pos),
             .is_lvalue    = false,
             .allow_addrof = false,
             .type         = c_type_clone(func_type.extra->func_type->returns),
@@ -1038,16 +1070,33 @@ error:
 cir_expr_t *c_compile2_expr_ident(c_compiler_t *cc, cir_scope_t *scope, c_ast_ident_t const *ident) {
     cir_scope_val_t *val = cir_scope_lookup_value(scope, ident->name);
     if (!val) {
-        cctx_diagnostic(cc->cctx, ident->pos, DIAG_ERR, "Use of undeclared identifier '%s'", ident->name);
+        cctx_diagnostic(
+            cc->cctx,
+            c_compile2_pos(cc, ident->pos),
+            DIAG_ERR,
+            "Use of undeclared identifier '%s'",
+            ident->name
+        );
         return NULL;
     }
-    return cir_expr_create_value(cir_value_create_scope_val(ident->pos, val));
+
+    // Inline functions whose body was skipped have to be compiled after all once they are referenced.
+    if (cc->lazy_parser && val->tag != CIR_SCOPE_VAL_ENUM_CONST) {
+        set_add(&cc->lazy_used, ident->name);
+        c_lazy_func_t *lazy = map_get(&cc->lazy_funcs, ident->name);
+        if (lazy) {
+            map_remove(&cc->lazy_funcs, ident->name);
+            vec_push(&cc->lazy_referenced, lazy);
+        }
+    }
+
+    return cir_expr_create_value(cir_value_create_scope_val(c_compile2_pos(cc, ident->pos), val));
 }
 
 // Compile an integer constant as part of an expression.
 cir_expr_t *c_compile2_expr_iconst(c_compiler_t *cc, cir_scope_t *scope, c_ast_expr_iconst_t const *iconst) {
     (void)scope;
-    return c_compile2_synth_iconst(cc, iconst->pos, iconst->prim, iconst->iconst);
+    return c_compile2_synth_iconst(cc, c_compile2_pos(cc, iconst->pos), iconst->prim, iconst->iconst);
 }
 
 // Compile a string constant as part of an expression.
@@ -1057,7 +1106,12 @@ cir_expr_t *c_compile2_expr_sconst(c_compiler_t *cc, cir_scope_t *scope, c_ast_e
     // String literals have type `char[N]`, NUL-terminated.
     size_t len = sconst->value.len;
     if (len > INT32_MAX - 1) {
-        cctx_diagnostic(cc->cctx, sconst->pos, DIAG_ERR, "String constant exceeds implementation limits");
+        cctx_diagnostic(
+            cc->cctx,
+            c_compile2_pos(cc, sconst->pos),
+            DIAG_ERR,
+            "String constant exceeds implementation limits"
+        );
         return NULL;
     }
     uint8_t *blob = lilycc_malloc(len + 1);
@@ -1071,7 +1125,9 @@ cir_expr_t *c_compile2_expr_sconst(c_compiler_t *cc, cir_scope_t *scope, c_ast_e
     type.prim          = C_COMP_ARRAY;
     type.qual.q_const  = true;
 
-    return cir_expr_create_value(cir_value_create_comp_const(cir_comp_const_create(sconst->pos, type, blob)));
+    return cir_expr_create_value(
+        cir_value_create_comp_const(cir_comp_const_create(c_compile2_pos(cc, sconst->pos), type, blob))
+    );
 }
 
 // Compile a compound literal as part of an expression.
@@ -1081,7 +1137,12 @@ cir_expr_t *
     if (!c_type_is_valid(spec_qual_type)) {
         return NULL;
     } else if (spec_qual_type.qual.s_typedef) {
-        cctx_diagnostic(cc->cctx, compliteral->type->spec_qual->pos, DIAG_ERR, "typedef not allowed here");
+        cctx_diagnostic(
+            cc->cctx,
+            c_compile2_pos(cc, compliteral->type->spec_qual->pos),
+            DIAG_ERR,
+            "typedef not allowed here"
+        );
         c_type_delete(spec_qual_type);
         return NULL;
     }
@@ -1090,10 +1151,10 @@ cir_expr_t *
     if (!c_type_is_valid(type)) {
         return NULL;
     } else if (name) {
-        cctx_diagnostic(cc->cctx, name->pos, DIAG_ERR, "name not allowed here");
+        cctx_diagnostic(cc->cctx, c_compile2_pos(cc, name->pos), DIAG_ERR, "name not allowed here");
     }
 
-    return c_compile2_compinit(cc, scope, type, compliteral->type->pos, compliteral->init);
+    return c_compile2_compinit(cc, scope, type, c_compile2_pos(cc, compliteral->type->pos), compliteral->init);
 }
 
 // Compile an expression list.
@@ -1121,10 +1182,10 @@ cir_expr_t *c_compile2_expr_exprs(c_compiler_t *cc, cir_scope_t *scope, c_ast_ex
     cir_expr_common_t common;
     if (out.len) {
         common     = cir_expr_common_clone(&out.arr[out.len - 1]->common);
-        common.pos = exprs->pos;
+        common.pos = c_compile2_pos(cc, exprs->pos);
     } else {
         common = (cir_expr_common_t){
-            .pos          = exprs->pos,
+            .pos          = c_compile2_pos(cc, exprs->pos),
             .allow_addrof = false,
             .is_lvalue    = false,
             .type         = C_TYPE_FROM_PRIM(C_PRIM_VOID),
@@ -1164,13 +1225,13 @@ cir_expr_t *c_compile2_expr_sizealign(c_compiler_t *cc, cir_scope_t *scope, c_as
     c_type_delete(type);
 
     if (!res) {
-        cctx_diagnostic(cc->cctx, sizealign->pos, DIAG_ERR, "Usage of incomplete type");
+        cctx_diagnostic(cc->cctx, c_compile2_pos(cc, sizealign->pos), DIAG_ERR, "Usage of incomplete type");
         return NULL;
     }
 
     return c_compile2_synth_iconst(
         cc,
-        sizealign->pos,
+        c_compile2_pos(cc, sizealign->pos),
         cc->options.size_type,
         ui128(sizealign->is_alignof ? align : size)
     );
@@ -1233,7 +1294,12 @@ static inline bool c_init_cursor_select_named(
 ) {
     c_type_ref_t field_type = cursor->field_type;
     if (field_type.prim != C_COMP_STRUCT && field_type.prim != C_COMP_UNION) {
-        cctx_diagnostic(cc->cctx, name->pos, DIAG_ERR, "Unexpected named initializer field for non-struct/union type");
+        cctx_diagnostic(
+            cc->cctx,
+            c_compile2_pos(cc, name->pos),
+            DIAG_ERR,
+            "Unexpected named initializer field for non-struct/union type"
+        );
         return false;
     }
 
@@ -1274,7 +1340,7 @@ static inline bool c_init_cursor_select_named(
     }
 
     if (err_notfound) {
-        cctx_diagnostic(cc->cctx, name->pos, DIAG_ERR, "No such struct/union field");
+        cctx_diagnostic(cc->cctx, c_compile2_pos(cc, name->pos), DIAG_ERR, "No such struct/union field");
     }
 
     return false;
@@ -1405,7 +1471,7 @@ static cir_expr_t *
         if (list->items.len == 0) {
             // Empty list; zero it.
             return cir_expr_create_value(cir_value_create_const(cir_const_create(
-                list->pos,
+                c_compile2_pos(cc, list->pos),
                 prim,
                 (ir_const_t){
                     .prim_type = c_type_to_ir_type(cc, C_TYPE_FROM_PRIM(prim)),
@@ -1414,7 +1480,12 @@ static cir_expr_t *
             )));
         } else if (list->items.len > 1) {
             if (warn_excess) {
-                cctx_diagnostic(cc->cctx, list->items.arr[1]->pos, DIAG_WARN, "Excess elements in scalar initializer");
+                cctx_diagnostic(
+                    cc->cctx,
+                    c_compile2_pos(cc, list->items.arr[1]->pos),
+                    DIAG_WARN,
+                    "Excess elements in scalar initializer"
+                );
             }
             warn_excess = false;
         }
@@ -1424,7 +1495,7 @@ static cir_expr_t *
             case C_AST_TAG_INIT_NAMED:
                 cctx_diagnostic(
                     cc->cctx,
-                    init->init_named->name->pos,
+                    c_compile2_pos(cc, init->init_named->name->pos),
                     DIAG_ERR,
                     "Designated initializer used with a scalar type"
                 );
@@ -1432,7 +1503,7 @@ static cir_expr_t *
             case C_AST_TAG_INIT_INDEXED:
                 cctx_diagnostic(
                     cc->cctx,
-                    init->init_indexed->index->pos,
+                    c_compile2_pos(cc, init->init_indexed->index->pos),
                     DIAG_ERR,
                     "Designated initializer used with a scalar type"
                 );
@@ -1441,7 +1512,7 @@ static cir_expr_t *
                 if (warn_braces == 1) {
                     cctx_diagnostic(
                         cc->cctx,
-                        list->items.arr[1]->pos,
+                        c_compile2_pos(cc, list->items.arr[1]->pos),
                         DIAG_WARN,
                         "Excess braces around scalar initializer"
                     );
@@ -1464,7 +1535,7 @@ static cir_expr_t *
         return value;
     }
 
-    return raw_cast(cc, val->pos, C_TYPE_FROM_PRIM(prim), value);
+    return raw_cast(cc, c_compile2_pos(cc, val->pos), C_TYPE_FROM_PRIM(prim), value);
 }
 
 // Compile excess nested initializers.
@@ -1518,13 +1589,13 @@ cir_expr_t *c_compile2_compinit(
                 .prim_type = prim,
                 .const128  = I128_ZERO,
             };
-            cir_const_t *iconst = cir_const_create(init->pos, type.prim, zero);
+            cir_const_t *iconst = cir_const_create(c_compile2_pos(cc, init->pos), type.prim, zero);
             c_type_delete(type);
             return cir_expr_create_value(cir_value_create_const(iconst));
 
         } else {
             return cir_expr_create_value(cir_value_create_comp_const(
-                cir_comp_const_create(init->pos, c_type_clone(type), lilycc_calloc(size, 1))
+                cir_comp_const_create(c_compile2_pos(cc, init->pos), c_type_clone(type), lilycc_calloc(size, 1))
             ));
         }
     }
@@ -1585,7 +1656,8 @@ cir_expr_t *c_compile2_compinit(
             } else if (field->tag == C_AST_TAG_INIT_INDEXED) {
                 // Indexed initializer field, e.g. `[foo] = bar`.
                 cir_expr_t *res = c_compile2_expr(cc, scope, field->init_indexed->index);
-                if (res == NULL || !c_init_cursor_select_indexed(cc, &cursor, res, field->init_indexed->index->pos)) {
+                pos_t       pos = c_compile2_pos(cc, field->init_indexed->index->pos);
+                if (res == NULL || !c_init_cursor_select_indexed(cc, &cursor, res, pos)) {
                     field_error = true;
                 }
                 field = field->init_indexed->value;
@@ -1651,7 +1723,12 @@ cir_expr_t *c_compile2_compinit(
                 }
 
                 if (!c_type_is_compatible(cursor.field_type, res->common.type)) {
-                    cctx_diagnostic(cc->cctx, field->pos, DIAG_ERR, "Initializer with value of incompatible type");
+                    cctx_diagnostic(
+                        cc->cctx,
+                        c_compile2_pos(cc, field->pos),
+                        DIAG_ERR,
+                        "Initializer with value of incompatible type"
+                    );
                     error = true;
 
                 } else {
@@ -1718,7 +1795,9 @@ cir_expr_t *c_compile2_compinit(
             }
         }
 
-        compinit = cir_value_create_comp_const(cir_comp_const_create(init->pos, c_type_clone(type), blob));
+        compinit = cir_value_create_comp_const(
+            cir_comp_const_create(c_compile2_pos(cc, init->pos), c_type_clone(type), blob)
+        );
 
     out_del_stores:
         for (size_t i = 0; i < cursor.stores.len; i++) {
@@ -1726,7 +1805,9 @@ cir_expr_t *c_compile2_compinit(
         }
         vec_clear(&cursor.stores);
     } else {
-        compinit = cir_value_create_comp_value(cir_comp_value_create(init->pos, c_type_clone(type), cursor.stores));
+        compinit = cir_value_create_comp_value(
+            cir_comp_value_create(c_compile2_pos(cc, init->pos), c_type_clone(type), cursor.stores)
+        );
     }
 
     // Final cleanup.
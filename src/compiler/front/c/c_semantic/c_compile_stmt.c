@@ -59,6 +59,7 @@ cir_stmt_t *c_compile2_stmt_stmts(c_compiler_t *cc, cir_scope_t *scope, c_ast_st
             errors = true;
         }
     }
+    cir_scope_exit(nested_scope);
 
     if (errors) {
         for (size_t i = 0; i < res.len; i++) {
@@ -69,7 +70,7 @@ cir_stmt_t *c_compile2_stmt_stmts(c_compiler_t *cc, cir_scope_t *scope, c_ast_st
         return NULL;
     }
 
-    return cir_stmt_create_stmts(cir_stmts_create(stmts->pos, nested_scope, res));
+    return cir_stmt_create_stmts(cir_stmts_create(c_compile2_pos(cc, stmts->pos), nested_scope, res));
 }
 
 // Compile a for loop statement.
@@ -99,12 +100,13 @@ cir_stmt_t *c_compile2_stmt_for(c_compiler_t *cc, cir_scope_t *scope, c_ast_stmt
         }
     }
     if (stmt->body->tag == C_AST_TAG_STMT_DEF) {
-        cctx_diagnostic(cc->cctx, stmt->body->pos, DIAG_ERR, "Declaration not allowed here");
+        cctx_diagnostic(cc->cctx, c_compile2_pos(cc, stmt->body->pos), DIAG_ERR, "Declaration not allowed here");
     }
     cir_stmt_t *body = c_compile2_stmt(cc, nested_scope, stmt->body);
     if (!body) {
         errors = true;
     }
+    cir_scope_exit(nested_scope);
 
     if (errors) {
         if (inc) {
@@ -120,7 +122,7 @@ cir_stmt_t *c_compile2_stmt_for(c_compiler_t *cc, cir_scope_t *scope, c_ast_stmt
         return NULL;
     }
 
-    return cir_stmt_create_for(cir_for_create(stmt->pos, nested_scope, init, cond, inc, body));
+    return cir_stmt_create_for(cir_for_create(c_compile2_pos(cc, stmt->pos), nested_scope, init, cond, inc, body));
 }
 
 // Compile a while or do...while loop statement.
@@ -128,6 +130,7 @@ cir_stmt_t *c_compile2_stmt_while(c_compiler_t *cc, cir_scope_t *scope, c_ast_st
     cir_expr_t  *cond         = c_compile2_expr(cc, scope, stmt->cond);
     cir_scope_t *nested_scope = cir_scope_create(CIR_SCOPE_WHILE, scope);
     cir_stmt_t  *body         = c_compile2_stmt(cc, nested_scope, stmt->body);
+    cir_scope_exit(nested_scope);
 
     if (!cond || !body) {
         if (cond) {
@@ -140,7 +143,9 @@ cir_stmt_t *c_compile2_stmt_while(c_compiler_t *cc, cir_scope_t *scope, c_ast_st
         return NULL;
     }
 
-    return cir_stmt_create_while(cir_while_create(stmt->pos, nested_scope, cond, body, stmt->is_do_while));
+    return cir_stmt_create_while(
+        cir_while_create(c_compile2_pos(cc, stmt->pos), nested_scope, cond, body, stmt->is_do_while)
+    );
 }
 
 // Compile an if...else statement.
@@ -165,7 +170,7 @@ cir_stmt_t *c_compile2_stmt_if(c_compiler_t *cc, cir_scope_t *scope, c_ast_stmt_
         return NULL;
     }
 
-    return cir_stmt_create_if(cir_if_create(stmt->pos, cond, if_body, else_body));
+    return cir_stmt_create_if(cir_if_create(c_compile2_pos(cc, stmt->pos), cond, if_body, else_body));
 }
 
 // Compile a switch statement.
@@ -173,6 +178,7 @@ cir_stmt_t *c_compile2_stmt_switch(c_compiler_t *cc, cir_scope_t *scope, c_ast_s
     cir_expr_t  *value        = c_compile2_expr(cc, scope, stmt->value);
     cir_scope_t *nested_scope = cir_scope_create(CIR_SCOPE_SWITCH, scope);
     cir_stmt_t  *body         = c_compile2_stmt(cc, nested_scope, stmt->body);
+    cir_scope_exit(nested_scope);
 
     if (!value || !body) {
         if (value) {
@@ -185,7 +191,7 @@ cir_stmt_t *c_compile2_stmt_switch(c_compiler_t *cc, cir_scope_t *scope, c_ast_s
         return NULL;
     }
 
-    return cir_stmt_create_switch(cir_switch_create(stmt->pos, nested_scope, value, body));
+    return cir_stmt_create_switch(cir_switch_create(c_compile2_pos(cc, stmt->pos), nested_scope, value, body));
 }
 
 // Compile a case statement.
@@ -200,7 +206,7 @@ cir_stmt_t *c_compile2_stmt_case(c_compiler_t *cc, cir_scope_t *scope, c_ast_stm
         cur = cur->parent;
     }
     if (!found_switch) {
-        cctx_diagnostic(cc->cctx, stmt->pos, DIAG_ERR, "Case label outside of switch statement");
+        cctx_diagnostic(cc->cctx, c_compile2_pos(cc, stmt->pos), DIAG_ERR, "Case label outside of switch statement");
     }
 
     cir_expr_t *lo = NULL;
@@ -226,7 +232,7 @@ cir_stmt_t *c_compile2_stmt_case(c_compiler_t *cc, cir_scope_t *scope, c_ast_stm
         return NULL;
     }
 
-    return cir_stmt_create_case(cir_case_create(stmt->pos, lo, hi, body));
+    return cir_stmt_create_case(cir_case_create(c_compile2_pos(cc, stmt->pos), lo, hi, body));
 }
 
 // Compile a label statement.
@@ -238,7 +244,7 @@ cir_stmt_t *c_compile2_stmt_label(c_compiler_t *cc, cir_scope_t *scope, c_ast_st
             return NULL;
         }
     }
-    cir_label_t *label = cir_label_create(stmt->pos, lilycc_strdup(stmt->name->name), body);
+    cir_label_t *label = cir_label_create(c_compile2_pos(cc, stmt->pos), lilycc_strdup(stmt->name->name), body);
     if (!cir_scope_add_label(cc->cctx, scope, label)) {
         cir_label_delete(label);
         return NULL;
@@ -255,14 +261,14 @@ cir_stmt_t *c_compile2_stmt_return(c_compiler_t *cc, cir_scope_t *scope, c_ast_s
             return NULL;
         }
     }
-    return cir_stmt_create_return(cir_return_create(stmt->pos, retval));
+    return cir_stmt_create_return(cir_return_create(c_compile2_pos(cc, stmt->pos), retval));
 }
 
 // Compile a goto statement.
 cir_stmt_t *c_compile2_stmt_goto(c_compiler_t *cc, cir_scope_t *scope, c_ast_stmt_goto_t const *stmt) {
     (void)cc;
     cir_scope_t *func_scope = cir_scope_func(scope);
-    cir_goto_t  *cir_goto   = cir_goto_create(stmt->pos, lilycc_strdup(stmt->target->name));
+    cir_goto_t  *cir_goto   = cir_goto_create(c_compile2_pos(cc, stmt->pos), lilycc_strdup(stmt->target->name));
     if (func_scope) {
         set_add(&func_scope->gotos, cir_goto);
     }
@@ -290,7 +296,12 @@ cir_stmt_t *c_compile2_stmt_def(c_compiler_t *cc, cir_scope_t *scope, c_ast_def_
             vec_c_ast_init_decl_t const *decls = &def->def_defs->decls->items;
 
             if (decls->len == 0 && spec_qual_type.prim < C_N_PRIM) {
-                cctx_diagnostic(cc->cctx, def->def_defs->pos, DIAG_WARN, "This statement declares nothing");
+                cctx_diagnostic(
+                    cc->cctx,
+                    c_compile2_pos(cc, def->def_defs->pos),
+                    DIAG_WARN,
+                    "This statement declares nothing"
+                );
             }
 
             for (size_t i = 0; i < decls->len; i++) {
@@ -303,9 +314,14 @@ cir_stmt_t *c_compile2_stmt_def(c_compiler_t *cc, cir_scope_t *scope, c_ast_def_
                     }
                     assert(name != NULL);
                     if (decl->init) {
-                        cctx_diagnostic(cc->cctx, decl->init->pos, DIAG_ERR, "Cannot have initializer for typedef");
+                        cctx_diagnostic(
+                            cc->cctx,
+                            c_compile2_pos(cc, decl->init->pos),
+                            DIAG_ERR,
+                            "Cannot have initializer for typedef"
+                        );
                     }
-                    cir_scope_add_typedef(cc->cctx, scope, name->name, name->pos, type);
+                    cir_scope_add_typedef(cc->cctx, scope, name->name, c_compile2_pos(cc, name->pos), type);
 
                 } else {
                     cir_unit_t *unit = c_compile2_decl(cc, scope, c_type_clone(spec_qual_type), decl);
@@ -316,12 +332,12 @@ cir_stmt_t *c_compile2_stmt_def(c_compiler_t *cc, cir_scope_t *scope, c_ast_def_
             }
 
             c_type_delete(spec_qual_type);
-            return cir_stmt_create_units(cir_unit_list_create(def->pos, units));
+            return cir_stmt_create_units(cir_unit_list_create(c_compile2_pos(cc, def->pos), units));
         }
         case C_AST_TAG_DEF_FUNC: fprintf(stderr, "TODO: Nested functions\n"); abort();
         case C_AST_TAG_DEF_STATIC_ASSERT:
             c_compile2_static_assert(cc, scope, def->def_static_assert);
-            return cir_stmt_create_units(cir_unit_list_create(def->pos, (vec_cir_unit_t){0}));
+            return cir_stmt_create_units(cir_unit_list_create(c_compile2_pos(cc, def->pos), (vec_cir_unit_t){0}));
         case C_AST_TAG_DEF_GARBAGE: return NULL;
     }
     UNREACHABLE();
@@ -342,18 +358,18 @@ cir_stmt_t *c_compile2_stmt_break(c_compiler_t *cc, cir_scope_t *scope, c_ast_st
     if (!found) {
         cctx_diagnostic(
             cc->cctx,
-            stmt->pos,
+            c_compile2_pos(cc, stmt->pos),
             DIAG_ERR,
             stmt->is_continue ? "Continue outside of loop" : "Break outside of loop or switch"
         );
     }
 
-    return cir_stmt_create_break(cir_break_create(stmt->pos, stmt->is_continue));
+    return cir_stmt_create_break(cir_break_create(c_compile2_pos(cc, stmt->pos), stmt->is_continue));
 }
 
 // Compile a no-operation (`;`) statement.
 cir_stmt_t *c_compile2_stmt_nop(c_compiler_t *cc, cir_scope_t *scope, c_ast_stmt_nop_t const *stmt) {
     (void)cc;
     (void)scope;
-    return cir_stmt_create_nop(stmt->pos);
+    return cir_stmt_create_nop(c_compile2_pos(cc, stmt->pos));
 }
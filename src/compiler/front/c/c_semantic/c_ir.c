@@ -836,10 +836,51 @@ void cir_trans_unit_delete(cir_trans_unit_t *node) {
 }
 
 
+// Create an empty symbol table.
+static cir_symtab_t *cir_symtab_create() {
+    cir_symtab_t *symtab = lilycc_calloc(1, sizeof(cir_symtab_t));
+    symtab->symbols      = STR_MAP_EMPTY;
+    return symtab;
+}
+
+// Destroy a symbol table; all scopes that use it must have been exited.
+static void cir_symtab_delete(cir_symtab_t *symtab) {
+    assert(symtab->log.len == 0);
+    map_foreach_value(cir_symbol_t, sym, &symtab->symbols) {
+        lilycc_free(sym);
+    }
+    map_clear(&symtab->symbols);
+    vec_clear(&symtab->log);
+    lilycc_free(symtab);
+}
+
+// Get the bindings of `name`, creating an entry for it if there is none yet.
+static cir_symbol_t *cir_symtab_get(cir_symtab_t *symtab, char const *name) {
+    cir_symbol_t *sym = map_get(&symtab->symbols, name);
+    if (!sym) {
+        sym = lilycc_calloc(1, sizeof(cir_symbol_t));
+        map_set(&symtab->symbols, name, sym);
+    }
+    return sym;
+}
+
+// Make `ptr` the innermost binding in `slot` of a `cir_symbol_t` until `scope` is exited.
+static void cir_scope_bind(cir_scope_t const *scope, cir_binding_t **slot, void *ptr) {
+    cir_binding_t *binding = lilycc_malloc(sizeof(cir_binding_t));
+    binding->scope         = scope;
+    binding->ptr           = ptr;
+    binding->shadowed      = *slot;
+    binding->slot          = slot;
+    binding->index         = scope->symtab->log.len;
+    *slot                  = binding;
+    vec_push(&scope->symtab->log, binding);
+}
+
 cir_scope_t *cir_scope_create(cir_scope_type_t kind, cir_scope_t *parent) {
     cir_scope_t *scope = lilycc_malloc(sizeof(cir_scope_t));
     scope->type        = kind;
     scope->parent      = parent;
+    scope->symtab      = parent ? parent->symtab : cir_symtab_create();
     scope->values      = STR_MAP_EMPTY;
     scope->typedefs    = STR_MAP_EMPTY;
     scope->tags        = STR_MAP_EMPTY;
@@ -849,6 +890,10 @@ cir_scope_t *cir_scope_create(cir_scope_type_t kind, cir_scope_t *parent) {
 }
 
 void cir_scope_delete(cir_scope_t *scope) {
+    cir_scope_exit(scope);
+    if (!scope->parent) {
+        cir_symtab_delete(scope->symtab);
+    }
     map_foreach_value(cir_scope_val_t, val, &scope->values) {
         if (val->tag == CIR_SCOPE_VAL_ENUM_CONST) {
             lilycc_free(val->enum_const);
@@ -872,6 +917,16 @@ void cir_scope_delete(cir_scope_t *scope) {
     lilycc_free(scope);
 }
 
+void cir_scope_exit(cir_scope_t *scope) {
+    // Scopes are exited innermost first, so the bindings of this scope are the last ones in the log.
+    vec_ptr_t *log = &scope->symtab->log;
+    while (log->len && ((cir_binding_t const *)log->arr[log->len - 1])->scope == scope) {
+        cir_binding_t *binding = vec_pop(log);
+        *binding->slot         = binding->shadowed;
+        lilycc_free(binding);
+    }
+}
+
 cir_scope_t *cir_scope_func(cir_scope_t *scope) {
     while (scope && scope->type != CIR_SCOPE_FUNC) {
         scope = scope->parent;
@@ -879,19 +934,35 @@ cir_scope_t *cir_scope_func(cir_scope_t *scope) {
     return scope;
 }
 
+size_t cir_scope_bindings_len(cir_scope_t const *scope) {
+    return scope->symtab->log.len;
+}
+
+void cir_scope_hide_bindings(cir_scope_t *scope, size_t start, size_t end) {
+    assert(start <= end && end <= scope->symtab->log.len);
+    scope->symtab->hidden_start = start;
+    scope->symtab->hidden_end   = end;
+}
+
 static void redef_diag(cctx_t *ctx, char const *name, pos_t redef, pos_t orig) {
     cctx_diagnostic(ctx, redef, DIAG_ERR, "Redefinition of %s", name);
     cctx_diagnostic(ctx, orig, DIAG_HINT, "Original definition of %s", name);
 }
 
-// Allocate and insert a value entry. Returns `false` if `name` already exists.
-static bool cir_scope_add_value(cctx_t *ctx, cir_scope_t *scope, char const *name, cir_scope_val_t val) {
+// Get the scope that declarations in `scope` belong to; loop scopes don't have declarations of their own.
+static cir_scope_t *cir_scope_decl_scope(cir_scope_t *scope) {
     while (scope->type == CIR_SCOPE_WHILE) {
         scope = scope->parent;
     }
     assert(scope != NULL);
+    return scope;
+}
+
+// Allocate and insert a value entry. Returns `false` if `name` already exists.
+static bool cir_scope_add_value(cctx_t *ctx, cir_scope_t *scope, char const *name, cir_scope_val_t val) {
+    scope = cir_scope_decl_scope(scope);
 
-    cir_scope_val_t const *exist = map_get(&scope->values, name);
+    cir_scope_val_t *exist = map_get(&scope->values, name);
     if (exist) {
         c_type_t exist_type = C_TYPE_INVALID; // Non-owning.
         switch (exist->tag) {
@@ -912,8 +983,9 @@ static bool cir_scope_add_value(cctx_t *ctx, cir_scope_t *scope, char const *nam
         // TODO: Check for `extern` on non-function types.
 
         if (compatible_func && exist->tag == CIR_SCOPE_VAL_DECL && val.tag == CIR_SCOPE_VAL_FUNC) {
-            // Definition of forward-declared function.
-            map_remove(&scope->values, name);
+            // Definition of forward-declared function; values that refer to the declaration now refer to this.
+            *exist = val;
+            return true;
 
         } else if (compatible_func && val.tag == CIR_SCOPE_VAL_DECL) {
             // Both are functions; if their types are compatible, that is due to forward-declaration.
@@ -935,6 +1007,7 @@ static bool cir_scope_add_value(cctx_t *ctx, cir_scope_t *scope, char const *nam
     cir_scope_val_t *entry = lilycc_malloc(sizeof(cir_scope_val_t));
     *entry                 = val;
     map_set(&scope->values, name, entry);
+    cir_scope_bind(scope, &cir_symtab_get(scope->symtab, name)->values, entry);
     return true;
 }
 
@@ -956,6 +1029,7 @@ bool cir_scope_add_enum_const(cctx_t *ctx, cir_scope_t *scope, char const *name,
 }
 
 bool cir_scope_add_typedef(cctx_t *ctx, cir_scope_t *scope, char const *name, pos_t pos, c_type_t type) {
+    scope                      = cir_scope_decl_scope(scope);
     cir_typedef_t const *exist = map_get(&scope->typedefs, name);
     if (exist) {
         if (c_type_is_identical(exist->type, type, true)) {
@@ -977,10 +1051,12 @@ bool cir_scope_add_typedef(cctx_t *ctx, cir_scope_t *scope, char const *name, po
     box->type          = type;
     box->pos           = pos;
     map_set(&scope->typedefs, name, box);
+    cir_scope_bind(scope, &cir_symtab_get(scope->symtab, name)->typedefs, box);
     return true;
 }
 
 bool cir_scope_add_tag(cctx_t *ctx, cir_scope_t *scope, c_comp_type_t *type) {
+    scope                      = cir_scope_decl_scope(scope);
     c_comp_type_t const *exist = map_get(&scope->tags, type->name);
     if (exist) {
         redef_diag(ctx, type->name, type->pos, exist->pos);
@@ -988,6 +1064,7 @@ bool cir_scope_add_tag(cctx_t *ctx, cir_scope_t *scope, c_comp_type_t *type) {
         return false;
     }
     map_set(&scope->tags, type->name, type);
+    cir_scope_bind(scope, &cir_symtab_get(scope->symtab, type->name)->tags, type);
     return true;
 }
 
@@ -1006,34 +1083,27 @@ bool cir_scope_add_label(cctx_t *ctx, cir_scope_t *scope, cir_label_t *label) {
     return true;
 }
 
-cir_scope_val_t *cir_scope_lookup_value(cir_scope_t const *scope, char const *name) {
-    for (; scope; scope = scope->parent) {
-        cir_scope_val_t *val = map_get(&scope->values, name);
-        if (val) {
-            return val;
-        }
+// Get the bound pointer of the innermost binding from `binding` on that isn't hidden by `cir_scope_hide_bindings`.
+static void *cir_symtab_visible(cir_symtab_t const *symtab, cir_binding_t const *binding) {
+    while (binding && binding->index >= symtab->hidden_start && binding->index < symtab->hidden_end) {
+        binding = binding->shadowed;
     }
-    return NULL;
+    return binding ? binding->ptr : NULL;
+}
+
+cir_scope_val_t *cir_scope_lookup_value(cir_scope_t const *scope, char const *name) {
+    cir_symbol_t const *sym = map_get(&scope->symtab->symbols, name);
+    return sym ? cir_symtab_visible(scope->symtab, sym->values) : NULL;
 }
 
 cir_typedef_t const *cir_scope_lookup_typedef(cir_scope_t const *scope, char const *name) {
-    for (; scope; scope = scope->parent) {
-        cir_typedef_t const *type = map_get(&scope->typedefs, name);
-        if (type) {
-            return type;
-        }
-    }
-    return NULL;
+    cir_symbol_t const *sym = map_get(&scope->symtab->symbols, name);
+    return sym ? cir_symtab_visible(scope->symtab, sym->typedefs) : NULL;
 }
 
 c_comp_type_t *cir_scope_lookup_tag(cir_scope_t const *scope, char const *name) {
-    for (; scope; scope = scope->parent) {
-        c_comp_type_t *type = map_get(&scope->tags, name);
-        if (type) {
-            return type;
-        }
-    }
-    return NULL;
+    cir_symbol_t const *sym = map_get(&scope->symtab->symbols, name);
+    return sym ? cir_symtab_visible(scope->symtab, sym->tags) : NULL;
 }
 
 cir_label_t *cir_scope_lookup_label(cir_scope_t const *scope, char const *name) {
@@ -144,6 +144,12 @@ typedef struct cir_scope     cir_scope_t;
 typedef struct cir_scope_val cir_scope_val_t;
 // A typedef and the position it was declared at.
 typedef struct cir_typedef   cir_typedef_t;
+// Translation-unit-wide table of the innermost binding of every name in the scopes being compiled.
+typedef struct cir_symtab    cir_symtab_t;
+// The bindings of one name in a `cir_symtab_t`.
+typedef struct cir_symbol    cir_symbol_t;
+// One binding of a name by one scope in the value, typedef or tag namespace.
+typedef struct cir_binding   cir_binding_t;
 
 // A constant value of primitive type.
 typedef struct cir_const      cir_const_t;
@@ -621,14 +627,54 @@ struct cir_typedef {
     c_type_t type;
 };
 
+// One binding of a name by one scope in the value, typedef or tag namespace.
+struct cir_binding {
+    // Scope that made the binding.
+    cir_scope_t const *scope;
+    // Bound `cir_scope_val_t`, `cir_typedef_t` or `c_comp_type_t`; owned by `scope`.
+    void              *ptr;
+    // Binding of the same name in the same namespace by an enclosing scope that this one shadows, if any.
+    cir_binding_t     *shadowed;
+    // Field of the `cir_symbol_t` that points to this binding while it is the innermost one.
+    cir_binding_t    **slot;
+    // Index of this binding in the undo log.
+    size_t             index;
+};
+
+// The bindings of one name in a `cir_symtab_t`.
+struct cir_symbol {
+    // Innermost binding in the value namespace, or `NULL`.
+    cir_binding_t *values;
+    // Innermost binding in the typedef namespace, or `NULL`.
+    cir_binding_t *typedefs;
+    // Innermost binding in the tag namespace, or `NULL`.
+    cir_binding_t *tags;
+};
+
+// Translation-unit-wide table of the innermost binding of every name in the scopes being compiled.
+// Scopes push their bindings on an undo log and pop them again when they are exited.
+struct cir_symtab {
+    // Bindings by name: `char *` -> `cir_symbol_t *` (owned).
+    map_t     symbols;
+    // Undo log of the bindings made by scopes that were not exited yet, innermost last.
+    // Array of `cir_binding_t *` (owned).
+    vec_ptr_t log;
+    // Start of the range of undo log indices that lookups skip; see `cir_scope_hide_bindings`.
+    size_t    hidden_start;
+    // End (exclusive) of the range of undo log indices that lookups skip.
+    size_t    hidden_end;
+};
+
 // A C scope holding non-owning references to the values, typedefs and tags declared within,
-// plus (on function scope) the labels namespace. Lookups walk the parent chain except for
-// labels, which only resolve against the enclosing function scope.
+// plus (on function scope) the labels namespace. Lookups go through the symbol table shared
+// by all scopes except for labels, which only resolve against the enclosing function scope.
 struct cir_scope {
     // Scope kind.
     cir_scope_type_t type;
     // Parent scope, or `NULL` for global scope.
     cir_scope_t     *parent;
+    // Symbol table shared by all scopes of the translation unit; owned by the global scope.
+    cir_symtab_t    *symtab;
     // Values namespace: `char *` -> `cir_scope_val_t *` (owned share).
     map_t            values;
     // Typedefs namespace: `char *` -> `cir_typedef_t *` (owned).
@@ -859,9 +905,18 @@ void              cir_trans_unit_delete(cir_trans_unit_t *node);
 cir_scope_t *cir_scope_create(cir_scope_type_t kind, cir_scope_t *parent);
 // Destroy a scope. Frees the owned value-entry wrappers and releases the typedef and tags;
 // the referenced nodes, the parent, and any child scopes are untouched.
+// Exits the scope first if that wasn't done yet.
 void         cir_scope_delete(cir_scope_t *scope);
+// Exit a scope once it is compiled; removes its bindings from the symbol table so they no longer shadow those of
+// the enclosing scopes. Does nothing if the scope was already exited.
+void         cir_scope_exit(cir_scope_t *scope);
 // Walk up to the enclosing function scope, or `NULL` if none.
 cir_scope_t *cir_scope_func(cir_scope_t *scope);
+// Get the number of bindings made by `scope` and its enclosing scopes so far.
+size_t       cir_scope_bindings_len(cir_scope_t const *scope);
+// Make lookups skip the bindings made between `cir_scope_bindings_len` returning `start` and returning `end`,
+// as if they weren't made yet. Bindings made after that are not affected. Pass `start == end` to undo this.
+void         cir_scope_hide_bindings(cir_scope_t *scope, size_t start, size_t end);
 
 // Add a variable declaration to the value namespace of `scope`.
 // Returns `false` if `name` already exists in *this* scope (shadowing a parent is allowed).
@@ -882,11 +937,14 @@ bool cir_scope_add_tag(cctx_t *ctx, cir_scope_t *scope, c_comp_type_t *type);
 // Returns `false` if no function scope is found, or if `name` is already a label in it.
 bool cir_scope_add_label(cctx_t *ctx, cir_scope_t *scope, cir_label_t *label);
 
-// Look up a value by `name`, walking parent scopes. Returns `NULL` if not found.
+// Look up a value by `name` in `scope` or its parents. Returns `NULL` if not found.
+// `scope` must be the innermost scope that was not exited yet, as it is for all lookups during compilation.
 cir_scope_val_t     *cir_scope_lookup_value(cir_scope_t const *scope, char const *name);
-// Look up a typedef by `name`, walking parent scopes. Returns `NULL` if not found.
+// Look up a typedef by `name` in `scope` or its parents. Returns `NULL` if not found.
+// `scope` must be the innermost scope that was not exited yet.
 cir_typedef_t const *cir_scope_lookup_typedef(cir_scope_t const *scope, char const *name);
-// Look up a tag by `name`, walking parent scopes. Returns `NULL` if not found.
+// Look up a tag by `name` in `scope` or its parents. Returns `NULL` if not found.
+// `scope` must be the innermost scope that was not exited yet.
 // Returns a non-owning pointer.
 c_comp_type_t       *cir_scope_lookup_tag(cir_scope_t const *scope, char const *name);
 // Look up a label by `name` in the enclosing function scope only (no parent walk past it).
@@ -0,0 +1,355 @@
+// SPDX-FileCopyrightText: 2026 Julian Scheffers <julian@scheffers.net>
+// SPDX-FileType: SOURCE
+// SPDX-License-Identifier: MIT
+
+#include "c_compiler.h"
+#include "c_parser2.h"
+#include "c_preproc.h"
+#include "c_tokenizer.h"
+#include "lilycc_malloc.h"
+#include "vec.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+// Benchmark input; either a file read from disk or a generated corpus.
+typedef struct {
+    // Name used in the output; the path for files.
+    char const *name;
+    // Source code to benchmark on.
+    vec_char_t  data;
+    // Number of non-whitespace tokens after preprocessing, used for the throughput of the parser.
+    size_t      pp_tokens;
+} bench_input_t;
+
+// Measurements of one stage on one input.
+typedef struct {
+    // Number of non-whitespace tokens produced.
+    size_t tokens;
+    // Number of diagnostics produced.
+    size_t diagnostics;
+    // Fastest time over all iterations in seconds.
+    double seconds;
+    // Peak memory allocated during the stage in bytes, or -1 if allocations are not instrumented.
+    long   peak_alloc;
+    // Number of allocations made during the stage, or -1 if allocations are not instrumented.
+    long   allocs;
+} bench_result_t;
+
+// Function that runs one stage of the compiler on a source file and returns the number of tokens produced.
+typedef size_t (*bench_stage_t)(srcfile_t *src, bench_input_t *input);
+
+
+
+// C options used by all stages.
+static c_options_t const bench_options = {
+    .c_std          = C_STD_def,
+    .char_is_signed = true,
+    .short16        = true,
+    .int32          = true,
+    .long64         = true,
+    .size_type      = C_PRIM_ULONG,
+};
+
+// Number of times each stage is run; the fastest run is reported.
+static int  bench_iters = 3;
+// Size of the generated corpora.
+static int  bench_scale = 20000;
+// Print results as JSON lines instead of a table.
+static bool bench_json  = false;
+
+
+
+// Append formatted text to a corpus.
+static void corpus_printf(vec_char_t *out, char const *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void corpus_printf(vec_char_t *out, char const *fmt, ...) {
+    va_list va;
+    va_start(va, fmt);
+    int len = vsnprintf(NULL, 0, fmt, va);
+    va_end(va);
+
+    vec_reserve(out, len + 1);
+    va_start(va, fmt);
+    vsnprintf(out->arr + out->len, len + 1, fmt, va);
+    va_end(va);
+    out->len += len;
+}
+
+// Generate a corpus of many small function definitions.
+static vec_char_t gen_decls(int scale) {
+    vec_char_t out = {0};
+    for (int i = 0; i < scale; i++) {
+        corpus_printf(&out, "int bench_f%d(int a, int b) {\n", i);
+        corpus_printf(&out, "    int c = a * %d + (b << 3);\n", i);
+        corpus_printf(&out, "    if (c > %d) {\n        return c - a;\n    }\n", i);
+        if (i) {
+            corpus_printf(&out, "    return bench_f%d(b, c);\n}\n\n", i - 1);
+        } else {
+            corpus_printf(&out, "    return c;\n}\n\n");
+        }
+    }
+    return out;
+}
+
+// Generate a corpus of declarations that lean heavily on function-like macros, pasting and stringizing.
+static vec_char_t gen_macros(int scale) {
+    vec_char_t out = {0};
+    for (int i = 0; i < scale; i++) {
+        corpus_printf(&out, "#define BENCH_ADD%d(x, y) ((x) + (y) * %d)\n", i, i);
+        corpus_printf(&out, "#define BENCH_CAT%d(x) x##_%d\n", i, i);
+        corpus_printf(&out, "#define BENCH_STR%d(x) #x\n", i);
+        corpus_printf(
+            &out,
+            "int BENCH_CAT%d(bench_v) = BENCH_ADD%d(BENCH_ADD%d(%d, 2), 3);\n",
+            i,
+            i,
+            i ? i - 1 : 0,
+            i
+        );
+        corpus_printf(&out, "char const *BENCH_CAT%d(bench_s) = BENCH_STR%d(hello world %d);\n\n", i, i, i);
+    }
+    return out;
+}
+
+// Read a file into memory.
+static bool read_file(char const *path, vec_char_t *out) {
+    FILE *fd = fopen(path, "rb");
+    if (!fd) {
+        return false;
+    }
+    char   buf[4096];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), fd))) {
+        vec_reserve(out, len);
+        memcpy(out->arr + out->len, buf, len);
+        out->len += len;
+    }
+    bool ok = !ferror(fd);
+    fclose(fd);
+    return ok;
+}
+
+
+
+// Count and delete all significant tokens from a tokenizer until EOF.
+static size_t count_tokens(tokenizer_t *tkn_ctx) {
+    size_t count = 0;
+    while (1) {
+        token_t tkn = tkn_ctx->next(tkn_ctx);
+        if (tkn.type == TOKENTYPE_EOF) {
+            tkn_delete(tkn);
+            return count;
+        }
+        count += tkn.type != TOKENTYPE_WHITESPACE && tkn.type != TOKENTYPE_EOL;
+        tkn_delete(tkn);
+    }
+}
+
+// Run the C tokenizer without preprocessing.
+static size_t stage_tokenize(srcfile_t *src, bench_input_t *input) {
+    (void)input;
+    c_tokenizer_t *c_ctx = c_tkn_create_impl(src, &bench_options);
+    size_t         count = count_tokens(&c_ctx->base);
+    tkn_ctx_delete(&c_ctx->base);
+    return count;
+}
+
+// Run the C preprocessor the same way `lily-cpp` does.
+static size_t stage_preproc(srcfile_t *src, bench_input_t *input) {
+    c_preproc_t *pre = c_preproc_create(src, &bench_options, true, false);
+    if (!pre) {
+        return 0;
+    }
+    pre->raw_mode    = true;
+    size_t count     = count_tokens(&pre->base);
+    input->pp_tokens = count;
+    tkn_ctx_delete(&pre->base);
+    return count;
+}
+
+// Preprocess and parse a whole translation unit.
+static size_t stage_parse(srcfile_t *src, bench_input_t *input) {
+    c_compiler_t *cc   = c_compiler_create(src->ctx, bench_options);
+    tokenizer_t  *tctx = c_tokenizer_create(cc, src, true);
+    c_parser_t   *pctx = c_parser_create(cc, tctx);
+    c_parse2(pctx);
+    c_parser_delete(pctx);
+    c_compiler_delete(cc);
+    return input->pp_tokens;
+}
+
+// Preprocess and parse a whole translation unit, parsing the function bodies on all CPUs.
+static size_t stage_parse_par(srcfile_t *src, bench_input_t *input) {
+    long          jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    c_compiler_t *cc   = c_compiler_create(src->ctx, bench_options);
+    tokenizer_t  *tctx = c_tokenizer_create(cc, src, true);
+    c_parser_t   *pctx = c_parser_create(cc, tctx);
+    c_parse2_parallel(pctx, jobs > 0 ? (size_t)jobs : 1);
+    c_parser_delete(pctx);
+    c_compiler_delete(cc);
+    return input->pp_tokens;
+}
+
+
+
+// Get the current time in seconds.
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Run one stage on one input `bench_iters` times.
+static bench_result_t run_stage(bench_input_t *input, bench_stage_t stage) {
+    bench_result_t res = {.seconds = -1, .peak_alloc = -1, .allocs = -1};
+    for (int i = 0; i < bench_iters; i++) {
+#if !defined NDEBUG && defined __GNUC__
+        size_t base_alloc = lilycc_total_alloc;
+        size_t base_count = lilycc_alloc_count;
+        lilycc_peak_alloc = base_alloc;
+#endif
+        double start = now();
+
+        cctx_t    *cctx = cctx_create();
+        srcfile_t *src  = srcfile_create(cctx, input->name, input->data.arr, input->data.len);
+        res.tokens      = stage(src, input);
+        res.diagnostics = cctx->diagnostics.len;
+        cctx_delete(cctx);
+
+        double time = now() - start;
+        if (res.seconds < 0 || time < res.seconds) {
+            res.seconds = time;
+        }
+#if !defined NDEBUG && defined __GNUC__
+        res.peak_alloc = (long)(lilycc_peak_alloc - base_alloc);
+        res.allocs     = (long)(lilycc_alloc_count - base_count);
+#endif
+    }
+    return res;
+}
+
+// Print the result of one stage.
+static void print_result(bench_input_t const *input, char const *stage, bench_result_t const *res) {
+    double bytes_per_sec  = input->data.len / res->seconds;
+    double tokens_per_sec = res->tokens / res->seconds;
+    if (bench_json) {
+        printf("{\"input\":\"");
+        for (char const *c = input->name; *c; c++) {
+            if (*c == '"' || *c == '\\') {
+                fputc('\\', stdout);
+            }
+            fputc(*c, stdout);
+        }
+        printf(
+            "\",\"stage\":\"%s\",\"bytes\":%zu,\"tokens\":%zu,\"diagnostics\":%zu,\"seconds\":%.6f,"
+            "\"bytes_per_sec\":%.0f,\"tokens_per_sec\":%.0f,",
+            stage,
+            input->data.len,
+            res->tokens,
+            res->diagnostics,
+            res->seconds,
+            bytes_per_sec,
+            tokens_per_sec
+        );
+        if (res->allocs >= 0) {
+            printf("\"peak_alloc\":%ld,\"allocs\":%ld}\n", res->peak_alloc, res->allocs);
+        } else {
+            printf("\"peak_alloc\":null,\"allocs\":null}\n");
+        }
+    } else {
+        printf(
+            "%-32s %-9s %10zu %10zu %10.4f %12.0f %12.0f %12ld %10ld\n",
+            input->name,
+            stage,
+            input->data.len,
+            res->tokens,
+            res->seconds,
+            bytes_per_sec,
+            tokens_per_sec,
+            res->peak_alloc,
+            res->allocs
+        );
+    }
+    fflush(stdout);
+}
+
+// Run all stages on one input.
+static void bench_input(bench_input_t *input) {
+    bench_result_t res;
+    res = run_stage(input, stage_tokenize);
+    print_result(input, "tokenize", &res);
+    res = run_stage(input, stage_preproc);
+    print_result(input, "preproc", &res);
+    res = run_stage(input, stage_parse);
+    print_result(input, "parse", &res);
+    res = run_stage(input, stage_parse_par);
+    print_result(input, "parse-par", &res);
+}
+
+static void usage(char const *argv0) {
+    fprintf(stderr, "Usage: %s [-j] [-n iterations] [-s scale] [file...]\n", argv0);
+    fprintf(stderr, "  -j            Print results as JSON lines.\n");
+    fprintf(stderr, "  -n iterations Run each stage this many times and report the fastest (default 3).\n");
+    fprintf(stderr, "  -s scale      Size of the generated corpora; 0 to skip them (default 20000).\n");
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "jn:s:h")) != -1) {
+        switch (opt) {
+            case 'j': bench_json = true; break;
+            case 'n': bench_iters = atoi(optarg); break;
+            case 's': bench_scale = atoi(optarg); break;
+            default: usage(argv[0]); return opt != 'h';
+        }
+    }
+    if (bench_iters < 1) {
+        bench_iters = 1;
+    }
+
+    if (!bench_json) {
+        printf(
+            "%-32s %-9s %10s %10s %10s %12s %12s %12s %10s\n",
+            "input",
+            "stage",
+            "bytes",
+            "tokens",
+            "seconds",
+            "bytes/s",
+            "tokens/s",
+            "peak_alloc",
+            "allocs"
+        );
+    }
+
+    int status = 0;
+    for (int i = optind; i < argc; i++) {
+        bench_input_t input = {.name = argv[i]};
+        if (!read_file(argv[i], &input.data)) {
+            perror(argv[i]);
+            status = 1;
+        } else {
+            bench_input(&input);
+        }
+        vec_clear(&input.data);
+    }
+
+    if (bench_scale > 0) {
+        bench_input_t input = {.name = "<synth-decls>", .data = gen_decls(bench_scale)};
+        bench_input(&input);
+        vec_clear(&input.data);
+
+        input = (bench_input_t){.name = "<synth-macros>", .data = gen_macros(bench_scale)};
+        bench_input(&input);
+        vec_clear(&input.data);
+    }
+
+    return status;
+}
@@ -1,12 +1,158 @@
-
 // SPDX-FileCopyrightText: 2025 Julian Scheffers <julian@scheffers.net>
 // SPDX-FileType: SOURCE
 // SPDX-License-Identifier: MIT
 
+#include "c_pch.h"
 #include "c_preproc.h"
 #include "c_tokenizer.h"
+#include "lilycc_malloc.h"
 
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _POSIX_C_SOURCE
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// Prefix header to precompile and load before each source file, if any.
+static char const *pch_header    = NULL;
+// Directory to cache the tokens of include files in, if any.
+static char const *tkn_cache_dir = NULL;
+// Reuse the pre-expansion of macro arguments that were pre-expanded before.
+static bool        memo_args     = false;
+// Directories to search for include files in, from `-I` options.
+static char const **include_dirs     = NULL;
+// Number of `include_dirs`.
+static size_t       include_dirs_len = 0;
+// Print the dependencies of the source files as Makefile rules instead of preprocessing them.
+static bool         deps_scan        = false;
+// Write the dependencies of each preprocessed source file to a `.d` file next to it.
+static bool         deps_file        = false;
+// Number of threads to scan dependencies on; the number of CPUs if 0.
+static long         scan_jobs        = 0;
+
+// Options to preprocess with.
+static c_options_t const options = {
+    .c_std          = C_STD_def,
+    .char_is_signed = true,
+    .short16        = true,
+    .int32          = true,
+    .long64         = true,
+    .size_type      = C_PRIM_ULONG,
+};
+
+// Shared state of the dependency scanning threads.
+typedef struct {
+    // Source files to scan.
+    char const *const *paths;
+    // Makefile rule for each of `paths`, or NULL if it couldn't be opened.
+    char             **rules;
+    // Number of `paths`.
+    size_t             len;
+    // Index of the next path to scan.
+    atomic_size_t      next;
+    // Directory listings of the include path, read before the threads start.
+    map_t             *listings;
+} scan_pool_t;
+
+
+
+// Create a preprocessor with the options from the command line.
+static c_preproc_t *cpp_create(srcfile_t *src) {
+    c_preproc_t *pre = c_preproc_create(src, &options, true, true);
+    if (!pre) {
+        return NULL;
+    }
+    pre->raw_mode                 = true;
+    pre->shared->memo_args        = memo_args;
+    pre->shared->include_dirs     = include_dirs;
+    pre->shared->include_dirs_len = include_dirs_len;
+    return pre;
+}
+
+// Print the diagnostics of a compiler context to stderr.
+static void print_diagnostics(cctx_t const *cctx) {
+    if (!cctx->diagnostics.len) {
+        return;
+    }
+    diagnostic_t const *diag = (diagnostic_t const *)cctx->diagnostics.head;
+#ifdef _POSIX_C_SOURCE
+    flockfile(stderr);
+#endif
+    while (diag) {
+        print_diagnostic(diag, stderr);
+        diag = (diagnostic_t const *)diag->node.next;
+    }
+    fflush(stderr);
+#ifdef _POSIX_C_SOURCE
+    funlockfile(stderr);
+#endif
+}
+
+// Append a path to a Makefile rule, escaping the characters that are special to make.
+static void deps_append_path(vec_char_t *rule, char const *path) {
+    for (; *path; path++) {
+        if (*path == ' ' || *path == '#') {
+            vec_push(rule, '\\');
+        } else if (*path == '$') {
+            vec_push(rule, '$');
+        }
+        vec_push(rule, *path);
+    }
+}
+
+// Make a Makefile rule for the object file of source file `path` that depends on all files read by a preprocessor.
+static char *deps_make_rule(c_preproc_shared_t const *shared, char const *path) {
+    char const *name = strrchr(path, '/');
+    name             = name ? name + 1 : path;
+    char const *ext  = strrchr(name, '.');
+
+    vec_char_t rule = {0};
+    for (char const *c = name; *c && c != ext; c++) {
+        vec_push(&rule, *c);
+    }
+    vec_push(&rule, '.');
+    vec_push(&rule, 'o');
+    vec_push(&rule, ':');
+    for (size_t i = 0; i < shared->read_files.len; i++) {
+        srcfile_t const *file = shared->read_files.arr[i];
+        if (i) {
+            vec_push(&rule, ' ');
+            vec_push(&rule, '\\');
+            vec_push(&rule, '\n');
+            vec_push(&rule, ' ');
+        }
+        vec_push(&rule, ' ');
+        deps_append_path(&rule, file->path);
+    }
+    vec_push(&rule, '\n');
+    vec_push(&rule, '\0');
+    return rule.arr;
+}
+
+// Write the dependencies of source file `path` to a `.d` file next to it.
+static void deps_write_file(c_preproc_shared_t const *shared, char const *path) {
+    char const *name   = strrchr(path, '/');
+    char const *ext    = strrchr(name ? name : path, '.');
+    size_t      stem   = ext ? (size_t)(ext - path) : strlen(path);
+    char       *d_path = lilycc_malloc(stem + 3);
+    memcpy(d_path, path, stem);
+    strcpy(d_path + stem, ".d");
+
+    char *rule = deps_make_rule(shared, path);
+    FILE *fd   = fopen(d_path, "w");
+    if (!fd || fputs(rule, fd) == EOF) {
+        perror("Cannot write dependency file");
+    }
+    if (fd) {
+        fclose(fd);
+    }
+    lilycc_free(rule);
+    lilycc_free(d_path);
+}
 
 static void preprocess(char const *path) {
     cctx_t    *cctx = cctx_create();
@@ -16,20 +162,15 @@ static void preprocess(char const *path) {
         cctx_delete(cctx);
         return;
     }
-    c_options_t options = {
-        .c_std          = C_STD_def,
-        .char_is_signed = true,
-        .short16        = true,
-        .int32          = true,
-        .long64         = true,
-        .size_type      = C_PRIM_ULONG,
-    };
-    c_preproc_t *pre = c_preproc_create(src, &options, true, true);
+    c_preproc_t *pre = cpp_create(src);
     if (!pre) {
         cctx_delete(cctx);
         return;
     }
-    pre->raw_mode = true;
+    pre->shared->tkn_cache_dir = tkn_cache_dir;
+    if (pch_header && !c_pch_use(pre, pch_header)) {
+        fprintf(stderr, "Cannot use precompiled header %s\n", pch_header);
+    }
 
     while (1) {
         token_t tkn = c_preproc_next(&pre->base);
@@ -43,21 +184,166 @@ static void preprocess(char const *path) {
     fputc('\n', stdout);
 
     if (cctx->diagnostics.len) {
-        diagnostic_t const *diag = (diagnostic_t const *)cctx->diagnostics.head;
         fflush(stdout);
-        while (diag) {
-            print_diagnostic(diag, stderr);
-            diag = (diagnostic_t const *)diag->node.next;
-        }
-        fflush(stderr);
+        print_diagnostics(cctx);
+    }
+    if (deps_file) {
+        deps_write_file(pre->shared, path);
     }
 
     tkn_ctx_delete(&pre->base);
     cctx_delete(cctx);
 }
 
+// Find the include files of source file `path` by only running the preprocessor's directives.
+// Returns the Makefile rule listing them, or NULL if the source file can't be opened.
+static char *scan_deps(char const *path, map_t *listings) {
+    cctx_t *cctx = cctx_create();
+#ifdef SRCFILE_LIST_DIRS
+    cctx->shared_listings = listings;
+#else
+    (void)listings;
+#endif
+    srcfile_t *src = srcfile_open(cctx, path);
+    if (!src) {
+        perror("Cannot open source file");
+        cctx_delete(cctx);
+        return NULL;
+    }
+    c_preproc_t *pre = cpp_create(src);
+    if (!pre) {
+        cctx_delete(cctx);
+        return NULL;
+    }
+    pre->directives_only = true;
+    tkn_delete(c_preproc_next(&pre->base));
+
+    print_diagnostics(cctx);
+    char *rule = deps_make_rule(pre->shared, path);
+
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+    return rule;
+}
+
+// Dependency scanning thread; takes source files from the pool until all of them are taken.
+static void *scan_worker(void *cookie) {
+    scan_pool_t *pool = cookie;
+    while (1) {
+        size_t i = atomic_fetch_add(&pool->next, 1);
+        if (i >= pool->len) {
+            return NULL;
+        }
+        pool->rules[i] = scan_deps(pool->paths[i], pool->listings);
+    }
+}
+
+// Scan the dependencies of many source files on `scan_jobs` threads and print them in order.
+// The threads share the listings of the include directories, which are read once up front.
+// Without POSIX threads, the files are scanned one after another on the calling thread.
+static void scan_all(char const *const *paths, size_t paths_len) {
+    map_t listings = STR_MAP_EMPTY;
+#ifdef SRCFILE_LIST_DIRS
+    srcfile_list_dir(&listings, ".");
+    for (size_t i = 0; i < include_dirs_len; i++) {
+        srcfile_list_dir(&listings, include_dirs[i]);
+    }
+#endif
+
+    scan_pool_t pool = {
+        .paths    = paths,
+        .rules    = lilycc_calloc(paths_len, sizeof(char *)),
+        .len      = paths_len,
+        .next     = 0,
+        .listings = &listings,
+    };
+
+#ifdef _POSIX_C_SOURCE
+    long jobs = scan_jobs;
+    if (jobs <= 0) {
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (jobs <= 0) {
+        jobs = 1;
+    }
+    if ((size_t)jobs > paths_len) {
+        jobs = (long)paths_len;
+    }
+
+    // The calling thread is one of the workers.
+    pthread_t *threads   = lilycc_calloc(jobs, sizeof(pthread_t));
+    long       n_threads = 0;
+    while (n_threads < jobs - 1 && !pthread_create(&threads[n_threads], NULL, scan_worker, &pool)) {
+        n_threads++;
+    }
+    scan_worker(&pool);
+    for (long i = 0; i < n_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    lilycc_free(threads);
+#else
+    scan_worker(&pool);
+#endif
+
+    for (size_t i = 0; i < paths_len; i++) {
+        if (pool.rules[i]) {
+            fputs(pool.rules[i], stdout);
+            lilycc_free(pool.rules[i]);
+        }
+    }
+    lilycc_free(pool.rules);
+#ifdef SRCFILE_LIST_DIRS
+    srcfile_listings_clear(&listings);
+#endif
+}
+
 int main(int argc, char **argv) {
+    include_dirs        = lilycc_calloc(argc, sizeof(char const *));
+    char const **inputs = lilycc_calloc(argc, sizeof(char const *));
+    size_t       n_in   = 0;
     for (int i = 1; i < argc; i++) {
-        preprocess(argv[i]);
+        if (!strcmp(argv[i], "-I") && i + 1 < argc) {
+            include_dirs[include_dirs_len++] = argv[++i];
+            continue;
+        }
+        if (!strncmp(argv[i], "-I", 2) && argv[i][2]) {
+            include_dirs[include_dirs_len++] = argv[i] + 2;
+            continue;
+        }
+        if (!strcmp(argv[i], "-M")) {
+            deps_scan = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "-MD")) {
+            deps_file = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            scan_jobs = strtol(argv[++i], NULL, 0);
+            continue;
+        }
+        if (!strcmp(argv[i], "--pch") && i + 1 < argc) {
+            pch_header = argv[++i];
+            continue;
+        }
+        if (!strcmp(argv[i], "--token-cache") && i + 1 < argc) {
+            tkn_cache_dir = argv[++i];
+            continue;
+        }
+        if (!strcmp(argv[i], "--memo-macro-args")) {
+            memo_args = true;
+            continue;
+        }
+        inputs[n_in++] = argv[i];
+    }
+
+    if (deps_scan) {
+        scan_all(inputs, n_in);
+    } else {
+        for (size_t i = 0; i < n_in; i++) {
+            preprocess(inputs[i]);
+        }
     }
+    lilycc_free(inputs);
+    lilycc_free(include_dirs);
 }
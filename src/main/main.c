@@ -11,13 +11,36 @@
 #include "c_ir.h"
 #include "c_parser.h"
 #include "c_parser2.h"
+#include "c_pch.h"
 #include "codegen.h"
 #include "ir.h"
 #include "ir/ir_optimizer.h"
 #include "ir_serialization.h"
+#include "lilycc_malloc.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef _POSIX_C_SOURCE
+#include <unistd.h>
+#endif
+
+// Prefix header to precompile and load before each source file, if any.
+static char const *pch_header    = NULL;
+// Directory to cache the tokens of include files in, if any.
+static char const *tkn_cache_dir = NULL;
+// Reuse the pre-expansion of macro arguments that were pre-expanded before.
+static bool        memo_args     = false;
+// Directories to search for include files in, from `-I` options.
+static char const **include_dirs     = NULL;
+// Number of `include_dirs`.
+static size_t       include_dirs_len = 0;
+// Number of threads to parse function bodies on; the number of CPUs if 0.
+// Experimental: no speedup over parsing on one thread has been measured yet.
+static long         parse_jobs       = 1;
+// Only parse the bodies of inline functions that are referenced.
+static bool         lazy_bodies      = false;
 
 static void compile(char const *path) {
     // Create requisite contexts.
@@ -124,15 +147,33 @@ static void compile2(char const *path) {
     backend_t const   *backend = backend_default();
     backend_profile_t *profile = backend->create_profile();
     backend->init_codegen(profile);
+    ((c_preproc_t *)tctx)->shared->tkn_cache_dir = tkn_cache_dir;
+    ((c_preproc_t *)tctx)->shared->memo_args     = memo_args;
+    ((c_preproc_t *)tctx)->shared->include_dirs     = include_dirs;
+    ((c_preproc_t *)tctx)->shared->include_dirs_len = include_dirs_len;
+    if (pch_header && !c_pch_use((c_preproc_t *)tctx, pch_header)) {
+        fprintf(stderr, "Cannot use precompiled header %s\n", pch_header);
+    }
 
     printf("// Compiling %s\n", path);
 
     // While not EOF, keep parsing and compiling stuff.
-    c_ast_def_list_t *ast = c_parse2(pctx);
-    c_ast_def_list_dbg(ast, 0, stdout);
+    long jobs = parse_jobs;
+#ifdef _POSIX_C_SOURCE
+    if (jobs <= 0) {
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+#endif
+    c_ast_def_list_t *ast;
+    if (lazy_bodies) {
+        ast             = c_parse2_lazy(pctx);
+        cc->lazy_parser = pctx;
+    } else {
+        ast = c_parse2_parallel(pctx, jobs > 0 ? (size_t)jobs : 1);
+    }
+    c_ast_def_list_dbg(ast, cctx, 0, stdout);
     cir_trans_unit_t *tu = c_compile2(cc, ast);
     cir_trans_unit_dbg(tu, 0, stdout);
-    c_ast_def_list_delete(ast);
     cir_trans_unit_delete(tu);
 
     // Print diagnostics.
@@ -155,8 +196,38 @@ static void compile2(char const *path) {
 }
 
 int main(int argc, char **argv) {
+    include_dirs = lilycc_calloc(argc, sizeof(char const *));
     for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-I") && i + 1 < argc) {
+            include_dirs[include_dirs_len++] = argv[++i];
+            continue;
+        }
+        if (!strncmp(argv[i], "-I", 2) && argv[i][2]) {
+            include_dirs[include_dirs_len++] = argv[i] + 2;
+            continue;
+        }
+        if (!strcmp(argv[i], "--pch") && i + 1 < argc) {
+            pch_header = argv[++i];
+            continue;
+        }
+        if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            parse_jobs = strtol(argv[++i], NULL, 0);
+            continue;
+        }
+        if (!strcmp(argv[i], "--token-cache") && i + 1 < argc) {
+            tkn_cache_dir = argv[++i];
+            continue;
+        }
+        if (!strcmp(argv[i], "--memo-macro-args")) {
+            memo_args = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "--lazy-bodies")) {
+            lazy_bodies = true;
+            continue;
+        }
         // compile(argv[i]);
         compile2(argv[i]);
     }
+    lilycc_free(include_dirs);
 }
@@ -0,0 +1,124 @@
+// SPDX-FileCopyrightText: 2026 Julian Scheffers <julian@scheffers.net>
+// SPDX-FileType: SOURCE
+// SPDX-License-Identifier: MIT
+
+#include "arena.h"
+#include "testcase.h"
+
+#include <stdint.h>
+#include <string.h>
+
+
+
+static char *test_arena_basic() {
+    arena_t arena = {0};
+
+    // Allocations are aligned and don't overlap.
+    char *a = arena_strndup(&arena, "hello, world", 5);
+    EXPECT_STR(a, "hello");
+    uint64_t *b = arena_alloc(&arena, sizeof(uint64_t) * 4);
+    EXPECT_INT((uintptr_t)b % _Alignof(max_align_t), 0);
+    memset(b, 0xff, sizeof(uint64_t) * 4);
+    EXPECT_STR(a, "hello");
+    uint32_t *c = arena_calloc(&arena, sizeof(uint32_t) * 3);
+    EXPECT_INT(c[0] | c[1] | c[2], 0);
+    EXPECT_INT(arena.used, 6 + sizeof(uint64_t) * 4 + sizeof(uint32_t) * 3);
+
+    // Enough allocations to need more blocks, including one larger than a block.
+    char *strs[1000];
+    for (int i = 0; i < 1000; i++) {
+        strs[i] = arena_strndup(&arena, "0123456789abcdefghijklmnopqrstuvwxyz", i % 37);
+    }
+    char *big = arena_alloc(&arena, 100000);
+    memset(big, 'x', 100000);
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_STR_L(strs[i], strlen(strs[i]), "0123456789abcdefghijklmnopqrstuvwxyz", (size_t)(i % 37));
+    }
+
+    // Resetting keeps one block around for reuse.
+    arena_reset(&arena);
+    EXPECT_INT(arena.used, 0);
+    RETURN_ON_FALSE(arena.blocks != NULL);
+    EXPECT_STR(arena_strndup(&arena, "again", 5), "again");
+    // An empty string may come without a pointer.
+    EXPECT_STR(arena_strndup(&arena, NULL, 0), "");
+
+    arena_clear(&arena);
+    RETURN_ON_FALSE(arena.blocks == NULL);
+
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_arena_basic)
+
+static char *test_arena_merge() {
+    arena_t arena = {0};
+    arena_t other = {0};
+
+    // Merging an empty arena does nothing.
+    char *a = arena_strndup(&arena, "first", 5);
+    arena_merge(&arena, &other);
+    EXPECT_INT(arena.used, 6);
+
+    // Memory from the other arena survives the merge.
+    char *b = arena_strndup(&other, "second", 6);
+    char *c = arena_alloc(&other, 100000);
+    memset(c, 'x', 100000);
+    arena_merge(&arena, &other);
+    RETURN_ON_FALSE(other.blocks == NULL);
+    EXPECT_INT(other.used, 0);
+    EXPECT_INT(arena.used, 6 + 7 + 100000);
+    EXPECT_STR(a, "first");
+    EXPECT_STR(b, "second");
+
+    // Allocations after the merge still come from the arena's own most recent block.
+    char *d = arena_strndup(&arena, "third", 5);
+    EXPECT_INT(d - a, 6);
+
+    // Merging into an empty arena.
+    arena_merge(&other, &arena);
+    RETURN_ON_FALSE(arena.blocks == NULL);
+    EXPECT_STR(b, "second");
+    EXPECT_STR(d, "third");
+
+    arena_clear(&other);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_arena_merge)
+
+static char *test_arena_rewind() {
+    arena_t arena = {0};
+
+    // Rewinding an empty arena to its start.
+    arena_mark_t start = arena_mark(&arena);
+    char        *a     = arena_strndup(&arena, "first", 5);
+    arena_rewind(&arena, start);
+    RETURN_ON_FALSE(arena.blocks == NULL);
+    EXPECT_INT(arena.used, 0);
+
+    // Memory from before the mark survives; memory after it is reused.
+    a                 = arena_strndup(&arena, "first", 5);
+    arena_mark_t mark = arena_mark(&arena);
+    char        *b    = arena_strndup(&arena, "second", 6);
+    arena_rewind(&arena, mark);
+    EXPECT_INT(arena.used, 6);
+    char *c = arena_strndup(&arena, "third", 5);
+    RETURN_ON_FALSE(c == b);
+    EXPECT_STR(a, "first");
+
+    // Blocks allocated after the mark are freed.
+    mark = arena_mark(&arena);
+    for (int i = 0; i < 100; i++) {
+        char *big = arena_alloc(&arena, 1000);
+        memset(big, 'x', 1000);
+    }
+    RETURN_ON_FALSE(arena.blocks != mark.block);
+    arena_rewind(&arena, mark);
+    RETURN_ON_FALSE(arena.blocks == mark.block);
+    EXPECT_INT(arena.used, 12);
+    EXPECT_STR(a, "first");
+    EXPECT_STR(c, "third");
+
+    arena_clear(&arena);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_arena_rewind)
@@ -5,6 +5,10 @@
 
 #include "compiler.h"
 #include "testcase.h"
+#include "tokenizer.h"
+
+#include <stdio.h>
+#include <unistd.h>
 
 
 
@@ -44,3 +48,188 @@ static char *test_srcfile_ram() {
     return TEST_OK;
 }
 LILY_TEST_CASE(test_srcfile_ram)
+
+
+// Files on disk are read in their entirety and behave exactly like RAM files.
+static char *test_srcfile_disk() {
+    char const data[] = "ab\r\ncd\xc3\xa9";
+
+    char path[] = "/tmp/lilycc_srcfile_XXXXXX";
+    int  fd     = mkstemp(path);
+    RETURN_ON_FALSE(fd >= 0);
+    RETURN_ON_FALSE(write(fd, data, sizeof(data) - 1) == sizeof(data) - 1);
+    close(fd);
+
+    cctx_t    *cctx = cctx_create();
+    srcfile_t *src  = srcfile_open(cctx, path);
+    unlink(path);
+    RETURN_ON_FALSE(src != NULL);
+    EXPECT_INT(src->content_len, sizeof(data) - 1);
+    RETURN_ON_FALSE(srcfile_open(cctx, path) == src);
+
+    pos_t pos = {.srcfile = src};
+    EXPECT_CHAR(srcfile_getc(src, &pos), 'a');
+    EXPECT_CHAR(srcfile_getc(src, &pos), 'b');
+    EXPECT_CHAR(srcfile_getc(src, &pos), '\n');
+    EXPECT_CHAR(srcfile_getc(src, &pos), 'c');
+    EXPECT_CHAR(srcfile_getc(src, &pos), 'd');
+    EXPECT_INT(pos.line, 1);
+    EXPECT_INT(pos.col, 2);
+    EXPECT_INT(srcfile_getc(src, &pos), 0xe9);
+    EXPECT_INT(srcfile_getc(src, &pos), -1);
+    EXPECT_INT(pos.off, sizeof(data) - 1);
+
+    // Seeking backwards does not cross the start of the line.
+    EXPECT_INT(srcfile_seekprev(src, &pos), true);
+    EXPECT_INT(pos.off, 6);
+    EXPECT_INT(srcfile_seekprev(src, &pos), true);
+    EXPECT_INT(srcfile_seekprev(src, &pos), true);
+    EXPECT_INT(srcfile_seekprev(src, &pos), false);
+    EXPECT_INT(pos.off, 4);
+
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_srcfile_disk)
+
+static char *test_srcfile_span() {
+    char const data[] = "ab\r\n\tcd\xc3\xa9\xc3\xa9xyz\r";
+    cctx_t    *cctx   = cctx_create();
+    srcfile_t *src    = srcfile_create(cctx, "<test>", data, sizeof(data) - 1);
+    EXPECT_INT(src->ascii_only, false);
+
+    // ASCII spans stop before the first non-ASCII byte.
+    pos_t     pos  = {.srcfile = src};
+    srcspan_t span = srcfile_span(src, pos.off, SIZE_MAX);
+    EXPECT_INT(span.is_ascii, true);
+    EXPECT_INT(span.len, 7);
+    EXPECT_INT(srcfile_span(src, pos.off, 3).len, 3);
+
+    // Advancing over a CRLF counts as a single newline.
+    srcfile_advance(src, &pos, 3);
+    EXPECT_INT(pos.off, 4);
+    EXPECT_INT(pos.line, 1);
+    EXPECT_INT(pos.col, 0);
+    srcfile_advance(src, &pos, 3);
+    EXPECT_INT(pos.col, 3);
+
+    // Non-ASCII spans cover the entire run of non-ASCII bytes.
+    span = srcfile_span(src, pos.off, SIZE_MAX);
+    EXPECT_INT(span.is_ascii, false);
+    EXPECT_INT(span.len, 4);
+    EXPECT_INT(srcfile_getc(src, &pos), 0xe9);
+    EXPECT_INT(srcfile_getc(src, &pos), 0xe9);
+
+    // A lone CR at the end of the file is a newline, after which the span is empty.
+    span = srcfile_span(src, pos.off, SIZE_MAX);
+    EXPECT_INT(span.is_ascii, true);
+    EXPECT_INT(span.len, 4);
+    srcfile_advance(src, &pos, span.len);
+    EXPECT_INT(pos.line, 2);
+    EXPECT_INT(pos.col, 0);
+    EXPECT_INT(srcfile_span(src, pos.off, SIZE_MAX).len, 0);
+
+    // The whole-file ASCII check is done when the file is created.
+    EXPECT_INT(srcfile_create(cctx, "<ascii>", "int x;\n", 7)->ascii_only, true);
+
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_srcfile_span)
+
+static char *test_srcfile_lines() {
+    char const data[] = "ab\r\n\xc3\xa9x\rcd\n\nef";
+    cctx_t    *cctx   = cctx_create();
+    srcfile_t *src    = srcfile_create(cctx, "<test>", data, sizeof(data) - 1);
+
+    // LF, CRLF and a lone CR all end a line.
+    EXPECT_INT(srcfile_line_start(src, 0), 0);
+    EXPECT_INT(srcfile_line_start(src, 1), 4);
+    EXPECT_INT(srcfile_line_start(src, 2), 8);
+    EXPECT_INT(srcfile_line_start(src, 3), 11);
+    EXPECT_INT(srcfile_line_start(src, 4), 12);
+    EXPECT_INT(srcfile_line_start(src, 5), -1);
+
+    EXPECT_INT(srcfile_line_of(src, 0), 0);
+    EXPECT_INT(srcfile_line_of(src, 3), 0);
+    EXPECT_INT(srcfile_line_of(src, 4), 1);
+    EXPECT_INT(srcfile_line_of(src, 9), 2);
+    EXPECT_INT(srcfile_line_of(src, 11), 3);
+    EXPECT_INT(srcfile_line_of(src, sizeof(data) - 1), 4);
+
+    // Columns count characters, not bytes.
+    EXPECT_INT(srcfile_col_of(src, 6), 1);
+    EXPECT_INT(srcfile_col_of(src, 9), 1);
+
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_srcfile_lines)
+
+static char *test_srcloc() {
+    cctx_t    *cctx = cctx_create();
+    srcfile_t *a    = srcfile_create(cctx, "<a>", "int a;\n", 7);
+    srcfile_t *b    = srcfile_create(cctx, "<b>", "\nint \xc3\xa9" "b;", 9);
+
+    // Locations of different files don't overlap, including their end.
+    srcloc_t a_end   = srcloc_from_pos((pos_t){.srcfile = a, .off = 7});
+    srcloc_t b_start = srcloc_from_pos((pos_t){.srcfile = b, .off = 0});
+    RETURN_ON_FALSE(a_end != SRCLOC_NONE);
+    RETURN_ON_FALSE(b_start > a_end);
+    EXPECT_INT(srcloc_from_pos((pos_t){0}), SRCLOC_NONE);
+
+    // Decoding recovers the file, line and column.
+    pos_t pos = srcloc_to_pos(cctx, srcloc_from_pos((pos_t){.srcfile = b, .off = 7}), 2);
+    RETURN_ON_FALSE(pos.srcfile == b);
+    EXPECT_INT(pos.off, 7);
+    EXPECT_INT(pos.line, 1);
+    EXPECT_INT(pos.col, 5);
+    EXPECT_INT(pos.len, 2);
+
+    pos = srcloc_to_pos(cctx, a_end, 0);
+    RETURN_ON_FALSE(pos.srcfile == a);
+    EXPECT_INT(pos.line, 1);
+    EXPECT_INT(pos.col, 0);
+    RETURN_ON_FALSE(srcloc_to_pos(cctx, SRCLOC_NONE, 0).srcfile == NULL);
+
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_srcloc)
+
+
+// Test the token lookahead buffer, including when it wraps around.
+static char *test_tkn_lookahead() {
+    token_t tokens[16];
+    for (int i = 0; i < 16; i++) {
+        tokens[i] = (token_t){.type = TOKENTYPE_ICONST, .ival = i};
+    }
+    tokenizer_t *tctx = &tkn_array_create(tokens, 16, (pos_t){0})->base;
+
+    // Fill the buffer, then consume part of it so the head moves forward.
+    EXPECT_INT(tkn_peek_n(tctx, 3).ival, 3);
+    EXPECT_INT(tkn_next(tctx).ival, 0);
+    EXPECT_INT(tkn_next(tctx).ival, 1);
+    EXPECT_INT(tkn_next(tctx).ival, 2);
+
+    // Peek far enough ahead that the buffer wraps around and then grows.
+    EXPECT_INT(tkn_peek_n(tctx, 2).ival, 5);
+    EXPECT_INT(tkn_peek_n(tctx, 9).ival, 12);
+    EXPECT_INT(tkn_peek(tctx).ival, 3);
+
+    // Tokens stuffed back are returned first, in reverse order of `tkn_unget`.
+    token_t a = tkn_next(tctx);
+    token_t b = tkn_next(tctx);
+    EXPECT_INT(b.ival, 4);
+    tkn_unget(tctx, b);
+    tkn_unget(tctx, a);
+    for (int i = 3; i < 16; i++) {
+        EXPECT_INT(tkn_next(tctx).ival, i);
+    }
+    EXPECT_INT(tkn_next(tctx).type, TOKENTYPE_EOF);
+    EXPECT_INT(tkn_peek_n(tctx, 4).type, TOKENTYPE_EOF);
+
+    tkn_ctx_delete(tctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_tkn_lookahead)
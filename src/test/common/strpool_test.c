@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: 2026 Julian Scheffers <julian@scheffers.net>
+// SPDX-FileType: SOURCE
+// SPDX-License-Identifier: MIT
+
+#include "hash.h"
+#include "strpool.h"
+#include "testcase.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+
+static char *test_strpool_basic() {
+    strpool_t pool = {0};
+
+    // Shouldn't crash.
+    RETURN_ON_FALSE(strpool_find(&pool, "foo", 3) == NULL);
+
+    // Interning the same string twice gives the same pointer.
+    char const *foo = strpool_intern(&pool, "foobar", 3);
+    EXPECT_STR(foo, "foo");
+    RETURN_ON_FALSE(strpool_intern(&pool, "foo", 3) == foo);
+    RETURN_ON_FALSE(strpool_find(&pool, "foo", 3) == foo);
+    RETURN_ON_FALSE(strpool_find(&pool, "fo", 2) == NULL);
+    RETURN_ON_FALSE(strpool_intern(&pool, "fo", 2) != foo);
+
+    // The entry header stores the hash and length.
+    EXPECT_INT(strpool_ent(foo)->len, 3);
+    EXPECT_INT(strpool_ent(foo)->hash, hash_cstr("foo"));
+
+    // Enough strings to grow the table and allocate more blocks.
+    char const *names[2000];
+    for (int i = 0; i < 2000; i++) {
+        char buf[32];
+        int  len = snprintf(buf, sizeof(buf), "ident_%d_with_some_padding", i);
+        names[i] = strpool_intern(&pool, buf, len);
+    }
+    EXPECT_INT(pool.len, 2002);
+    for (int i = 0; i < 2000; i++) {
+        char buf[32];
+        int  len = snprintf(buf, sizeof(buf), "ident_%d_with_some_padding", i);
+        RETURN_ON_FALSE(strpool_find(&pool, buf, len) == names[i]);
+    }
+    RETURN_ON_FALSE(strpool_find(&pool, "foo", 3) == foo);
+
+    strpool_clear(&pool);
+    EXPECT_INT(pool.len, 0);
+    RETURN_ON_FALSE(strpool_find(&pool, "foo", 3) == NULL);
+
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_strpool_basic)
@@ -13,11 +13,13 @@
 #include "c_types.h"
 #include "c_types1.h"
 #include "compiler.h"
+#include "lilycc_malloc.h"
 #include "list.h"
 #include "testcase.h"
 #include "tokenizer.h"
 
 #include <stdio.h>
+#include <string.h>
 
 static c_options_t c_compiler2_test_options = {
     .c_std          = C_STD_max,
@@ -62,7 +64,6 @@ fail:
     if (cir) {
         cir_expr_delete(cir);
     }
-    c_ast_expr_delete(ast);
     c_parser_delete(parser);
     c_compiler_delete(cc);
     cctx_delete(cctx);
@@ -109,7 +110,6 @@ fail:
     if (cir) {
         cir_expr_delete(cir);
     }
-    c_ast_type_name_delete(ast);
     c_parser_delete(parser);
     c_compiler_delete(cc);
     cctx_delete(cctx);
@@ -198,3 +198,113 @@ COMPILE_TYPE_TEST(arr2_of_char, "char[2][9]", 18, 1)
 COMPILE_TYPE_TEST(struct, "struct { char a; int b; }", 8, 4)
 COMPILE_TYPE_TEST(union, "union { char a; int b; }", 4, 4)
 COMPILE_TYPE_TEST(struct_nesting, "struct { char a; struct { long c; }; int b; }", 24, 8)
+
+// Inline functions skipped by `c_parse2_lazy` are only parsed and compiled once they are referenced.
+static char *test_c_compile2_lazy_inline() {
+    char const source[] = "static inline int h(int x) { return x * 2; }\n"
+                          "static inline int bad(int x) { return x +; }\n"
+                          "int f(int a) { return h(a); }\n";
+    cctx_t           *cctx   = cctx_create();
+    srcfile_t        *src    = srcfile_create(cctx, "<c_compile2_lazy_inline>", source, sizeof(source) - 1);
+    c_compiler_t     *cc     = c_compiler_create(cctx, c_compiler2_test_options);
+    tokenizer_t      *tkn    = c_tokenizer_create(cc, src, false);
+    c_parser_t       *parser = c_parser_create(cc, tkn);
+    cir_trans_unit_t *tu     = NULL;
+    char             *res    = TEST_FAIL;
+    cir_unit_tag_t    tags[4];
+    size_t            units_len;
+
+    c_ast_def_list_t *ast = c_parse2_lazy(parser);
+    cc->lazy_parser       = parser;
+    tu                    = c_compile2(cc, ast);
+    TEST_DIAGNOSTICS()
+
+    units_len = tu->units.len;
+    for (size_t i = 0; i < units_len && i < 4; i++) {
+        tags[i] = tu->units.arr[i]->tag;
+    }
+    res = TEST_OK;
+
+fail:
+    if (tu) {
+        cir_trans_unit_delete(tu);
+    }
+    c_parser_delete(parser);
+    c_compiler_delete(cc);
+    cctx_delete(cctx);
+
+    if (res == TEST_OK) {
+        // `bad` is never referenced, so its syntax error goes unnoticed; `h` is compiled after the rest of the file.
+        EXPECT_INT(units_len, 4);
+        EXPECT_INT(tags[0], CIR_UNIT_DECL);
+        EXPECT_INT(tags[1], CIR_UNIT_DECL);
+        EXPECT_INT(tags[2], CIR_UNIT_FUNC);
+        EXPECT_INT(tags[3], CIR_UNIT_FUNC);
+    }
+
+    return res;
+}
+LILY_TEST_CASE(test_c_compile2_lazy_inline)
+
+// A skipped inline function body only sees the names that were declared before its definition.
+static char *test_c_compile2_lazy_inline_scope() {
+    char const source[] = "static inline int late(int x) { return x + later_var; }\n"
+                          "int later_var;\n"
+                          "int k(int a) { return late(a); }\n";
+    cctx_t       *cctx   = cctx_create();
+    srcfile_t    *src    = srcfile_create(cctx, "<c_compile2_lazy_inline_scope>", source, sizeof(source) - 1);
+    c_compiler_t *cc     = c_compiler_create(cctx, c_compiler2_test_options);
+    tokenizer_t  *tkn    = c_tokenizer_create(cc, src, false);
+    c_parser_t   *parser = c_parser_create(cc, tkn);
+
+    c_ast_def_list_t *ast = c_parse2_lazy(parser);
+    cc->lazy_parser       = parser;
+    cir_trans_unit_delete(c_compile2(cc, ast));
+
+    size_t              diags_len = cctx->diagnostics.len;
+    diagnostic_t const *diag      = (diagnostic_t const *)cctx->diagnostics.head;
+    bool                undeclared
+        = diag && diag->pos.line == 0 && !strcmp(diag->msg, "Use of undeclared identifier 'later_var'");
+
+    c_parser_delete(parser);
+    c_compiler_delete(cc);
+    cctx_delete(cctx);
+
+    EXPECT_INT(diags_len, 1);
+    RETURN_ON_FALSE(undeclared);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_c_compile2_lazy_inline_scope)
+
+// Names declared in a scope shadow those of its parents until it is exited.
+static char *test_c_compile2_scope_shadow() {
+    pos_t        pos    = {0};
+    cir_scope_t *global = cir_scope_create(CIR_SCOPE_GLOBAL, NULL);
+    cir_scope_t *func   = cir_scope_create(CIR_SCOPE_FUNC, global);
+    cir_scope_t *block  = cir_scope_create(CIR_SCOPE_STMTS, func);
+    cir_decl_t  *outer  = cir_decl_create(pos, C_TYPE_FROM_PRIM(C_PRIM_SINT), lilycc_strdup("a"), NULL);
+    cir_decl_t  *inner  = cir_decl_create(pos, C_TYPE_FROM_PRIM(C_PRIM_CHAR), lilycc_strdup("a"), NULL);
+    cctx_t      *cctx   = cctx_create();
+
+    bool             added_outer = cir_scope_add_decl(cctx, global, outer);
+    bool             added_inner = cir_scope_add_decl(cctx, block, inner);
+    cir_scope_val_t *in_block    = cir_scope_lookup_value(block, "a");
+    cir_scope_exit(block);
+    cir_scope_val_t *in_func = cir_scope_lookup_value(func, "a");
+    cir_scope_exit(func);
+    cir_scope_val_t *undeclared = cir_scope_lookup_value(global, "b");
+
+    bool ok = added_outer && added_inner && in_block && in_block->decl == inner && in_func && in_func->decl == outer
+              && !undeclared;
+
+    cir_scope_delete(block);
+    cir_scope_delete(func);
+    cir_scope_delete(global);
+    cir_decl_delete(outer);
+    cir_decl_delete(inner);
+    cctx_delete(cctx);
+
+    RETURN_ON_FALSE(ok);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_c_compile2_scope_shadow)
@@ -24,7 +24,7 @@ static char *test_c_compile_type() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_compile_type>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create_impl(src, C_STD_def)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     c_compiler_t *cc = c_compiler_create(
         cctx,
@@ -98,7 +98,7 @@ static char *test_c_compile_expr() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_compile_expr>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create_impl(src, C_STD_def)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     c_compiler_t *cc = c_compiler_create(
         cctx,
@@ -174,7 +174,7 @@ static char *test_c_compile_func() {
     cctx_t       *cctx = cctx_create();
     srcfile_t    *src  = srcfile_create(cctx, "<c_compile_func>", source, sizeof(source) - 1);
     tokenizer_t  *tctx = &c_tkn_create_impl(src, C_STD_def)->base;
-    c_parser_t    pctx = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t    pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
     c_compiler_t *cc   = c_compiler_create(
         cctx,
         (c_options_t){
@@ -255,7 +255,7 @@ static char *test_c_compile_enum() {
     cctx_t       *cctx = cctx_create();
     srcfile_t    *src  = srcfile_create(cctx, "<test_c_compile_enum>", source, sizeof(source) - 1);
     tokenizer_t  *tctx = &c_tkn_create_impl(src, C_STD_def)->base;
-    c_parser_t    pctx = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t    pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
     c_compiler_t *cc   = c_compiler_create(
         cctx,
         (c_options_t){
@@ -353,7 +353,7 @@ static char *test_c_compile_struct() {
     cctx_t       *cctx = cctx_create();
     srcfile_t    *src  = srcfile_create(cctx, "<test_c_compile_enum>", source, sizeof(source) - 1);
     tokenizer_t  *tctx = &c_tkn_create_impl(src, C_STD_def)->base;
-    c_parser_t    pctx = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t    pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
     c_compiler_t *cc   = c_compiler_create(
         cctx,
         (c_options_t){
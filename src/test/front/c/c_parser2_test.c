@@ -27,7 +27,7 @@ static char *test_c_expr_prefix() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_expr_prefix>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create_impl(src, &c_parse2_test_options)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     c_ast_expr_t *expr = c_parse2_expr(&pctx);
 
@@ -38,11 +38,11 @@ static char *test_c_expr_prefix() {
             print_diagnostic(diag, stderr);
             diag = (diagnostic_t const *)diag->node.next;
         }
-        c_ast_expr_dbg(expr, 0, stdout);
+        c_ast_expr_dbg(expr, cctx, 0, stdout);
         return TEST_FAIL;
     }
 
-    c_ast_expr_delete(expr);
+    arena_clear(&pctx.ast_arena);
     tkn_ctx_delete(tctx);
     cctx_delete(cctx);
     return TEST_OK;
@@ -55,7 +55,7 @@ static char *test_c_expr_basic() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_expr_basic>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create_impl(src, &c_parse2_test_options)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     c_ast_expr_t *expr = c_parse2_expr(&pctx);
 
@@ -66,11 +66,11 @@ static char *test_c_expr_basic() {
             print_diagnostic(diag, stderr);
             diag = (diagnostic_t const *)diag->node.next;
         }
-        c_ast_expr_dbg(expr, 0, stdout);
+        c_ast_expr_dbg(expr, cctx, 0, stdout);
         return TEST_FAIL;
     }
 
-    c_ast_expr_delete(expr);
+    arena_clear(&pctx.ast_arena);
     tkn_ctx_delete(tctx);
     cctx_delete(cctx);
     return TEST_OK;
@@ -83,7 +83,7 @@ static char *test_c_expr_call() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_expr_call>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create_impl(src, &c_parse2_test_options)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     c_ast_expr_t *expr = c_parse2_expr(&pctx);
 
@@ -94,11 +94,11 @@ static char *test_c_expr_call() {
             print_diagnostic(diag, stderr);
             diag = (diagnostic_t const *)diag->node.next;
         }
-        c_ast_expr_dbg(expr, 0, stdout);
+        c_ast_expr_dbg(expr, cctx, 0, stdout);
         return TEST_FAIL;
     }
 
-    c_ast_expr_delete(expr);
+    arena_clear(&pctx.ast_arena);
     tkn_ctx_delete(tctx);
     cctx_delete(cctx);
     return TEST_OK;
@@ -111,7 +111,7 @@ static char *test_c_expr_deref() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_expr_deref>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create_impl(src, &c_parse2_test_options)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     c_ast_expr_t *expr = c_parse2_expr(&pctx);
 
@@ -122,11 +122,11 @@ static char *test_c_expr_deref() {
             print_diagnostic(diag, stderr);
             diag = (diagnostic_t const *)diag->node.next;
         }
-        c_ast_expr_dbg(expr, 0, stdout);
+        c_ast_expr_dbg(expr, cctx, 0, stdout);
         return TEST_FAIL;
     }
 
-    c_ast_expr_delete(expr);
+    arena_clear(&pctx.ast_arena);
     tkn_ctx_delete(tctx);
     cctx_delete(cctx);
     return TEST_OK;
@@ -139,9 +139,9 @@ static char *test_c_expr_cast() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_expr_cast>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create_impl(src, &c_parse2_test_options)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
-    set_add(&pctx.type_names, "ident0");
+    c_parser_add_type_name(&pctx, "ident0", false);
     c_ast_expr_t *expr = c_parse2_expr(&pctx);
 
     if (cctx->diagnostics.len) {
@@ -151,12 +151,12 @@ static char *test_c_expr_cast() {
             print_diagnostic(diag, stderr);
             diag = (diagnostic_t const *)diag->node.next;
         }
-        c_ast_expr_dbg(expr, 0, stdout);
+        c_ast_expr_dbg(expr, cctx, 0, stdout);
         return TEST_FAIL;
     }
 
     set_clear(&pctx.type_names);
-    c_ast_expr_delete(expr);
+    arena_clear(&pctx.ast_arena);
     tkn_ctx_delete(tctx);
     cctx_delete(cctx);
     return TEST_OK;
@@ -169,10 +169,10 @@ static char *test_c_type_funcptr() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_type_funcptr>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create_impl(src, &c_parse2_test_options)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
-    set_add(&pctx.type_names, "ident0");
-    set_add(&pctx.type_names, "ident1");
+    c_parser_add_type_name(&pctx, "ident0", false);
+    c_parser_add_type_name(&pctx, "ident1", false);
     c_ast_type_name_t *type = c_parse2_type_name(&pctx);
 
     if (cctx->diagnostics.len) {
@@ -182,12 +182,12 @@ static char *test_c_type_funcptr() {
             print_diagnostic(diag, stderr);
             diag = (diagnostic_t const *)diag->node.next;
         }
-        c_ast_type_name_dbg(type, 0, stdout);
+        c_ast_type_name_dbg(type, cctx, 0, stdout);
         return TEST_FAIL;
     }
 
     set_clear(&pctx.type_names);
-    c_ast_type_name_delete(type);
+    arena_clear(&pctx.ast_arena);
     tkn_ctx_delete(tctx);
     cctx_delete(cctx);
     return TEST_OK;
@@ -207,7 +207,7 @@ static char *test_c_type_struct() {
     cctx_t      *cctx = cctx_create();
     srcfile_t   *src  = srcfile_create(cctx, "<c_type_struct>", source, sizeof(source) - 1);
     tokenizer_t *tctx = &c_tkn_create_impl(src, &c_parse2_test_options)->base;
-    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     c_ast_type_name_t *type = c_parse2_type_name(&pctx);
 
@@ -218,13 +218,13 @@ static char *test_c_type_struct() {
             print_diagnostic(diag, stderr);
             diag = (diagnostic_t const *)diag->node.next;
         }
-        c_ast_type_name_dbg(type, 0, stdout);
+        c_ast_type_name_dbg(type, cctx, 0, stdout);
         return TEST_FAIL;
     }
 
     set_clear(&pctx.type_names);
     set_clear(&pctx.local_type_names);
-    c_ast_type_name_delete(type);
+    arena_clear(&pctx.ast_arena);
     tkn_ctx_delete(tctx);
     cctx_delete(cctx);
     return TEST_OK;
@@ -244,7 +244,7 @@ static char *test_c_type_enum() {
     cctx_t      *cctx = cctx_create();
     srcfile_t   *src  = srcfile_create(cctx, "<c_type_enum>", source, sizeof(source) - 1);
     tokenizer_t *tctx = &c_tkn_create_impl(src, &c_parse2_test_options)->base;
-    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     c_ast_type_name_t *type = c_parse2_type_name(&pctx);
 
@@ -255,13 +255,13 @@ static char *test_c_type_enum() {
             print_diagnostic(diag, stderr);
             diag = (diagnostic_t const *)diag->node.next;
         }
-        c_ast_type_name_dbg(type, 0, stdout);
+        c_ast_type_name_dbg(type, cctx, 0, stdout);
         return TEST_FAIL;
     }
 
     set_clear(&pctx.type_names);
     set_clear(&pctx.local_type_names);
-    c_ast_type_name_delete(type);
+    arena_clear(&pctx.ast_arena);
     tkn_ctx_delete(tctx);
     cctx_delete(cctx);
     return TEST_OK;
@@ -274,9 +274,9 @@ static char *test_c_stmt_decl() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_stmt_decl>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create_impl(src, &c_parse2_test_options)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
-    set_add(&pctx.type_names, "typename");
+    c_parser_add_type_name(&pctx, "typename", false);
     c_ast_def_t *def = c_parse2_def(&pctx, false);
 
     if (cctx->diagnostics.len) {
@@ -286,12 +286,12 @@ static char *test_c_stmt_decl() {
             print_diagnostic(diag, stderr);
             diag = (diagnostic_t const *)diag->node.next;
         }
-        c_ast_def_dbg(def, 0, stdout);
+        c_ast_def_dbg(def, cctx, 0, stdout);
         return TEST_FAIL;
     }
 
     set_clear(&pctx.type_names);
-    c_ast_def_delete(def);
+    arena_clear(&pctx.ast_arena);
     tkn_ctx_delete(tctx);
     cctx_delete(cctx);
     return TEST_OK;
@@ -318,9 +318,9 @@ static char *test_c_stmt_ctrl() {
     cctx_t      *cctx = cctx_create();
     srcfile_t   *src  = srcfile_create(cctx, "<c_stmt_ctrl>", source, sizeof(source) - 1);
     tokenizer_t *tctx = &c_tkn_create_impl(src, &c_parse2_test_options)->base;
-    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
-    set_add(&pctx.type_names, "typename");
+    c_parser_add_type_name(&pctx, "typename", false);
     c_ast_stmt_list_t *stmts = c_parse2_stmts(&pctx);
 
     if (cctx->diagnostics.len) {
@@ -330,12 +330,12 @@ static char *test_c_stmt_ctrl() {
             print_diagnostic(diag, stderr);
             diag = (diagnostic_t const *)diag->node.next;
         }
-        c_ast_stmt_list_dbg(stmts, 0, stdout);
+        c_ast_stmt_list_dbg(stmts, cctx, 0, stdout);
         return TEST_FAIL;
     }
 
     set_clear(&pctx.type_names);
-    c_ast_stmt_list_delete(stmts);
+    arena_clear(&pctx.ast_arena);
     tkn_ctx_delete(tctx);
     cctx_delete(cctx);
     return TEST_OK;
@@ -354,9 +354,9 @@ static char *test_c_function() {
     cctx_t      *cctx = cctx_create();
     srcfile_t   *src  = srcfile_create(cctx, "<c_function>", source, sizeof(source) - 1);
     tokenizer_t *tctx = &c_tkn_create_impl(src, &c_parse2_test_options)->base;
-    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
-    set_add(&pctx.type_names, "typename");
+    c_parser_add_type_name(&pctx, "typename", false);
     c_ast_def_t *def = c_parse2_def(&pctx, true);
 
     if (cctx->diagnostics.len) {
@@ -366,12 +366,12 @@ static char *test_c_function() {
             print_diagnostic(diag, stderr);
             diag = (diagnostic_t const *)diag->node.next;
         }
-        c_ast_def_dbg(def, 0, stdout);
+        c_ast_def_dbg(def, cctx, 0, stdout);
         return TEST_FAIL;
     }
 
     set_clear(&pctx.type_names);
-    c_ast_def_delete(def);
+    arena_clear(&pctx.ast_arena);
     tkn_ctx_delete(tctx);
     cctx_delete(cctx);
     return TEST_OK;
@@ -396,7 +396,7 @@ static char *test_c_compliteral() {
     cctx_t      *cctx = cctx_create();
     srcfile_t   *src  = srcfile_create(cctx, "<c_compiteral>", source, sizeof(source) - 1);
     tokenizer_t *tctx = &c_tkn_create_impl(src, &c_parse2_test_options)->base;
-    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     c_ast_expr_t *expr = c_parse2_expr(&pctx);
 
@@ -407,13 +407,58 @@ static char *test_c_compliteral() {
             print_diagnostic(diag, stderr);
             diag = (diagnostic_t const *)diag->node.next;
         }
-        c_ast_expr_dbg(expr, 0, stdout);
+        c_ast_expr_dbg(expr, cctx, 0, stdout);
         return TEST_FAIL;
     }
 
-    c_ast_expr_delete(expr);
+    arena_clear(&pctx.ast_arena);
     tkn_ctx_delete(tctx);
     cctx_delete(cctx);
     return TEST_OK;
 }
 LILY_TEST_CASE(test_c_compliteral)
+
+
+static char *test_c_parse_parallel() {
+    // clang-format off
+    char const   source[] =
+    "int a() { T * x; return 0; }\n"
+    "typedef int T;\n"
+    "int b() { T * x; { T * y; } x = ; }\n"
+    "int c() {}\n"
+    "int d = (1;\n"
+    "int e() { typedef T U; U * z; }\n"
+    "int f() { U * z; }\n"
+    ;
+    // clang-format on
+    cctx_t      *cctx = cctx_create();
+    srcfile_t   *src  = srcfile_create(cctx, "<c_parse_parallel>", source, sizeof(source) - 1);
+    tokenizer_t *tctx = &c_tkn_create_impl(src, &c_parse2_test_options)->base;
+    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
+
+    c_ast_def_list_t *defs = c_parse2_parallel(&pctx, 4);
+
+    // Each body is parsed with the type names that are defined before it.
+    EXPECT_INT(defs->items.len, 7);
+    c_ast_def_t *const *items = defs->items.arr;
+    EXPECT_INT(items[0]->tag, C_AST_TAG_DEF_FUNC);
+    EXPECT_INT(items[0]->def_func->body->items.arr[0]->tag, C_AST_TAG_STMT_EXPR);
+    EXPECT_INT(items[2]->tag, C_AST_TAG_DEF_FUNC);
+    EXPECT_INT(items[2]->def_func->body->items.arr[0]->tag, C_AST_TAG_STMT_DEF);
+    EXPECT_INT(items[3]->def_func->body->items.len, 0);
+    EXPECT_INT(items[6]->def_func->body->items.arr[0]->tag, C_AST_TAG_STMT_DEF);
+
+    // Diagnostics of the bodies are in source order with the rest.
+    EXPECT_INT(cctx->diagnostics.len, 2);
+    diagnostic_t const *diag0 = (diagnostic_t const *)cctx->diagnostics.head;
+    diagnostic_t const *diag1 = (diagnostic_t const *)cctx->diagnostics.tail;
+    EXPECT_INT(diag0->pos.line, 2);
+    EXPECT_INT(diag1->pos.line, 4);
+
+    set_clear(&pctx.type_names);
+    arena_clear(&pctx.ast_arena);
+    tkn_ctx_delete(tctx);
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_c_parse_parallel)
@@ -15,7 +15,7 @@ static char *test_c_expr_basic() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_expr_basic>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create(src, C_STD_def)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     token_t expr = c_parse_expr(&pctx, false);
 
@@ -115,7 +115,7 @@ static char *test_c_expr_call() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_expr_call>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create(src, C_STD_def)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     token_t expr = c_parse_expr(&pctx, false);
 
@@ -143,7 +143,7 @@ static char *test_c_expr_deref() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_expr_deref>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create(src, C_STD_def)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     token_t expr = c_parse_expr(&pctx, false);
 
@@ -170,9 +170,9 @@ static char *test_c_expr_cast() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_expr_cast>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create(src, C_STD_def)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
-    set_add(&pctx.type_names, "ident0");
+    c_parser_add_type_name(&pctx, "ident0", false);
     token_t token = c_parse_expr(&pctx, false);
 
     if (cctx->diagnostics.len) {
@@ -200,10 +200,10 @@ static char *test_c_type_funcptr() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_type_funcptr>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create(src, C_STD_def)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
-    set_add(&pctx.type_names, "ident0");
-    set_add(&pctx.type_names, "ident1");
+    c_parser_add_type_name(&pctx, "ident0", false);
+    c_parser_add_type_name(&pctx, "ident1", false);
     token_t token = c_parse_type_name(&pctx);
 
     if (cctx->diagnostics.len) {
@@ -238,7 +238,7 @@ static char *test_c_type_struct() {
     cctx_t      *cctx = cctx_create();
     srcfile_t   *src  = srcfile_create(cctx, "<c_type_struct>", source, sizeof(source) - 1);
     tokenizer_t *tctx = &c_tkn_create(src, C_STD_def)->base;
-    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     token_t token = c_parse_decls(&pctx, false);
 
@@ -275,7 +275,7 @@ static char *test_c_type_enum() {
     cctx_t      *cctx = cctx_create();
     srcfile_t   *src  = srcfile_create(cctx, "<c_type_enum>", source, sizeof(source) - 1);
     tokenizer_t *tctx = &c_tkn_create(src, C_STD_def)->base;
-    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     token_t token = c_parse_decls(&pctx, false);
 
@@ -305,9 +305,9 @@ static char *test_c_stmt_decl() {
     cctx_t      *cctx     = cctx_create();
     srcfile_t   *src      = srcfile_create(cctx, "<c_stmt_decl>", source, sizeof(source) - 1);
     tokenizer_t *tctx     = &c_tkn_create(src, C_STD_def)->base;
-    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx     = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
-    set_add(&pctx.type_names, "typename");
+    c_parser_add_type_name(&pctx, "typename", false);
     token_t decl = c_parse_decls(&pctx, false);
 
     if (cctx->diagnostics.len) {
@@ -349,9 +349,9 @@ static char *test_c_stmt_ctrl() {
     cctx_t      *cctx = cctx_create();
     srcfile_t   *src  = srcfile_create(cctx, "<c_stmt_ctrl>", source, sizeof(source) - 1);
     tokenizer_t *tctx = &c_tkn_create(src, C_STD_def)->base;
-    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
-    set_add(&pctx.type_names, "typename");
+    c_parser_add_type_name(&pctx, "typename", false);
     token_t decl = c_parse_stmts(&pctx);
 
     if (cctx->diagnostics.len) {
@@ -385,9 +385,9 @@ static char *test_c_function() {
     cctx_t      *cctx = cctx_create();
     srcfile_t   *src  = srcfile_create(cctx, "<c_function>", source, sizeof(source) - 1);
     tokenizer_t *tctx = &c_tkn_create(src, C_STD_def)->base;
-    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
-    set_add(&pctx.type_names, "typename");
+    c_parser_add_type_name(&pctx, "typename", false);
     token_t decl = c_parse_decls(&pctx, true);
 
     if (cctx->diagnostics.len) {
@@ -427,7 +427,7 @@ static char *test_c_compliteral() {
     cctx_t      *cctx = cctx_create();
     srcfile_t   *src  = srcfile_create(cctx, "<c_compiteral>", source, sizeof(source) - 1);
     tokenizer_t *tctx = &c_tkn_create(src, C_STD_def)->base;
-    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = STR_SET_EMPTY};
+    c_parser_t   pctx = {.tkn_ctx = tctx, .type_names = PTR_SET_EMPTY};
 
     token_t complit = c_parse_expr(&pctx, false);
 
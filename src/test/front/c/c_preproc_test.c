@@ -3,11 +3,17 @@
 // SPDX-FileType: SOURCE
 // SPDX-License-Identifier: MIT
 
+#include "c_pch.h"
 #include "c_preproc.h"
 #include "c_std.h"
 #include "c_tokenizer.h"
 #include "testcase.h"
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 static c_options_t c_preproc_test_options = {
     .c_std          = C_STD_max,
     .gnu_ext_enable = true,
@@ -62,7 +68,7 @@ static token_t pp_next(c_preproc_t *pre) {
     do {                                                                                                               \
         token_t tmp = pp_next(pre);                                                                                    \
         EXPECT_INT(tmp.type, TOKENTYPE_SCONST);                                                                        \
-        EXPECT_STR(tmp.strval, str);                                                                                   \
+        EXPECT_STR_L(tmp.strval, tmp.strval_len, str, strlen(str));                                                    \
         tkn_delete(tmp);                                                                                               \
     } while (0)
 
@@ -102,6 +108,27 @@ static char *test_preproc_counter() {
 LILY_TEST_CASE(test_preproc_counter)
 
 
+// Built-in macros are tokenized from a temporary source file, so their strings must not borrow from it.
+static char *test_preproc_builtin_str() {
+    char const   data[] = "__DATE__\n";
+    cctx_t      *cctx   = cctx_create();
+    srcfile_t   *src    = srcfile_create(cctx, "<test_preproc_builtin_str>", data, sizeof(data) - 1);
+    c_preproc_t *pre    = c_preproc_create(src, &c_preproc_test_options, false, false);
+
+    token_t tkn = pp_next(pre);
+    EXPECT_INT(tkn.type, TOKENTYPE_SCONST);
+    EXPECT_INT(tkn.strval_len, 11);
+    RETURN_ON_FALSE(!tkn.strval_borrowed);
+    tkn_delete(tkn);
+    EXPECT_EOF(pre);
+
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_preproc_builtin_str)
+
+
 // Forward references inside a macro body are resolved at expansion time, so
 // redefining a referenced macro between two expansions changes the result.
 static char *test_preproc_object_macros() {
@@ -252,18 +279,37 @@ LILY_TEST_CASE(test_preproc_va_opt)
 
 
 // `##` between two identifier arguments fuses them into a single identifier.
+// Other pastes must form exactly one pp-number or punctuator; anything else is an error that leaves both tokens.
 static char *test_preproc_func_paste() {
     // clang-format off
     char const data[] =
         "#define PASTE(A, B) A##B\n"
-        "PASTE(foo, bar)\n";
+        "#define FOOBAR 42\n"
+        "PASTE(foo, bar)\n"
+        "PASTE(FOO, BAR)\n"
+        "PASTE(x, 1)\n"
+        "PASTE(0x, 1f)\n"
+        "PASTE(1, 2)\n"
+        "PASTE(<, <=)\n"
+        "PASTE(-, >)\n"
+        "PASTE(x, +)\n";
     // clang-format on
     cctx_t      *cctx = cctx_create();
     srcfile_t   *src  = srcfile_create(cctx, "<test_preproc_func_paste>", data, sizeof(data) - 1);
     c_preproc_t *pre  = c_preproc_create(src, &c_preproc_test_options, false, false);
 
     EXPECT_IDENT(pre, "foobar");
+    EXPECT_ICONST(pre, 42);
+    EXPECT_IDENT(pre, "x1");
+    EXPECT_ICONST(pre, 0x1f);
+    EXPECT_ICONST(pre, 12);
+    EXPECT_PUNCT(pre, C_TKN_SHL_S);
+    EXPECT_PUNCT(pre, C_TKN_ARROW);
+    EXPECT_INT(cctx->diagnostics.len, 0);
+    EXPECT_IDENT(pre, "x");
+    EXPECT_PUNCT(pre, C_TKN_ADD);
     EXPECT_EOF(pre);
+    EXPECT_INT(cctx->diagnostics.len, 1);
 
     tkn_ctx_delete(&pre->base);
     cctx_delete(cctx);
@@ -283,7 +329,8 @@ static char *test_preproc_stringize() {
         "#define PASTE(A, B) A##B\n"
         "STR(This is some text)\n"
         "STR(PASTE(foo, bar))\n"
-        "STR2(PASTE(foo, bar))\n";
+        "STR2(PASTE(foo, bar))\n"
+        "STR( \"a\\\"b\"  '\\\\' x )\n";
     // clang-format on
     cctx_t      *cctx = cctx_create();
     srcfile_t   *src  = srcfile_create(cctx, "<test_preproc_stringize>", data, sizeof(data) - 1);
@@ -292,6 +339,7 @@ static char *test_preproc_stringize() {
     EXPECT_SCONST(pre, "This is some text");
     EXPECT_SCONST(pre, "PASTE(foo, bar)");
     EXPECT_SCONST(pre, "foobar");
+    EXPECT_SCONST(pre, "\"a\\\"b\" '\\\\' x");
     EXPECT_EOF(pre);
 
     tkn_ctx_delete(&pre->base);
@@ -357,6 +405,83 @@ static char *test_preproc_nested_calls() {
 LILY_TEST_CASE(test_preproc_nested_calls)
 
 
+// Arguments are macro-expanded before substitution, even when they invoke the macro that is being called. Macros whose
+// expansion produced an argument stay disabled inside it, so `G` does not recurse through its own argument.
+static char *test_preproc_arg_expand() {
+    // clang-format off
+    char const data[] =
+        "#define ID(x) x\n"
+        "#define G ID(G)\n"
+        "#define AA(x) BB(x)\n"
+        "#define BB(x) AA(x) x\n"
+        "ID(ID(ID(a)))\n"
+        "G\n"
+        "AA(AA(1))\n";
+    // clang-format on
+    cctx_t      *cctx = cctx_create();
+    srcfile_t   *src  = srcfile_create(cctx, "<test_preproc_arg_expand>", data, sizeof(data) - 1);
+    c_preproc_t *pre  = c_preproc_create(src, &c_preproc_test_options, false, false);
+
+    EXPECT_IDENT(pre, "a");
+    EXPECT_IDENT(pre, "G");
+    EXPECT_IDENT(pre, "AA");
+    EXPECT_PUNCT(pre, C_TKN_LPAR);
+    EXPECT_IDENT(pre, "AA");
+    EXPECT_PUNCT(pre, C_TKN_LPAR);
+    EXPECT_ICONST(pre, 1);
+    EXPECT_PUNCT(pre, C_TKN_RPAR);
+    EXPECT_ICONST(pre, 1);
+    EXPECT_PUNCT(pre, C_TKN_RPAR);
+    EXPECT_IDENT(pre, "AA");
+    EXPECT_PUNCT(pre, C_TKN_LPAR);
+    EXPECT_ICONST(pre, 1);
+    EXPECT_PUNCT(pre, C_TKN_RPAR);
+    EXPECT_ICONST(pre, 1);
+    EXPECT_EOF(pre);
+
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_preproc_arg_expand)
+
+
+// Memoized argument pre-expansions are reused for identical arguments, but not after a macro they used is redefined,
+// and not if they use procedural macros like `__COUNTER__`.
+static char *test_preproc_memo_args() {
+    // clang-format off
+    char const data[] =
+        "#define ID(x) x\n"
+        "#define V 1\n"
+        "ID(V)\n"
+        "ID(V)\n"
+        "#undef V\n"
+        "#define V 2\n"
+        "ID(V)\n"
+        "ID(__COUNTER__)\n"
+        "ID(__COUNTER__)\n";
+    // clang-format on
+    cctx_t      *cctx = cctx_create();
+    srcfile_t   *src  = srcfile_create(cctx, "<test_preproc_memo_args>", data, sizeof(data) - 1);
+    c_preproc_t *pre  = c_preproc_create(src, &c_preproc_test_options, false, false);
+    pre->shared->memo_args = true;
+
+    EXPECT_ICONST(pre, 1);
+    EXPECT_ICONST(pre, 1);
+    EXPECT_INT(pre->shared->arg_memo.len, 1);
+    EXPECT_ICONST(pre, 2);
+    EXPECT_ICONST(pre, 0);
+    EXPECT_ICONST(pre, 1);
+    EXPECT_EOF(pre);
+    EXPECT_INT(pre->shared->arg_memo.len, 1);
+
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_preproc_memo_args)
+
+
 // `#if` evaluates a constant expression with C operator precedence. Both
 // expressions here are false, so neither inner `#error` fires and no
 // diagnostics are produced.
@@ -461,3 +586,509 @@ static char *test_preproc_if_branches() {
     return TEST_OK;
 }
 LILY_TEST_CASE(test_preproc_if_branches)
+
+
+// `#if` conditions support `?:` and don't evaluate the operands that `&&`, `||` and `?:` skip. Conditions that only
+// depend on which macros are defined are memoized, and re-evaluated once one of those macros changes.
+static char *test_preproc_if_memo() {
+    // clang-format off
+    char const header[] =
+        "#if defined(FEATURE) && !defined NO_FEATURE\n"
+        "feature\n"
+        "#else\n"
+        "plain\n"
+        "#endif\n"
+        "#if (0 && 1 / 0) || (1 ? 2 : 1 % 0) != 2\n"
+        "#error fail\n"
+        "#endif\n"
+        "#if VALUE > 1\n"
+        "value\n"
+        "#endif\n";
+    char const data[] =
+        "#define VALUE 2\n"
+        "#include \"cond.h\"\n"
+        "#define FEATURE\n"
+        "#include \"cond.h\"\n"
+        "#define UNRELATED\n"
+        "#include \"cond.h\"\n"
+        "#define NO_FEATURE\n"
+        "#include \"cond.h\"\n";
+    // clang-format on
+    cctx_t      *cctx = cctx_create();
+    srcfile_create(cctx, "cond.h", header, sizeof(header) - 1);
+    srcfile_t   *src = srcfile_create(cctx, "<test_preproc_if_memo>", data, sizeof(data) - 1);
+    c_preproc_t *pre = c_preproc_create(src, &c_preproc_test_options, false, false);
+
+    EXPECT_IDENT(pre, "plain");
+    EXPECT_IDENT(pre, "value");
+    EXPECT_IDENT(pre, "feature");
+    EXPECT_IDENT(pre, "value");
+    EXPECT_IDENT(pre, "feature");
+    EXPECT_IDENT(pre, "value");
+    EXPECT_IDENT(pre, "plain");
+    EXPECT_IDENT(pre, "value");
+    EXPECT_EOF(pre);
+    RETURN_ON_FALSE(cctx->diagnostics.len == 0);
+    // `VALUE > 1` expands a macro, so only the first two conditions are memoized.
+    EXPECT_INT(pre->shared->cond_memo.len, 2);
+
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_preproc_if_memo)
+
+
+// A header wrapped in an include guard is not read again while its macro is defined.
+static char *test_preproc_include_guard() {
+    // clang-format off
+    char const guarded[] =
+        "// Comments and whitespace may surround the guard.\n"
+        "#ifndef GUARDED_H\n"
+        "#define GUARDED_H\n"
+        "guarded\n"
+        "#endif\n"
+        "\n";
+    char const guarded_if[] =
+        "#if !defined(GUARDED_IF_H)\n"
+        "#define GUARDED_IF_H\n"
+        "guarded_if\n"
+        "#endif\n";
+    char const unguarded[] =
+        "#ifndef UNGUARDED_H\n"
+        "#define UNGUARDED_H\n"
+        "#endif\n"
+        "unguarded\n";
+    char const data[] =
+        "#include \"guarded.h\"\n"
+        "#include \"guarded.h\"\n"
+        "#include \"guarded_if.h\"\n"
+        "#include \"guarded_if.h\"\n"
+        "#include \"unguarded.h\"\n"
+        "#include \"unguarded.h\"\n"
+        "#undef GUARDED_H\n"
+        "#include \"guarded.h\"\n";
+    // clang-format on
+    cctx_t      *cctx   = cctx_create();
+    srcfile_t   *src_g  = srcfile_create(cctx, "guarded.h", guarded, sizeof(guarded) - 1);
+    srcfile_t   *src_gi = srcfile_create(cctx, "guarded_if.h", guarded_if, sizeof(guarded_if) - 1);
+    srcfile_t   *src_u  = srcfile_create(cctx, "unguarded.h", unguarded, sizeof(unguarded) - 1);
+    srcfile_t   *src    = srcfile_create(cctx, "<test_preproc_include_guard>", data, sizeof(data) - 1);
+    c_preproc_t *pre    = c_preproc_create(src, &c_preproc_test_options, false, false);
+
+    EXPECT_IDENT(pre, "guarded");
+    EXPECT_IDENT(pre, "guarded_if");
+    EXPECT_IDENT(pre, "unguarded");
+    EXPECT_IDENT(pre, "unguarded");
+    EXPECT_IDENT(pre, "guarded");
+    EXPECT_EOF(pre);
+
+    EXPECT_STR(map_get(&pre->shared->guard_macros, src_g), "GUARDED_H");
+    EXPECT_STR(map_get(&pre->shared->guard_macros, src_gi), "GUARDED_IF_H");
+    RETURN_ON_FALSE(map_get(&pre->shared->guard_macros, src_u) == NULL);
+
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_preproc_include_guard)
+
+
+// With only directives processed, include files are found but nothing except EOF is emitted or expanded.
+static char *test_preproc_directives_only() {
+    // clang-format off
+    char const header[] =
+        "#define USE_OTHER 1\n"
+        "#define MACRO(x) x\n"
+        "header_text\n";
+    char const other[]  = "#define OTHER_SEEN\n";
+    char const unused[] = "#define UNUSED_SEEN\n";
+    char const data[] =
+        "#include \"header.h\"\n"
+        "text MACRO(\n"
+        "#if USE_OTHER\n"
+        "#include \"other.h\"\n"
+        "#else\n"
+        "#include \"unused.h\"\n"
+        "#endif\n";
+    // clang-format on
+    cctx_t *cctx = cctx_create();
+    srcfile_create(cctx, "header.h", header, sizeof(header) - 1);
+    srcfile_create(cctx, "other.h", other, sizeof(other) - 1);
+    srcfile_create(cctx, "unused.h", unused, sizeof(unused) - 1);
+    srcfile_t   *src     = srcfile_create(cctx, "<test_preproc_directives_only>", data, sizeof(data) - 1);
+    c_preproc_t *pre     = c_preproc_create(src, &c_preproc_test_options, false, false);
+    pre->directives_only = true;
+
+    // An unterminated `MACRO(` would be an error if text lines were expanded.
+    EXPECT_EOF(pre);
+    EXPECT_INT(cctx->diagnostics.len, 0);
+
+    char const *other_seen = strpool_find(&cctx->idents, "OTHER_SEEN", 10);
+    RETURN_ON_FALSE(other_seen && map_get(&pre->shared->macros, other_seen));
+    char const *unused_seen = strpool_find(&cctx->idents, "UNUSED_SEEN", 11);
+    RETURN_ON_FALSE(!unused_seen || !map_get(&pre->shared->macros, unused_seen));
+
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_preproc_directives_only)
+
+
+// Inactive groups are skipped without tokenizing them; `#` only starts a directive at the beginning of a line.
+static char *test_preproc_skip_group() {
+    // clang-format off
+    char const data[] =
+        "#if 0\n"
+        "don't \"# not a directive\" '#'\n"
+        "/* # not a directive\n"
+        "   either */ skipped \\\n"
+        "# not a directive\n"
+        "  // # not a directive \\\n"
+        "# still a comment\n"
+        "#  if 1\n"
+        "nested\n"
+        "#  endif\n"
+        "#else\n"
+        "kept\n"
+        "#endif\n"
+        "#ifdef UNDEFINED\n"
+        "gone\n"
+        "/* comment */ # endif\n"
+        "after\n";
+    // clang-format on
+    cctx_t      *cctx = cctx_create();
+    srcfile_t   *src  = srcfile_create(cctx, "<test_preproc_skip_group>", data, sizeof(data) - 1);
+    c_preproc_t *pre  = c_preproc_create(src, &c_preproc_test_options, false, false);
+
+    EXPECT_IDENT(pre, "kept");
+    token_t tkn = pp_next(pre);
+    EXPECT_INT(tkn.type, TOKENTYPE_IDENT);
+    EXPECT_STR(tkn.strval, "after");
+    EXPECT_INT(tkn.pos.line, 16);
+    EXPECT_INT(tkn.pos.col, 0);
+    tkn_delete(tkn);
+    EXPECT_EOF(pre);
+    EXPECT_INT(cctx->diagnostics.len, 0);
+
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_preproc_skip_group)
+
+
+// An unterminated `#if` in the main file is reported instead of hanging at EOF.
+static char *test_preproc_unterminated_if() {
+    char const   data[] = "#if 0\nskipped\n";
+    cctx_t      *cctx   = cctx_create();
+    srcfile_t   *src    = srcfile_create(cctx, "<test_preproc_unterminated_if>", data, sizeof(data) - 1);
+    c_preproc_t *pre    = c_preproc_create(src, &c_preproc_test_options, false, false);
+
+    EXPECT_EOF(pre);
+    EXPECT_INT(cctx->diagnostics.len, 1);
+
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_preproc_unterminated_if)
+
+
+// A precompiled header restores macros, `__COUNTER__` and include guards, and replays the tokens its header emitted.
+static char *test_preproc_pch() {
+    // clang-format off
+    char const header[] =
+        "#ifndef PCH_TEST_H\n"
+        "#define PCH_TEST_H\n"
+        "#define PCH_SWAP(a, b) b a\n"
+        "#define PCH_STR(x) #x\n"
+        "pch_emitted __COUNTER__\n"
+        "#endif\n";
+    char const data[] = "PCH_SWAP(x, y) PCH_STR(foo  bar) __COUNTER__\n";
+    // clang-format on
+    char header_path[] = "/tmp/lilycc_pch_XXXXXX";
+    int  fd            = mkstemp(header_path);
+    RETURN_ON_FALSE(fd >= 0);
+    RETURN_ON_FALSE(write(fd, header, sizeof(header) - 1) == sizeof(header) - 1);
+    close(fd);
+    char pch_path[sizeof(header_path) + 4];
+    snprintf(pch_path, sizeof(pch_path), "%s.pch", header_path);
+
+    bool created = c_pch_create(&c_preproc_test_options, NULL, 0, header_path, pch_path, false);
+    if (!created) {
+        unlink(header_path);
+    }
+    RETURN_ON_FALSE(created);
+
+    cctx_t      *cctx   = cctx_create();
+    srcfile_t   *src    = srcfile_create(cctx, "<test_preproc_pch>", data, sizeof(data) - 1);
+    c_preproc_t *pre    = c_preproc_create(src, &c_preproc_test_options, false, false);
+    bool         loaded = c_pch_load(pre, pch_path);
+    if (!loaded) {
+        unlink(header_path);
+        unlink(pch_path);
+    }
+    RETURN_ON_FALSE(loaded);
+
+    // Macro bodies are only built once the macro is used.
+    char const *swap_name = strpool_find(&cctx->idents, "PCH_SWAP", 8);
+    RETURN_ON_FALSE(swap_name != NULL);
+    c_macro_t const *swap = map_get(&pre->shared->macros, swap_name);
+    RETURN_ON_FALSE(swap != NULL && swap->pch_body != NULL);
+
+    EXPECT_IDENT(pre, "pch_emitted");
+    EXPECT_ICONST(pre, 0);
+    EXPECT_IDENT(pre, "y");
+    EXPECT_IDENT(pre, "x");
+    EXPECT_SCONST(pre, "foo bar");
+    EXPECT_ICONST(pre, 1);
+    EXPECT_EOF(pre);
+    EXPECT_INT(cctx->diagnostics.len, 0);
+    RETURN_ON_FALSE(swap->pch_body == NULL);
+    RETURN_ON_FALSE(pre->shared->pch->files_len == 1);
+    EXPECT_STR(map_get(&pre->shared->guard_macros, pre->shared->pch->files[0]), "PCH_TEST_H");
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+
+    // The precompiled header is rejected once the header changes.
+    fd = open(header_path, O_WRONLY | O_APPEND);
+    RETURN_ON_FALSE(fd >= 0);
+    RETURN_ON_FALSE(write(fd, "\n", 1) == 1);
+    close(fd);
+    cctx = cctx_create();
+    src  = srcfile_create(cctx, "<test_preproc_pch>", data, sizeof(data) - 1);
+    pre  = c_preproc_create(src, &c_preproc_test_options, false, false);
+    EXPECT_INT(c_pch_load(pre, pch_path), false);
+    EXPECT_IDENT(pre, "PCH_SWAP");
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+
+    unlink(header_path);
+    unlink(pch_path);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_preproc_pch)
+
+
+// Count the entries in a directory, not counting `.` and `..`.
+static int count_dir_entries(char const *path) {
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return -1;
+    }
+    int            count = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir))) {
+        count += strcmp(ent->d_name, ".") && strcmp(ent->d_name, "..");
+    }
+    closedir(dir);
+    return count;
+}
+
+// Include files replayed from the token cache preprocess exactly like freshly tokenized ones.
+static char *test_preproc_tkn_cache() {
+    char const header[]  = "#define HDR_VAL 42\n  hdr_ident \"str\" 0x1f\n";
+    char const skipped[] = "#if 0\ndon't\n#endif\nskipped_ok\n";
+    char       dir[]     = "/tmp/lilycc_tkc_XXXXXX";
+    RETURN_ON_FALSE(mkdtemp(dir) != NULL);
+    char header_path[sizeof(dir) + 16];
+    char skipped_path[sizeof(dir) + 16];
+    snprintf(header_path, sizeof(header_path), "%s/hdr.h", dir);
+    snprintf(skipped_path, sizeof(skipped_path), "%s/skip.h", dir);
+    FILE *fd = fopen(header_path, "wb");
+    RETURN_ON_FALSE(fd && fwrite(header, 1, sizeof(header) - 1, fd) == sizeof(header) - 1);
+    fclose(fd);
+    fd = fopen(skipped_path, "wb");
+    RETURN_ON_FALSE(fd && fwrite(skipped, 1, sizeof(skipped) - 1, fd) == sizeof(skipped) - 1);
+    fclose(fd);
+
+    char data[128];
+    snprintf(data, sizeof(data), "#include \"%s\"\n#include \"%s\"\nHDR_VAL\n", header_path, skipped_path);
+
+    // The first run writes the cache, the second run reads it.
+    for (int run = 0; run < 2; run++) {
+        cctx_t      *cctx = cctx_create();
+        srcfile_t   *src  = srcfile_create(cctx, "<test_preproc_tkn_cache>", data, strlen(data));
+        c_preproc_t *pre = c_preproc_create(src, &c_preproc_test_options, false, false);
+        pre->shared->tkn_cache_dir = dir;
+
+        token_t tkn = pp_next(pre);
+        EXPECT_INT(tkn.type, TOKENTYPE_IDENT);
+        EXPECT_STR(tkn.strval, "hdr_ident");
+        EXPECT_INT(tkn.pos.line, 1);
+        EXPECT_INT(tkn.pos.col, 2);
+        EXPECT_INT(tkn.pos.len, 9);
+        tkn_delete(tkn);
+        EXPECT_SCONST(pre, "str");
+        EXPECT_ICONST(pre, 0x1f);
+        EXPECT_IDENT(pre, "skipped_ok");
+        EXPECT_ICONST(pre, 42);
+        EXPECT_EOF(pre);
+        EXPECT_INT(cctx->diagnostics.len, 0);
+
+        tkn_ctx_delete(&pre->base);
+        cctx_delete(cctx);
+
+        // Only `hdr.h` is cached; `skip.h` had tokenizer errors in a skipped group, which a cache can't reproduce.
+        EXPECT_INT(count_dir_entries(dir), 3);
+    }
+
+    DIR           *dirp = opendir(dir);
+    struct dirent *ent;
+    while ((ent = readdir(dirp))) {
+        char path[sizeof(dir) + 256];
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if (strcmp(ent->d_name, ".") && strcmp(ent->d_name, "..")) {
+            unlink(path);
+        }
+    }
+    closedir(dirp);
+    rmdir(dir);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_preproc_tkn_cache)
+
+
+// Write `data` to a new file at `path`.
+static bool write_test_file(char const *path, char const *data) {
+    FILE *fd = fopen(path, "wb");
+    if (!fd) {
+        return false;
+    }
+    size_t len = strlen(data);
+    bool   ok  = fwrite(data, 1, len, fd) == len;
+    fclose(fd);
+    return ok;
+}
+
+// Include files are searched for in the include directories in order; `#include_next` continues after the
+// directory the current file was found in, and lookups that failed are remembered.
+static char *test_preproc_include_search() {
+    char dir[] = "/tmp/lilycc_inc_XXXXXX";
+    RETURN_ON_FALSE(mkdtemp(dir) != NULL);
+    char dir_a[sizeof(dir) + 4];
+    char dir_b[sizeof(dir) + 4];
+    char path_a[sizeof(dir) + 16];
+    char path_b[sizeof(dir) + 16];
+    char path_probe[sizeof(dir) + 16];
+    snprintf(dir_a, sizeof(dir_a), "%s/a", dir);
+    snprintf(dir_b, sizeof(dir_b), "%s/b", dir);
+    snprintf(path_a, sizeof(path_a), "%s/a/x.h", dir);
+    snprintf(path_b, sizeof(path_b), "%s/b/x.h", dir);
+    snprintf(path_probe, sizeof(path_probe), "%s/b/probe.h", dir);
+    RETURN_ON_FALSE(mkdir(dir_a, 0700) == 0 && mkdir(dir_b, 0700) == 0);
+    RETURN_ON_FALSE(write_test_file(path_a, "a_before\n#include_next <x.h>\na_after\n"));
+    RETURN_ON_FALSE(write_test_file(path_b, "b_only\n"));
+    RETURN_ON_FALSE(write_test_file(path_probe, "bad\n"));
+
+    // clang-format off
+    char const data[] =
+        "#include <x.h>\n"
+        "#if __has_include(<absent.h>) || __has_include(\"absent.h\")\n"
+        "bad\n"
+        "#endif\n"
+        "#if __has_include(<absent.h>)\n"
+        "bad\n"
+        "#endif\n"
+        "#if __has_include(<probe.h>)\n"
+        "probed\n"
+        "#endif\n"
+        "#include \"x.h\"\n";
+    // clang-format on
+    char const  *search[] = {dir_a, dir_b};
+    cctx_t      *cctx     = cctx_create();
+    srcfile_t   *src      = srcfile_create(cctx, "<test_preproc_include_search>", data, sizeof(data) - 1);
+    c_preproc_t *pre      = c_preproc_create(src, &c_preproc_test_options, false, false);
+    pre->shared->include_dirs     = search;
+    pre->shared->include_dirs_len = 2;
+
+    EXPECT_IDENT(pre, "a_before");
+    EXPECT_IDENT(pre, "b_only");
+    EXPECT_IDENT(pre, "a_after");
+    EXPECT_IDENT(pre, "probed");
+    EXPECT_IDENT(pre, "a_before");
+    EXPECT_IDENT(pre, "b_only");
+    EXPECT_IDENT(pre, "a_after");
+    EXPECT_EOF(pre);
+    EXPECT_INT(cctx->diagnostics.len, 0);
+
+    // Each file was opened once, and each failed lookup is remembered.
+    EXPECT_INT(cctx->srcs_len, 4);
+    RETURN_ON_FALSE(map_get(&cctx->srcs_by_path, path_a) != NULL);
+    RETURN_ON_FALSE(map_get(&cctx->srcs_by_path, path_b) != NULL);
+    RETURN_ON_FALSE(cctx->missing_paths.len > 0);
+
+    // The file only probed by `__has_include` wasn't read from.
+    EXPECT_INT(pre->shared->read_files.len, 3);
+    RETURN_ON_FALSE(pre->shared->read_files.arr[0] == src);
+    RETURN_ON_FALSE(pre->shared->read_files.arr[1] == map_get(&cctx->srcs_by_path, path_a));
+    RETURN_ON_FALSE(pre->shared->read_files.arr[2] == map_get(&cctx->srcs_by_path, path_b));
+
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+
+    unlink(path_a);
+    unlink(path_b);
+    unlink(path_probe);
+    rmdir(dir_a);
+    rmdir(dir_b);
+    rmdir(dir);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_preproc_include_search)
+
+
+// A precompiled header searches the include directories of the preprocessor that uses it,
+// and is only reused with the same include directories.
+static char *test_preproc_pch_include_dirs() {
+    char dir[] = "/tmp/lilycc_pchinc_XXXXXX";
+    RETURN_ON_FALSE(mkdtemp(dir) != NULL);
+    char inc_dir[sizeof(dir) + 4];
+    char inc_path[sizeof(dir) + 16];
+    char header_path[sizeof(dir) + 16];
+    char pch_path[sizeof(dir) + 16];
+    snprintf(inc_dir, sizeof(inc_dir), "%s/inc", dir);
+    snprintf(inc_path, sizeof(inc_path), "%s/inc/inc.h", dir);
+    snprintf(header_path, sizeof(header_path), "%s/pre.h", dir);
+    snprintf(pch_path, sizeof(pch_path), "%s/pre.h.pch", dir);
+    RETURN_ON_FALSE(mkdir(inc_dir, 0700) == 0);
+    RETURN_ON_FALSE(write_test_file(inc_path, "#define INC_VAL 7\n"));
+    RETURN_ON_FALSE(write_test_file(header_path, "#include <inc.h>\n"));
+
+    char const   data[]   = "INC_VAL\n";
+    char const  *search[] = {inc_dir};
+    cctx_t      *cctx     = cctx_create();
+    srcfile_t   *src      = srcfile_create(cctx, "<test_preproc_pch_include_dirs>", data, sizeof(data) - 1);
+    c_preproc_t *pre      = c_preproc_create(src, &c_preproc_test_options, false, false);
+    pre->shared->include_dirs     = search;
+    pre->shared->include_dirs_len = 1;
+    bool used                     = c_pch_use(pre, header_path);
+    if (used) {
+        EXPECT_ICONST(pre, 7);
+        EXPECT_EOF(pre);
+        EXPECT_INT(cctx->diagnostics.len, 0);
+    }
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+
+    // Without the include directory, the precompiled header doesn't apply.
+    cctx = cctx_create();
+    src  = srcfile_create(cctx, "<test_preproc_pch_include_dirs>", data, sizeof(data) - 1);
+    pre  = c_preproc_create(src, &c_preproc_test_options, false, false);
+    bool reused = c_pch_load(pre, pch_path);
+    tkn_ctx_delete(&pre->base);
+    cctx_delete(cctx);
+
+    unlink(pch_path);
+    unlink(header_path);
+    unlink(inc_path);
+    rmdir(inc_dir);
+    rmdir(dir);
+
+    RETURN_ON_FALSE(used);
+    RETURN_ON_FALSE(!reused);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_preproc_pch_include_dirs)
@@ -8,6 +8,9 @@
 #include "c_tokenizer.h"
 #include "testcase.h"
 
+#include <stdio.h>
+#include <string.h>
+
 
 
 static c_options_t c_tokenizer_test_options = {
@@ -135,6 +138,135 @@ static char *test_c_tkn_basic() {
 }
 LILY_TEST_CASE(test_c_tkn_basic)
 
+// Test that the block comment fast path stops at `*/` wherever it falls relative to the bulk scanning chunks.
+static char *test_c_tkn_comment_end() {
+    char padding[40];
+    memset(padding, 'x', sizeof(padding));
+
+    for (size_t pad = 0; pad < sizeof(padding); pad++) {
+        // The string literal makes the file non-ASCII, so the comment text is scanned in chunks.
+        char   data[128];
+        size_t len = snprintf(
+            data,
+            sizeof(data),
+            "/*%.*s*/\"\xc3\xa9\" /*%.*s**/",
+            (int)pad,
+            padding,
+            (int)pad,
+            padding
+        );
+
+        for (int preproc = 0; preproc < 2; preproc++) {
+            cctx_t        *cctx    = cctx_create();
+            srcfile_t     *src     = srcfile_create(cctx, "<c_tkn_comment_end>", data, len);
+            c_tokenizer_t *c_ctx   = c_tkn_create_impl(src, &c_tokenizer_test_options);
+            tokenizer_t   *tkn_ctx = &c_ctx->base;
+            c_ctx->preproc_mode    = preproc;
+            c_ctx->keep_comments   = preproc;
+            token_t tkn;
+
+            if (preproc) {
+                tkn = c_tkn_next(tkn_ctx); // /*<pad>*/
+                EXPECT_INT(tkn.type, TOKENTYPE_WHITESPACE);
+                EXPECT_INT(tkn.subtype, C_BLOCK_COMMENT);
+                EXPECT_INT(tkn.pos.len, pad + 4);
+                EXPECT_INT(tkn.strval_len, pad);
+                tkn_delete(tkn);
+            }
+
+            tkn = c_tkn_next(tkn_ctx); // "é"
+            EXPECT_INT(tkn.type, TOKENTYPE_SCONST);
+            EXPECT_INT(tkn.pos.off, pad + 4);
+            EXPECT_STR_L(tkn.strval, tkn.strval_len, "\xc3\xa9", 2);
+            tkn_delete(tkn);
+
+            if (preproc) {
+                tkn_delete(c_tkn_next(tkn_ctx)); // Whitespace.
+                tkn = c_tkn_next(tkn_ctx);       // /*<pad>**/
+                EXPECT_INT(tkn.type, TOKENTYPE_WHITESPACE);
+                EXPECT_INT(tkn.subtype, C_BLOCK_COMMENT);
+                EXPECT_INT(tkn.pos.len, pad + 5);
+                EXPECT_INT(tkn.strval_len, pad + 1);
+                tkn_delete(tkn);
+            }
+
+            tkn = c_tkn_next(tkn_ctx);
+            EXPECT_INT(tkn.type, TOKENTYPE_EOF);
+            EXPECT_INT(cctx->diagnostics.len, 0);
+            tkn_delete(tkn);
+
+            tkn_ctx_delete(tkn_ctx);
+            cctx_delete(cctx);
+        }
+    }
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_c_tkn_comment_end)
+
+// Test that string literals without escapes reference the source instead of being copied to the token arena.
+static char *test_c_tkn_str_borrow() {
+    char const data[] = "\"plain\" \"esc\\n\" \"caf\xc3\xa9\" 'c'";
+
+    cctx_t    *cctx = cctx_create();
+    srcfile_t *src  = srcfile_create(cctx, "<c_tkn_str_borrow>", data, sizeof(data) - 1);
+
+    c_tokenizer_t *c_ctx   = c_tkn_create_impl(src, &c_tokenizer_test_options);
+    tokenizer_t   *tkn_ctx = &c_ctx->base;
+    c_ctx->preproc_mode    = true;
+    token_t tkn;
+
+    tkn = c_tkn_next(tkn_ctx); // "plain"
+    EXPECT_INT(tkn.type, TOKENTYPE_SCONST);
+    EXPECT_INT(tkn.pos.len, 7);
+    EXPECT_STR_L(tkn.strval, tkn.strval_len, "plain", 5);
+    RETURN_ON_FALSE(tkn.strval_borrowed);
+    RETURN_ON_FALSE(tkn.strval == (char const *)src->content + 1);
+    token_t conv = c_tkn_conv_str(cctx, C_STD_max, &tkn);
+    EXPECT_STR_L(conv.strval, conv.strval_len, "plain", 5);
+    RETURN_ON_FALSE(conv.strval_borrowed);
+    token_t clone = tkn_clone(&conv);
+    RETURN_ON_FALSE(clone.strval == conv.strval);
+    tkn_own_strval(&clone);
+    RETURN_ON_FALSE(!clone.strval_borrowed);
+    EXPECT_STR(clone.strval, "plain");
+    tkn_delete(clone);
+    tkn_delete(conv);
+    tkn_delete(tkn);
+
+    tkn_delete(c_tkn_next(tkn_ctx)); // Whitespace.
+    tkn = c_tkn_next(tkn_ctx);       // "esc\n"
+    EXPECT_STR_L(tkn.strval, tkn.strval_len, "esc\\n", 5);
+    // Copied to the token arena rather than borrowed from the source.
+    RETURN_ON_FALSE(tkn.strval_borrowed);
+    RETURN_ON_FALSE(tkn.strval < (char const *)src->content || tkn.strval >= (char const *)src->content + src->content_len);
+    EXPECT_INT(tkn.strval[tkn.strval_len], 0);
+    conv = c_tkn_conv_str(cctx, C_STD_max, &tkn);
+    EXPECT_STR(conv.strval, "esc\n");
+    RETURN_ON_FALSE(!conv.strval_borrowed);
+    tkn_delete(conv);
+    tkn_delete(tkn);
+
+    tkn_delete(c_tkn_next(tkn_ctx)); // Whitespace.
+    tkn = c_tkn_next(tkn_ctx);       // "café"
+    EXPECT_STR_L(tkn.strval, tkn.strval_len, "caf\xc3\xa9", 5);
+    tkn_delete(tkn);
+
+    tkn_delete(c_tkn_next(tkn_ctx)); // Whitespace.
+    tkn = c_tkn_next(tkn_ctx);       // 'c'
+    EXPECT_INT(tkn.subtype, C_STR_RAW_SQUOT);
+    EXPECT_STR_L(tkn.strval, tkn.strval_len, "c", 1);
+    RETURN_ON_FALSE(tkn.strval_borrowed);
+    conv = c_tkn_conv_str(cctx, C_STD_max, &tkn);
+    EXPECT_INT(conv.type, TOKENTYPE_CCONST);
+    EXPECT_CHAR(conv.ival, 'c');
+    tkn_delete(tkn);
+
+    tkn_ctx_delete(tkn_ctx);
+    cctx_delete(cctx);
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_c_tkn_str_borrow)
+
 
 // Test of literal suffix behaviour.
 static char *test_c_tkn_litsuffix() {
@@ -395,3 +527,34 @@ static char *test_c_tkn_errors() {
     return TEST_OK;
 }
 LILY_TEST_CASE(test_c_tkn_errors)
+
+// Test keyword lookup.
+static char *test_c_keyw_get() {
+    // Every keyword is found by its own spelling.
+    for (c_keyw_t i = 0; i < C_N_KEYWS; i++) {
+        EXPECT_INT(c_keyw_get(C_STD_max, c_keywords[i], strlen(c_keywords[i])), i);
+    }
+
+    // Prefixes, extensions and case variants of keywords are not keywords.
+    EXPECT_INT(c_keyw_get(C_STD_max, "in", 2), C_N_KEYWS);
+    EXPECT_INT(c_keyw_get(C_STD_max, "integer", 7), C_N_KEYWS);
+    EXPECT_INT(c_keyw_get(C_STD_max, "INT", 3), C_N_KEYWS);
+    EXPECT_INT(c_keyw_get(C_STD_max, "typeof_", 7), C_N_KEYWS);
+    EXPECT_INT(c_keyw_get(C_STD_max, "", 0), C_N_KEYWS);
+
+    // Only the length given is considered.
+    EXPECT_INT(c_keyw_get(C_STD_max, "intx", 3), C_KEYW_int);
+
+    // Keywords from later standards are identifiers.
+    EXPECT_INT(c_keyw_get(C_STD_C99, "bool", 4), C_N_KEYWS);
+    EXPECT_INT(c_keyw_get(C_STD_C99, "_Bool", 5), C_KEYW__Bool);
+    EXPECT_INT(c_keyw_get(C_STD_C99, "_Atomic", 7), C_N_KEYWS);
+
+    // Alternate spellings are replaced.
+    EXPECT_INT(c_keyw_main(C_KEYW_bool), C_KEYW__Bool);
+    EXPECT_INT(c_keyw_main(C_KEYW_alignas), C_KEYW__Alignas);
+    EXPECT_INT(c_keyw_main(C_KEYW_int), C_KEYW_int);
+
+    return TEST_OK;
+}
+LILY_TEST_CASE(test_c_keyw_get)
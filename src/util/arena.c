@@ -0,0 +1,135 @@
+// SPDX-FileCopyrightText: 2026 Julian Scheffers <julian@scheffers.net>
+// SPDX-FileType: SOURCE
+// SPDX-License-Identifier: MIT
+
+#include "arena.h"
+
+#include "lilycc_malloc.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+
+
+// Block of memory that an arena allocates from.
+struct arena_blk {
+    // Previously allocated block.
+    arena_blk_t *prev;
+    // Number of bytes used.
+    size_t       used;
+    // Capacity in bytes.
+    size_t       cap;
+    // Memory for allocations.
+    _Alignas(max_align_t) uint8_t data[];
+};
+
+// Default size of a newly allocated block.
+#define ARENA_BLK_SIZE 16384
+
+
+
+// Allocate memory from an arena with a specific alignment, abort if out of memory.
+// The memory stays valid until the arena is reset or cleared.
+void *arena_alloc_aligned(arena_t *arena, size_t size, size_t align) {
+    assert(align && !(align & (align - 1)) && align <= _Alignof(max_align_t));
+
+    arena_blk_t *blk = arena->blocks;
+    size_t       pad = blk ? -blk->used & (align - 1) : 0;
+    if (!blk || blk->cap - blk->used < size + pad) {
+        size_t cap    = size > ARENA_BLK_SIZE ? size : ARENA_BLK_SIZE;
+        blk           = lilycc_malloc(sizeof(arena_blk_t) + cap);
+        blk->prev     = arena->blocks;
+        blk->used     = 0;
+        blk->cap      = cap;
+        arena->blocks = blk;
+        pad           = 0;
+    }
+
+    void *mem    = blk->data + blk->used + pad;
+    blk->used   += size + pad;
+    arena->used += size;
+    return mem;
+}
+
+// Allocate zero-initialized memory from an arena, abort if out of memory.
+void *arena_calloc(arena_t *arena, size_t size) {
+    void *mem = arena_alloc(arena, size);
+    memset(mem, 0, size);
+    return mem;
+}
+
+// Copy `len` bytes into a NUL-terminated string allocated from an arena.
+char *arena_strndup(arena_t *arena, char const *str, size_t len) {
+    char *mem = arena_alloc_aligned(arena, len + 1, 1);
+    // `str` may be NULL if `len` is 0, which `memcpy` doesn't allow.
+    if (len) {
+        memcpy(mem, str, len);
+    }
+    mem[len] = 0;
+    return mem;
+}
+
+// Free everything allocated from an arena, but keep its first block around for reuse.
+void arena_reset(arena_t *arena) {
+    if (!arena->blocks) {
+        return;
+    }
+    while (arena->blocks->prev) {
+        arena_blk_t *prev = arena->blocks->prev;
+        lilycc_free(arena->blocks);
+        arena->blocks = prev;
+    }
+    arena->blocks->used = 0;
+    arena->used         = 0;
+}
+
+// Free everything allocated from an arena, including all its blocks.
+void arena_clear(arena_t *arena) {
+    while (arena->blocks) {
+        arena_blk_t *prev = arena->blocks->prev;
+        lilycc_free(arena->blocks);
+        arena->blocks = prev;
+    }
+    arena->used = 0;
+}
+
+// Move everything allocated from `other` into `arena`, leaving `other` empty.
+// Memory from `other` stays valid and is freed along with the rest of `arena`.
+void arena_merge(arena_t *arena, arena_t *other) {
+    if (!other->blocks) {
+        return;
+    }
+    // The blocks of `other` go below the oldest block so new allocations keep using the most recent one.
+    arena_blk_t **oldest = &arena->blocks;
+    while (*oldest) {
+        oldest = &(*oldest)->prev;
+    }
+    *oldest       = other->blocks;
+    arena->used  += other->used;
+    other->blocks = NULL;
+    other->used   = 0;
+}
+
+// Get the current position of an arena, so that what is allocated after it can be freed by `arena_rewind`.
+arena_mark_t arena_mark(arena_t const *arena) {
+    return (arena_mark_t){
+        .block    = arena->blocks,
+        .blk_used = arena->blocks ? arena->blocks->used : 0,
+        .used     = arena->used,
+    };
+}
+
+// Free everything allocated from an arena since `mark` was taken.
+// The arena must not have been reset, cleared or merged into since then.
+void arena_rewind(arena_t *arena, arena_mark_t mark) {
+    while (arena->blocks != mark.block) {
+        arena_blk_t *prev = arena->blocks->prev;
+        lilycc_free(arena->blocks);
+        arena->blocks = prev;
+    }
+    if (arena->blocks) {
+        arena->blocks->used = mark.blk_used;
+    }
+    arena->used = mark.used;
+}
@@ -0,0 +1,66 @@
+// SPDX-FileCopyrightText: 2026 Julian Scheffers <julian@scheffers.net>
+// SPDX-FileType: SOURCE
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stddef.h>
+
+
+
+// Region allocator; everything allocated from it is freed at once.
+typedef struct arena      arena_t;
+// Block of memory that an arena allocates from.
+typedef struct arena_blk  arena_blk_t;
+// Position in an arena that it can be rewound to.
+typedef struct arena_mark arena_mark_t;
+
+
+
+// Region allocator; everything allocated from it is freed at once.
+// A zero-initialized arena is empty and ready for use.
+struct arena {
+    // Most recently allocated block.
+    arena_blk_t *blocks;
+    // Total number of bytes handed out since the last reset.
+    size_t       used;
+};
+
+// Position in an arena that it can be rewound to; see `arena_mark` and `arena_rewind`.
+struct arena_mark {
+    // Most recently allocated block at the time of the mark.
+    arena_blk_t *block;
+    // Number of bytes used in `block` at the time of the mark.
+    size_t       blk_used;
+    // Total number of bytes handed out at the time of the mark.
+    size_t       used;
+};
+
+
+
+// Allocate memory from an arena with a specific alignment, abort if out of memory.
+// The memory stays valid until the arena is reset or cleared.
+void *arena_alloc_aligned(arena_t *arena, size_t size, size_t align) __attribute__((malloc, warn_unused_result));
+// Allocate zero-initialized memory from an arena, abort if out of memory.
+void *arena_calloc(arena_t *arena, size_t size) __attribute__((malloc, warn_unused_result));
+// Copy `len` bytes into a NUL-terminated string allocated from an arena.
+char *arena_strndup(arena_t *arena, char const *str, size_t len) __attribute__((warn_unused_result));
+// Free everything allocated from an arena, but keep its first block around for reuse.
+void  arena_reset(arena_t *arena);
+// Free everything allocated from an arena, including all its blocks.
+void  arena_clear(arena_t *arena);
+// Move everything allocated from `other` into `arena`, leaving `other` empty.
+// Memory from `other` stays valid and is freed along with the rest of `arena`.
+void  arena_merge(arena_t *arena, arena_t *other);
+
+// Get the current position of an arena, so that what is allocated after it can be freed by `arena_rewind`.
+arena_mark_t arena_mark(arena_t const *arena);
+// Free everything allocated from an arena since `mark` was taken.
+// The arena must not have been reset, cleared or merged into since then.
+void         arena_rewind(arena_t *arena, arena_mark_t mark);
+
+// Allocate memory from an arena suitably aligned for any type, abort if out of memory.
+// The memory stays valid until the arena is reset or cleared.
+static inline void *arena_alloc(arena_t *arena, size_t size) {
+    return arena_alloc_aligned(arena, size, _Alignof(max_align_t));
+}
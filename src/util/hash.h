@@ -13,6 +13,8 @@
 
 // Get the hash of a C-string.
 uint32_t hash_cstr(char const *str);
+// Get the hash of a block of memory; same as `hash_cstr` for strings without the NUL terminator.
+uint32_t hash_mem(void const *data, size_t len);
 // Get the hash of a pointer.
 uint32_t hash_ptr(void const *ptr);
 
@@ -21,6 +21,10 @@
 
 // Total size allocated through Lily-CC's allocator.
 atomic_size_t lilycc_total_alloc   = 0;
+// Highest value `lilycc_total_alloc` has reached; may be lowered to measure the peak of a specific workload.
+atomic_size_t lilycc_peak_alloc    = 0;
+// Number of allocations made through Lily-CC's allocator, including reallocations.
+atomic_size_t lilycc_alloc_count   = 0;
 // Allocation debug printing output.
 FILE         *lilycc_alloc_debugfd = NULL;
 
@@ -35,6 +39,14 @@ __attribute__((constructor)) static void init_alloc_instrument() {
     }
 }
 
+// Account for `size` bytes more being allocated.
+static void alloc_account(size_t size) {
+    size_t total = atomic_fetch_add(&lilycc_total_alloc, size) + size;
+    size_t peak  = lilycc_peak_alloc;
+    while (total > peak && !atomic_compare_exchange_weak(&lilycc_peak_alloc, &peak, total));
+    lilycc_alloc_count++;
+}
+
 typedef struct alloc_hdr alloc_hdr_t;
 
 struct __attribute__((aligned(16))) alloc_hdr {
@@ -54,8 +66,8 @@ static void *wrap_malloc(size_t size) {
         return NULL;
     }
 
-    hdr->size           = size;
-    lilycc_total_alloc += size;
+    hdr->size = size;
+    alloc_account(size);
     memset(hdr + 1, 0xcc, size);
 
     return hdr + 1;
@@ -104,8 +116,8 @@ static void *wrap_realloc(void *ptr, size_t newsize) {
     }
 
     lilycc_total_alloc -= mem->size;
-    lilycc_total_alloc += newsize;
-    mem->size           = newsize;
+    alloc_account(newsize);
+    mem->size = newsize;
 
     return mem + 1;
 }
@@ -148,6 +160,7 @@ static char *wrap_strdup(char const *str) {
 #define wrap_calloc      calloc
 #define wrap_realloc     realloc
 #define wrap_strdup      strdup
+#define wrap_free        free
 #endif
 
 // Strong malloc; abort if out of memory.
@@ -13,6 +13,10 @@
 #if !defined NDEBUG && defined __GNUC__
 // Total size allocated through Lily-CC's allocator.
 extern atomic_size_t lilycc_total_alloc;
+// Highest value `lilycc_total_alloc` has reached; may be lowered to measure the peak of a specific workload.
+extern atomic_size_t lilycc_peak_alloc;
+// Number of allocations made through Lily-CC's allocator, including reallocations.
+extern atomic_size_t lilycc_alloc_count;
 // Allocation debug printing output.
 extern FILE         *lilycc_alloc_debugfd;
 #endif
@@ -0,0 +1,87 @@
+// SPDX-FileCopyrightText: 2026 Julian Scheffers <julian@scheffers.net>
+// SPDX-FileType: SOURCE
+// SPDX-License-Identifier: MIT
+
+#include "strpool.h"
+
+#include "hash.h"
+#include "lilycc_malloc.h"
+
+#include <assert.h>
+#include <string.h>
+
+
+
+// Minimum size of the hash table.
+#define STRPOOL_MIN_CAP  256
+
+
+
+// Find the table slot for a string; either the slot holding it or the empty slot where it would go.
+static strpool_ent_t **strpool_slot(strpool_t const *pool, char const *str, size_t len, uint32_t hash) {
+    size_t mask = pool->table_cap - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        strpool_ent_t *ent = pool->table[i];
+        if (!ent || (ent->hash == hash && ent->len == len && !memcmp(ent->str, str, len))) {
+            return &pool->table[i];
+        }
+    }
+}
+
+// Double the size of the hash table.
+static void strpool_grow(strpool_t *pool) {
+    size_t          old_cap   = pool->table_cap;
+    strpool_ent_t **old_table = pool->table;
+
+    pool->table_cap = old_cap ? old_cap * 2 : STRPOOL_MIN_CAP;
+    pool->table     = lilycc_calloc(pool->table_cap, sizeof(strpool_ent_t *));
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old_table[i]) {
+            *strpool_slot(pool, old_table[i]->str, old_table[i]->len, old_table[i]->hash) = old_table[i];
+        }
+    }
+    lilycc_free(old_table);
+}
+
+// Get the existing interned copy of a string, or intern a new copy of it.
+// The returned string stays valid until the pool is cleared.
+char const *strpool_intern(strpool_t *pool, char const *str, size_t len) {
+    assert(len < UINT32_MAX);
+    // Keep the load factor below 1/2.
+    if ((pool->len + 1) * 2 > pool->table_cap) {
+        strpool_grow(pool);
+    }
+
+    uint32_t        hash = hash_mem(str, len);
+    strpool_ent_t **slot = strpool_slot(pool, str, len, hash);
+    if (*slot) {
+        return (*slot)->str;
+    }
+
+    strpool_ent_t *ent = arena_alloc_aligned(&pool->arena, sizeof(strpool_ent_t) + len + 1, _Alignof(strpool_ent_t));
+    ent->hash          = hash;
+    ent->len           = len;
+    memcpy(ent->str, str, len);
+    ent->str[len] = 0;
+    *slot         = ent;
+    pool->len++;
+    return ent->str;
+}
+
+// Get the existing interned copy of a string, or NULL if it was never interned.
+char const *strpool_find(strpool_t const *pool, char const *str, size_t len) {
+    if (!pool->table_cap) {
+        return NULL;
+    }
+    strpool_ent_t *ent = *strpool_slot(pool, str, len, hash_mem(str, len));
+    return ent ? ent->str : NULL;
+}
+
+// Free all interned strings.
+void strpool_clear(strpool_t *pool) {
+    arena_clear(&pool->arena);
+    lilycc_free(pool->table);
+    pool->table     = NULL;
+    pool->table_cap = 0;
+    pool->len       = 0;
+}
@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: 2026 Julian Scheffers <julian@scheffers.net>
+// SPDX-FileType: SOURCE
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "arena.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+// Interned string pool.
+typedef struct strpool     strpool_t;
+// Interned string pool entry.
+typedef struct strpool_ent strpool_ent_t;
+
+
+
+// Interned string pool.
+// Every distinct string is stored exactly once, so interned strings can be compared by pointer.
+struct strpool {
+    // Open-addressing hash table of entries; capacity is always a power of 2.
+    strpool_ent_t **table;
+    // Capacity of `table`.
+    size_t          table_cap;
+    // Number of interned strings.
+    size_t          len;
+    // Memory that entries are allocated from.
+    arena_t         arena;
+};
+
+// Interned string pool entry.
+struct strpool_ent {
+    // Hash of the string, as computed by `hash_mem`.
+    uint32_t hash;
+    // Length of the string in bytes, excluding the NUL terminator.
+    uint32_t len;
+    // NUL-terminated string data.
+    char     str[];
+};
+
+
+
+// Get the existing interned copy of a string, or intern a new copy of it.
+// The returned string stays valid until the pool is cleared.
+char const *strpool_intern(strpool_t *pool, char const *str, size_t len);
+// Get the existing interned copy of a string, or NULL if it was never interned.
+char const *strpool_find(strpool_t const *pool, char const *str, size_t len) __attribute__((pure));
+// Free all interned strings.
+void        strpool_clear(strpool_t *pool);
+
+// Get the pool entry of an interned string.
+static inline strpool_ent_t const *strpool_ent(char const *interned) {
+    return (strpool_ent_t const *)(interned - offsetof(strpool_ent_t, str));
+}
@@ -5,6 +5,12 @@
 
 #include "utf8.h"
 
+#include <string.h>
+
+#if defined __AVX2__ || defined __SSE2__
+#include <immintrin.h>
+#endif
+
 
 
 /// UTF-8 encode a single character.
@@ -104,3 +110,47 @@ int utf8_decode(char const *str, size_t len, size_t *offset) {
 
     return val;
 }
+
+/// Measure how many bytes at the start of a buffer are 7-bit ASCII.
+/// Uses SSE2/AVX2 if available, otherwise checks a machine word at a time.
+/// @param str Buffer to scan
+/// @param len Buffer length in bytes
+/// @return Length of the pure-ASCII prefix in bytes (equal to `len` if the whole buffer is ASCII)
+size_t utf8_ascii_len(char const *str, size_t len) {
+    size_t i = 0;
+
+#if defined __AVX2__
+    for (; i + 32 <= len; i += 32) {
+        __m256i  chunk = _mm256_loadu_si256((__m256i const *)(str + i));
+        uint32_t mask  = (uint32_t)_mm256_movemask_epi8(chunk);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined __SSE2__
+    for (; i + 16 <= len; i += 16) {
+        __m128i  chunk = _mm_loadu_si128((__m128i const *)(str + i));
+        uint32_t mask  = (uint32_t)_mm_movemask_epi8(chunk);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    // Word-at-a-time for whatever is left (or everything, if there is no SIMD).
+    uint64_t const high_bits = 0x8080808080808080llu;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, str + i, 8);
+        if (word & high_bits) {
+            break;
+        }
+    }
+
+    // Find the exact offset of the first non-ASCII byte.
+    while (i < len && !(str[i] & 0x80)) {
+        i++;
+    }
+    return i;
+}
@@ -25,3 +25,10 @@ uint8_t utf8_encode(char *str, size_t cap, int val);
 /// @param offset In/out current buffer offset
 /// @return A UTF-8 codepoint, or 0xFFFD if incorrectly encoded.
 int utf8_decode(char const *str, size_t len, size_t *offset);
+
+/// Measure how many bytes at the start of a buffer are 7-bit ASCII.
+/// Uses SSE2/AVX2 if available, otherwise checks a machine word at a time.
+/// @param str Buffer to scan
+/// @param len Buffer length in bytes
+/// @return Length of the pure-ASCII prefix in bytes (equal to `len` if the whole buffer is ASCII)
+size_t utf8_ascii_len(char const *str, size_t len);